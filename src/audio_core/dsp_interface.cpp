@@ -2,6 +2,8 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include "audio_core/dsp_interface.h"
 #include "audio_core/sink.h"
@@ -11,16 +13,47 @@
 #include "core/dumping/backend.h"
 #include "core/settings.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
 namespace AudioCore {
 
-DspInterface::DspInterface() = default;
+/// Multiplies every sample by factor, truncating towards zero. factor must be within [0, 1].
+static void ScaleVolume(s16* samples, std::size_t num_samples, float factor) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    // Same arithmetic as the scalar loop below (s16 -> float, multiply, truncate), eight samples
+    // at a time. The products cannot overflow s16 since factor <= 1.
+    const __m128 factor_vec = _mm_set1_ps(factor);
+    for (; i + 8 <= num_samples; i += 8) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+        const __m128i scaled_lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), factor_vec));
+        const __m128i scaled_hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), factor_vec));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i),
+                         _mm_packs_epi32(scaled_lo, scaled_hi));
+    }
+#endif
+    for (; i < num_samples; i++) {
+        samples[i] = static_cast<s16>(samples[i] * factor);
+    }
+}
+
+DspInterface::DspInterface()
+    : stretching_mode(Settings::AudioStretchingMode::SoundTouch),
+      active_stretching_mode(Settings::AudioStretchingMode::SoundTouch) {}
+
 DspInterface::~DspInterface() = default;
 
 void DspInterface::SetSink(const std::string& sink_id, const std::string& audio_device) {
     sink = CreateSinkFromID(Settings::values.sink_id, Settings::values.audio_device_id);
     sink->SetCallback(
         [this](s16* buffer, std::size_t num_frames) { OutputCallback(buffer, num_frames); });
-    time_stretcher.SetOutputSampleRate(sink->GetNativeSampleRate());
+    output_sample_rate = sink->GetNativeSampleRate();
+    time_stretcher.SetOutputSampleRate(output_sample_rate);
+    latency_stretcher.SetSampleRate(output_sample_rate);
 }
 
 Sink& DspInterface::GetSink() {
@@ -38,6 +71,11 @@ void DspInterface::EnableStretching(bool enable) {
     perform_time_stretching = enable;
 }
 
+void DspInterface::SetStretchingMode(Settings::AudioStretchingMode mode, u32 target_latency_ms_) {
+    target_latency_ms = target_latency_ms_;
+    stretching_mode = mode;
+}
+
 void DspInterface::OutputFrame(StereoFrame16 frame) {
     if (!sink)
         return;
@@ -62,16 +100,74 @@ void DspInterface::OutputSample(std::array<s16, 2> sample) {
     }
 }
 
+DspInterface::OutputStats DspInterface::GetAndResetOutputStats() {
+    OutputStats stats{};
+    stats.callbacks = stats_callbacks.exchange(0);
+    stats.underruns = stats_underruns.exchange(0);
+    stats.fifo_fill = fifo.Size();
+    stats.fifo_capacity = fifo.Capacity();
+    const u64 jitter_sum_us = stats_jitter_sum_us.exchange(0);
+    stats.mean_callback_jitter_ms =
+        stats.callbacks == 0 ? 0.0 : jitter_sum_us / 1000.0 / stats.callbacks;
+    stats.max_callback_jitter_ms = stats_jitter_max_us.exchange(0) / 1000.0;
+    return stats;
+}
+
+void DspInterface::UpdateOutputStats(std::size_t num_frames, std::size_t frames_written) {
+    const auto now = std::chrono::steady_clock::now();
+    if (last_callback_time != std::chrono::steady_clock::time_point{}) {
+        const auto interval = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - last_callback_time);
+        const s64 expected_us = static_cast<s64>(num_frames) * 1000000 / output_sample_rate;
+        const u64 jitter_us = static_cast<u64>(std::abs(interval.count() - expected_us));
+        stats_jitter_sum_us += jitter_us;
+        if (jitter_us > stats_jitter_max_us.load(std::memory_order_relaxed)) {
+            stats_jitter_max_us = jitter_us;
+        }
+    }
+    last_callback_time = now;
+
+    stats_callbacks++;
+    if (frames_written < num_frames) {
+        stats_underruns++;
+    }
+}
+
 void DspInterface::OutputCallback(s16* buffer, std::size_t num_frames) {
+    // Audio still held by the previously used stretcher is dropped when switching.
+    const Settings::AudioStretchingMode mode = stretching_mode;
+    if (mode != active_stretching_mode) {
+        if (active_stretching_mode == Settings::AudioStretchingMode::LatencyTargeting) {
+            latency_stretcher.Clear();
+        } else {
+            time_stretcher.Clear();
+        }
+        active_stretching_mode = mode;
+    }
+
     std::size_t frames_written;
-    if (perform_time_stretching) {
-        const std::vector<s16> in{fifo.Pop()};
-        const std::size_t num_in{in.size() / 2};
-        frames_written = time_stretcher.Process(in.data(), num_in, buffer, num_frames);
+    if (perform_time_stretching && mode == Settings::AudioStretchingMode::LatencyTargeting) {
+        latency_stretcher.SetTargetLatency(target_latency_ms);
+        frames_written = latency_stretcher.Process(fifo, buffer, num_frames);
+    } else if (perform_time_stretching) {
+        // Feed the stretcher straight out of the FIFO and let it write into the sink's buffer.
+        const std::size_t num_in = fifo.Size();
+        if (time_stretcher.UpdateRatio(num_in, num_frames)) {
+            fifo.Consume(
+                [this](const s16* in, std::size_t count) { time_stretcher.PushSamples(in, count); },
+                num_in);
+        } else {
+            fifo.Discard(num_in);
+        }
+        frames_written = time_stretcher.ReceiveSamples(buffer, num_frames);
     } else if (flushing_time_stretcher) {
-        time_stretcher.Flush();
-        frames_written = time_stretcher.Process(nullptr, 0, buffer, num_frames);
-        frames_written += fifo.Pop(buffer, num_frames - frames_written);
+        if (mode == Settings::AudioStretchingMode::LatencyTargeting) {
+            frames_written = latency_stretcher.Flush(buffer, num_frames);
+        } else {
+            time_stretcher.Flush();
+            frames_written = time_stretcher.Process(nullptr, 0, buffer, num_frames);
+        }
+        frames_written += fifo.Pop(buffer + 2 * frames_written, num_frames - frames_written);
         flushing_time_stretcher = false;
     } else {
         frames_written = fifo.Pop(buffer, num_frames);
@@ -81,6 +177,8 @@ void DspInterface::OutputCallback(s16* buffer, std::size_t num_frames) {
         std::memcpy(&last_frame[0], buffer + 2 * (frames_written - 1), 2 * sizeof(s16));
     }
 
+    UpdateOutputStats(num_frames, frames_written);
+
     // Hold last emitted frame; this prevents popping.
     for (std::size_t i = frames_written; i < num_frames; i++) {
         std::memcpy(buffer + 2 * i, &last_frame[0], 2 * sizeof(s16));
@@ -88,13 +186,13 @@ void DspInterface::OutputCallback(s16* buffer, std::size_t num_frames) {
 
     // Implementation of the hardware volume slider with a dynamic range of 60 dB
     const float linear_volume = std::clamp(Settings::values.volume, 0.0f, 1.0f);
-    if (linear_volume != 1.0) {
-        const float volume_scale_factor =
+    if (linear_volume != last_volume) {
+        last_volume = linear_volume;
+        volume_scale_factor =
             linear_volume == 0 ? 0 : std::exp(6.90775f * linear_volume) * 0.001f;
-        for (std::size_t i = 0; i < num_frames; i++) {
-            buffer[i * 2 + 0] = static_cast<s16>(buffer[i * 2 + 0] * volume_scale_factor);
-            buffer[i * 2 + 1] = static_cast<s16>(buffer[i * 2 + 1] * volume_scale_factor);
-        }
+    }
+    if (linear_volume != 1.0) {
+        ScaleVolume(buffer, num_frames * 2, volume_scale_factor);
     }
 }
 
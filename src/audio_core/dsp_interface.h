@@ -4,10 +4,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <boost/serialization/access.hpp>
 #include "audio_core/audio_types.h"
+#include "audio_core/latency_stretcher.h"
 #include "audio_core/time_stretch.h"
 #include "common/common_types.h"
 #include "common/ring_buffer.h"
@@ -17,6 +20,10 @@ namespace Service::DSP {
 class DSP_DSP;
 } // namespace Service::DSP
 
+namespace Settings {
+enum class AudioStretchingMode;
+} // namespace Settings
+
 namespace AudioCore {
 
 class Sink;
@@ -84,6 +91,14 @@ public:
     /// Returns a reference to the array backing DSP memory
     virtual std::array<u8, Memory::DSP_RAM_SIZE>& GetDspMemory() = 0;
 
+    /**
+     * Returns the handler the emulated CPU accesses DSP memory through when the DSP runs on
+     * another thread, or nullptr when the CPU can map GetDspMemory directly.
+     */
+    virtual Memory::MMIORegionPointer GetDspMemoryHandler() {
+        return nullptr;
+    }
+
     /// Sets the dsp class that we trigger interrupts for
     virtual void SetServiceToInterrupt(std::weak_ptr<Service::DSP::DSP_DSP> dsp) = 0;
 
@@ -99,6 +114,27 @@ public:
     Sink& GetSink();
     /// Enable/Disable audio stretching.
     void EnableStretching(bool enable);
+    /// Select the stretcher to use, and the output latency the latency-targeting one aims for.
+    void SetStretchingMode(Settings::AudioStretchingMode mode, u32 target_latency_ms);
+
+    /// Statistics about the path from the DSP to the sink.
+    struct OutputStats {
+        /// Number of sink callbacks since the last reset
+        u64 callbacks;
+        /// Number of sink callbacks that ran out of audio and had to hold the last frame
+        u64 underruns;
+        /// Number of stereo frames currently waiting in the output FIFO
+        std::size_t fifo_fill;
+        /// Capacity of the output FIFO, in stereo frames
+        std::size_t fifo_capacity;
+        /// Mean and maximum deviation of the interval between sink callbacks from the interval
+        /// implied by the number of frames requested, in milliseconds
+        double mean_callback_jitter_ms;
+        double max_callback_jitter_ms;
+    };
+
+    /// Returns the output statistics gathered since the last call. Thread-safe.
+    OutputStats GetAndResetOutputStats();
 
 protected:
     void OutputFrame(StereoFrame16 frame);
@@ -108,12 +144,31 @@ private:
     void FlushResidualStretcherAudio();
     void OutputCallback(s16* buffer, std::size_t num_frames);
 
+    void UpdateOutputStats(std::size_t num_frames, std::size_t frames_written);
+
     std::atomic<bool> perform_time_stretching = false;
     std::atomic<bool> flushing_time_stretcher = false;
+    std::atomic<Settings::AudioStretchingMode> stretching_mode;
+    std::atomic<u32> target_latency_ms = 40;
     Common::RingBuffer<s16, 0x2000, 2> fifo;
     std::array<s16, 2> last_frame{};
     TimeStretcher time_stretcher;
+    LatencyStretcher latency_stretcher;
+    /// The stretcher currently holding audio. Only accessed from the sink callback.
+    Settings::AudioStretchingMode active_stretching_mode;
     std::unique_ptr<Sink> sink;
+    unsigned int output_sample_rate = native_sample_rate;
+
+    // Volume slider state. Only accessed from the sink callback.
+    float last_volume = 1.0f;
+    float volume_scale_factor = 1.0f;
+
+    // Output statistics. Written by the sink callback, read and reset by GetAndResetOutputStats.
+    std::chrono::steady_clock::time_point last_callback_time{};
+    std::atomic<u64> stats_callbacks{0};
+    std::atomic<u64> stats_underruns{0};
+    std::atomic<u64> stats_jitter_sum_us{0};
+    std::atomic<u64> stats_jitter_max_us{0};
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {}
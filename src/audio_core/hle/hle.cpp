@@ -28,8 +28,10 @@
 #include "common/common_types.h"
 #include "common/hash.h"
 #include "common/logging/log.h"
+#include "common/thread_pool.h"
 #include "core/core.h"
 #include "core/core_timing.h"
+#include "core/settings.h"
 
 SERIALIZE_EXPORT_IMPL(AudioCore::DspHle)
 
@@ -38,7 +40,9 @@ using Service::DSP::DSP_DSP;
 
 namespace AudioCore {
 
-DspHle::DspHle() : DspHle(Core::System::GetInstance().Memory()) {}
+DspHle::DspHle()
+    : DspHle(Core::System::GetInstance().Memory(), Core::System::GetInstance().CoreTiming(),
+             Settings::values.enable_dsp_hle_multithread) {}
 
 template <class Archive>
 void DspHle::serialize(Archive& ar, const unsigned int) {
@@ -56,7 +60,8 @@ static constexpr u64 audio_frame_ticks = samples_per_frame * 4096 * 2ull; ///< U
 
 struct DspHle::Impl final {
 public:
-    explicit Impl(DspHle& parent, Memory::MemorySystem& memory);
+    explicit Impl(DspHle& parent, Memory::MemorySystem& memory, Core::Timing& timing,
+                  bool multithread);
     ~Impl();
 
     DspState GetDspState() const;
@@ -80,6 +85,8 @@ private:
     HLE::SharedMemory& ReadRegion();
     HLE::SharedMemory& WriteRegion();
 
+    void GenerateIntermediateMixes(HLE::SharedMemory& read, HLE::SharedMemory& write,
+                                   std::array<QuadFrame32, 3>& intermediate_mixes);
     StereoFrame16 GenerateCurrentFrame();
     bool Tick();
     void AudioTickCallback(s64 cycles_late);
@@ -98,10 +105,14 @@ private:
     HLE::Mixers mixers{};
 
     DspHle& parent;
+    Core::Timing& timing;
     Core::TimingEventType* tick_event{};
 
     std::unique_ptr<HLE::DecoderBase> decoder{};
 
+    /// Workers used to tick sources in parallel. Null when sources are processed serially.
+    std::unique_ptr<Common::ThreadPool> source_workers{};
+
     std::weak_ptr<DSP_DSP> dsp_dsp{};
 
     template <class Archive>
@@ -116,13 +127,24 @@ private:
     friend class boost::serialization::access;
 };
 
-DspHle::Impl::Impl(DspHle& parent_, Memory::MemorySystem& memory) : parent(parent_) {
+DspHle::Impl::Impl(DspHle& parent_, Memory::MemorySystem& memory, Core::Timing& timing_,
+                   bool multithread)
+    : parent(parent_), timing(timing_) {
     dsp_memory.raw_memory.fill(0);
 
     for (auto& source : sources) {
         source.SetMemory(memory);
     }
 
+    if (multithread) {
+        // A handful of workers is plenty for 24 sources; more just adds wakeup latency.
+        const std::size_t num_workers = Common::ThreadPool::DefaultThreadCount(3);
+        if (num_workers > 0) {
+            source_workers = std::make_unique<Common::ThreadPool>(num_workers, "DspHle Sources");
+        }
+        LOG_INFO(Audio_DSP, "Processing sources on {} worker threads", num_workers);
+    }
+
 #if defined(HAVE_MF) && defined(HAVE_FFMPEG)
     decoder = std::make_unique<HLE::WMFDecoder>(memory);
     if (!decoder->IsValid()) {
@@ -148,7 +170,6 @@ DspHle::Impl::Impl(DspHle& parent_, Memory::MemorySystem& memory) : parent(paren
         decoder = std::make_unique<HLE::NullDecoder>();
     }
 
-    Core::Timing& timing = Core::System::GetInstance().CoreTiming();
     tick_event =
         timing.RegisterEvent("AudioCore::DspHle::tick_event", [this](u64, s64 cycles_late) {
             this->AudioTickCallback(cycles_late);
@@ -157,7 +178,6 @@ DspHle::Impl::Impl(DspHle& parent_, Memory::MemorySystem& memory) : parent(paren
 }
 
 DspHle::Impl::~Impl() {
-    Core::Timing& timing = Core::System::GetInstance().CoreTiming();
     timing.UnscheduleEvent(tick_event, 0);
 }
 
@@ -398,6 +418,35 @@ HLE::SharedMemory& DspHle::Impl::WriteRegion() {
     return CurrentRegionIndex() != 0 ? dsp_memory.region_0 : dsp_memory.region_1;
 }
 
+void DspHle::Impl::GenerateIntermediateMixes(HLE::SharedMemory& read, HLE::SharedMemory& write,
+                                             std::array<QuadFrame32, 3>& intermediate_mixes) {
+    if (!source_workers) {
+        for (std::size_t i = 0; i < HLE::num_sources; i++) {
+            write.source_statuses.status[i] = sources[i].Tick(read.source_configurations.config[i],
+                                                              read.adpcm_coefficients.coeff[i]);
+            for (std::size_t mix = 0; mix < 3; mix++) {
+                sources[i].MixInto(intermediate_mixes[mix], mix);
+            }
+        }
+        return;
+    }
+
+    // Sources only touch their own configuration, status and state until they are mixed, so they
+    // can be ticked independently.
+    source_workers->ParallelFor(HLE::num_sources, [&](std::size_t i) {
+        write.source_statuses.status[i] =
+            sources[i].Tick(read.source_configurations.config[i], read.adpcm_coefficients.coeff[i]);
+    });
+
+    // Each intermediate mix is only written by one worker and still accumulates the sources in
+    // ascending order, so the result is bit-identical to the serial path.
+    source_workers->ParallelFor(intermediate_mixes.size(), [&](std::size_t mix) {
+        for (const auto& source : sources) {
+            source.MixInto(intermediate_mixes[mix], mix);
+        }
+    });
+}
+
 StereoFrame16 DspHle::Impl::GenerateCurrentFrame() {
     HLE::SharedMemory& read = ReadRegion();
     HLE::SharedMemory& write = WriteRegion();
@@ -405,13 +454,7 @@ StereoFrame16 DspHle::Impl::GenerateCurrentFrame() {
     std::array<QuadFrame32, 3> intermediate_mixes = {};
 
     // Generate intermediate mixes
-    for (std::size_t i = 0; i < HLE::num_sources; i++) {
-        write.source_statuses.status[i] =
-            sources[i].Tick(read.source_configurations.config[i], read.adpcm_coefficients.coeff[i]);
-        for (std::size_t mix = 0; mix < 3; mix++) {
-            sources[i].MixInto(intermediate_mixes[mix], mix);
-        }
-    }
+    GenerateIntermediateMixes(read, write, intermediate_mixes);
 
     // Generate final mix
     write.dsp_status = mixers.Tick(read.dsp_configuration, read.intermediate_mix_samples,
@@ -452,11 +495,11 @@ void DspHle::Impl::AudioTickCallback(s64 cycles_late) {
     }
 
     // Reschedule recurrent event
-    Core::Timing& timing = Core::System::GetInstance().CoreTiming();
     timing.ScheduleEvent(audio_frame_ticks - cycles_late, tick_event);
 }
 
-DspHle::DspHle(Memory::MemorySystem& memory) : impl(std::make_unique<Impl>(*this, memory)) {}
+DspHle::DspHle(Memory::MemorySystem& memory, Core::Timing& timing, bool multithread)
+    : impl(std::make_unique<Impl>(*this, memory, timing, multithread)) {}
 DspHle::~DspHle() = default;
 
 u16 DspHle::RecvData(u32 register_number) {
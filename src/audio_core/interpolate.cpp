@@ -6,6 +6,11 @@
 #include "audio_core/interpolate.h"
 #include "common/assert.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <immintrin.h>
+#include "common/x64/cpu_detect.h"
+#endif
+
 namespace AudioCore::AudioInterp {
 
 // Calculations are done in fixed point with 24 fractional bits.
@@ -73,4 +78,252 @@ void Linear(State& state, StereoBuffer16& input, float rate, StereoFrame16& outp
                     });
 }
 
+namespace {
+
+// Polyphase filter coefficients are Q14 fixed point. The centre tap of phase 0 is exactly 1.0,
+// which would not fit into Q15.
+constexpr unsigned polyphase_coeff_bits = 14;
+constexpr unsigned polyphase_phase_bits = 9;
+constexpr std::size_t polyphase_phases = 1 << polyphase_phase_bits;
+/// Kaiser window shape parameter. Trades transition width for stopband attenuation.
+constexpr double polyphase_kaiser_beta = 7.0;
+
+namespace ConstexprMath {
+
+constexpr double pi = 3.14159265358979323846;
+
+constexpr double Sin(double x) {
+    while (x > pi) {
+        x -= 2 * pi;
+    }
+    while (x < -pi) {
+        x += 2 * pi;
+    }
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 14; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double Sqrt(double x) {
+    if (x <= 0) {
+        return 0;
+    }
+    double guess = x > 1 ? x : 1;
+    for (int i = 0; i < 32; i++) {
+        guess = 0.5 * (guess + x / guess);
+    }
+    return guess;
+}
+
+/// Zeroth-order modified Bessel function of the first kind.
+constexpr double BesselI0(double x) {
+    double term = 1;
+    double sum = 1;
+    for (int k = 1; k < 32; k++) {
+        const double t = x / (2 * k);
+        term *= t * t;
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double Round(double x) {
+    return x >= 0 ? static_cast<double>(static_cast<s64>(x + 0.5))
+                  : static_cast<double>(static_cast<s64>(x - 0.5));
+}
+
+} // namespace ConstexprMath
+
+/// One filter per phase. The table has an extra entry so that a fraction rounded up to 1.0 does
+/// not need to be special-cased.
+struct PolyphaseTable {
+    alignas(32) std::array<std::array<s16, polyphase_taps>, polyphase_phases + 1> coeffs{};
+};
+
+constexpr PolyphaseTable GeneratePolyphaseTable() {
+    using namespace ConstexprMath;
+
+    constexpr double half_width = polyphase_taps / 2;
+    constexpr double scale = 1 << polyphase_coeff_bits;
+
+    PolyphaseTable table{};
+    for (std::size_t phase = 0; phase <= polyphase_phases; phase++) {
+        const double fraction = static_cast<double>(phase) / polyphase_phases;
+
+        std::array<double, polyphase_taps> h{};
+        double sum = 0;
+        for (std::size_t tap = 0; tap < polyphase_taps; tap++) {
+            // Distance between this tap and the output position, which lies between taps 7 and 8.
+            const double x = static_cast<double>(tap) - (half_width - 1) - fraction;
+            const double sinc = x == 0 ? 1.0 : Sin(pi * x) / (pi * x);
+            const double t = x / half_width;
+            const double window = BesselI0(polyphase_kaiser_beta * Sqrt(1 - t * t)) /
+                                  BesselI0(polyphase_kaiser_beta);
+            h[tap] = sinc * window;
+            sum += h[tap];
+        }
+
+        // Normalise for unity DC gain, then put the rounding residue into the largest tap so
+        // that the fixed point coefficients also sum to exactly 1.0.
+        s32 fixed_sum = 0;
+        std::size_t largest = 0;
+        for (std::size_t tap = 0; tap < polyphase_taps; tap++) {
+            const s32 c = static_cast<s32>(Round(h[tap] / sum * scale));
+            table.coeffs[phase][tap] = static_cast<s16>(c);
+            fixed_sum += c;
+            if (h[tap] > h[largest]) {
+                largest = tap;
+            }
+        }
+        table.coeffs[phase][largest] += static_cast<s16>(static_cast<s32>(scale) - fixed_sum);
+    }
+    return table;
+}
+
+constexpr PolyphaseTable polyphase_table = GeneratePolyphaseTable();
+
+static_assert(polyphase_table.coeffs[0][polyphase_taps / 2 - 1] == 1 << polyphase_coeff_bits,
+              "Phase zero must pass samples through unchanged");
+
+std::array<s16, 2> PolyphaseKernelGeneric(const s16* left, const s16* right, const s16* coeffs) {
+    s32 acc_left = 0;
+    s32 acc_right = 0;
+    for (std::size_t tap = 0; tap < polyphase_taps; tap++) {
+        acc_left += left[tap] * coeffs[tap];
+        acc_right += right[tap] * coeffs[tap];
+    }
+    constexpr s32 rounding = 1 << (polyphase_coeff_bits - 1);
+    return {
+        static_cast<s16>(std::clamp((acc_left + rounding) >> polyphase_coeff_bits, -32768, 32767)),
+        static_cast<s16>(std::clamp((acc_right + rounding) >> polyphase_coeff_bits, -32768, 32767)),
+    };
+}
+
+#ifdef ARCHITECTURE_x86_64
+
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/// Rounds, shifts and saturates the accumulators in lanes 0 (left) and 1 (right).
+FORCE_INLINE std::array<s16, 2> PolyphaseNarrow(__m128i acc) {
+    constexpr s32 rounding = 1 << (polyphase_coeff_bits - 1);
+    acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(rounding)), polyphase_coeff_bits);
+    const u32 packed = static_cast<u32>(_mm_cvtsi128_si32(_mm_packs_epi32(acc, acc)));
+    return {static_cast<s16>(packed & 0xFFFF), static_cast<s16>(packed >> 16)};
+}
+
+std::array<s16, 2> PolyphaseKernelSSE2(const s16* left, const s16* right, const s16* coeffs) {
+    const __m128i c0 = _mm_load_si128(reinterpret_cast<const __m128i*>(coeffs));
+    const __m128i c1 = _mm_load_si128(reinterpret_cast<const __m128i*>(coeffs + 8));
+    const __m128i acc_left = _mm_add_epi32(
+        _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left)), c0),
+        _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(left + 8)), c1));
+    const __m128i acc_right = _mm_add_epi32(
+        _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(right)), c0),
+        _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(right + 8)), c1));
+
+    // [l0+l2, r0+r2, l1+l3, r1+r3] -> [l, r, ...]
+    __m128i acc = _mm_add_epi32(_mm_unpacklo_epi32(acc_left, acc_right),
+                                _mm_unpackhi_epi32(acc_left, acc_right));
+    acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+    return PolyphaseNarrow(acc);
+}
+
+TARGET_AVX2 std::array<s16, 2> PolyphaseKernelAVX2(const s16* left, const s16* right,
+                                                   const s16* coeffs) {
+    const __m256i c = _mm256_load_si256(reinterpret_cast<const __m256i*>(coeffs));
+    const __m256i acc_left =
+        _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(left)), c);
+    const __m256i acc_right =
+        _mm256_madd_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(right)), c);
+
+    // [l01, l23, r01, r23 | l45, l67, r45, r67] -> [l, r, l, r]
+    const __m256i sums = _mm256_hadd_epi32(acc_left, acc_right);
+    __m128i acc =
+        _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    acc = _mm_hadd_epi32(acc, acc);
+    return PolyphaseNarrow(acc);
+}
+
+#undef TARGET_AVX2
+
+#endif // ARCHITECTURE_x86_64
+
+} // Anonymous namespace
+
+std::vector<std::pair<const char*, PolyphaseKernel>> GetPolyphaseKernels() {
+    std::vector<std::pair<const char*, PolyphaseKernel>> kernels{
+        {"generic", PolyphaseKernelGeneric}};
+#ifdef ARCHITECTURE_x86_64
+    kernels.emplace_back("SSE2", PolyphaseKernelSSE2);
+    if (Common::GetCPUCaps().avx2) {
+        kernels.emplace_back("AVX2", PolyphaseKernelAVX2);
+    }
+#endif
+    return kernels;
+}
+
+void Polyphase(State& state, StereoBuffer16& input, float rate, StereoFrame16& output,
+               std::size_t& outputi) {
+    ASSERT(rate > 0);
+
+    static const PolyphaseKernel kernel = GetPolyphaseKernels().back().second;
+
+    constexpr std::size_t history_size = polyphase_taps - 1;
+    constexpr std::size_t scratch_size = 512;
+    constexpr u64 phase_shift = 24 - polyphase_phase_bits;
+    constexpr u64 phase_round = 1 << (phase_shift - 1);
+
+    const u64 step_size = static_cast<u64>(rate * scale_factor);
+
+    // The kernels want planar input that is contiguous in memory, so the history and as much of
+    // the input as fits are deinterleaved into scratch buffers, one chunk at a time.
+    alignas(32) std::array<s16, scratch_size> left;
+    alignas(32) std::array<s16, scratch_size> right;
+
+    while (outputi < output.size() && !input.empty()) {
+        for (std::size_t i = 0; i < history_size; i++) {
+            left[i] = state.polyphase_history[i][0];
+            right[i] = state.polyphase_history[i][1];
+        }
+        const std::size_t available = std::min(input.size(), scratch_size - history_size);
+        auto it = input.begin();
+        for (std::size_t i = history_size; i < history_size + available; i++, ++it) {
+            left[i] = (*it)[0];
+            right[i] = (*it)[1];
+        }
+
+        u64 fposition = state.fposition;
+        while (outputi < output.size()) {
+            const std::size_t inputi = static_cast<std::size_t>(fposition >> 24);
+            if (inputi >= available) {
+                break;
+            }
+
+            const std::size_t phase = static_cast<std::size_t>(
+                ((fposition & scale_mask) + phase_round) >> phase_shift);
+            output[outputi++] =
+                kernel(&left[inputi], &right[inputi], polyphase_table.coeffs[phase].data());
+
+            fposition += step_size;
+        }
+
+        const std::size_t consumed =
+            std::min(static_cast<std::size_t>(fposition >> 24), available);
+        for (std::size_t i = 0; i < history_size; i++) {
+            state.polyphase_history[i] = {left[consumed + i], right[consumed + i]};
+        }
+        state.fposition = fposition - consumed * scale_factor;
+
+        input.erase(input.begin(), std::next(input.begin(), consumed));
+    }
+}
+
 } // namespace AudioCore::AudioInterp
@@ -5,7 +5,10 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <deque>
+#include <utility>
+#include <vector>
 #include "audio_core/audio_types.h"
 #include "common/common_types.h"
 
@@ -14,10 +17,15 @@ namespace AudioCore::AudioInterp {
 /// A variable length buffer of signed PCM16 stereo samples.
 using StereoBuffer16 = std::deque<std::array<s16, 2>>;
 
+/// Number of taps of the windowed-sinc filter used by polyphase interpolation.
+constexpr std::size_t polyphase_taps = 16;
+
 struct State {
     /// Two historical samples.
     std::array<s16, 2> xn1 = {}; ///< x[n-1]
     std::array<s16, 2> xn2 = {}; ///< x[n-2]
+    /// Historical samples for polyphase interpolation, oldest first.
+    std::array<std::array<s16, 2>, polyphase_taps - 1> polyphase_history = {};
     /// Current fractional position.
     u64 fposition = 0;
 };
@@ -46,4 +54,27 @@ void None(State& state, StereoBuffer16& input, float rate, StereoFrame16& output
 void Linear(State& state, StereoBuffer16& input, float rate, StereoFrame16& output,
             std::size_t& outputi);
 
+/**
+ * Polyphase interpolation. This is a 16-tap Kaiser-windowed sinc filter with 512 phases.
+ * There is an eight-sample predelay.
+ * @param state Interpolation state.
+ * @param input Input buffer.
+ * @param rate Stretch factor. Must be a positive non-zero value.
+ *             rate > 1.0 performs decimation and rate < 1.0 performs upsampling.
+ * @param output The resampled audio buffer.
+ * @param outputi The index of output to start writing to.
+ */
+void Polyphase(State& state, StereoBuffer16& input, float rate, StereoFrame16& output,
+               std::size_t& outputi);
+
+/**
+ * Computes one stereo sample of polyphase interpolation from planar input: the taps starting at
+ * left and right are weighted by coeffs, which are Q14 fixed point and aligned to 32 bytes.
+ */
+using PolyphaseKernel = std::array<s16, 2> (*)(const s16* left, const s16* right,
+                                                const s16* coeffs);
+
+/// Returns every polyphase kernel the host CPU can run, by name. Polyphase uses the last one.
+std::vector<std::pair<const char*, PolyphaseKernel>> GetPolyphaseKernels();
+
 } // namespace AudioCore::AudioInterp
@@ -0,0 +1,231 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "audio_core/latency_stretcher.h"
+#include "common/logging/log.h"
+
+namespace AudioCore {
+
+namespace {
+
+// WSOLA parameters. Each segment produces (sequence - overlap) frames of output; the seek window
+// bounds how far the segment start may move to line up with the previous segment's waveform.
+constexpr double sequence_ms = 12.0;
+constexpr double overlap_ms = 3.0;
+constexpr double seek_window_ms = 6.0;
+/// The seek first tries every n-th offset, then refines around the best one.
+constexpr std::size_t coarse_seek_step = 4;
+
+// Controller parameters. The error is measured in seconds, so with these gains the loop settles
+// within a few seconds and a 40ms overshoot speeds playback up by 10%.
+constexpr double proportional_gain = 2.5; // per second
+constexpr double integral_gain = 2.5;     // per second squared
+/// Time constant of the low-pass filter on the measured fill, which otherwise saw-tooths with
+/// the sizes of the frames pushed and the callbacks.
+constexpr double fill_filter_time = 0.1; // seconds
+constexpr double min_tempo = 0.1;
+constexpr double max_tempo = 4.0;
+/// Audio beyond this multiple of the target is dropped rather than played back faster.
+constexpr double max_overshoot = 4.0;
+
+std::size_t MillisecondsToFrames(double milliseconds, unsigned int sample_rate) {
+    return std::max<std::size_t>(
+        static_cast<std::size_t>(milliseconds * sample_rate / 1000.0 + 0.5), 1);
+}
+
+} // Anonymous namespace
+
+LatencyStretcher::LatencyStretcher(unsigned int sample_rate) {
+    SetSampleRate(sample_rate);
+}
+
+LatencyStretcher::~LatencyStretcher() = default;
+
+void LatencyStretcher::SetSampleRate(unsigned int sample_rate_) {
+    sample_rate = sample_rate_;
+    sequence_length = MillisecondsToFrames(sequence_ms, sample_rate);
+    overlap_length = MillisecondsToFrames(overlap_ms, sample_rate);
+    seek_length = MillisecondsToFrames(seek_window_ms, sample_rate);
+
+    input.assign(2 * (seek_length + sequence_length), 0);
+    overlap.assign(2 * overlap_length, 0);
+    overlap_reference.assign(overlap_length, 0.0f);
+    seek_scratch.assign(seek_length + overlap_length, 0.0f);
+    pending.assign(2 * (sequence_length - overlap_length), 0);
+
+    SetTargetLatency(target_latency_ms);
+    Clear();
+}
+
+void LatencyStretcher::SetTargetLatency(u32 milliseconds) {
+    target_latency_ms = std::max(milliseconds, min_target_latency_ms);
+    target_latency_frames = static_cast<double>(target_latency_ms) * sample_rate / 1000.0;
+}
+
+std::size_t LatencyStretcher::UpdateTempo(std::size_t fifo_fill, std::size_t num_out) {
+    const double fill = static_cast<double>(fifo_fill + BufferedFrames());
+    const double time_delta = static_cast<double>(num_out) / sample_rate; // seconds
+
+    std::size_t drop = 0;
+    if (fill > max_overshoot * target_latency_frames + num_out) {
+        // Far more audio than we could catch up on by speeding up; skip straight to the target.
+        drop = fifo_fill - std::min<std::size_t>(
+                               fifo_fill, static_cast<std::size_t>(target_latency_frames));
+        smoothed_fill = fill - drop;
+        LOG_DEBUG(Audio, "Dropping {} frames of backlog", drop);
+    } else if (!controller_primed) {
+        smoothed_fill = fill;
+    } else {
+        const double lpf_gain = 1.0 - std::exp(-time_delta / fill_filter_time);
+        smoothed_fill += lpf_gain * (fill - smoothed_fill);
+    }
+    controller_primed = true;
+
+    const double error = (smoothed_fill - target_latency_frames) / sample_rate; // seconds
+    // If nothing at all arrived since the last callback ran dry, emulation is most likely paused
+    // or stuck loading. The integrator is frozen then so that it does not wind up.
+    if (!starved || fifo_fill > 0) {
+        integral = std::clamp(integral + integral_gain * error * time_delta, min_tempo - 1.0,
+                              max_tempo - 1.0);
+    }
+    starved = false;
+    tempo = std::clamp(1.0 + proportional_gain * error + integral, min_tempo, max_tempo);
+
+    LOG_TRACE(Audio, "fill:{:0.1f}ms tempo:{:0.6f}", smoothed_fill * 1000.0 / sample_rate, tempo);
+
+    return drop;
+}
+
+std::size_t LatencyStretcher::InputWanted() const {
+    if (fifo_skip > 0) {
+        return 0;
+    }
+    return seek_length + sequence_length - input_count;
+}
+
+bool LatencyStretcher::RenderSegment() {
+    if (fifo_skip > 0 || input_count < sequence_length) {
+        return false;
+    }
+
+    // Rather than stall for a full seek window when the FIFO runs low, seek over what is there.
+    const std::size_t seek_range = std::min(seek_length, input_count - sequence_length + 1);
+    const s16* const src = input.data() + 2 * SeekBestOverlap(seek_range);
+
+    // Crossfade from the tail of the last segment into the new one, then copy the rest of the
+    // segment up to where the next overlap begins.
+    const int fade_length = static_cast<int>(overlap_length);
+    for (int i = 0; i < fade_length; i++) {
+        for (int c = 0; c < 2; c++) {
+            pending[2 * i + c] = static_cast<s16>(
+                (overlap[2 * i + c] * (fade_length - i) + src[2 * i + c] * i) / fade_length);
+        }
+    }
+    const std::size_t body_length = sequence_length - 2 * overlap_length;
+    std::memcpy(pending.data() + 2 * overlap_length, src + 2 * overlap_length,
+                body_length * 2 * sizeof(s16));
+    pending_pos = 0;
+    pending_count = sequence_length - overlap_length;
+
+    const s16* const tail = src + 2 * (sequence_length - overlap_length);
+    std::memcpy(overlap.data(), tail, overlap_length * 2 * sizeof(s16));
+    for (std::size_t i = 0; i < overlap_length; i++) {
+        overlap_reference[i] = static_cast<float>(tail[2 * i] + tail[2 * i + 1]);
+    }
+
+    // Advance the nominal input position by the tempo-scaled amount of output just produced.
+    skip_fraction += tempo * static_cast<double>(pending_count);
+    const std::size_t skip = static_cast<std::size_t>(skip_fraction);
+    skip_fraction -= static_cast<double>(skip);
+    const std::size_t skipped = std::min(skip, input_count);
+    std::memmove(input.data(), input.data() + 2 * skipped,
+                 (input_count - skipped) * 2 * sizeof(s16));
+    input_count -= skipped;
+    fifo_skip = skip - skipped;
+    return true;
+}
+
+std::size_t LatencyStretcher::SeekBestOverlap(std::size_t seek_range) {
+    for (std::size_t i = 0; i < seek_range + overlap_length; i++) {
+        seek_scratch[i] = static_cast<float>(input[2 * i] + input[2 * i + 1]);
+    }
+
+    // Normalised cross-correlation between the reference and the window starting at offset.
+    const auto score = [this](std::size_t offset) {
+        const float* const candidate = seek_scratch.data() + offset;
+        float correlation = 0.0f;
+        float norm = 0.0f;
+        for (std::size_t i = 0; i < overlap_length; i++) {
+            correlation += overlap_reference[i] * candidate[i];
+            norm += candidate[i] * candidate[i];
+        }
+        return correlation / std::sqrt(norm + 1.0f);
+    };
+
+    std::size_t best_offset = 0;
+    float best_score = score(0);
+    for (std::size_t offset = coarse_seek_step; offset < seek_range;
+         offset += coarse_seek_step) {
+        const float s = score(offset);
+        if (s > best_score) {
+            best_score = s;
+            best_offset = offset;
+        }
+    }
+
+    const std::size_t coarse_offset = best_offset;
+    const std::size_t refine_begin =
+        coarse_offset > coarse_seek_step ? coarse_offset - coarse_seek_step + 1 : 0;
+    const std::size_t refine_end = std::min(coarse_offset + coarse_seek_step, seek_range);
+    for (std::size_t offset = refine_begin; offset < refine_end; offset++) {
+        if (offset == coarse_offset) {
+            continue;
+        }
+        const float s = score(offset);
+        if (s > best_score) {
+            best_score = s;
+            best_offset = offset;
+        }
+    }
+    return best_offset;
+}
+
+std::size_t LatencyStretcher::ReadPending(s16* out, std::size_t num_out) {
+    const std::size_t count = std::min(pending_count, num_out);
+    std::memcpy(out, pending.data() + 2 * pending_pos, count * 2 * sizeof(s16));
+    pending_pos += count;
+    pending_count -= count;
+    return count;
+}
+
+std::size_t LatencyStretcher::Flush(s16* out, std::size_t num_out) {
+    std::size_t written = ReadPending(out, num_out);
+    // The overlap is the audio that directly follows the pending output.
+    const std::size_t tail = std::min(overlap_length, num_out - written);
+    std::memcpy(out + 2 * written, overlap.data(), tail * 2 * sizeof(s16));
+    written += tail;
+    Clear();
+    return written;
+}
+
+void LatencyStretcher::Clear() {
+    tempo = 1.0;
+    integral = 0.0;
+    smoothed_fill = 0.0;
+    controller_primed = false;
+    starved = false;
+
+    input_count = 0;
+    fifo_skip = 0;
+    skip_fraction = 0.0;
+    std::fill(overlap.begin(), overlap.end(), s16{0});
+    std::fill(overlap_reference.begin(), overlap_reference.end(), 0.0f);
+    pending_pos = 0;
+    pending_count = 0;
+}
+
+} // namespace AudioCore
@@ -0,0 +1,134 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "audio_core/audio_types.h"
+#include "common/common_types.h"
+
+namespace AudioCore {
+
+/**
+ * Time stretcher that keeps the amount of buffered audio close to a target latency.
+ *
+ * A PI controller compares the audio waiting in the output FIFO (plus what the stretcher itself
+ * holds) against the target and derives the playback tempo from it. The tempo is applied with a
+ * small WSOLA (waveform similarity overlap-add) implementation which only pulls as much input from
+ * the FIFO as the next output segment needs, so the FIFO fill is an accurate latency measurement.
+ *
+ * Not thread-safe: every member must be called from the sink callback thread.
+ */
+class LatencyStretcher {
+public:
+    /// Lowest target latency. Any lower and the FIFO runs dry between sink callbacks.
+    static constexpr u32 min_target_latency_ms = 20;
+
+    explicit LatencyStretcher(unsigned int sample_rate = native_sample_rate);
+    ~LatencyStretcher();
+
+    /// Sets the rate both input and output are sampled at. Clears all state.
+    void SetSampleRate(unsigned int sample_rate);
+
+    /// Sets the amount of buffered audio the controller aims for, at least min_target_latency_ms.
+    void SetTargetLatency(u32 milliseconds);
+
+    /**
+     * Fills `out` with stretched audio taken from `fifo`.
+     * @param fifo    Ring buffer of stereo frames. Only the frames needed are popped from it.
+     * @param out     Output sample buffer
+     * @param num_out Desired number of output frames in `out`
+     * @returns Actual number of frames written to `out`
+     */
+    template <typename Fifo>
+    std::size_t Process(Fifo& fifo, s16* out, std::size_t num_out) {
+        fifo.Discard(UpdateTempo(fifo.Size(), num_out));
+
+        std::size_t written = ReadPending(out, num_out);
+        while (written < num_out) {
+            fifo_skip -= fifo.Discard(fifo_skip);
+            input_count += fifo.Pop(input.data() + 2 * input_count, InputWanted());
+            if (!RenderSegment()) {
+                starved = true;
+                break;
+            }
+            written += ReadPending(out + 2 * written, num_out - written);
+        }
+        return written;
+    }
+
+    /**
+     * Writes out the audio that has already been stretched, then clears all state.
+     * @returns Number of frames written to `out`
+     */
+    std::size_t Flush(s16* out, std::size_t num_out);
+
+    void Clear();
+
+    /// Number of frames held by the stretcher, both unprocessed input and stretched output.
+    std::size_t BufferedFrames() const {
+        return input_count + pending_count;
+    }
+
+    /// Current playback tempo. Values above 1 drain the FIFO, below 1 let it fill up.
+    double Tempo() const {
+        return tempo;
+    }
+
+private:
+    /**
+     * Runs the controller for one callback.
+     * @returns Number of frames to drop from the FIFO because it has far overshot the target.
+     */
+    std::size_t UpdateTempo(std::size_t fifo_fill, std::size_t num_out);
+
+    /// Number of frames to pop from the FIFO so that the next segment can be rendered.
+    std::size_t InputWanted() const;
+
+    /// Stretches one segment of input into the pending output. Returns false if short of input.
+    bool RenderSegment();
+
+    /// Returns the offset in [0, seek_range) whose waveform best continues the last segment.
+    std::size_t SeekBestOverlap(std::size_t seek_range);
+
+    std::size_t ReadPending(s16* out, std::size_t num_out);
+
+    unsigned int sample_rate = native_sample_rate;
+    u32 target_latency_ms = 40;
+    double target_latency_frames = 0.0;
+
+    // WSOLA geometry, in frames
+    std::size_t sequence_length = 0;
+    std::size_t overlap_length = 0;
+    std::size_t seek_length = 0;
+
+    // Controller state
+    double tempo = 1.0;
+    double integral = 0.0;
+    double smoothed_fill = 0.0;
+    bool controller_primed = false;
+    bool starved = false;
+
+    // Interleaved stereo input, starting at the nominal position of the next segment
+    std::vector<s16> input;
+    std::size_t input_count = 0;
+    /// Input frames the last segment skipped over that were not yet popped from the FIFO
+    std::size_t fifo_skip = 0;
+    double skip_fraction = 0.0;
+
+    /// Tail of the last segment, crossfaded into the start of the next one
+    std::vector<s16> overlap;
+    /// Mono (L + R) copy of `overlap` used as the reference waveform while seeking
+    std::vector<float> overlap_reference;
+    /// Mono copy of the seek window of the input
+    std::vector<float> seek_scratch;
+
+    /// Stretched output that has not been handed to the sink yet
+    std::vector<s16> pending;
+    std::size_t pending_pos = 0;
+    std::size_t pending_count = 0;
+};
+
+} // namespace AudioCore
@@ -4,14 +4,17 @@
 
 #include <array>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
 #include <thread>
 #include <teakra/teakra.h>
 #include "audio_core/lle/lle.h"
 #include "common/assert.h"
 #include "common/bit_field.h"
+#include "common/ring_buffer.h"
 #include "common/swap.h"
 #include "common/thread.h"
-#include "core/core.h"
 #include "core/core_timing.h"
 #include "core/hle/lock.h"
 #include "core/hle/service/dsp/dsp_dsp.h"
@@ -120,16 +123,40 @@ static u8 PipeIndexToSlotIndex(u8 pipe_index, PipeDirection direction) {
     return (pipe_index << 1) + static_cast<u8>(direction);
 }
 
+/// A write to a CPU-to-DSP register, queued for the Teakra thread in decoupled mode.
+struct CpuToDspEvent {
+    enum class Type : u8 {
+        SendData,
+        SetSemaphore,
+    };
+    Type type;
+    u8 register_number;
+    u16 value;
+};
+
+/// An interrupt raised by the DSP, queued for the emulation thread in decoupled mode.
+struct DspToCpuEvent {
+    Service::DSP::DSP_DSP::InterruptType type;
+    u8 pipe;
+};
+
 struct DspLle::Impl final {
-    Impl(bool multithread) : multithread(multithread) {
-        teakra_slice_event = Core::System::GetInstance().CoreTiming().RegisterEvent(
+    Impl(Core::Timing& timing, Threading threading) : timing(timing), threading(threading) {
+        teakra_slice_event = timing.RegisterEvent(
             "DSP slice", [this](u64, int late) { TeakraSliceEvent(static_cast<u64>(late)); });
+        if (threading == Threading::Decoupled) {
+            memory_region = std::make_shared<DspMemoryRegion>(*this);
+        }
     }
 
     ~Impl() {
         StopTeakraThread();
+        if (memory_region) {
+            memory_region->Detach();
+        }
     }
 
+    Core::Timing& timing;
     Teakra::Teakra teakra;
     u16 pipe_base_waddr = 0;
 
@@ -138,15 +165,114 @@ struct DspLle::Impl final {
 
     Core::TimingEventType* teakra_slice_event;
     std::atomic<bool> loaded = false;
+    std::weak_ptr<Service::DSP::DSP_DSP> service;
 
-    const bool multithread;
+    const Threading threading;
     std::thread teakra_thread;
     Common::Barrier teakra_slice_barrier{2};
     std::atomic<bool> stop_signal = false;
     std::size_t stop_generation;
 
+    // Decoupled mode. The emulation thread grants the Teakra thread cycles as emulated time
+    // passes; the Teakra thread may run up to RunAheadWindow cycles past what was granted, and
+    // the emulation thread only waits for it once it falls more than RunAheadWindow behind.
+    std::mutex cycles_mutex;
+    std::condition_variable cycles_condvar;
+    u64 granted_cycles = 0;
+    u64 executed_cycles = 0;
+    /// Held by the Teakra thread while it runs the core, and by the emulation thread while it
+    /// reads the registers or the memory of the core.
+    mutable std::mutex core_mutex;
+    Common::RingBuffer<CpuToDspEvent, 256> cpu_to_dsp_events;
+    Common::RingBuffer<DspToCpuEvent, 256> dsp_to_cpu_events;
+    /// Event popped by the Teakra thread that could not be applied yet. Teakra thread only.
+    std::optional<CpuToDspEvent> held_event;
+
     static constexpr u32 DspDataOffset = 0x40000;
     static constexpr u32 TeakraSlice = 16384;
+    static constexpr u64 RunAheadWindow = 16 * TeakraSlice;
+
+    /// The emulated CPU's view of DSP memory in decoupled mode. Locks the core for every access.
+    class DspMemoryRegion final : public Memory::MMIORegion {
+    public:
+        explicit DspMemoryRegion(Impl& impl) : impl(&impl) {}
+
+        /// Cuts the region off the core when the core is destroyed. Reads then return zero.
+        void Detach() {
+            impl = nullptr;
+        }
+
+        bool IsValidAddress(VAddr addr) override {
+            return addr >= Memory::DSP_RAM_VADDR &&
+                   addr < Memory::DSP_RAM_VADDR + Memory::DSP_RAM_SIZE;
+        }
+
+        u8 Read8(VAddr addr) override {
+            return Read<u8>(addr);
+        }
+        u16 Read16(VAddr addr) override {
+            return Read<u16>(addr);
+        }
+        u32 Read32(VAddr addr) override {
+            return Read<u32>(addr);
+        }
+        u64 Read64(VAddr addr) override {
+            return Read<u64>(addr);
+        }
+
+        bool ReadBlock(VAddr src_addr, void* dest_buffer, std::size_t size) override {
+            return Access(src_addr, size,
+                          [&](u8* memory) { std::memcpy(dest_buffer, memory, size); });
+        }
+
+        void Write8(VAddr addr, u8 data) override {
+            Write(addr, data);
+        }
+        void Write16(VAddr addr, u16 data) override {
+            Write(addr, data);
+        }
+        void Write32(VAddr addr, u32 data) override {
+            Write(addr, data);
+        }
+        void Write64(VAddr addr, u64 data) override {
+            Write(addr, data);
+        }
+
+        bool WriteBlock(VAddr dest_addr, const void* src_buffer, std::size_t size) override {
+            return Access(dest_addr, size,
+                          [&](u8* memory) { std::memcpy(memory, src_buffer, size); });
+        }
+
+    private:
+        /// Runs `access` on the memory at `addr` while the Teakra thread is kept off the core.
+        template <typename Func>
+        bool Access(VAddr addr, std::size_t size, Func&& access) {
+            if (!impl || !IsValidAddress(addr) ||
+                addr - Memory::DSP_RAM_VADDR + size > Memory::DSP_RAM_SIZE) {
+                return false;
+            }
+            auto lock = impl->LockCore();
+            access(impl->teakra.GetDspMemory().data() + (addr - Memory::DSP_RAM_VADDR));
+            return true;
+        }
+
+        template <typename T>
+        T Read(VAddr addr) {
+            T value{};
+            ReadBlock(addr, &value, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void Write(VAddr addr, T data) {
+            WriteBlock(addr, &data, sizeof(T));
+        }
+
+        Impl* impl;
+    };
+
+    /// Set in decoupled mode only.
+    std::shared_ptr<DspMemoryRegion> memory_region;
 
     void TeakraThread() {
         while (true) {
@@ -160,31 +286,213 @@ struct DspLle::Impl final {
         stop_signal = false;
     }
 
+    void DecoupledTeakraThread() {
+        while (true) {
+            {
+                std::unique_lock lock{cycles_mutex};
+                cycles_condvar.wait(lock, [this] {
+                    return stop_signal ||
+                           executed_cycles + TeakraSlice <= granted_cycles + RunAheadWindow;
+                });
+                if (stop_signal) {
+                    break;
+                }
+            }
+
+            {
+                std::lock_guard lock{core_mutex};
+                ApplyCpuEvents();
+                teakra.Run(TeakraSlice);
+            }
+
+            {
+                std::lock_guard lock{cycles_mutex};
+                executed_cycles += TeakraSlice;
+            }
+            cycles_condvar.notify_all();
+        }
+    }
+
+    /// Applies the register writes queued by the emulation thread, in order. Teakra thread only.
+    void ApplyCpuEvents() {
+        while (true) {
+            if (!held_event) {
+                CpuToDspEvent event;
+                if (cpu_to_dsp_events.Pop(&event, 1) == 0) {
+                    return;
+                }
+                held_event = event;
+            }
+            if (held_event->type == CpuToDspEvent::Type::SetSemaphore) {
+                teakra.SetSemaphore(held_event->value);
+            } else {
+                // Keep this and every later event queued until the DSP has read the register.
+                if (!teakra.SendDataIsEmpty(held_event->register_number)) {
+                    return;
+                }
+                teakra.SendData(held_event->register_number, held_event->value);
+            }
+            held_event.reset();
+        }
+    }
+
+    void StartTeakraThread() {
+        if (threading == Threading::Lockstep) {
+            teakra_thread = std::thread(&Impl::TeakraThread, this);
+        } else if (threading == Threading::Decoupled) {
+            granted_cycles = executed_cycles = 0;
+            held_event.reset();
+            cpu_to_dsp_events.Discard();
+            dsp_to_cpu_events.Discard();
+            teakra_thread = std::thread(&Impl::DecoupledTeakraThread, this);
+        }
+    }
+
     void StopTeakraThread() {
-        if (teakra_thread.joinable()) {
-            stop_generation = teakra_slice_barrier.Generation() + 1;
-            stop_signal = true;
-            teakra_slice_barrier.Sync();
+        if (!teakra_thread.joinable()) {
+            return;
+        }
+        if (threading == Threading::Decoupled) {
+            {
+                std::lock_guard lock{cycles_mutex};
+                stop_signal = true;
+            }
+            cycles_condvar.notify_all();
             teakra_thread.join();
+            stop_signal = false;
+            return;
+        }
+        stop_generation = teakra_slice_barrier.Generation() + 1;
+        stop_signal = true;
+        teakra_slice_barrier.Sync();
+        teakra_thread.join();
+    }
+
+    /**
+     * Locks the core against the Teakra thread in decoupled mode. The other modes only touch the
+     * core from one thread at a time, so nothing is locked. Must not be held while waiting on the
+     * Teakra thread.
+     */
+    std::unique_lock<std::mutex> LockCore() const {
+        if (threading != Threading::Decoupled) {
+            return {};
         }
+        return std::unique_lock{core_mutex};
+    }
+
+    bool RecvDataIsReady(u8 register_number) const {
+        auto lock = LockCore();
+        return teakra.RecvDataIsReady(register_number);
     }
 
+    /// Reads a DSP-to-CPU data register, running the DSP until it has written one.
+    u16 RecvData(u8 register_number) {
+        while (!RecvDataIsReady(register_number))
+            RunTeakraSlice();
+        auto lock = LockCore();
+        return teakra.RecvData(register_number);
+    }
+
+    /**
+     * Grants the Teakra thread another slice in decoupled mode. If `sync` is set, waits until it
+     * has run every slice granted so far; otherwise only waits while it lags too far behind.
+     */
+    void GrantTeakraSlice(bool sync) {
+        std::unique_lock lock{cycles_mutex};
+        granted_cycles += TeakraSlice;
+        cycles_condvar.notify_all();
+        const u64 allowed_lag = sync ? 0 : RunAheadWindow;
+        cycles_condvar.wait(lock,
+                            [&] { return executed_cycles + allowed_lag >= granted_cycles; });
+    }
+
+    /// Runs the DSP for (at least) another slice, for when the CPU has to wait on the DSP.
     void RunTeakraSlice() {
-        if (multithread) {
-            teakra_slice_barrier.Sync();
-        } else {
+        switch (threading) {
+        case Threading::SingleThread:
             teakra.Run(TeakraSlice);
+            break;
+        case Threading::Lockstep:
+            teakra_slice_barrier.Sync();
+            break;
+        case Threading::Decoupled:
+            GrantTeakraSlice(true);
+            break;
         }
     }
 
     void TeakraSliceEvent(u64 late) {
-        RunTeakraSlice();
+        if (threading == Threading::Decoupled) {
+            GrantTeakraSlice(false);
+            DeliverDspEvents();
+        } else {
+            RunTeakraSlice();
+        }
         u64 next = TeakraSlice * 2; // DSP runs at clock rate half of the CPU rate
         if (next < late)
             next = 0;
         else
             next -= late;
-        Core::System::GetInstance().CoreTiming().ScheduleEvent(next, teakra_slice_event, 0);
+        timing.ScheduleEvent(next, teakra_slice_event, 0);
+    }
+
+    /// Writes to a CPU-to-DSP data register once the DSP has read the previous value.
+    void SendData(u8 register_number, u16 value) {
+        if (threading == Threading::Decoupled) {
+            PushCpuEvent({CpuToDspEvent::Type::SendData, register_number, value});
+            return;
+        }
+        while (!teakra.SendDataIsEmpty(register_number))
+            RunTeakraSlice();
+        teakra.SendData(register_number, value);
+    }
+
+    void SetSemaphore(u16 semaphore_value) {
+        if (threading == Threading::Decoupled) {
+            PushCpuEvent({CpuToDspEvent::Type::SetSemaphore, 0, semaphore_value});
+            return;
+        }
+        teakra.SetSemaphore(semaphore_value);
+    }
+
+    void PushCpuEvent(const CpuToDspEvent& event) {
+        while (cpu_to_dsp_events.Push(&event, 1) == 0)
+            RunTeakraSlice();
+    }
+
+    /// Raises an interrupt on the CPU side. Called on the Teakra thread in the threaded modes.
+    void SignalInterrupt(Service::DSP::DSP_DSP::InterruptType type, u8 pipe) {
+        if (threading == Threading::Decoupled) {
+            const DspToCpuEvent event{type, pipe};
+            if (dsp_to_cpu_events.Push(&event, 1) == 0) {
+                LOG_ERROR(Audio_DSP, "DSP event queue is full, dropping interrupt");
+            }
+            return;
+        }
+        DeliverInterrupt(type, pipe);
+    }
+
+    /// Delivers the interrupts queued by the Teakra thread. Emulation thread only.
+    void DeliverDspEvents() {
+        DspToCpuEvent event;
+        while (dsp_to_cpu_events.Pop(&event, 1) != 0) {
+            DeliverInterrupt(event.type, event.pipe);
+        }
+    }
+
+    void DeliverInterrupt(Service::DSP::DSP_DSP::InterruptType type, u8 pipe) {
+        if (!loaded)
+            return;
+
+        if (type == Service::DSP::DSP_DSP::InterruptType::Pipe && pipe == 0) {
+            // pipe 0 is for debug. 3DS automatically drains this pipe and discards the data
+            ReadPipe(pipe, GetPipeReadableSize(pipe));
+            return;
+        }
+        std::lock_guard lock(HLE::g_hle_lock);
+        if (auto locked = service.lock()) {
+            locked->SignalInterrupt(type, static_cast<DspPipe>(pipe));
+        }
     }
 
     u8* GetDspDataPointer(u32 baddr) {
@@ -219,6 +527,7 @@ struct DspLle::Impl final {
     }
 
     void WritePipe(u8 pipe_index, const std::vector<u8>& data) {
+        auto lock = LockCore();
         PipeStatus pipe_status = GetPipeStatus(pipe_index, PipeDirection::CPUtoDSP);
         bool need_update = false;
         const u8* buffer_ptr = data.data();
@@ -250,13 +559,14 @@ struct DspLle::Impl final {
         }
         if (need_update) {
             UpdatePipeStatus(pipe_status);
-            while (!teakra.SendDataIsEmpty(2))
-                RunTeakraSlice();
-            teakra.SendData(2, pipe_status.slot_index);
+            // Sending may wait on the Teakra thread, which needs the core to run
+            lock.unlock();
+            SendData(2, pipe_status.slot_index);
         }
     }
 
     std::vector<u8> ReadPipe(u8 pipe_index, u16 bsize) {
+        auto lock = LockCore();
         PipeStatus pipe_status = GetPipeStatus(pipe_index, PipeDirection::DSPtoCPU);
         bool need_update = false;
         std::vector<u8> data(bsize);
@@ -287,13 +597,14 @@ struct DspLle::Impl final {
         }
         if (need_update) {
             UpdatePipeStatus(pipe_status);
-            while (!teakra.SendDataIsEmpty(2))
-                RunTeakraSlice();
-            teakra.SendData(2, pipe_status.slot_index);
+            // Sending may wait on the Teakra thread, which needs the core to run
+            lock.unlock();
+            SendData(2, pipe_status.slot_index);
         }
         return data;
     }
     u16 GetPipeReadableSize(u8 pipe_index) const {
+        auto lock = LockCore();
         PipeStatus pipe_status = GetPipeStatus(pipe_index, PipeDirection::DSPtoCPU);
         u16 size = pipe_status.write_bptr - pipe_status.read_bptr;
         if (pipe_status.IsWrapped()) {
@@ -325,26 +636,19 @@ struct DspLle::Impl final {
 
         // TODO: load special segment
 
-        Core::System::GetInstance().CoreTiming().ScheduleEvent(TeakraSlice, teakra_slice_event, 0);
-
-        if (multithread) {
-            teakra_thread = std::thread(&Impl::TeakraThread, this);
-        }
+        timing.ScheduleEvent(TeakraSlice, teakra_slice_event, 0);
+        StartTeakraThread();
 
         // Wait for initialization
         if (dsp.recv_data_on_start) {
             for (u8 i = 0; i < 3; ++i) {
-                do {
-                    while (!teakra.RecvDataIsReady(i))
-                        RunTeakraSlice();
-                } while (teakra.RecvData(i) != 1);
+                while (RecvData(i) != 1) {
+                }
             }
         }
 
         // Get pipe base address
-        while (!teakra.RecvDataIsReady(2))
-            RunTeakraSlice();
-        pipe_base_waddr = teakra.RecvData(2);
+        pipe_base_waddr = RecvData(2);
 
         loaded = true;
     }
@@ -359,35 +663,26 @@ struct DspLle::Impl final {
 
         // Send finalization signal via command/reply register 2
         constexpr u16 FinalizeSignal = 0x8000;
-        while (!teakra.SendDataIsEmpty(2))
-            RunTeakraSlice();
-
-        teakra.SendData(2, FinalizeSignal);
+        SendData(2, FinalizeSignal);
 
         // Wait for completion
-        while (!teakra.RecvDataIsReady(2))
-            RunTeakraSlice();
+        RecvData(2); // discard the value
 
-        teakra.RecvData(2); // discard the value
-
-        Core::System::GetInstance().CoreTiming().UnscheduleEvent(teakra_slice_event, 0);
+        timing.UnscheduleEvent(teakra_slice_event, 0);
         StopTeakraThread();
     }
 };
 
 u16 DspLle::RecvData(u32 register_number) {
-    while (!impl->teakra.RecvDataIsReady(register_number)) {
-        impl->RunTeakraSlice();
-    }
-    return impl->teakra.RecvData(static_cast<u8>(register_number));
+    return impl->RecvData(static_cast<u8>(register_number));
 }
 
 bool DspLle::RecvDataIsReady(u32 register_number) const {
-    return impl->teakra.RecvDataIsReady(register_number);
+    return impl->RecvDataIsReady(static_cast<u8>(register_number));
 }
 
 void DspLle::SetSemaphore(u16 semaphore_value) {
-    impl->teakra.SetSemaphore(semaphore_value);
+    impl->SetSemaphore(semaphore_value);
 }
 
 std::vector<u8> DspLle::PipeRead(DspPipe pipe_number, u32 length) {
@@ -403,32 +698,31 @@ void DspLle::PipeWrite(DspPipe pipe_number, const std::vector<u8>& buffer) {
 }
 
 std::array<u8, Memory::DSP_RAM_SIZE>& DspLle::GetDspMemory() {
+    // Unsynchronised. In decoupled mode the Teakra thread may be writing this memory at any time,
+    // so the emulated CPU accesses it through GetDspMemoryHandler instead.
     return impl->teakra.GetDspMemory();
 }
 
+Memory::MMIORegionPointer DspLle::GetDspMemoryHandler() {
+    return impl->memory_region;
+}
+
 void DspLle::SetServiceToInterrupt(std::weak_ptr<Service::DSP::DSP_DSP> dsp) {
-    impl->teakra.SetRecvDataHandler(0, [this, dsp]() {
+    using InterruptType = Service::DSP::DSP_DSP::InterruptType;
+    impl->service = std::move(dsp);
+
+    impl->teakra.SetRecvDataHandler(0, [this]() {
         if (!impl->loaded)
             return;
-
-        std::lock_guard lock(HLE::g_hle_lock);
-        if (auto locked = dsp.lock()) {
-            locked->SignalInterrupt(Service::DSP::DSP_DSP::InterruptType::Zero,
-                                    static_cast<DspPipe>(0));
-        }
+        impl->SignalInterrupt(InterruptType::Zero, 0);
     });
-    impl->teakra.SetRecvDataHandler(1, [this, dsp]() {
+    impl->teakra.SetRecvDataHandler(1, [this]() {
         if (!impl->loaded)
             return;
-
-        std::lock_guard lock(HLE::g_hle_lock);
-        if (auto locked = dsp.lock()) {
-            locked->SignalInterrupt(Service::DSP::DSP_DSP::InterruptType::One,
-                                    static_cast<DspPipe>(0));
-        }
+        impl->SignalInterrupt(InterruptType::One, 0);
     });
 
-    auto ProcessPipeEvent = [this, dsp](bool event_from_data) {
+    auto ProcessPipeEvent = [this](bool event_from_data) {
         if (!impl->loaded)
             return;
 
@@ -448,16 +742,7 @@ void DspLle::SetServiceToInterrupt(std::weak_ptr<Service::DSP::DSP_DSP> dsp) {
             ASSERT(pipe < 16);
             if (side != static_cast<u16>(PipeDirection::DSPtoCPU))
                 return;
-            if (pipe == 0) {
-                // pipe 0 is for debug. 3DS automatically drains this pipe and discards the data
-                impl->ReadPipe(pipe, impl->GetPipeReadableSize(pipe));
-            } else {
-                std::lock_guard lock(HLE::g_hle_lock);
-                if (auto locked = dsp.lock()) {
-                    locked->SignalInterrupt(Service::DSP::DSP_DSP::InterruptType::Pipe,
-                                            static_cast<DspPipe>(pipe));
-                }
-            }
+            impl->SignalInterrupt(InterruptType::Pipe, static_cast<u8>(pipe));
         }
     };
 
@@ -473,8 +758,8 @@ void DspLle::UnloadComponent() {
     impl->UnloadComponent();
 }
 
-DspLle::DspLle(Memory::MemorySystem& memory, bool multithread)
-    : impl(std::make_unique<Impl>(multithread)) {
+DspLle::DspLle(Memory::MemorySystem& memory, Core::Timing& timing, Threading threading)
+    : impl(std::make_unique<Impl>(timing, threading)) {
     Teakra::AHBMCallback ahbm;
     ahbm.read8 = [&memory](u32 address) -> u8 {
         return *memory.GetFCRAMPointer(address - Memory::FCRAM_PADDR);
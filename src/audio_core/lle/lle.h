@@ -6,11 +6,26 @@
 
 #include "audio_core/dsp_interface.h"
 
+namespace Core {
+class Timing;
+} // namespace Core
+
 namespace AudioCore {
 
 class DspLle final : public DspInterface {
 public:
-    explicit DspLle(Memory::MemorySystem& memory, bool multithread);
+    /// How the Teakra core is scheduled relative to the emulated CPU.
+    enum class Threading {
+        /// Teakra runs on the emulation thread.
+        SingleThread,
+        /// Teakra runs on its own thread, in lockstep with the emulated CPU every slice.
+        Lockstep,
+        /// Teakra runs on its own thread and may run a bounded number of cycles ahead of or behind
+        /// the emulated CPU. The CPU only waits for it when it needs a reply from the DSP.
+        Decoupled,
+    };
+
+    DspLle(Memory::MemorySystem& memory, Core::Timing& timing, Threading threading);
     ~DspLle() override;
 
     u16 RecvData(u32 register_number) override;
@@ -21,6 +36,7 @@ public:
     void PipeWrite(DspPipe pipe_number, const std::vector<u8>& buffer) override;
 
     std::array<u8, Memory::DSP_RAM_SIZE>& GetDspMemory() override;
+    Memory::MMIORegionPointer GetDspMemoryHandler() override;
 
     void SetServiceToInterrupt(std::weak_ptr<Service::DSP::DSP_DSP> dsp) override;
 
@@ -30,16 +30,21 @@ void TimeStretcher::SetOutputSampleRate(unsigned int sample_rate) {
 
 std::size_t TimeStretcher::Process(const s16* in, std::size_t num_in, s16* out,
                                    std::size_t num_out) {
+    if (UpdateRatio(num_in, num_out)) {
+        PushSamples(in, num_in);
+    }
+    return ReceiveSamples(out, num_out);
+}
+
+bool TimeStretcher::UpdateRatio(std::size_t num_in, std::size_t num_out) {
     const double time_delta = static_cast<double>(num_out) / sample_rate; // seconds
     double current_ratio = static_cast<double>(num_in) / static_cast<double>(num_out);
 
     const double max_latency = 0.25; // seconds
     const double max_backlog = sample_rate * max_latency;
     const double backlog_fullness = sound_touch->numSamples() / max_backlog;
-    if (backlog_fullness > 4.0) {
-        // Too many samples in backlog: Don't push anymore on
-        num_in = 0;
-    }
+    // Too many samples in backlog: Don't push anymore on
+    const bool accept_input = backlog_fullness <= 4.0;
 
     // We ideally want the backlog to be about 50% full.
     // This gives some headroom both ways to prevent underflow and overflow.
@@ -59,10 +64,17 @@ std::size_t TimeStretcher::Process(const s16* in, std::size_t num_in, s16* out,
     stretch_ratio = std::max(stretch_ratio, 0.05);
     sound_touch->setTempo(stretch_ratio);
 
-    LOG_TRACE(Audio, "{:5}/{:5} ratio:{:0.6f} backlog:{:0.6f}", num_in, num_out, stretch_ratio,
-              backlog_fullness);
+    LOG_TRACE(Audio, "{:5}/{:5} ratio:{:0.6f} backlog:{:0.6f}", accept_input ? num_in : 0,
+              num_out, stretch_ratio, backlog_fullness);
 
+    return accept_input;
+}
+
+void TimeStretcher::PushSamples(const s16* in, std::size_t num_in) {
     sound_touch->putSamples(in, static_cast<u32>(num_in));
+}
+
+std::size_t TimeStretcher::ReceiveSamples(s16* out, std::size_t num_out) {
     return sound_touch->receiveSamples(out, static_cast<u32>(num_out));
 }
 
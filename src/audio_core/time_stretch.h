@@ -29,6 +29,22 @@ public:
     /// @returns Actual number of frames written to `out`
     std::size_t Process(const s16* in, std::size_t num_in, s16* out, std::size_t num_out);
 
+    /// Updates the stretch ratio for one output callback. This is the first step of Process,
+    /// for callers that feed input in pieces via PushSamples.
+    /// @param num_in   Number of input frames available for this callback
+    /// @param num_out  Desired number of output frames for this callback
+    /// @returns False if the backlog is too full and the input should be dropped
+    bool UpdateRatio(std::size_t num_in, std::size_t num_out);
+
+    /// @param in      Input sample buffer
+    /// @param num_in  Number of input frames in `in`
+    void PushSamples(const s16* in, std::size_t num_in);
+
+    /// @param out      Output sample buffer
+    /// @param num_out  Desired number of output frames in `out`
+    /// @returns Actual number of frames written to `out`
+    std::size_t ReceiveSamples(s16* out, std::size_t num_out);
+
     void Clear();
 
     void Flush();
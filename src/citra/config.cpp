@@ -121,6 +121,9 @@ void Config::ReadValues() {
     Settings::values.shaders_accurate_mul =
         sdl2_config->GetBoolean("Renderer", "shaders_accurate_mul", true);
     Settings::values.use_shader_jit = sdl2_config->GetBoolean("Renderer", "use_shader_jit", true);
+    Settings::values.use_async_gpu = sdl2_config->GetBoolean("Renderer", "use_async_gpu", false);
+    Settings::values.async_gpu_queue_depth =
+        static_cast<u16>(sdl2_config->GetInteger("Renderer", "async_gpu_queue_depth", 8));
     Settings::values.resolution_factor =
         static_cast<u16>(sdl2_config->GetInteger("Renderer", "resolution_factor", 1));
     Settings::values.use_disk_shader_cache =
@@ -183,14 +186,23 @@ void Config::ReadValues() {
     Settings::values.custom_textures = sdl2_config->GetBoolean("Utility", "custom_textures", false);
     Settings::values.preload_textures =
         sdl2_config->GetBoolean("Utility", "preload_textures", false);
+    Settings::values.use_title_cache = sdl2_config->GetBoolean("Utility", "use_title_cache", false);
 
     // Audio
     Settings::values.enable_dsp_lle = sdl2_config->GetBoolean("Audio", "enable_dsp_lle", false);
     Settings::values.enable_dsp_lle_multithread =
         sdl2_config->GetBoolean("Audio", "enable_dsp_lle_multithread", false);
+    Settings::values.enable_dsp_lle_decoupled =
+        sdl2_config->GetBoolean("Audio", "enable_dsp_lle_decoupled", false);
+    Settings::values.enable_dsp_hle_multithread =
+        sdl2_config->GetBoolean("Audio", "enable_dsp_hle_multithread", false);
     Settings::values.sink_id = sdl2_config->GetString("Audio", "output_engine", "auto");
     Settings::values.enable_audio_stretching =
         sdl2_config->GetBoolean("Audio", "enable_audio_stretching", true);
+    Settings::values.audio_stretching_mode = static_cast<Settings::AudioStretchingMode>(
+        sdl2_config->GetInteger("Audio", "audio_stretching_mode", 0));
+    Settings::values.audio_target_latency_ms =
+        static_cast<u16>(sdl2_config->GetInteger("Audio", "audio_target_latency_ms", 40));
     Settings::values.audio_device_id = sdl2_config->GetString("Audio", "output_device", "auto");
     Settings::values.volume = static_cast<float>(sdl2_config->GetReal("Audio", "volume", 1));
     Settings::values.mic_input_device =
@@ -122,6 +122,15 @@ shaders_accurate_mul =
 # 0: Interpreter (slow), 1 (default): JIT (fast)
 use_shader_jit =
 
+# Whether to process GPU commands on a separate thread, overlapping them with CPU emulation.
+# Only takes effect with the software renderer.
+# 0 (default): No, 1: Yes
+use_async_gpu =
+
+# How many command lists, transfers and fills may be queued for the GPU thread at once
+# Default: 8
+async_gpu_queue_depth =
+
 # Forces VSync on the display thread. Usually doesn't impact performance, but on some drivers it can
 # so only turn this off if you notice a speed difference.
 # 0: Off, 1 (default): On
@@ -217,6 +226,11 @@ custom_textures =
 # 0 (default): Off, 1: On
 preload_textures =
 
+# Keeps the decrypted, decompressed and patched code of each title in cache/titles/ to speed up
+# later boots. The executables are written to disk unencrypted.
+# 0 (default): Off, 1: On
+use_title_cache =
+
 [Audio]
 # Whether or not to enable DSP LLE
 # 0 (default): No, 1: Yes
@@ -226,6 +240,15 @@ enable_dsp_lle =
 # 0 (default): No, 1: Yes
 enable_dsp_lle_thread =
 
+# Whether or not to let the DSP LLE thread run ahead of emulation instead of in lockstep with it.
+# Only takes effect together with enable_dsp_lle_thread. Faster, but less accurate DSP timing.
+# 0 (default): No, 1: Yes
+enable_dsp_lle_decoupled =
+
+# Whether or not to process DSP HLE audio sources on worker threads
+# Output is identical to the single-threaded path.
+# 0 (default): No, 1: Yes
+enable_dsp_hle_multithread =
 
 # Which audio output engine to use.
 # auto (default): Auto-select, null: No audio output, sdl2: SDL2 (if available)
@@ -237,6 +260,16 @@ output_engine =
 # 0: No, 1 (default): Yes
 enable_audio_stretching =
 
+# Which audio stretcher to use when audio stretching is enabled.
+# 0 (default): SoundTouch, 1: Latency targeting, which speeds up or slows down audio to keep the
+# audio latency close to audio_target_latency_ms
+audio_stretching_mode =
+
+# The audio latency the latency targeting stretcher aims for, in milliseconds.
+# Lower values respond faster but are more likely to stutter when emulation speed is uneven.
+# 40 (default)
+audio_target_latency_ms =
+
 # Which audio device to use.
 # auto (default): Auto-select
 output_device =
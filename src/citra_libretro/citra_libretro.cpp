@@ -136,6 +136,7 @@ void LibRetro::OnConfigureEnvironment() {
         {"citra_use_cpu_jit", "Enable CPU JIT; enabled|disabled"},
         {"citra_cpu_scale", cpuScale.c_str()},
         {"citra_use_hw_renderer", "Enable hardware renderer; enabled|disabled"},
+        {"citra_use_async_gpu", "Run the software renderer on its own thread; disabled|enabled"},
         {"citra_use_shader_jit", "Enable shader JIT; enabled|disabled"},
         {"citra_use_hw_shaders", "Enable hardware shaders; enabled|disabled"},
         {"citra_use_hw_shader_cache", "Save hardware shader cache to disk; enabled|disabled"},
@@ -156,6 +157,14 @@ void LibRetro::OnConfigureEnvironment() {
         {"citra_mouse_touchscreen", "Simulate touchscreen interactions with mouse; enabled|disabled"},
         {"citra_touch_touchscreen", "Simulate touchscreen interactions with touchscreen; disabled|enabled"},
         {"citra_render_touchscreen", "Render simulated touchscreen interactions; disabled|enabled"},
+        {"citra_dsp_emulation",
+         "DSP emulation; HLE|LLE|LLE (multithreaded)|LLE (decoupled, multithreaded)"},
+        {"citra_use_dsp_hle_multithread", "Mix DSP HLE audio sources on worker threads; disabled|enabled"},
+        {"citra_audio_stretching", "Audio stretching; disabled|SoundTouch|Latency targeting"},
+        {"citra_audio_target_latency",
+         "Audio target latency (only for latency targeting); 40 ms|20 ms|30 ms|60 ms|80 ms|100 ms"},
+        {"citra_use_title_cache",
+         "Write decrypted game executables to disk to speed up boots; disabled|enabled"},
         {"citra_use_virtual_sd", "Enable virtual SD card; enabled|disabled"},
         {"citra_use_libretro_save_path", "Savegame location; LibRetro Default|Citra Default"},
         {"citra_is_new_3ds", "3DS system model; Old 3DS|New 3DS"},
@@ -221,7 +230,6 @@ void UpdateSettings() {
     Settings::values.volume = 1.0f;
 
     // We don't need these, as this is the frontend's responsibility.
-    Settings::values.enable_audio_stretching = false;
     Settings::values.use_frame_limit_alternate = true;
     Settings::values.frame_limit = 10000;
 
@@ -239,14 +247,41 @@ void UpdateSettings() {
         Settings::values.cpu_clock_percentage = scale;
     }
 
+    auto dsp = LibRetro::FetchVariable("citra_dsp_emulation", "HLE");
+    Settings::values.enable_dsp_lle = dsp != "HLE";
+    Settings::values.enable_dsp_lle_multithread = dsp != "HLE" && dsp != "LLE";
+    Settings::values.enable_dsp_lle_decoupled = dsp == "LLE (decoupled, multithreaded)";
+    Settings::values.enable_dsp_hle_multithread =
+        LibRetro::FetchVariable("citra_use_dsp_hle_multithread", "disabled") == "enabled";
+
+    auto stretching = LibRetro::FetchVariable("citra_audio_stretching", "disabled");
+    Settings::values.enable_audio_stretching = stretching != "disabled";
+    Settings::values.audio_stretching_mode = stretching == "Latency targeting"
+                                                 ? Settings::AudioStretchingMode::LatencyTargeting
+                                                 : Settings::AudioStretchingMode::SoundTouch;
+
+    auto latency = LibRetro::FetchVariable("citra_audio_target_latency", "40 ms");
+    auto endOfLatency = latency.find(' ');
+    if (endOfLatency == std::string::npos) {
+        LOG_ERROR(Frontend, "Failed to parse audio target latency!");
+        Settings::values.audio_target_latency_ms = 40;
+    } else {
+        Settings::values.audio_target_latency_ms = stoi(latency.substr(0, endOfLatency));
+    }
+
     Settings::values.use_hw_renderer =
         LibRetro::FetchVariable("citra_use_hw_renderer", "enabled") == "enabled";
     Settings::values.use_hw_shader =
             LibRetro::FetchVariable("citra_use_hw_shaders", "enabled") == "enabled";
+    Settings::values.use_async_gpu =
+        LibRetro::FetchVariable("citra_use_async_gpu", "disabled") == "enabled";
+    Settings::values.async_gpu_queue_depth = 8;
     Settings::values.use_shader_jit =
         LibRetro::FetchVariable("citra_use_shader_jit", "enabled") == "enabled";
     Settings::values.shaders_accurate_mul =
             LibRetro::FetchVariable("citra_use_acc_mul", "enabled") == "enabled";
+    Settings::values.use_title_cache =
+        LibRetro::FetchVariable("citra_use_title_cache", "disabled") == "enabled";
     Settings::values.use_virtual_sd =
         LibRetro::FetchVariable("citra_use_virtual_sd", "enabled") == "enabled";
     Settings::values.is_new_3ds =
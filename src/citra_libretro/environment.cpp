@@ -143,7 +143,7 @@ void retro_get_system_info(struct retro_system_info* info) {
     info->library_name = "Citra";
     info->library_version = Common::g_scm_desc;
     info->need_fullpath = true;
-    info->valid_extensions = "3ds|3dsx|cia|elf";
+    info->valid_extensions = "3ds|3dsx|cia|elf|zcci|zcxi";
 }
 
 void retro_set_audio_sample(retro_audio_sample_t cb) {
@@ -106,11 +106,19 @@ void Config::ReadAudioValues() {
     Settings::values.enable_dsp_lle = ReadSetting(QStringLiteral("enable_dsp_lle"), false).toBool();
     Settings::values.enable_dsp_lle_multithread =
         ReadSetting(QStringLiteral("enable_dsp_lle_multithread"), false).toBool();
+    Settings::values.enable_dsp_lle_decoupled =
+        ReadSetting(QStringLiteral("enable_dsp_lle_decoupled"), false).toBool();
+    Settings::values.enable_dsp_hle_multithread =
+        ReadSetting(QStringLiteral("enable_dsp_hle_multithread"), false).toBool();
     Settings::values.sink_id = ReadSetting(QStringLiteral("output_engine"), QStringLiteral("auto"))
                                    .toString()
                                    .toStdString();
     Settings::values.enable_audio_stretching =
         ReadSetting(QStringLiteral("enable_audio_stretching"), true).toBool();
+    Settings::values.audio_stretching_mode = static_cast<Settings::AudioStretchingMode>(
+        ReadSetting(QStringLiteral("audio_stretching_mode"), 0).toInt());
+    Settings::values.audio_target_latency_ms =
+        ReadSetting(QStringLiteral("audio_target_latency_ms"), 40).toInt();
     Settings::values.audio_device_id =
         ReadSetting(QStringLiteral("output_device"), QStringLiteral("auto"))
             .toString()
@@ -284,6 +292,8 @@ void Config::ReadUtilityValues() {
         ReadSetting(QStringLiteral("custom_textures"), false).toBool();
     Settings::values.preload_textures =
         ReadSetting(QStringLiteral("preload_textures"), false).toBool();
+    Settings::values.use_title_cache =
+        ReadSetting(QStringLiteral("use_title_cache"), false).toBool();
 
     qt_config->endGroup();
 }
@@ -488,6 +498,9 @@ void Config::ReadRendererValues() {
     Settings::values.shaders_accurate_mul =
         ReadSetting(QStringLiteral("shaders_accurate_mul"), true).toBool();
     Settings::values.use_shader_jit = ReadSetting(QStringLiteral("use_shader_jit"), true).toBool();
+    Settings::values.use_async_gpu = ReadSetting(QStringLiteral("use_async_gpu"), false).toBool();
+    Settings::values.async_gpu_queue_depth =
+        static_cast<u16>(ReadSetting(QStringLiteral("async_gpu_queue_depth"), 8).toInt());
     Settings::values.use_disk_shader_cache =
         ReadSetting(QStringLiteral("use_disk_shader_cache"), true).toBool();
     Settings::values.use_vsync_new = ReadSetting(QStringLiteral("use_vsync_new"), true).toBool();
@@ -733,10 +746,18 @@ void Config::SaveAudioValues() {
     WriteSetting(QStringLiteral("enable_dsp_lle"), Settings::values.enable_dsp_lle, false);
     WriteSetting(QStringLiteral("enable_dsp_lle_multithread"),
                  Settings::values.enable_dsp_lle_multithread, false);
+    WriteSetting(QStringLiteral("enable_dsp_lle_decoupled"),
+                 Settings::values.enable_dsp_lle_decoupled, false);
+    WriteSetting(QStringLiteral("enable_dsp_hle_multithread"),
+                 Settings::values.enable_dsp_hle_multithread, false);
     WriteSetting(QStringLiteral("output_engine"), QString::fromStdString(Settings::values.sink_id),
                  QStringLiteral("auto"));
     WriteSetting(QStringLiteral("enable_audio_stretching"),
                  Settings::values.enable_audio_stretching, true);
+    WriteSetting(QStringLiteral("audio_stretching_mode"),
+                 static_cast<int>(Settings::values.audio_stretching_mode), 0);
+    WriteSetting(QStringLiteral("audio_target_latency_ms"),
+                 Settings::values.audio_target_latency_ms, 40);
     WriteSetting(QStringLiteral("output_device"),
                  QString::fromStdString(Settings::values.audio_device_id), QStringLiteral("auto"));
     WriteSetting(QStringLiteral("volume"), Settings::values.volume, 1.0f);
@@ -844,6 +865,7 @@ void Config::SaveUtilityValues() {
     WriteSetting(QStringLiteral("dump_textures"), Settings::values.dump_textures, false);
     WriteSetting(QStringLiteral("custom_textures"), Settings::values.custom_textures, false);
     WriteSetting(QStringLiteral("preload_textures"), Settings::values.preload_textures, false);
+    WriteSetting(QStringLiteral("use_title_cache"), Settings::values.use_title_cache, false);
 
     qt_config->endGroup();
 }
@@ -997,6 +1019,9 @@ void Config::SaveRendererValues() {
     WriteSetting(QStringLiteral("shaders_accurate_mul"), Settings::values.shaders_accurate_mul,
                  true);
     WriteSetting(QStringLiteral("use_shader_jit"), Settings::values.use_shader_jit, true);
+    WriteSetting(QStringLiteral("use_async_gpu"), Settings::values.use_async_gpu, false);
+    WriteSetting(QStringLiteral("async_gpu_queue_depth"), Settings::values.async_gpu_queue_depth,
+                 8);
     WriteSetting(QStringLiteral("use_disk_shader_cache"), Settings::values.use_disk_shader_cache,
                  true);
     WriteSetting(QStringLiteral("use_vsync_new"), Settings::values.use_vsync_new, true);
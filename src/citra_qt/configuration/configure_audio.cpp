@@ -34,6 +34,7 @@ ConfigureAudio::ConfigureAudio(QWidget* parent)
     ui->emulation_combo_box->addItem(tr("HLE (fast)"));
     ui->emulation_combo_box->addItem(tr("LLE (accurate)"));
     ui->emulation_combo_box->addItem(tr("LLE multi-core"));
+    ui->emulation_combo_box->addItem(tr("LLE multi-core (run-ahead)"));
     ui->emulation_combo_box->setEnabled(!Core::System::GetInstance().IsPoweredOn());
 
     connect(ui->volume_slider, &QSlider::valueChanged, this,
@@ -72,7 +73,7 @@ void ConfigureAudio::SetConfiguration() {
     int selection;
     if (Settings::values.enable_dsp_lle) {
         if (Settings::values.enable_dsp_lle_multithread) {
-            selection = 2;
+            selection = Settings::values.enable_dsp_lle_decoupled ? 3 : 2;
         } else {
             selection = 1;
         }
@@ -130,7 +131,8 @@ void ConfigureAudio::ApplyConfiguration() {
     Settings::values.volume =
         static_cast<float>(ui->volume_slider->sliderPosition()) / ui->volume_slider->maximum();
     Settings::values.enable_dsp_lle = ui->emulation_combo_box->currentIndex() != 0;
-    Settings::values.enable_dsp_lle_multithread = ui->emulation_combo_box->currentIndex() == 2;
+    Settings::values.enable_dsp_lle_multithread = ui->emulation_combo_box->currentIndex() >= 2;
+    Settings::values.enable_dsp_lle_decoupled = ui->emulation_combo_box->currentIndex() == 3;
     Settings::values.mic_input_type =
         static_cast<Settings::MicInputType>(ui->input_type_combo_box->currentIndex());
 
@@ -712,8 +712,9 @@ void GameList::LoadInterfaceLayout() {
 }
 
 const QStringList GameList::supported_file_extensions = {
-    QStringLiteral("3ds"), QStringLiteral("3dsx"), QStringLiteral("elf"), QStringLiteral("axf"),
-    QStringLiteral("cci"), QStringLiteral("cxi"),  QStringLiteral("app")};
+    QStringLiteral("3ds"),  QStringLiteral("3dsx"), QStringLiteral("elf"),
+    QStringLiteral("axf"),  QStringLiteral("cci"),  QStringLiteral("cxi"),
+    QStringLiteral("app"),  QStringLiteral("zcci"), QStringLiteral("zcxi")};
 
 void GameList::RefreshGameDirectory() {
     if (!UISettings::values.game_dirs.isEmpty() && current_worker != nullptr) {
@@ -4,7 +4,6 @@
 
 #pragma once
 
-#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -16,6 +15,7 @@
 #include <QVector>
 #include "citra_qt/compatibility_list.h"
 #include "common/common_types.h"
+#include "core/loader/game_scanner.h"
 
 class QStandardItem;
 
@@ -60,5 +60,5 @@ private:
     const CompatibilityList& compatibility_list;
 
     QStringList watch_list;
-    std::atomic_bool stop_processing;
+    Loader::GameScanner scanner;
 };
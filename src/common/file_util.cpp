@@ -399,6 +399,38 @@ u64 GetSize(FILE* f) {
     return size;
 }
 
+s64 GetModificationTime(const std::string& filename) {
+    std::string copy(filename);
+    StripTailDirSlashes(copy);
+
+#ifdef _WIN32
+    // stat only has a resolution of seconds on Windows
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(Common::UTF8ToUTF16W(copy).c_str(), GetFileExInfoStandard, &data)) {
+        LOG_DEBUG(Common_Filesystem, "GetFileAttributesEx failed on {}: {}", filename,
+                  GetLastErrorMsg());
+        return 0;
+    }
+    // In units of 100 ns since 1601
+    constexpr s64 epoch_offset = 116444736000000000LL;
+    const s64 time = static_cast<s64>(static_cast<u64>(data.ftLastWriteTime.dwHighDateTime) << 32 |
+                                      data.ftLastWriteTime.dwLowDateTime);
+    return (time - epoch_offset) * 100;
+#else
+    struct stat buf;
+    if (stat(copy.c_str(), &buf) != 0) {
+        LOG_DEBUG(Common_Filesystem, "stat failed on {}: {}", filename, GetLastErrorMsg());
+        return 0;
+    }
+#ifdef __APPLE__
+    const struct timespec& time = buf.st_mtimespec;
+#else
+    const struct timespec& time = buf.st_mtim;
+#endif
+    return static_cast<s64>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+}
+
 bool CreateEmptyFile(const std::string& filename) {
     LOG_TRACE(Common_Filesystem, "{}", filename);
 
@@ -478,7 +510,16 @@ u64 ScanDirectoryTree(const std::string& directory, FSTEntry& parent_entry,
         entry.virtualName = virtual_name;
         entry.physicalName = directory + DIR_SEP + virtual_name;
 
-        if (IsDirectory(entry.physicalName)) {
+        // One stat call per entry, as this runs for every entry of potentially large directories
+        struct stat file_info;
+#ifdef _WIN32
+        const int result =
+            _wstat64(Common::UTF8ToUTF16W(entry.physicalName).c_str(), &file_info);
+#else
+        const int result = stat(entry.physicalName.c_str(), &file_info);
+#endif
+
+        if (result == 0 && S_ISDIR(file_info.st_mode)) {
             entry.isDirectory = true;
             // is a directory, lets go inside if we didn't recurse to often
             if (recursion > 0) {
@@ -489,7 +530,7 @@ u64 ScanDirectoryTree(const std::string& directory, FSTEntry& parent_entry,
             }
         } else { // is a file
             entry.isDirectory = false;
-            entry.size = GetSize(entry.physicalName);
+            entry.size = result == 0 ? file_info.st_size : 0;
         }
         (*num_entries_out)++;
 
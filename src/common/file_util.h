@@ -113,6 +113,10 @@ private:
 // Overloaded GetSize, accepts FILE*
 [[nodiscard]] u64 GetSize(CORE_FILE* f);
 
+// Returns the time filename was last modified in nanoseconds since the epoch, or 0 on failure.
+// The resolution depends on the host file system.
+[[nodiscard]] s64 GetModificationTime(const std::string& filename);
+
 // Returns true if successful, or path already exists.
 bool CreateDir(const std::string& filename);
 
@@ -0,0 +1,192 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <utility>
+#include "common/logging/log.h"
+#include "common/mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include "common/string_util.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FileUtil {
+
+MappedFile::MappedFile() = default;
+
+MappedFile::MappedFile(const std::string& filename, u64 offset, std::size_t size) {
+    Open(filename, offset, size);
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    Close();
+    filename = std::move(other.filename);
+    offset = other.offset;
+    size = other.size;
+    data = std::exchange(other.data, nullptr);
+    view = std::exchange(other.view, nullptr);
+    view_size = std::exchange(other.view_size, 0);
+    return *this;
+}
+
+bool MappedFile::Open(const std::string& filename_, u64 offset_, std::size_t size_) {
+    Close();
+    filename = filename_;
+    offset = offset_;
+    size = size_;
+    return Map();
+}
+
+#if defined(HAVE_LIBRETRO_VFS)
+
+// Content may only be reachable through the frontend's VFS, which cannot be mapped.
+bool MappedFile::Map() {
+    return false;
+}
+
+void MappedFile::Close() {}
+
+void MappedFile::Advise(std::size_t, std::size_t, Advice) const {}
+
+#elif defined(_WIN32)
+
+bool MappedFile::Map() {
+    if (size == 0) {
+        return false;
+    }
+
+    HANDLE file = CreateFileW(Common::UTF8ToUTF16W(filename).c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) ||
+        static_cast<u64>(file_size.QuadPart) < offset + size) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const u64 view_offset = offset - offset % info.dwAllocationGranularity;
+    view_size = static_cast<std::size_t>(offset - view_offset) + size;
+    view = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(view_offset >> 32),
+                         static_cast<DWORD>(view_offset), view_size);
+    // The view keeps the mapping alive.
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        LOG_WARNING(Common_Filesystem, "Failed to map {}: error {}", filename, GetLastError());
+        view_size = 0;
+        return false;
+    }
+    data = static_cast<const u8*>(view) + (offset - view_offset);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (view != nullptr) {
+        UnmapViewOfFile(view);
+    }
+    data = nullptr;
+    view = nullptr;
+    view_size = 0;
+}
+
+void MappedFile::Advise(std::size_t, std::size_t, Advice) const {
+    // Windows reads ahead of sequential page faults on its own and has no equivalent of
+    // madvise that works on Windows 7.
+}
+
+#else
+
+bool MappedFile::Map() {
+    if (size == 0) {
+        return false;
+    }
+
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<u64>(file_stat.st_size) < offset + size) {
+        close(fd);
+        return false;
+    }
+
+    const u64 page_size = static_cast<u64>(sysconf(_SC_PAGESIZE));
+    const u64 view_offset = offset - offset % page_size;
+    view_size = static_cast<std::size_t>(offset - view_offset) + size;
+    view = mmap(nullptr, view_size, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(view_offset));
+    // The mapping keeps the file open.
+    close(fd);
+    if (view == MAP_FAILED) {
+        LOG_WARNING(Common_Filesystem, "Failed to map {}: {}", filename, GetLastErrorMsg());
+        view = nullptr;
+        view_size = 0;
+        return false;
+    }
+    data = static_cast<const u8*>(view) + (offset - view_offset);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (view != nullptr) {
+        munmap(view, view_size);
+    }
+    data = nullptr;
+    view = nullptr;
+    view_size = 0;
+}
+
+void MappedFile::Advise(std::size_t advise_offset, std::size_t length, Advice advice) const {
+    if (data == nullptr || advise_offset >= size) {
+        return;
+    }
+    length = std::min(length, size - advise_offset);
+
+    // madvise wants a page-aligned address, so round the start of the range down.
+    const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t start =
+        static_cast<std::size_t>(data - static_cast<const u8*>(view)) + advise_offset;
+    const std::size_t page_start = start - start % page_size;
+    int posix_advice = MADV_NORMAL;
+    switch (advice) {
+    case Advice::WillNeed:
+        posix_advice = MADV_WILLNEED;
+        break;
+    case Advice::Sequential:
+        posix_advice = MADV_SEQUENTIAL;
+        break;
+    case Advice::Random:
+        posix_advice = MADV_RANDOM;
+        break;
+    }
+    madvise(static_cast<u8*>(view) + page_start, start - page_start + length, posix_advice);
+}
+
+#endif
+
+} // namespace FileUtil
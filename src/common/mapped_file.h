@@ -0,0 +1,91 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "common/common_funcs.h"
+#include "common/common_types.h"
+#include "common/file_util.h"
+#include "common/logging/log.h"
+
+namespace FileUtil {
+
+/**
+ * A read-only memory mapping of a range of a file.
+ *
+ * Mapping can fail for reasons that reading would not (e.g. address space exhaustion on 32-bit
+ * hosts, or files that only exist in the libretro VFS), so users must check IsOpen() and fall
+ * back to IOFile.
+ */
+class MappedFile : NonCopyable {
+public:
+    enum class Advice {
+        WillNeed,   ///< The range is about to be read, start paging it in
+        Sequential, ///< The range is going to be read front to back
+        Random,     ///< The range is going to be read in no particular order
+    };
+
+    MappedFile();
+    MappedFile(const std::string& filename, u64 offset, std::size_t size);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// Maps `size` bytes of the file starting at `offset`. Returns true on success.
+    bool Open(const std::string& filename, u64 offset, std::size_t size);
+    void Close();
+
+    [[nodiscard]] bool IsOpen() const {
+        return data != nullptr;
+    }
+
+    /// Pointer to the first mapped byte of the file, the one at `offset`.
+    const u8* Data() const {
+        return data;
+    }
+
+    std::size_t Size() const {
+        return size;
+    }
+
+    const std::string& GetFilename() const {
+        return filename;
+    }
+
+    /// Offset in the file of the first mapped byte.
+    u64 GetOffset() const {
+        return offset;
+    }
+
+    /// Passes a hint about how [offset, offset + length) will be accessed on to the OS.
+    void Advise(std::size_t offset, std::size_t length, Advice advice) const;
+
+private:
+    bool Map();
+
+    std::string filename;
+    u64 offset = 0;
+    std::size_t size = 0;
+
+    const u8* data = nullptr;
+    /// Start of the mapping, which is aligned down from `data` to the allocation granularity
+    void* view = nullptr;
+    std::size_t view_size = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& Path::make(filename);
+        ar& offset;
+        ar& size;
+        if (Archive::is_loading::value && !Map()) {
+            LOG_WARNING(Common_Filesystem, "Could not map {} again after loading", filename);
+        }
+    }
+    friend class boost::serialization::access;
+};
+
+} // namespace FileUtil
@@ -17,7 +17,7 @@
 
 namespace Common {
 
-/// SPSC ring buffer
+/// Wait-free SPSC ring buffer
 /// @tparam T            Element type
 /// @tparam capacity     Number of slots in ring buffer
 /// @tparam granularity  Slot size in terms of number of elements
@@ -39,8 +39,9 @@ public:
     /// @param slot_count  Number of slots to push
     /// @returns The number of slots actually pushed
     std::size_t Push(const void* new_slots, std::size_t slot_count) {
-        const std::size_t write_index = m_write_index.load();
-        const std::size_t slots_free = capacity + m_read_index.load() - write_index;
+        const std::size_t write_index = m_write_index.load(std::memory_order_relaxed);
+        const std::size_t slots_free =
+            capacity + m_read_index.load(std::memory_order_acquire) - write_index;
         const std::size_t push_count = std::min(slot_count, slots_free);
 
         const std::size_t pos = write_index % capacity;
@@ -52,7 +53,7 @@ public:
         in += first_copy * slot_size;
         std::memcpy(m_data.data(), in, second_copy * slot_size);
 
-        m_write_index.store(write_index + push_count);
+        m_write_index.store(write_index + push_count, std::memory_order_release);
 
         return push_count;
     }
@@ -66,24 +67,51 @@ public:
     /// @param max_slots  Maximum number of slots to pop
     /// @returns The number of slots actually popped
     std::size_t Pop(void* output, std::size_t max_slots = ~std::size_t(0)) {
-        const std::size_t read_index = m_read_index.load();
-        const std::size_t slots_filled = m_write_index.load() - read_index;
+        char* out = static_cast<char*>(output);
+        return Consume(
+            [&out](const T* slots, std::size_t slot_count) {
+                std::memcpy(out, slots, slot_count * slot_size);
+                out += slot_count * slot_size;
+            },
+            max_slots);
+    }
+
+    /// Pops slots from the ring buffer without copying them.
+    /// `consumer(const T* slots, std::size_t slot_count)` is called with each contiguous run of
+    /// filled slots (at most two runs, as the buffer may wrap around). The slots are only released
+    /// back to the producer once the consumer has returned.
+    /// @param consumer   Callable that processes the popped slots in place
+    /// @param max_slots  Maximum number of slots to pop
+    /// @returns The number of slots actually popped
+    template <typename Consumer>
+    std::size_t Consume(Consumer&& consumer, std::size_t max_slots = ~std::size_t(0)) {
+        const std::size_t read_index = m_read_index.load(std::memory_order_relaxed);
+        const std::size_t slots_filled =
+            m_write_index.load(std::memory_order_acquire) - read_index;
         const std::size_t pop_count = std::min(slots_filled, max_slots);
 
         const std::size_t pos = read_index % capacity;
         const std::size_t first_copy = std::min(capacity - pos, pop_count);
         const std::size_t second_copy = pop_count - first_copy;
 
-        char* out = static_cast<char*>(output);
-        std::memcpy(out, m_data.data() + pos * granularity, first_copy * slot_size);
-        out += first_copy * slot_size;
-        std::memcpy(out, m_data.data(), second_copy * slot_size);
+        if (first_copy > 0) {
+            consumer(m_data.data() + pos * granularity, first_copy);
+        }
+        if (second_copy > 0) {
+            consumer(m_data.data(), second_copy);
+        }
 
-        m_read_index.store(read_index + pop_count);
+        m_read_index.store(read_index + pop_count, std::memory_order_release);
 
         return pop_count;
     }
 
+    /// Drops up to `max_slots` slots from the ring buffer
+    /// @returns The number of slots actually dropped
+    std::size_t Discard(std::size_t max_slots = ~std::size_t(0)) {
+        return Consume([](const T*, std::size_t) {}, max_slots);
+    }
+
     std::vector<T> Pop(std::size_t max_slots = ~std::size_t(0)) {
         std::vector<T> out(std::min(max_slots, capacity) * granularity);
         const std::size_t count = Pop(out.data(), out.size() / granularity);
@@ -93,7 +121,10 @@ public:
 
     /// @returns Number of slots used
     [[nodiscard]] std::size_t Size() const {
-        return m_write_index.load() - m_read_index.load();
+        // The read index is loaded first: both indices only ever increase and read <= write, so
+        // this can never underflow even while the other side is active.
+        const std::size_t read_index = m_read_index.load(std::memory_order_acquire);
+        return m_write_index.load(std::memory_order_acquire) - read_index;
     }
 
     /// @returns Maximum size of ring buffer
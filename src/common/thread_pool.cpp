@@ -0,0 +1,108 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <atomic>
+#include "common/thread.h"
+#include "common/thread_pool.h"
+
+namespace Common {
+
+ThreadPool::ThreadPool(std::size_t num_threads, std::string name_) : name(std::move(name_)) {
+    threads.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    condvar.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func) {
+    if (count == 0) {
+        return;
+    }
+    if (threads.empty() || count == 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    // Helpers may only get scheduled after the caller has already finished all the work, so the
+    // shared state is reference counted and func is never touched once every index is claimed.
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable condvar;
+    };
+    const auto state = std::make_shared<State>();
+
+    const auto run = [state, count, &func] {
+        std::size_t completed = 0;
+        for (std::size_t i = state->next++; i < count; i = state->next++) {
+            func(i);
+            completed++;
+        }
+        if (completed == 0) {
+            return;
+        }
+        std::lock_guard lock{state->mutex};
+        state->done += completed;
+        if (state->done == count) {
+            state->condvar.notify_all();
+        }
+    };
+
+    const std::size_t num_helpers = std::min(threads.size(), count - 1);
+    for (std::size_t i = 0; i < num_helpers; i++) {
+        Enqueue(run);
+    }
+    run();
+
+    std::unique_lock lock{state->mutex};
+    state->condvar.wait(lock, [&] { return state->done == count; });
+}
+
+std::size_t ThreadPool::DefaultThreadCount(std::size_t max_threads) {
+    // Leave a core for the emulated CPU thread and one for the video/frontend thread.
+    const std::size_t hardware = std::thread::hardware_concurrency();
+    return std::clamp<std::size_t>(hardware > 2 ? hardware - 2 : 0, 0, max_threads);
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock{mutex};
+        tasks.push(std::move(task));
+    }
+    condvar.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    SetCurrentThreadName(name.c_str());
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{mutex};
+            condvar.wait(lock, [this] { return stop || !tasks.empty(); });
+            if (stop && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+} // namespace Common
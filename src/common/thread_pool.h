@@ -0,0 +1,81 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Common {
+
+/**
+ * A fixed-size pool of worker threads for short, independent tasks.
+ * Tasks are executed in FIFO order; there is no work stealing or prioritisation.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param num_threads Number of worker threads to spawn. May be zero, in which case
+     *                    ParallelFor runs entirely on the calling thread.
+     * @param name Name given to the worker threads.
+     */
+    explicit ThreadPool(std::size_t num_threads, std::string name = "ThreadPool");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Returns the number of worker threads (not counting the calling thread).
+    std::size_t NumThreads() const {
+        return threads.size();
+    }
+
+    /**
+     * Queues a task to be run on a worker thread.
+     * @return A future that becomes ready with the task's result once it has run.
+     */
+    template <typename Func>
+    std::future<std::invoke_result_t<Func>> Push(Func&& func) {
+        using Result = std::invoke_result_t<Func>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+        std::future<Result> result = task->get_future();
+        Enqueue([task] { (*task)(); });
+        return result;
+    }
+
+    /**
+     * Calls func(i) for every i in [0, count), distributing the calls over the worker threads and
+     * the calling thread. Returns once every call has completed. The order in which indices are
+     * processed is unspecified, so func must not depend on it.
+     */
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func);
+
+    /**
+     * Returns a sensible number of worker threads for a pool that is used alongside the
+     * emulation threads, clamped to [0, max_threads].
+     */
+    static std::size_t DefaultThreadCount(std::size_t max_threads);
+
+private:
+    void Enqueue(std::function<void()> task);
+    void WorkerLoop();
+
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condvar;
+    bool stop = false;
+    std::string name;
+};
+
+} // namespace Common
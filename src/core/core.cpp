@@ -23,6 +23,7 @@
 #include "core/dumping/backend.h"
 #ifdef ENABLE_FFMPEG_VIDEO_DUMPER
 #include "core/dumping/ffmpeg_backend.h"
+#include "core/file_sys/disk_archive.h"
 #endif
 #include "core/custom_tex_cache.h"
 #include "core/gdbstub/gdbstub.h"
@@ -389,16 +390,24 @@ System::ResultStatus System::Init(Frontend::EmuWindow& emu_window, u32 system_mo
     kernel->SetRunningCPU(cpu_cores[0].get());
 
     if (Settings::values.enable_dsp_lle) {
-        dsp_core = std::make_unique<AudioCore::DspLle>(*memory,
-                                                       Settings::values.enable_dsp_lle_multithread);
+        using Threading = AudioCore::DspLle::Threading;
+        Threading threading = Threading::SingleThread;
+        if (Settings::values.enable_dsp_lle_multithread) {
+            threading = Settings::values.enable_dsp_lle_decoupled ? Threading::Decoupled
+                                                                  : Threading::Lockstep;
+        }
+        dsp_core = std::make_unique<AudioCore::DspLle>(*memory, *timing, threading);
     } else {
-        dsp_core = std::make_unique<AudioCore::DspHle>(*memory);
+        dsp_core = std::make_unique<AudioCore::DspHle>(*memory, *timing,
+                                                       Settings::values.enable_dsp_hle_multithread);
     }
 
     memory->SetDSP(*dsp_core);
 
     dsp_core->SetSink(Settings::values.sink_id, Settings::values.audio_device_id);
     dsp_core->EnableStretching(Settings::values.enable_audio_stretching);
+    dsp_core->SetStretchingMode(Settings::values.audio_stretching_mode,
+                                Settings::values.audio_target_latency_ms);
 
     telemetry_session = std::make_unique<Core::TelemetrySession>();
 
@@ -528,6 +537,15 @@ void System::Shutdown(bool is_deserializing) {
     telemetry_session->AddField(performance, "Shutdown_Framerate", perf_results.game_fps);
     telemetry_session->AddField(performance, "Shutdown_Frametime", perf_results.frametime * 1000.0);
     telemetry_session->AddField(performance, "Mean_Frametime_MS", perf_stats->GetMeanFrametime());
+    if (dsp_core) {
+        const auto audio_stats = dsp_core->GetAndResetOutputStats();
+        telemetry_session->AddField(performance, "Shutdown_AudioUnderruns",
+                                    audio_stats.underruns);
+        telemetry_session->AddField(performance, "Shutdown_AudioCallbackJitterMeanMS",
+                                    audio_stats.mean_callback_jitter_ms);
+        telemetry_session->AddField(performance, "Shutdown_AudioCallbackJitterMaxMS",
+                                    audio_stats.max_callback_jitter_ms);
+    }
 
     // Shutdown emulation session
     VideoCore::Shutdown();
@@ -548,6 +566,8 @@ void System::Shutdown(bool is_deserializing) {
     kernel.reset();
     cpu_cores.clear();
     timing.reset();
+    // Flushes data buffered by files that are still open
+    FileSys::DiskFile::ShutdownFlusher();
 
     if (video_dumper && video_dumper->IsDumping()) {
         video_dumper->StopDumping();
@@ -604,6 +624,12 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
         Init(*m_emu_window, *system_mode.first, *n3ds_mode.first, num_cores);
     }
 
+    if (Archive::is_saving::value) {
+        // Work on the GPU thread writes to memory. The interrupts it raised are saved as they
+        // are, and signalled at the same point in emulated time after loading.
+        GPU::WaitIdle();
+    }
+
     // flush on save, don't flush on load
     bool should_flush = !Archive::is_loading::value;
     Memory::RasterizerClearAll(should_flush);
@@ -615,6 +641,9 @@ void System::serialize(Archive& ar, const unsigned int file_version) {
     ar&* archive_manager.get();
     ar& GPU::g_regs;
     ar& LCD::g_regs;
+    if (file_version >= 2) {
+        GPU::serialize(ar, file_version);
+    }
 
     // NOTE: DSP doesn't like being destroyed and recreated. So instead we do an inline
     // serialization; this means that the DSP Settings need to match for loading to work.
@@ -410,4 +410,4 @@ private:
 
 } // namespace Core
 
-BOOST_CLASS_VERSION(Core::System, 1)
+BOOST_CLASS_VERSION(Core::System, 2)
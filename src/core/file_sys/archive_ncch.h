@@ -92,7 +92,9 @@ public:
     bool Close() const override {
         return false;
     }
-    void Flush() const override {}
+    ResultCode Flush() const override {
+        return RESULT_SUCCESS;
+    }
 
 private:
     std::vector<u8> file_buffer;
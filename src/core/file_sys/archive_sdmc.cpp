@@ -10,6 +10,7 @@
 #include "core/file_sys/archive_sdmc.h"
 #include "core/file_sys/disk_archive.h"
 #include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
 #include "core/file_sys/path_parser.h"
 #include "core/settings.h"
 
@@ -98,6 +99,7 @@ ResultVal<std::unique_ptr<FileBackend>> SDMCArchive::OpenFileBase(const Path& pa
         } else {
             // Create the file
             FileUtil::CreateEmptyFile(full_path);
+            HostDirectoryCache::AddEntry(full_path, false);
         }
         break;
     case PathParser::FileFound:
@@ -107,6 +109,7 @@ ResultVal<std::unique_ptr<FileBackend>> SDMCArchive::OpenFileBase(const Path& pa
     FileUtil::IOFile file(full_path, mode.write_flag ? "r+b" : "rb");
     if (!file.IsOpen()) {
         LOG_CRITICAL(Service_FS, "(unreachable) Unknown error opening {}", full_path);
+        HostDirectoryCache::Invalidate(full_path);
         return ERROR_NOT_FOUND;
     }
 
@@ -142,9 +145,11 @@ ResultCode SDMCArchive::DeleteFile(const Path& path) const {
     }
 
     if (FileUtil::Delete(full_path)) {
+        HostDirectoryCache::RemoveEntry(full_path);
         return RESULT_SUCCESS;
     }
 
+    HostDirectoryCache::Invalidate(full_path);
     LOG_CRITICAL(Service_FS, "(unreachable) Unknown error deleting {}", full_path);
     return ERROR_NOT_FOUND;
 }
@@ -169,6 +174,8 @@ ResultCode SDMCArchive::RenameFile(const Path& src_path, const Path& dest_path)
     const auto dest_path_full = path_parser_dest.BuildHostPath(mount_point);
 
     if (FileUtil::Rename(src_path_full, dest_path_full)) {
+        HostDirectoryCache::Invalidate(src_path_full);
+        HostDirectoryCache::Invalidate(dest_path_full);
         return RESULT_SUCCESS;
     }
 
@@ -210,9 +217,12 @@ static ResultCode DeleteDirectoryHelper(const Path& path, const std::string& mou
     }
 
     if (deleter(full_path)) {
+        HostDirectoryCache::RemoveEntry(full_path);
         return RESULT_SUCCESS;
     }
 
+    // A recursive delete can fail halfway through.
+    HostDirectoryCache::Invalidate(full_path);
     LOG_ERROR(Service_FS, "Directory not empty {}", full_path);
     return ERROR_UNEXPECTED_FILE_OR_DIRECTORY_SDMC;
 }
@@ -256,6 +266,7 @@ ResultCode SDMCArchive::CreateFile(const FileSys::Path& path, u64 size) const {
 
     if (size == 0) {
         FileUtil::CreateEmptyFile(full_path);
+        HostDirectoryCache::AddEntry(full_path, false);
         return RESULT_SUCCESS;
     }
 
@@ -263,9 +274,11 @@ ResultCode SDMCArchive::CreateFile(const FileSys::Path& path, u64 size) const {
     // Creates a sparse file (or a normal file on filesystems without the concept of sparse files)
     // We do this by seeking to the right size, then writing a single null byte.
     if (file.Seek(size - 1, SEEK_SET) && file.WriteBytes("", 1) == 1) {
+        HostDirectoryCache::AddEntry(full_path, false);
         return RESULT_SUCCESS;
     }
 
+    HostDirectoryCache::Invalidate(full_path);
     LOG_ERROR(Service_FS, "Too large file");
     return ResultCode(ErrorDescription::TooLarge, ErrorModule::FS, ErrorSummary::OutOfResource,
                       ErrorLevel::Info);
@@ -298,6 +311,7 @@ ResultCode SDMCArchive::CreateDirectory(const Path& path) const {
     }
 
     if (FileUtil::CreateDir(mount_point + path.AsString())) {
+        HostDirectoryCache::AddEntry(full_path, true);
         return RESULT_SUCCESS;
     }
 
@@ -326,6 +340,8 @@ ResultCode SDMCArchive::RenameDirectory(const Path& src_path, const Path& dest_p
     const auto dest_path_full = path_parser_dest.BuildHostPath(mount_point);
 
     if (FileUtil::Rename(src_path_full, dest_path_full)) {
+        HostDirectoryCache::Invalidate(src_path_full);
+        HostDirectoryCache::Invalidate(dest_path_full);
         return RESULT_SUCCESS;
     }
 
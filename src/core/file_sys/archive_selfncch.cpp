@@ -73,7 +73,9 @@ public:
         return true;
     }
 
-    void Flush() const override {}
+    ResultCode Flush() const override {
+        return RESULT_SUCCESS;
+    }
 
 private:
     std::shared_ptr<std::vector<u8>> data;
@@ -12,6 +12,7 @@
 #include "common/file_util.h"
 #include "core/file_sys/archive_systemsavedata.h"
 #include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
 #include "core/file_sys/savedata_archive.h"
 #include "core/hle/service/fs/archive.h"
 
@@ -72,6 +73,7 @@ ResultCode ArchiveFactory_SystemSaveData::Format(const Path& path,
     std::string fullpath = GetSystemSaveDataPath(base_path, path);
     FileUtil::DeleteDirRecursively(fullpath);
     FileUtil::CreateFullPath(fullpath);
+    HostDirectoryCache::Invalidate(fullpath);
     return RESULT_SUCCESS;
 }
 
@@ -0,0 +1,347 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include "common/logging/log.h"
+#include "common/swap.h"
+#include "common/thread_pool.h"
+#include "common/zstd_compression.h"
+#include "core/file_sys/compressed_image.h"
+
+namespace FileSys {
+
+namespace {
+
+/// Magic number that every Zstandard frame starts with.
+constexpr u32 zstd_frame_magic = 0xFD2FB528;
+/// Magic number of the skippable frame holding the seek table.
+constexpr u32 skippable_frame_magic = 0x184D2A5E;
+/// Magic number that the seek table ends with.
+constexpr u32 seekable_magic = 0x8F92EAB1;
+/// Flag of the seek table descriptor saying that each entry also has a checksum of its frame.
+constexpr u8 checksum_flag = 0x80;
+/// Bits of the seek table descriptor that have to be zero.
+constexpr u8 reserved_flags = 0x7C;
+
+struct SkippableFrameHeader {
+    u32_le magic;
+    u32_le size;
+};
+static_assert(sizeof(SkippableFrameHeader) == 8, "SkippableFrameHeader has incorrect size");
+
+struct SeekTableEntry {
+    u32_le compressed_size;
+    u32_le size;
+};
+static_assert(sizeof(SeekTableEntry) == 8, "SeekTableEntry has incorrect size");
+
+#pragma pack(push, 1)
+struct SeekTableFooter {
+    u32_le num_frames;
+    u8 descriptor;
+    u32_le magic;
+};
+#pragma pack(pop)
+static_assert(sizeof(SeekTableFooter) == 9, "SeekTableFooter has incorrect size");
+
+/**
+ * Copies `length` bytes at `offset` out of the frames that hold them.
+ * @param get_frame Returns the decompressed data of the frame with the given index
+ */
+template <typename Frames, typename GetFrame>
+std::size_t CopyFrames(const Frames& frames, u64 offset, std::size_t length, u8* buffer,
+                       GetFrame&& get_frame) {
+    // The first frame that ends after the offset
+    auto it = std::upper_bound(frames.begin(), frames.end(), offset,
+                               [](u64 value, const auto& frame) { return value < frame.offset; });
+    std::size_t index = it == frames.begin() ? 0 : it - frames.begin() - 1;
+
+    std::size_t read_length = 0;
+    for (; index < frames.size() && read_length < length; index++) {
+        const std::vector<u8>& data = get_frame(index);
+        if (data.size() != frames[index].size) {
+            break;
+        }
+        const std::size_t frame_offset = offset + read_length - frames[index].offset;
+        const std::size_t copy_length = std::min(length - read_length, data.size() - frame_offset);
+        std::memcpy(buffer + read_length, data.data() + frame_offset, copy_length);
+        read_length += copy_length;
+    }
+    return read_length;
+}
+
+} // Anonymous namespace
+
+CompressedImage::CompressedImage(const std::string& path) : path(path), file(path, "rb") {
+    if (!file || !IsCompressedImage(file) || !ReadSeekTable(file, frames)) {
+        LOG_ERROR(Service_FS, "{} is not a valid compressed image", path);
+        return;
+    }
+    size = frames.empty() ? 0 : frames.back().offset + frames.back().size;
+    is_open = true;
+}
+
+std::size_t CompressedImage::Read(u64 offset, std::size_t length, u8* buffer) {
+    if (!is_open || offset >= size) {
+        return 0;
+    }
+    length = static_cast<std::size_t>(std::min<u64>(length, size - offset));
+
+    std::lock_guard lock{mutex};
+    const std::size_t read_length =
+        CopyFrames(frames, offset, length, buffer,
+                   [this](std::size_t index) -> const std::vector<u8>& { return GetFrame(index); });
+    if (read_length != length) {
+        LOG_ERROR(Service_FS, "Compressed image {} is corrupted around offset 0x{:X}", path,
+                  offset + read_length);
+    }
+    return read_length;
+}
+
+bool CompressedImage::IsCompressedImage(FileUtil::IOFile& file) {
+    if (file.GetSize() < sizeof(u32) + sizeof(SkippableFrameHeader) + sizeof(SeekTableFooter)) {
+        return false;
+    }
+
+    u32_le first_magic;
+    u32_le last_magic;
+    file.Seek(0, SEEK_SET);
+    file.ReadBytes(&first_magic, sizeof(first_magic));
+    file.Seek(-static_cast<s64>(sizeof(last_magic)), SEEK_END);
+    file.ReadBytes(&last_magic, sizeof(last_magic));
+    return file && first_magic == zstd_frame_magic && last_magic == seekable_magic;
+}
+
+std::size_t CompressedImage::ReadOnce(FileUtil::IOFile& file, u64 offset, std::size_t length,
+                                      u8* buffer) {
+    std::vector<Frame> frames;
+    if (!ReadSeekTable(file, frames)) {
+        return 0;
+    }
+
+    std::vector<u8> data;
+    return CopyFrames(frames, offset, length, buffer,
+                      [&](std::size_t index) -> const std::vector<u8>& {
+                          data = DecompressFrame(file, frames[index]);
+                          return data;
+                      });
+}
+
+bool CompressedImage::ReadSeekTable(FileUtil::IOFile& file, std::vector<Frame>& frames) {
+    const u64 file_size = file.GetSize();
+    if (file_size < sizeof(SkippableFrameHeader) + sizeof(SeekTableFooter)) {
+        return false;
+    }
+
+    SeekTableFooter footer;
+    file.Seek(file_size - sizeof(footer), SEEK_SET);
+    if (file.ReadBytes(&footer, sizeof(footer)) != sizeof(footer) ||
+        footer.magic != seekable_magic || (footer.descriptor & reserved_flags) != 0) {
+        return false;
+    }
+
+    // Frame checksums are not checked, as Zstandard already detects corrupted frames.
+    const u64 entry_size = sizeof(SeekTableEntry) + (footer.descriptor & checksum_flag ? 4 : 0);
+    const u64 table_size = footer.num_frames * entry_size + sizeof(SeekTableFooter);
+    if (file_size < table_size + sizeof(SkippableFrameHeader)) {
+        return false;
+    }
+    const u64 table_offset = file_size - table_size - sizeof(SkippableFrameHeader);
+
+    SkippableFrameHeader header;
+    file.Seek(table_offset, SEEK_SET);
+    if (file.ReadBytes(&header, sizeof(header)) != sizeof(header) ||
+        header.magic != skippable_frame_magic || header.size != table_size) {
+        return false;
+    }
+
+    std::vector<u8> table(table_size - sizeof(SeekTableFooter));
+    if (file.ReadBytes(table.data(), table.size()) != table.size()) {
+        return false;
+    }
+
+    frames.resize(footer.num_frames);
+    u64 compressed_offset = 0;
+    u64 offset = 0;
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        SeekTableEntry entry;
+        std::memcpy(&entry, table.data() + i * entry_size, sizeof(entry));
+        frames[i] = {compressed_offset, offset, entry.compressed_size, entry.size};
+        compressed_offset += entry.compressed_size;
+        offset += entry.size;
+    }
+    return compressed_offset <= table_offset;
+}
+
+std::vector<u8> CompressedImage::DecompressFrame(FileUtil::IOFile& file, const Frame& frame) {
+    std::vector<u8> compressed(frame.compressed_size);
+    file.Seek(frame.compressed_offset, SEEK_SET);
+    if (file.ReadBytes(compressed.data(), compressed.size()) != compressed.size()) {
+        return {};
+    }
+    return Common::Compression::DecompressDataZSTD(compressed);
+}
+
+const std::vector<u8>& CompressedImage::GetFrame(std::size_t index) {
+    auto it = std::find_if(cache.begin(), cache.end(),
+                           [index](const CachedFrame& frame) { return frame.index == index; });
+    if (it != cache.end()) {
+        cache.splice(cache.begin(), cache, it);
+        return cache.front().data;
+    }
+
+    if (cache.size() < max_cached_frames) {
+        cache.emplace_front();
+    } else {
+        // Reuses the least recently used frame
+        cache.splice(cache.begin(), cache, std::prev(cache.end()));
+    }
+    cache.front().index = index;
+    cache.front().data = DecompressFrame(file, frames[index]);
+    if (cache.front().data.size() != frames[index].size) {
+        // Keeps the bad data out of the cache, so that the next read tries again
+        cache.front().index = frames.size();
+    }
+    return cache.front().data;
+}
+
+bool CompressImage(const std::string& source_path, const std::string& destination_path,
+                   std::size_t frame_size, int compression_level, std::size_t num_threads,
+                   const std::function<void(u64, u64)>& progress) {
+    FileUtil::IOFile source(source_path, "rb");
+    if (!source) {
+        LOG_ERROR(Service_FS, "Could not open {}", source_path);
+        return false;
+    }
+    const u64 source_size = source.GetSize();
+    if (source_size == 0 || frame_size == 0 || frame_size > 0x40000000) {
+        LOG_ERROR(Service_FS, "Can not compress {} into frames of {} bytes", source_path,
+                  frame_size);
+        return false;
+    }
+
+    FileUtil::IOFile destination(destination_path, "wb");
+    if (!destination) {
+        LOG_ERROR(Service_FS, "Could not create {}", destination_path);
+        return false;
+    }
+
+    const auto fail = [&] {
+        destination.Close();
+        FileUtil::Delete(destination_path);
+        return false;
+    };
+
+    // Frames are compressed in batches, a few per thread, and written out in order.
+    num_threads = std::max<std::size_t>(num_threads, 1);
+    Common::ThreadPool threads(num_threads - 1, "Image Compression");
+    const std::size_t batch_size = num_threads * 4;
+    std::vector<std::vector<u8>> batch(batch_size);
+    std::vector<SeekTableEntry> entries;
+
+    u64 offset = 0;
+    while (offset < source_size) {
+        const std::size_t num_frames = static_cast<std::size_t>(
+            std::min<u64>(batch_size, (source_size - offset + frame_size - 1) / frame_size));
+        for (std::size_t i = 0; i < num_frames; i++) {
+            batch[i].resize(static_cast<std::size_t>(
+                std::min<u64>(frame_size, source_size - offset - i * frame_size)));
+            if (source.ReadBytes(batch[i].data(), batch[i].size()) != batch[i].size()) {
+                LOG_ERROR(Service_FS, "Could not read {}", source_path);
+                return fail();
+            }
+        }
+
+        threads.ParallelFor(num_frames, [&](std::size_t i) {
+            batch[i] = Common::Compression::CompressDataZSTD(batch[i].data(), batch[i].size(),
+                                                             compression_level);
+        });
+
+        for (std::size_t i = 0; i < num_frames; i++) {
+            const u64 size = std::min<u64>(frame_size, source_size - offset);
+            if (batch[i].empty() ||
+                destination.WriteBytes(batch[i].data(), batch[i].size()) != batch[i].size()) {
+                LOG_ERROR(Service_FS, "Could not write {}", destination_path);
+                return fail();
+            }
+            entries.push_back({static_cast<u32>(batch[i].size()), static_cast<u32>(size)});
+            offset += size;
+        }
+
+        if (progress) {
+            progress(offset, source_size);
+        }
+    }
+
+    SkippableFrameHeader header;
+    header.magic = skippable_frame_magic;
+    header.size = static_cast<u32>(entries.size() * sizeof(SeekTableEntry) +
+                                   sizeof(SeekTableFooter));
+    SeekTableFooter footer;
+    footer.num_frames = static_cast<u32>(entries.size());
+    footer.descriptor = 0;
+    footer.magic = seekable_magic;
+    if (destination.WriteBytes(&header, sizeof(header)) != sizeof(header) ||
+        destination.WriteBytes(entries.data(), entries.size() * sizeof(SeekTableEntry)) !=
+            entries.size() * sizeof(SeekTableEntry) ||
+        destination.WriteBytes(&footer, sizeof(footer)) != sizeof(footer) ||
+        !destination.Close()) {
+        LOG_ERROR(Service_FS, "Could not write {}", destination_path);
+        return fail();
+    }
+    return true;
+}
+
+ImageFile::ImageFile(const std::string& path) : file(path, "rb") {
+    if (file && CompressedImage::IsCompressedImage(file)) {
+        file.Close();
+        image = std::make_shared<CompressedImage>(path);
+    } else {
+        file.Seek(0, SEEK_SET);
+    }
+}
+
+ImageFile::ImageFile(FileUtil::IOFile&& file) : file(std::move(file)) {}
+
+bool ImageFile::IsOpen() const {
+    return image ? image->IsOpen() : file.IsOpen();
+}
+
+ImageFile::operator bool() const {
+    return image ? image->IsOpen() : static_cast<bool>(file);
+}
+
+bool ImageFile::Seek(s64 offset, int origin) {
+    if (!image) {
+        return file.Seek(offset, origin);
+    }
+
+    s64 base = 0;
+    if (origin == SEEK_CUR) {
+        base = static_cast<s64>(position);
+    } else if (origin == SEEK_END) {
+        base = static_cast<s64>(image->GetSize());
+    }
+    if (base + offset < 0) {
+        return false;
+    }
+    position = static_cast<u64>(base + offset);
+    return true;
+}
+
+u64 ImageFile::GetSize() const {
+    return image ? image->GetSize() : file.GetSize();
+}
+
+std::size_t ImageFile::ReadImpl(void* data, std::size_t length) {
+    if (!image) {
+        return file.ReadBytes(static_cast<u8*>(data), length);
+    }
+    const std::size_t read_length = image->Read(position, length, static_cast<u8*>(data));
+    position += read_length;
+    return read_length;
+}
+
+} // namespace FileSys
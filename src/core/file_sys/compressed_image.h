@@ -0,0 +1,174 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <boost/serialization/access.hpp>
+#include "common/common_types.h"
+#include "common/file_util.h"
+
+namespace FileSys {
+
+/**
+ * A title image (CCI or CXI) compressed in the Zstandard seekable format: the image is cut into
+ * frames of a fixed size that are each compressed on their own, followed by a skippable frame
+ * holding the compressed and decompressed size of every frame. Random reads only have to
+ * decompress the frames they touch, and any Zstandard decoder can still decompress the whole file.
+ */
+class CompressedImage {
+public:
+    /// Size of the frames images are cut into unless told otherwise. This matches the blocks of
+    /// DirectRomFSReader, so that a miss in its cache decompresses a single frame.
+    static constexpr std::size_t default_frame_size = 64 * 1024;
+    /// Number of decompressed frames kept around for reads that hit the same frame again.
+    static constexpr std::size_t max_cached_frames = 8;
+
+    explicit CompressedImage(const std::string& path);
+
+    /// Whether the file could be opened and has a valid seek table.
+    bool IsOpen() const {
+        return is_open;
+    }
+
+    /// Size of the decompressed image.
+    u64 GetSize() const {
+        return size;
+    }
+
+    const std::string& GetPath() const {
+        return path;
+    }
+
+    /**
+     * Reads decompressed data. Safe to call from several threads at once.
+     * @return Number of bytes read, which is less than `length` past the end or on errors
+     */
+    std::size_t Read(u64 offset, std::size_t length, u8* buffer);
+
+    /**
+     * Checks for the magic values at the start and the end of a compressed image. This moves the
+     * position of the file.
+     */
+    static bool IsCompressedImage(FileUtil::IOFile& file);
+
+    /**
+     * Reads decompressed data from a compressed image without caching anything, for one-off reads
+     * such as identifying what the image holds. This moves the position of the file.
+     */
+    static std::size_t ReadOnce(FileUtil::IOFile& file, u64 offset, std::size_t length,
+                                u8* buffer);
+
+private:
+    struct Frame {
+        u64 compressed_offset;
+        u64 offset;
+        u32 compressed_size;
+        u32 size;
+    };
+
+    struct CachedFrame {
+        std::size_t index;
+        std::vector<u8> data;
+    };
+
+    /// Reads the seek table at the end of the file into `frames`.
+    static bool ReadSeekTable(FileUtil::IOFile& file, std::vector<Frame>& frames);
+
+    /// Reads and decompresses a frame. Returns an empty vector on errors.
+    static std::vector<u8> DecompressFrame(FileUtil::IOFile& file, const Frame& frame);
+
+    /// Returns the given frame, decompressing it if it is not cached yet.
+    const std::vector<u8>& GetFrame(std::size_t index);
+
+    std::string path;
+    bool is_open = false;
+    u64 size = 0;
+    std::vector<Frame> frames;
+
+    /// Protects the file and the cache.
+    std::mutex mutex;
+    FileUtil::IOFile file;
+    /// Cached frames, the most recently used first
+    std::list<CachedFrame> cache;
+};
+
+/**
+ * Compresses a title image into the format read by CompressedImage.
+ * @param source_path Path of the image to compress
+ * @param destination_path Path of the compressed image, which is overwritten
+ * @param frame_size Size of the frames the image is cut into
+ * @param compression_level Zstandard compression level, between 1 and 22
+ * @param num_threads Number of threads compressing frames, including the calling one
+ * @param progress Called with the number of bytes compressed so far and the size of the image
+ * @return Whether the image was compressed. On failure the destination is deleted.
+ */
+bool CompressImage(const std::string& source_path, const std::string& destination_path,
+                   std::size_t frame_size, int compression_level, std::size_t num_threads,
+                   const std::function<void(u64, u64)>& progress = {});
+
+/**
+ * A read-only file that is either a plain title image or a CompressedImage, with the interface of
+ * FileUtil::IOFile that the title loaders use. Compressed images read as their decompressed
+ * contents.
+ */
+class ImageFile {
+public:
+    ImageFile() = default;
+    /// Opens the image at `path`, detecting whether it is compressed.
+    explicit ImageFile(const std::string& path);
+    /// Wraps an already open plain file.
+    ImageFile(FileUtil::IOFile&& file);
+
+    bool IsOpen() const;
+
+    bool IsCompressed() const {
+        return image != nullptr;
+    }
+
+    explicit operator bool() const;
+
+    bool Seek(s64 offset, int origin);
+    u64 GetSize() const;
+
+    template <typename T>
+    std::size_t ReadBytes(T* data, std::size_t length) {
+        static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+        return ReadImpl(data, length);
+    }
+
+    template <typename T>
+    std::size_t ReadArray(T* data, std::size_t length) {
+        return ReadBytes(data, length * sizeof(T)) / sizeof(T);
+    }
+
+private:
+    std::size_t ReadImpl(void* data, std::size_t length);
+
+    FileUtil::IOFile file;
+    std::shared_ptr<CompressedImage> image;
+    u64 position = 0;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& file;
+        std::string compressed_path = image ? image->GetPath() : std::string{};
+        ar& FileUtil::Path::make(compressed_path);
+        ar& position;
+        if (Archive::is_loading::value) {
+            image = compressed_path.empty() ? nullptr
+                                            : std::make_shared<CompressedImage>(compressed_path);
+        }
+    }
+    friend class boost::serialization::access;
+};
+
+} // namespace FileSys
@@ -3,14 +3,20 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
 #include <memory>
+#include <set>
+#include <thread>
 #include "common/archives.h"
 #include "common/common_types.h"
 #include "common/file_util.h"
 #include "common/logging/log.h"
 #include "core/file_sys/disk_archive.h"
 #include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FileSys namespace
@@ -20,11 +26,133 @@ SERIALIZE_EXPORT_IMPL(FileSys::DiskDirectory)
 
 namespace FileSys {
 
+/// Writes out the buffers of files that are neither written to, flushed nor closed for a while.
+class DiskFile::Flusher {
+public:
+    Flusher() : thread([this] { Run(); }) {}
+
+    ~Flusher() {
+        {
+            std::lock_guard lock{mutex};
+            stop = true;
+        }
+        cv.notify_one();
+        thread.join();
+
+        // Files that outlive the flusher are written out now and must not unregister from it.
+        for (const DiskFile* file : files) {
+            std::lock_guard file_lock{file->write_mutex};
+            file->FlushWriteBuffer();
+            file->flusher_registered = false;
+        }
+    }
+
+    void Add(const DiskFile* file) {
+        {
+            std::lock_guard lock{mutex};
+            files.insert(file);
+        }
+        cv.notify_one();
+    }
+
+    void Remove(const DiskFile* file) {
+        std::lock_guard lock{mutex};
+        files.erase(file);
+    }
+
+private:
+    void Run() {
+        std::unique_lock lock{mutex};
+        while (!stop) {
+            if (files.empty()) {
+                cv.wait(lock, [this] { return stop || !files.empty(); });
+                continue;
+            }
+            cv.wait_for(lock, write_back_delay / 4);
+
+            const auto now = std::chrono::steady_clock::now();
+            for (auto it = files.begin(); it != files.end();) {
+                const DiskFile& file = **it;
+                std::lock_guard file_lock{file.write_mutex};
+                if (!file.write_buffer.empty() &&
+                    now - file.write_buffer_time < write_back_delay) {
+                    ++it;
+                    continue;
+                }
+                file.FlushWriteBuffer();
+                file.flusher_registered = false;
+                it = files.erase(it);
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::set<const DiskFile*> files;
+    bool stop = false;
+    std::thread thread;
+};
+
+std::mutex DiskFile::flusher_mutex;
+std::unique_ptr<DiskFile::Flusher> DiskFile::flusher;
+
+void DiskFile::ShutdownFlusher() {
+    std::lock_guard lock{flusher_mutex};
+    flusher.reset();
+}
+
+DiskFile::~DiskFile() {
+    bool registered;
+    {
+        std::lock_guard lock{write_mutex};
+        if (file) {
+            FlushWriteBuffer();
+        }
+        registered = flusher_registered;
+    }
+    if (registered) {
+        std::lock_guard lock{flusher_mutex};
+        if (flusher) {
+            flusher->Remove(this);
+        }
+    }
+}
+
+bool DiskFile::FlushWriteBuffer() const {
+    if (write_buffer.empty())
+        return true;
+
+    host_write_count++;
+    const bool success = file->Seek(write_buffer_offset, SEEK_SET) &&
+                         file->WriteBytes(write_buffer.data(), write_buffer.size()) ==
+                             write_buffer.size() &&
+                         file->Flush();
+    if (!success) {
+        LOG_ERROR(Service_FS, "Could not write 0x{:x} buffered bytes at 0x{:x}: {}",
+                  write_buffer.size(), write_buffer_offset, std::strerror(errno));
+        write_failed = true;
+    }
+    write_buffer.clear();
+    return success;
+}
+
+bool DiskFile::TakeWriteError() const {
+    const bool failed = write_failed;
+    write_failed = false;
+    return failed;
+}
+
 ResultVal<std::size_t> DiskFile::Read(const u64 offset, const std::size_t length,
                                       u8* buffer) const {
     if (!mode.read_flag)
         return ERROR_INVALID_OPEN_FLAGS;
 
+    std::lock_guard lock{write_mutex};
+    if (offset < write_buffer_offset + write_buffer.size() &&
+        offset + length > write_buffer_offset) {
+        FlushWriteBuffer();
+    }
+
     file->Seek(offset, SEEK_SET);
     return MakeResult<std::size_t>(file->ReadBytes(buffer, length));
 }
@@ -34,25 +162,91 @@ ResultVal<std::size_t> DiskFile::Write(const u64 offset, const std::size_t lengt
     if (!mode.write_flag)
         return ERROR_INVALID_OPEN_FLAGS;
 
-    file->Seek(offset, SEEK_SET);
-    std::size_t written = file->WriteBytes(buffer, length);
-    if (flush)
-        file->Flush();
-    return MakeResult<std::size_t>(written);
+    bool register_with_flusher = false;
+    {
+        std::lock_guard lock{write_mutex};
+        if (length >= write_buffer_size) {
+            FlushWriteBuffer();
+            if (TakeWriteError()) {
+                return ERROR_INSUFFICIENT_SPACE;
+            }
+            file->Seek(offset, SEEK_SET);
+            host_write_count++;
+            std::size_t written = file->WriteBytes(buffer, length);
+            if (flush)
+                file->Flush();
+            return MakeResult<std::size_t>(written);
+        }
+
+        // Only writes that continue or overwrite the buffered range are collected with it.
+        const bool continues_buffer = offset >= write_buffer_offset &&
+                                      offset <= write_buffer_offset + write_buffer.size() &&
+                                      offset + length <= write_buffer_offset + write_buffer_size;
+        if (!continues_buffer) {
+            FlushWriteBuffer();
+        }
+        // A buffered write that failed is reported by the next write. The host file system
+        // failing a write is most likely to be out of space, the only such error the FS reports.
+        if (TakeWriteError()) {
+            return ERROR_INSUFFICIENT_SPACE;
+        }
+        if (write_buffer.empty()) {
+            write_buffer_offset = offset;
+            write_buffer_time = std::chrono::steady_clock::now();
+            register_with_flusher = !flusher_registered;
+            flusher_registered = true;
+        }
+
+        const std::size_t buffer_offset = static_cast<std::size_t>(offset - write_buffer_offset);
+        if (buffer_offset + length > write_buffer.size()) {
+            write_buffer.resize(buffer_offset + length);
+        }
+        std::memcpy(write_buffer.data() + buffer_offset, buffer, length);
+    }
+
+    if (register_with_flusher) {
+        std::lock_guard lock{flusher_mutex};
+        if (!flusher) {
+            flusher = std::make_unique<Flusher>();
+        }
+        flusher->Add(this);
+    }
+    return MakeResult<std::size_t>(length);
 }
 
 u64 DiskFile::GetSize() const {
-    return file->GetSize();
+    std::lock_guard lock{write_mutex};
+    const u64 buffer_end = write_buffer.empty() ? 0 : write_buffer_offset + write_buffer.size();
+    return std::max(file->GetSize(), buffer_end);
 }
 
 bool DiskFile::SetSize(const u64 size) const {
+    std::lock_guard lock{write_mutex};
+    FlushWriteBuffer();
     file->Resize(size);
     file->Flush();
     return true;
 }
 
 bool DiskFile::Close() const {
-    return file->Close();
+    std::lock_guard lock{write_mutex};
+    FlushWriteBuffer();
+    const bool failed = TakeWriteError();
+    return file->Close() && !failed;
+}
+
+ResultCode DiskFile::Flush() const {
+    std::lock_guard lock{write_mutex};
+    FlushWriteBuffer();
+    if (TakeWriteError() || !file->Flush()) {
+        return ERROR_INSUFFICIENT_SPACE;
+    }
+    return RESULT_SUCCESS;
+}
+
+u64 DiskFile::GetHostWriteCount() const {
+    std::lock_guard lock{write_mutex};
+    return host_write_count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -62,6 +256,8 @@ DiskDirectory::DiskDirectory(const std::string& path) {
     directory.size = size;
     directory.isDirectory = true;
     children_iterator = directory.children.begin();
+    // The listing was just read from the host, so it also refreshes the archives' lookups.
+    HostDirectoryCache::UpdateListing(path, directory.children);
 }
 
 u32 DiskDirectory::Read(const u32 count, Entry* entries) {
@@ -4,8 +4,10 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <boost/serialization/base_object.hpp>
@@ -23,8 +25,25 @@
 
 namespace FileSys {
 
+/**
+ * A file on the host file system.
+ *
+ * Small writes are collected in a write-back buffer and reach the host file in one piece. The
+ * flush flag of a write does not force this; the buffer is written out when a write does not
+ * continue it, when it is full, when the file is read where it is buffered, resized, flushed or
+ * closed, and at the latest write_back_delay after the first write into it. If the emulator
+ * crashes, the writes of that last interval are lost. The buffer is written out in place rather
+ * than through a temporary file, so a crash in the middle of that can leave the host file
+ * partially updated, as it could before. Writing the buffer out can fail after the write that
+ * filled it returned; that error is returned by the next write, flush or close of the file.
+ */
 class DiskFile : public FileBackend {
 public:
+    /// Writes at least this large skip the buffer
+    static constexpr std::size_t write_buffer_size = 64 * 1024;
+    /// Longest time buffered writes are held back before they are written to the host file
+    static constexpr std::chrono::milliseconds write_back_delay{1000};
+
     DiskFile(FileUtil::IOFile&& file_, const Mode& mode_,
              std::unique_ptr<DelayGenerator> delay_generator_)
         : file(new FileUtil::IOFile(std::move(file_))) {
@@ -32,26 +51,60 @@ public:
         mode.hex = mode_.hex;
     }
 
+    ~DiskFile() override;
+
     ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const override;
     ResultVal<std::size_t> Write(u64 offset, std::size_t length, bool flush,
                                  const u8* buffer) override;
     u64 GetSize() const override;
     bool SetSize(u64 size) const override;
     bool Close() const override;
+    ResultCode Flush() const override;
 
-    void Flush() const override {
-        file->Flush();
-    }
+    /// Returns the number of writes made to the host file so far.
+    u64 GetHostWriteCount() const;
+
+    /**
+     * Stops the thread that writes out buffered writes after a delay, writing out the buffers of
+     * the files that are still open. A later buffered write starts it again.
+     */
+    static void ShutdownFlusher();
 
 protected:
     Mode mode;
     std::unique_ptr<FileUtil::IOFile> file;
 
 private:
+    class Flusher;
+
+    /// Started by the first buffered write and stopped by ShutdownFlusher. Files unregister from
+    /// it under flusher_mutex, so that none is destroyed while it shuts down.
+    static std::mutex flusher_mutex;
+    static std::unique_ptr<Flusher> flusher;
+
+    /// Writes the buffered writes to the host file. write_mutex has to be held.
+    bool FlushWriteBuffer() const;
+
+    /// Returns whether writing the buffer failed since the last call. write_mutex has to be held.
+    bool TakeWriteError() const;
+
+    // Reads can run on the FS I/O thread and delayed flushes on the flusher thread.
+    mutable std::mutex write_mutex;
+    mutable std::vector<u8> write_buffer;
+    mutable u64 write_buffer_offset = 0;
+    mutable std::chrono::steady_clock::time_point write_buffer_time;
+    mutable bool flusher_registered = false;
+    mutable bool write_failed = false;
+    mutable u64 host_write_count = 0;
+
     DiskFile() = default;
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
+        if (Archive::is_saving::value) {
+            std::lock_guard lock{write_mutex};
+            FlushWriteBuffer();
+        }
         ar& boost::serialization::base_object<FileBackend>(*this);
         ar& mode.hex;
         ar& file;
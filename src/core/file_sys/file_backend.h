@@ -28,9 +28,24 @@ public:
      * @param length Length in bytes of data to read from file
      * @param buffer Buffer to read data into
      * @return Number of bytes read, or error code
+     * @note This may be called on the FS I/O thread. Only GetReadDelayNs and GetDirectView are
+     * called on the backend while a read is in flight, and any host state that the backend shares
+     * with others has to be locked.
      */
     virtual ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const = 0;
 
+    /**
+     * Get a view of data in the file that can be copied from directly, for backends that keep the
+     * file contents in (mapped) memory. The view keeps the memory alive while it is held.
+     * @param offset Offset in bytes of the data
+     * @param length Length in bytes of the data
+     * @return Pointer to the data, or nullptr if the backend can't provide one for that range
+     * @note This may be called while Read runs on the FS I/O thread.
+     */
+    virtual std::shared_ptr<const u8> GetDirectView(u64 offset, std::size_t length) const {
+        return nullptr;
+    }
+
     /**
      * Write data to the file
      * @param offset Offset in bytes to start writing data to
@@ -86,8 +101,9 @@ public:
 
     /**
      * Flushes the file
+     * @return the result of writing out the data written to the file so far
      */
-    virtual void Flush() const = 0;
+    virtual ResultCode Flush() const = 0;
 
 protected:
     std::unique_ptr<DelayGenerator> delay_generator;
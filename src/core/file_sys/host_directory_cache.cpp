@@ -0,0 +1,183 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "common/logging/log.h"
+#include "core/file_sys/host_directory_cache.h"
+
+namespace FileSys::HostDirectoryCache {
+
+namespace {
+
+/// Names in a directory, mapped to whether each one is a directory itself
+using Listing = std::unordered_map<std::string, bool>;
+
+std::mutex mutex;
+/// Listings by the normalized host path of their directory
+std::map<std::string, Listing> listings;
+
+/// Converts a path to the one key used for it, without repeated or trailing separators.
+std::string Normalize(const std::string& path) {
+    std::string key;
+    key.reserve(path.size());
+    for (char c : path) {
+#ifdef _WIN32
+        if (c == '\\')
+            c = '/';
+#endif
+        if (c == '/' && !key.empty() && key.back() == '/')
+            continue;
+        key += c;
+    }
+    if (key.size() > 1 && key.back() == '/')
+        key.pop_back();
+    return key;
+}
+
+/// Paths going through ".." have several keys, so they bypass the cache.
+bool HasParentReference(const std::string& key) {
+    std::size_t start = 0;
+    while (start <= key.size()) {
+        const std::size_t end = std::min(key.find('/', start), key.size());
+        if (key.compare(start, end - start, "..") == 0)
+            return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+/// Splits a key into the key of its parent directory and its name.
+std::pair<std::string, std::string> SplitParent(const std::string& key) {
+    const std::size_t separator = key.rfind('/');
+    if (separator == std::string::npos)
+        return {".", key};
+    if (separator == 0)
+        return {"/", key.substr(1)};
+    return {key.substr(0, separator), key.substr(separator + 1)};
+}
+
+Listing MakeListing(const std::vector<FileUtil::FSTEntry>& entries) {
+    Listing listing;
+    listing.reserve(entries.size());
+    for (const FileUtil::FSTEntry& entry : entries) {
+        listing.emplace(entry.virtualName, entry.isDirectory);
+    }
+    return listing;
+}
+
+Listing ReadListing(const std::string& directory) {
+    FileUtil::FSTEntry parent;
+    FileUtil::ScanDirectoryTree(directory, parent);
+    LOG_TRACE(Service_FS, "Listed {} entries in {}", parent.children.size(), directory);
+    return MakeListing(parent.children);
+}
+
+EntryType ReadEntryType(const std::string& path) {
+    if (!FileUtil::Exists(path))
+        return EntryType::None;
+    return FileUtil::IsDirectory(path) ? EntryType::Directory : EntryType::File;
+}
+
+/// Drops the listings of a directory and of everything below it.
+void EraseBelow(const std::string& key) {
+    const std::string prefix = key.back() == '/' ? key : key + '/';
+    listings.erase(key);
+    auto it = listings.lower_bound(prefix);
+    while (it != listings.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        it = listings.erase(it);
+    }
+}
+
+} // Anonymous namespace
+
+EntryType GetEntryType(const std::string& path) {
+    const std::string key = Normalize(path);
+    if (key.empty() || HasParentReference(key))
+        return ReadEntryType(path);
+
+    const auto [parent, name] = SplitParent(key);
+    std::lock_guard lock{mutex};
+    auto listing = listings.find(parent);
+    if (listing == listings.end()) {
+        listing = listings.emplace(parent, ReadListing(parent)).first;
+    }
+
+    const auto entry = listing->second.find(name);
+    if (entry != listing->second.end())
+        return entry->second ? EntryType::Directory : EntryType::File;
+
+    // The entry might have been created without going through the cache.
+    const EntryType type = ReadEntryType(key);
+    if (type != EntryType::None) {
+        listing->second.emplace(name, type == EntryType::Directory);
+    }
+    return type;
+}
+
+void AddEntry(const std::string& path, bool is_directory) {
+    const std::string key = Normalize(path);
+    if (key.empty() || HasParentReference(key)) {
+        Clear();
+        return;
+    }
+
+    const auto [parent, name] = SplitParent(key);
+    std::lock_guard lock{mutex};
+    const auto listing = listings.find(parent);
+    if (listing != listings.end()) {
+        listing->second[name] = is_directory;
+    }
+    EraseBelow(key);
+    if (is_directory) {
+        listings.emplace(key, Listing{});
+    }
+}
+
+void RemoveEntry(const std::string& path) {
+    const std::string key = Normalize(path);
+    if (key.empty() || HasParentReference(key)) {
+        Clear();
+        return;
+    }
+
+    const auto [parent, name] = SplitParent(key);
+    std::lock_guard lock{mutex};
+    const auto listing = listings.find(parent);
+    if (listing != listings.end()) {
+        listing->second.erase(name);
+    }
+    EraseBelow(key);
+}
+
+void Invalidate(const std::string& path) {
+    const std::string key = Normalize(path);
+    if (key.empty() || HasParentReference(key)) {
+        Clear();
+        return;
+    }
+
+    std::lock_guard lock{mutex};
+    listings.erase(SplitParent(key).first);
+    EraseBelow(key);
+}
+
+void UpdateListing(const std::string& directory, const std::vector<FileUtil::FSTEntry>& entries) {
+    const std::string key = Normalize(directory);
+    if (key.empty() || HasParentReference(key))
+        return;
+
+    std::lock_guard lock{mutex};
+    listings.insert_or_assign(key, MakeListing(entries));
+}
+
+void Clear() {
+    std::lock_guard lock{mutex};
+    listings.clear();
+}
+
+} // namespace FileSys::HostDirectoryCache
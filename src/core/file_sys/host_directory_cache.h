@@ -0,0 +1,64 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "common/file_util.h"
+
+/**
+ * In-memory copy of the host directory listings below the mount points of the SDMC and save data
+ * archives. A directory is listed from the host in one pass the first time a path in it is looked
+ * up, and the archives report their own changes, so that repeated lookups need no host calls.
+ *
+ * Paths that are missing from a cached listing are checked on the host before being reported as
+ * missing, so entries created behind the cache's back are still found. Code that deletes files
+ * under these directories without going through an archive has to call Invalidate.
+ */
+namespace FileSys::HostDirectoryCache {
+
+enum class EntryType {
+    None,
+    File,
+    Directory,
+};
+
+/**
+ * Gets the type of an entry in the host file system.
+ * @param path Full host path of the entry
+ */
+EntryType GetEntryType(const std::string& path);
+
+/**
+ * Records that a file or an empty directory was created.
+ * @param path Full host path of the new entry
+ * @param is_directory Whether the new entry is a directory
+ */
+void AddEntry(const std::string& path, bool is_directory);
+
+/**
+ * Records that a file or directory was deleted, along with everything below it.
+ * @param path Full host path of the deleted entry
+ */
+void RemoveEntry(const std::string& path);
+
+/**
+ * Forgets everything that is known about a path and the directory containing it, so that it is
+ * read from the host again on the next lookup.
+ * @param path Full host path that was changed behind the cache's back
+ */
+void Invalidate(const std::string& path);
+
+/**
+ * Replaces the cached listing of a directory with one that was just read from the host.
+ * @param directory Full host path of the directory
+ * @param entries The entries of the directory
+ */
+void UpdateListing(const std::string& directory, const std::vector<FileUtil::FSTEntry>& entries);
+
+/// Forgets all cached listings.
+void Clear();
+
+} // namespace FileSys::HostDirectoryCache
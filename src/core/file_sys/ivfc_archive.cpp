@@ -107,6 +107,16 @@ ResultVal<std::size_t> IVFCFile::Read(const u64 offset, const std::size_t length
     return MakeResult<std::size_t>(romfs_file->ReadFile(offset, length, buffer));
 }
 
+std::shared_ptr<const u8> IVFCFile::GetDirectView(const u64 offset,
+                                                  const std::size_t length) const {
+    const u8* data = romfs_file->GetDirectPointer(offset, length);
+    if (data == nullptr) {
+        return nullptr;
+    }
+    // Share ownership of the reader, which owns the memory.
+    return std::shared_ptr<const u8>(romfs_file, data);
+}
+
 ResultVal<std::size_t> IVFCFile::Write(const u64 offset, const std::size_t length, const bool flush,
                                        const u8* buffer) {
     LOG_ERROR(Service_FS, "Attempted to write to IVFC file");
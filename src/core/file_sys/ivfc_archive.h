@@ -125,6 +125,7 @@ public:
     IVFCFile(std::shared_ptr<RomFSReader> file, std::unique_ptr<DelayGenerator> delay_generator_);
 
     ResultVal<std::size_t> Read(u64 offset, std::size_t length, u8* buffer) const override;
+    std::shared_ptr<const u8> GetDirectView(u64 offset, std::size_t length) const override;
     ResultVal<std::size_t> Write(u64 offset, std::size_t length, bool flush,
                                  const u8* buffer) override;
     u64 GetSize() const override;
@@ -132,7 +133,9 @@ public:
     bool Close() const override {
         return false;
     }
-    void Flush() const override {}
+    ResultCode Flush() const override {
+        return RESULT_SUCCESS;
+    }
 
 private:
     std::shared_ptr<RomFSReader> romfs_file;
@@ -170,7 +173,9 @@ public:
     bool Close() const override {
         return false;
     }
-    void Flush() const override {}
+    ResultCode Flush() const override {
+        return RESULT_SUCCESS;
+    }
 
 private:
     std::vector<u8> romfs_file;
@@ -4,11 +4,18 @@
 
 #include <algorithm>
 #include <cstring>
+#include <optional>
+#include <sstream>
+#include <utility>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <fmt/format.h>
 #include "common/alignment.h"
 #include "common/archives.h"
 #include "common/assert.h"
 #include "common/common_paths.h"
 #include "common/file_util.h"
+#include "common/hash.h"
 #include "common/string_util.h"
 #include "common/swap.h"
 #include "core/file_sys/layered_fs.h"
@@ -22,7 +29,10 @@ struct FileRelocationInfo {
     int type;                      // 0 - none, 1 - replaced / created, 2 - patched, 3 - removed
     u64 original_offset;           // Type 0. Offset is absolute
     std::string replace_file_path; // Type 1
-    std::vector<u8> patched_file;  // Type 2
+    std::string patch_file_path;   // Type 2
+    u64 original_size;             // Type 2
+    bool patch_applied;            // Type 2
+    std::vector<u8> patched_file;  // Type 2, filled in when the file is first read
     u64 size;                      // Relocated file size
 };
 struct LayeredFS::File {
@@ -54,6 +64,49 @@ struct FileMetadata {
 };
 static_assert(sizeof(FileMetadata) == 0x20, "Size of FileMetadata is not correct");
 
+/// What LoadRelocations and LoadExtRelocations need to know about the mod directories.
+struct LayeredFS::ModIndex {
+    /// Bumped whenever the contents of the index change
+    static constexpr u32 current_version = 2;
+
+    u32 version = current_version;
+    std::string patch_path;
+    std::string patch_ext_path;
+    /// Every directory that was walked and its modification time in nanoseconds. Adding, removing
+    /// or renaming an entry updates the time of the directory holding it, which invalidates the
+    /// index. Files overwritten in place do not, so their sizes are not part of the index.
+    std::vector<std::pair<std::string, s64>> directories;
+    /// Files and directories in patch_path relative to it, directories with a trailing '/'.
+    /// Parents come before their children.
+    std::vector<std::string> replacements;
+    /// Files in patch_ext_path, relative to it
+    std::vector<std::string> extensions;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& version;
+        ar& patch_path;
+        ar& patch_ext_path;
+        ar& directories;
+        ar& replacements;
+        ar& extensions;
+    }
+};
+
+namespace {
+
+/// Enough of a BPS patch to hold its magic and the source and target sizes
+constexpr std::size_t bps_header_size = 32;
+
+std::string GetModIndexPath(const std::string& patch_path, const std::string& patch_ext_path) {
+    const std::string key = patch_path + '\0' + patch_ext_path;
+    return fmt::format("{}layeredfs{}{:016X}.bin",
+                       FileUtil::GetUserPath(FileUtil::UserPath::CacheDir), DIR_SEP,
+                       Common::ComputeHash64(key.data(), key.size()));
+}
+
+} // Anonymous namespace
+
 LayeredFS::LayeredFS() = default;
 
 LayeredFS::LayeredFS(std::shared_ptr<RomFSReader> romfs_, std::string patch_path_,
@@ -73,8 +126,9 @@ void LayeredFS::Load() {
     LoadDirectory(root, 0);
 
     if (load_relocations) {
-        LoadRelocations();
-        LoadExtRelocations();
+        const ModIndex index = LoadModIndex();
+        LoadRelocations(index);
+        LoadExtRelocations(index);
     }
 
     RebuildMetadata();
@@ -139,73 +193,143 @@ std::string LayeredFS::ReadName(u32 offset, u32 name_length) {
     return Common::UTF16ToUTF8(name);
 }
 
-void LayeredFS::LoadRelocations() {
-    if (!FileUtil::Exists(patch_path)) {
-        return;
+LayeredFS::ModIndex LayeredFS::LoadModIndex() {
+    if (!patch_ext_path.empty() &&
+        (patch_ext_path.back() == '/' || patch_ext_path.back() == '\\')) {
+        patch_ext_path.erase(patch_ext_path.size() - 1, 1);
+    }
+
+    const std::string index_path = GetModIndexPath(patch_path, patch_ext_path);
+    std::string serialized;
+    if (FileUtil::ReadFileToString(false, index_path, serialized) > 0) {
+        std::optional<ModIndex> index;
+        try {
+            std::istringstream stream(serialized);
+            iarchive ia{stream};
+            ia >> index.emplace();
+        } catch (const std::exception& e) {
+            LOG_WARNING(Service_FS, "LayeredFS index {} is invalid: {}", index_path, e.what());
+            index.reset();
+        }
+
+        const auto is_up_to_date = [this](const ModIndex& candidate) {
+            return candidate.version == ModIndex::current_version &&
+                   candidate.patch_path == patch_path &&
+                   candidate.patch_ext_path == patch_ext_path &&
+                   std::all_of(candidate.directories.begin(), candidate.directories.end(),
+                               [](const auto& directory) {
+                                   return FileUtil::GetModificationTime(directory.first) ==
+                                          directory.second;
+                               });
+        };
+        if (index && is_up_to_date(*index)) {
+            LOG_DEBUG(Service_FS, "Using LayeredFS index {}", index_path);
+            return std::move(*index);
+        }
+    }
+
+    ModIndex index;
+    index.patch_path = patch_path;
+    index.patch_ext_path = patch_ext_path;
+
+    // The times of directories that do not exist are recorded as 0, so creating them later also
+    // invalidates the index.
+    index.directories.emplace_back(patch_path, FileUtil::GetModificationTime(patch_path));
+    if (FileUtil::Exists(patch_path)) {
+        const FileUtil::DirectoryEntryCallable callback =
+            [this, &index, &callback](u64* /*num_entries_out*/, const std::string& directory,
+                                      const std::string& virtual_name) {
+                const auto physical_name = directory + virtual_name;
+                const auto path = physical_name.substr(patch_path.size() - 1);
+                if (FileUtil::IsDirectory(physical_name)) {
+                    index.directories.emplace_back(
+                        physical_name, FileUtil::GetModificationTime(physical_name));
+                    index.replacements.push_back(path + DIR_SEP);
+                    return FileUtil::ForeachDirectoryEntry(nullptr, physical_name + DIR_SEP,
+                                                           callback);
+                }
+                index.replacements.push_back(path);
+                return true;
+            };
+        FileUtil::ForeachDirectoryEntry(nullptr, patch_path, callback);
     }
 
-    const FileUtil::DirectoryEntryCallable callback = [this,
-                                                       &callback](u64* /*num_entries_out*/,
-                                                                  const std::string& directory,
-                                                                  const std::string& virtual_name) {
-        auto* parent = directory_path_map.at(directory.substr(patch_path.size() - 1));
+    index.directories.emplace_back(patch_ext_path,
+                                   FileUtil::GetModificationTime(patch_ext_path));
+    if (FileUtil::Exists(patch_ext_path)) {
+        FileUtil::ForeachDirectoryEntry(
+            nullptr, patch_ext_path + DIR_SEP,
+            [&index](u64* /*num_entries_out*/, const std::string& directory,
+                     const std::string& virtual_name) {
+                if (!FileUtil::IsDirectory(directory + virtual_name)) {
+                    index.extensions.push_back(DIR_SEP + virtual_name);
+                }
+                return true;
+            });
+    }
 
-        if (FileUtil::IsDirectory(directory + virtual_name + DIR_SEP)) {
-            const auto path = (directory + virtual_name + DIR_SEP).substr(patch_path.size() - 1);
+    std::ostringstream stream;
+    {
+        oarchive oa{stream};
+        oa << index;
+    }
+    std::string index_folder;
+    Common::SplitPath(index_path, &index_folder, nullptr, nullptr);
+    if (!FileUtil::CreateFullPath(index_folder) ||
+        FileUtil::WriteStringToFile(false, index_path, stream.str()) != stream.str().size()) {
+        LOG_WARNING(Service_FS, "Could not write LayeredFS index {}", index_path);
+    }
+    return index;
+}
+
+void LayeredFS::LoadRelocations(const ModIndex& index) {
+    std::size_t replaced = 0;
+    for (const auto& path : index.replacements) {
+        const bool is_directory = path.back() == '/';
+        const std::size_t name_end = is_directory ? path.size() - 1 : path.size();
+        const std::size_t name_begin = path.rfind('/', name_end - 1) + 1;
+        auto* parent = directory_path_map.at(path.substr(0, name_begin));
+        const auto name = path.substr(name_begin, name_end - name_begin);
+
+        if (is_directory) {
             if (!directory_path_map.count(path)) { // Add this directory
                 auto directory = std::make_unique<Directory>();
-                directory->name = virtual_name;
+                directory->name = name;
                 directory->path = path;
                 directory->parent = parent;
                 directory_path_map.emplace(path, directory.get());
                 parent->directories.emplace_back(std::move(directory));
-                LOG_INFO(Service_FS, "LayeredFS created directory {}", path);
+                LOG_DEBUG(Service_FS, "LayeredFS created directory {}", path);
             }
-            return FileUtil::ForeachDirectoryEntry(nullptr, directory + virtual_name + DIR_SEP,
-                                                   callback);
+            continue;
         }
 
-        const auto path = (directory + virtual_name).substr(patch_path.size() - 1);
         if (!file_path_map.count(path)) { // Newly created file
             auto file = std::make_unique<File>();
-            file->name = virtual_name;
+            file->name = name;
             file->path = path;
             file->parent = parent;
             file_path_map.emplace(path, file.get());
             parent->files.emplace_back(std::move(file));
-            LOG_INFO(Service_FS, "LayeredFS created file {}", path);
+            LOG_DEBUG(Service_FS, "LayeredFS created file {}", path);
         }
 
         auto* file = file_path_map.at(path);
         file->relocation.type = 1;
-        file->relocation.replace_file_path = directory + virtual_name;
-        file->relocation.size = FileUtil::GetSize(directory + virtual_name);
-        LOG_INFO(Service_FS, "LayeredFS replacement file in use for {}", path);
-        return true;
-    };
-
-    FileUtil::ForeachDirectoryEntry(nullptr, patch_path, callback);
-}
-
-void LayeredFS::LoadExtRelocations() {
-    if (!FileUtil::Exists(patch_ext_path)) {
-        return;
+        file->relocation.replace_file_path = patch_path.substr(0, patch_path.size() - 1) + path;
+        // Read on every boot, as overwriting a file does not invalidate the index
+        file->relocation.size = FileUtil::GetSize(file->relocation.replace_file_path);
+        LOG_DEBUG(Service_FS, "LayeredFS replacement file in use for {}", path);
+        replaced++;
     }
 
-    if (patch_ext_path.back() == '/' || patch_ext_path.back() == '\\') {
-        // ScanDirectoryTree expects a path without trailing '/'
-        patch_ext_path.erase(patch_ext_path.size() - 1, 1);
+    if (replaced != 0) {
+        LOG_INFO(Service_FS, "LayeredFS replacement files in use for {} files", replaced);
     }
+}
 
-    FileUtil::FSTEntry result;
-    FileUtil::ScanDirectoryTree(patch_ext_path, result, 256);
-
-    for (const auto& entry : result.children) {
-        if (FileUtil::IsDirectory(entry.physicalName)) {
-            continue;
-        }
-
-        const auto path = entry.physicalName.substr(patch_ext_path.size());
+void LayeredFS::LoadExtRelocations(const ModIndex& index) {
+    for (const auto& path : index.extensions) {
         if (path.size() >= 5 && path.substr(path.size() - 5) == ".stub") {
             // Remove the corresponding file if exists
             const auto file_path = path.substr(0, path.size() - 5);
@@ -222,6 +346,7 @@ void LayeredFS::LoadExtRelocations() {
             const auto extension = path.substr(path.size() - 4);
             if (extension != ".ips" && extension != ".bps") {
                 LOG_WARNING(Service_FS, "LayeredFS unknown ext file {}", path);
+                continue;
             }
 
             const auto file_path = path.substr(0, path.size() - 4);
@@ -230,43 +355,97 @@ void LayeredFS::LoadExtRelocations() {
                 continue;
             }
 
-            FileUtil::IOFile patch_file(entry.physicalName, "rb");
-            if (!patch_file) {
-                LOG_ERROR(Service_FS, "LayeredFS Could not open file {}", entry.physicalName);
-                continue;
+            auto& file = *file_path_map[file_path];
+            const auto patch_file_path = patch_ext_path + path;
+            u64 patched_size = file.relocation.size;
+            if (extension == ".bps") {
+                // The patch itself is only read once the file is, but its size has to be known
+                // to build the metadata.
+                FileUtil::IOFile patch_file(patch_file_path, "rb");
+                if (!patch_file) {
+                    LOG_ERROR(Service_FS, "LayeredFS Could not open file {}", patch_file_path);
+                    continue;
+                }
+                std::vector<u8> header(std::min<u64>(patch_file.GetSize(), bps_header_size));
+                if (patch_file.ReadBytes(header.data(), header.size()) != header.size()) {
+                    LOG_ERROR(Service_FS, "LayeredFS Could not read file {}", patch_file_path);
+                    continue;
+                }
+                const auto size = Patch::GetBpsPatchedSize(header, file.relocation.size);
+                if (!size) {
+                    LOG_ERROR(Service_FS, "LayeredFS failed to patch file {}", file_path);
+                    continue;
+                }
+                patched_size = *size;
             }
 
-            const auto size = patch_file.GetSize();
-            std::vector<u8> patch(size);
-            if (patch_file.ReadBytes(patch.data(), size) != size) {
-                LOG_ERROR(Service_FS, "LayeredFS Could not read file {}", entry.physicalName);
-                continue;
-            }
+            LOG_INFO(Service_FS, "LayeredFS patching file {}", file_path);
+            file.relocation.type = 2;
+            file.relocation.patch_file_path = patch_file_path;
+            file.relocation.original_size = file.relocation.size;
+            file.relocation.size = patched_size;
+        } else {
+            LOG_WARNING(Service_FS, "LayeredFS unknown ext file {}", path);
+        }
+    }
+}
 
-            auto& file = *file_path_map[file_path];
-            std::vector<u8> buffer(file.relocation.size); // Original size
-            romfs->ReadFile(file.relocation.original_offset, buffer.size(), buffer.data());
+FileUtil::IOFile* LayeredFS::OpenReplacementFile(const File& file) {
+    if (const auto it = open_file_map.find(&file); it != open_file_map.end()) {
+        open_files.splice(open_files.begin(), open_files, it->second);
+        return &open_files.front().second;
+    }
 
-            bool ret = false;
-            if (extension == ".ips") {
-                ret = Patch::ApplyIpsPatch(patch, buffer);
-            } else {
-                ret = Patch::ApplyBpsPatch(patch, buffer);
-            }
+    FileUtil::IOFile replace_file(file.relocation.replace_file_path, "rb");
+    if (!replace_file) {
+        return nullptr;
+    }
+    if (replace_file.GetSize() != file.relocation.size) {
+        // The layout of the RomFS cannot change while the game runs, so the file keeps the size
+        // it had when the game booted: it is cut off or padded with zeros.
+        LOG_WARNING(Service_FS,
+                    "LayeredFS replacement file {} changed size, it will be picked up on the next "
+                    "boot",
+                    file.relocation.replace_file_path);
+    }
 
-            if (ret) {
-                LOG_INFO(Service_FS, "LayeredFS patched file {}", file_path);
+    if (open_files.size() >= max_open_files) {
+        open_file_map.erase(open_files.back().first);
+        open_files.pop_back();
+    }
+    open_files.emplace_front(&file, std::move(replace_file));
+    open_file_map.emplace(&file, open_files.begin());
+    return &open_files.front().second;
+}
 
-                file.relocation.type = 2;
-                file.relocation.size = buffer.size();
-                file.relocation.patched_file = std::move(buffer);
-            } else {
-                LOG_ERROR(Service_FS, "LayeredFS failed to patch file {}", file_path);
-            }
+void LayeredFS::ApplyPatch(File& file) {
+    auto& relocation = file.relocation;
+    relocation.patch_applied = true;
+
+    FileUtil::IOFile patch_file(relocation.patch_file_path, "rb");
+    std::vector<u8> patch(patch_file ? patch_file.GetSize() : 0);
+    bool ret = patch_file && patch_file.ReadBytes(patch.data(), patch.size()) == patch.size();
+
+    std::vector<u8> buffer(relocation.original_size);
+    romfs->ReadFile(relocation.original_offset, buffer.size(), buffer.data());
+    if (ret) {
+        if (relocation.patch_file_path.substr(relocation.patch_file_path.size() - 4) == ".ips") {
+            ret = Patch::ApplyIpsPatch(patch, buffer);
         } else {
-            LOG_WARNING(Service_FS, "LayeredFS unknown ext file {}", path);
+            ret = Patch::ApplyBpsPatch(patch, buffer);
         }
     }
+
+    if (ret) {
+        LOG_INFO(Service_FS, "LayeredFS patched file {}", file.path);
+    } else {
+        // The metadata already promised the patched size, so the original data is padded to it.
+        LOG_ERROR(Service_FS, "LayeredFS failed to patch file {}", file.path);
+        buffer.assign(relocation.original_size, 0);
+        romfs->ReadFile(relocation.original_offset, buffer.size(), buffer.data());
+    }
+    buffer.resize(relocation.size);
+    relocation.patched_file = std::move(buffer);
 }
 
 static std::size_t GetNameSize(const std::string& name) {
@@ -487,9 +666,16 @@ std::size_t LayeredFS::GetSize() const {
     return metadata.size() + current_data_offset;
 }
 
+std::size_t LayeredFS::GetOpenFileCount() const {
+    std::lock_guard lock{mutex};
+    return open_files.size();
+}
+
 std::size_t LayeredFS::ReadFile(std::size_t offset, std::size_t length, u8* buffer) {
     ASSERT_MSG(offset + length <= GetSize(), "Out of bound");
 
+    std::lock_guard lock{mutex};
+
     std::size_t read_size = 0;
     if (offset < metadata.size()) {
         // First read the metadata
@@ -501,6 +687,11 @@ std::size_t LayeredFS::ReadFile(std::size_t offset, std::size_t length, u8* buff
         offset -= metadata.size();
     }
 
+    if (read_size == length) {
+        // There may be no file data to look up at all
+        return read_size;
+    }
+
     // Read files
     auto current = (--data_offset_map.upper_bound(offset));
     while (read_size < length) {
@@ -522,15 +713,20 @@ std::size_t LayeredFS::ReadFile(std::size_t offset, std::size_t length, u8* buff
             romfs->ReadFile(relocation.original_offset + relative_offset, to_read,
                             buffer + read_size);
         } else if (relocation.type == 1) { // replace
-            FileUtil::IOFile replace_file(relocation.replace_file_path, "rb");
-            if (replace_file) {
-                replace_file.Seek(relative_offset, SEEK_SET);
-                replace_file.ReadBytes(buffer + read_size, to_read);
+            std::size_t replaced = 0;
+            if (auto* replace_file = OpenReplacementFile(*current->second)) {
+                replace_file->Seek(relative_offset, SEEK_SET);
+                replaced = replace_file->ReadBytes(buffer + read_size, to_read);
             } else {
                 LOG_ERROR(Service_FS, "Could not open replacement file for {}",
                           current->second->path);
             }
+            // The file shrank since the game booted
+            std::memset(buffer + read_size + replaced, 0, to_read - replaced);
         } else if (relocation.type == 2) { // patch
+            if (!relocation.patch_applied) {
+                ApplyPatch(*current->second);
+            }
             std::memcpy(buffer + read_size, relocation.patched_file.data() + relative_offset,
                         to_read);
         } else {
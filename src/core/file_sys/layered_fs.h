@@ -4,8 +4,10 @@
 
 #pragma once
 
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -14,6 +16,7 @@
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/string.hpp>
 #include "common/common_types.h"
+#include "common/file_util.h"
 #include "common/swap.h"
 #include "core/file_sys/romfs_reader.h"
 
@@ -41,6 +44,12 @@ static_assert(sizeof(RomFSHeader) == 0x28, "Size of RomFSHeader is not correct")
  * patch_ext_path: Path for RomFS extensions. Files present in this path:
  *  - When with an extension of ".stub", remove the corresponding file in the RomFS.
  *  - When with an extension of ".ips" or ".bps", patch the file in the RomFS.
+ *
+ * Walking the mod directories is the slow part of loading large mods, so the result is kept in an
+ * index in the cache directory, which is reused for as long as no mod directory has been modified.
+ * The sizes of replacement files are still read on every boot, as overwriting a file does not
+ * modify its directory. Patches are applied when the file is first read, and replacement files
+ * are kept open in a small LRU pool.
  */
 class LayeredFS : public RomFSReader {
 public:
@@ -53,6 +62,12 @@ public:
 
     bool DumpRomFS(const std::string& target_path);
 
+    /// Maximum number of replacement files kept open at once
+    static constexpr std::size_t max_open_files = 32;
+
+    /// Returns the number of replacement files that are open right now
+    std::size_t GetOpenFileCount() const;
+
 private:
     struct File;
     struct Directory {
@@ -73,11 +88,22 @@ private:
     // Returns offset of the next sibling file to load (0xFFFFFFFF if the last file)
     u32 LoadFile(Directory& parent, u32 offset);
 
+    struct ModIndex;
+
+    // Loads the index of the mod directories, or builds it if it is missing or out of date
+    ModIndex LoadModIndex();
+
     // Load replace/create relocations
-    void LoadRelocations();
+    void LoadRelocations(const ModIndex& index);
 
     // Load patch/remove relocations
-    void LoadExtRelocations();
+    void LoadExtRelocations(const ModIndex& index);
+
+    // Returns an open handle to the replacement file of file, or nullptr if it can't be opened
+    FileUtil::IOFile* OpenReplacementFile(const File& file);
+
+    // Applies the patch of file if this is the first time it is read
+    void ApplyPatch(File& file);
 
     // Calculate the offset of a single directory add it to the map and list of directories
     void PrepareBuildDirectory(Directory& current);
@@ -128,6 +154,12 @@ private:
     std::vector<u8> file_metadata_table; // rebuilt file metadata table
     u64 current_data_offset{};           // current assigned data offset
 
+    // Open replacement files, most recently used first
+    std::list<std::pair<const File*, FileUtil::IOFile>> open_files;
+    std::unordered_map<const File*, decltype(open_files)::iterator> open_file_map;
+
+    mutable std::mutex mutex;
+
     LayeredFS();
 
     template <class Archive>
@@ -9,14 +9,18 @@
 #include <cryptopp/modes.h>
 #include <cryptopp/sha.h>
 #include "common/common_types.h"
+#include "common/hash.h"
 #include "common/logging/log.h"
 #include "core/core.h"
 #include "core/file_sys/layered_fs.h"
 #include "core/file_sys/ncch_container.h"
 #include "core/file_sys/patch.h"
 #include "core/file_sys/seed_db.h"
+#include "core/file_sys/title_cache.h"
+#include "core/hw/aes/bulk_decrypt.h"
 #include "core/hw/aes/key.h"
 #include "core/loader/loader.h"
+#include "core/settings.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FileSys namespace
@@ -116,7 +120,7 @@ static bool LZSS_Decompress(const u8* compressed, u32 compressed_size, u8* decom
 
 NCCHContainer::NCCHContainer(const std::string& filepath, u32 ncch_offset, u32 partition)
     : ncch_offset(ncch_offset), partition(partition), filepath(filepath) {
-    file = FileUtil::IOFile(filepath, "rb");
+    file = ImageFile(filepath);
 }
 
 Loader::ResultStatus NCCHContainer::OpenFile(const std::string& filepath, u32 ncch_offset,
@@ -124,7 +128,7 @@ Loader::ResultStatus NCCHContainer::OpenFile(const std::string& filepath, u32 nc
     this->filepath = filepath;
     this->ncch_offset = ncch_offset;
     this->partition = partition;
-    file = FileUtil::IOFile(filepath, "rb");
+    file = ImageFile(filepath);
 
     if (!file.IsOpen()) {
         LOG_WARNING(Service_FS, "Failed to open {}", filepath);
@@ -237,12 +241,18 @@ Loader::ResultStatus NCCHContainer::Load() {
                     }
                 }
 
-                SetKeyY(KeySlotID::NCCHSecure1, key_y_primary);
-                if (!IsNormalKeyAvailable(KeySlotID::NCCHSecure1)) {
-                    LOG_ERROR(Service_FS, "Secure1 KeyX missing");
-                    failed_to_decrypt = true;
-                }
-                primary_key = GetNormalKey(KeySlotID::NCCHSecure1);
+                // The keys are derived from copies of the key slots, as titles may be loaded
+                // on several threads at once (e.g. by the game list).
+                const auto derive_key = [&](KeySlotID slot_id, const AESKey& key_y,
+                                            const char* name) {
+                    const auto key = DeriveNormalKey(slot_id, key_y);
+                    if (!key) {
+                        LOG_ERROR(Service_FS, "{} KeyX missing", name);
+                        failed_to_decrypt = true;
+                    }
+                    return key.value_or(AESKey{});
+                };
+                primary_key = derive_key(KeySlotID::NCCHSecure1, key_y_primary, "Secure1");
 
                 switch (ncch_header.secondary_key_slot) {
                 case 0:
@@ -251,30 +261,18 @@ Loader::ResultStatus NCCHContainer::Load() {
                     break;
                 case 1:
                     LOG_DEBUG(Service_FS, "Secure2 crypto");
-                    SetKeyY(KeySlotID::NCCHSecure2, key_y_secondary);
-                    if (!IsNormalKeyAvailable(KeySlotID::NCCHSecure2)) {
-                        LOG_ERROR(Service_FS, "Secure2 KeyX missing");
-                        failed_to_decrypt = true;
-                    }
-                    secondary_key = GetNormalKey(KeySlotID::NCCHSecure2);
+                    secondary_key =
+                        derive_key(KeySlotID::NCCHSecure2, key_y_secondary, "Secure2");
                     break;
                 case 10:
                     LOG_DEBUG(Service_FS, "Secure3 crypto");
-                    SetKeyY(KeySlotID::NCCHSecure3, key_y_secondary);
-                    if (!IsNormalKeyAvailable(KeySlotID::NCCHSecure3)) {
-                        LOG_ERROR(Service_FS, "Secure3 KeyX missing");
-                        failed_to_decrypt = true;
-                    }
-                    secondary_key = GetNormalKey(KeySlotID::NCCHSecure3);
+                    secondary_key =
+                        derive_key(KeySlotID::NCCHSecure3, key_y_secondary, "Secure3");
                     break;
                 case 11:
                     LOG_DEBUG(Service_FS, "Secure4 crypto");
-                    SetKeyY(KeySlotID::NCCHSecure4, key_y_secondary);
-                    if (!IsNormalKeyAvailable(KeySlotID::NCCHSecure4)) {
-                        LOG_ERROR(Service_FS, "Secure4 KeyX missing");
-                        failed_to_decrypt = true;
-                    }
-                    secondary_key = GetNormalKey(KeySlotID::NCCHSecure4);
+                    secondary_key =
+                        derive_key(KeySlotID::NCCHSecure4, key_y_secondary, "Secure4");
                     break;
                 }
             }
@@ -325,7 +323,7 @@ Loader::ResultStatus NCCHContainer::Load() {
 
         // System archives and DLC don't have an extended header but have RomFS
         if (ncch_header.extended_header_size) {
-            auto read_exheader = [this](FileUtil::IOFile& file) {
+            auto read_exheader = [this](auto& file) {
                 const std::size_t size = sizeof(exheader_header);
                 return file && file.ReadBytes(&exheader_header, size) == size;
             };
@@ -425,7 +423,7 @@ Loader::ResultStatus NCCHContainer::Load() {
                     .ProcessData(data, data, sizeof(exefs_header));
             }
 
-            exefs_file = FileUtil::IOFile(filepath, "rb");
+            exefs_file = ImageFile(filepath);
             has_exefs = true;
         }
 
@@ -454,7 +452,7 @@ Loader::ResultStatus NCCHContainer::LoadOverrides() {
     std::string exefs_override = filepath + ".exefs";
     std::string exefsdir_override = filepath + ".exefsdir/";
     if (FileUtil::Exists(exefs_override)) {
-        exefs_file = FileUtil::IOFile(exefs_override, "rb");
+        exefs_file = ImageFile(exefs_override);
 
         if (exefs_file.ReadBytes(&exefs_header, sizeof(ExeFs_Header)) == sizeof(ExeFs_Header)) {
             LOG_DEBUG(Service_FS, "Loading ExeFS section from {}", exefs_override);
@@ -462,7 +460,7 @@ Loader::ResultStatus NCCHContainer::LoadOverrides() {
             is_tainted = true;
             has_exefs = true;
         } else {
-            exefs_file = FileUtil::IOFile(filepath, "rb");
+            exefs_file = ImageFile(filepath);
         }
     } else if (FileUtil::Exists(exefsdir_override) && FileUtil::IsDirectory(exefsdir_override)) {
         is_tainted = true;
@@ -531,9 +529,7 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
                 key = secondary_key;
             }
 
-            CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec(key.data(), key.size(),
-                                                              exefs_ctr.data());
-            dec.Seek(section.offset + sizeof(ExeFs_Header));
+            const u64 crypto_offset = section.offset + sizeof(ExeFs_Header);
 
             if (strcmp(section.name, ".code") == 0 && is_compressed) {
                 // Section is compressed, read compressed .code section...
@@ -548,7 +544,8 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
                     return Loader::ResultStatus::Error;
 
                 if (is_encrypted) {
-                    dec.ProcessData(&temp_buffer[0], &temp_buffer[0], section.size);
+                    HW::AES::DecryptCTR(key, exefs_ctr, crypto_offset, &temp_buffer[0],
+                                        section.size);
                 }
 
                 // Decompress .code section...
@@ -563,7 +560,8 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
                 if (exefs_file.ReadBytes(buffer.data(), section.size) != section.size)
                     return Loader::ResultStatus::Error;
                 if (is_encrypted) {
-                    dec.ProcessData(buffer.data(), buffer.data(), section.size);
+                    HW::AES::DecryptCTR(key, exefs_ctr, crypto_offset, buffer.data(),
+                                        section.size);
                 }
             }
 
@@ -573,35 +571,87 @@ Loader::ResultStatus NCCHContainer::LoadSectionExeFS(const char* name, std::vect
     return Loader::ResultStatus::ErrorNotUsed;
 }
 
-Loader::ResultStatus NCCHContainer::ApplyCodePatch(std::vector<u8>& code) const {
-    struct PatchLocation {
-        std::string path;
-        bool (*patch_fn)(const std::vector<u8>& patch, std::vector<u8>& code);
+Loader::ResultStatus NCCHContainer::LoadCode(std::vector<u8>& code, std::size_t bss_size) {
+    Loader::ResultStatus result = Load();
+    if (result != Loader::ResultStatus::Success)
+        return result;
+
+    CodePatch patch;
+    const Loader::ResultStatus patch_result = ReadCodePatch(patch);
+    if (patch_result != Loader::ResultStatus::Success &&
+        patch_result != Loader::ResultStatus::ErrorNotUsed)
+        return patch_result;
+    const bool has_patch = patch_result == Loader::ResultStatus::Success;
+
+    const auto apply_patch = [&] {
+        LOG_INFO(Service_FS, "File {} patching code.bin", patch.path);
+        return patch.patch_fn(patch.data, code);
     };
 
+    // Drop-in replacements are not covered by the ExeFS header, so they are never cached.
+    if (LoadOverrideExeFSSection(".code", code) == Loader::ResultStatus::Success) {
+        code.resize(code.size() + bss_size, 0);
+        if (has_patch && !apply_patch())
+            return Loader::ResultStatus::Error;
+        return Loader::ResultStatus::Success;
+    }
+
+    // The ExeFS header holds the SHA-256 of every section, so together with the patch it
+    // identifies the resulting code.
+    const bool use_cache = Settings::values.use_title_cache && has_exefs;
+    u64 cache_key = 0;
+    if (use_cache) {
+        std::vector<u8> key_data(sizeof(ExeFs_Header) + sizeof(u64) + 1);
+        std::memcpy(key_data.data(), &exefs_header, sizeof(ExeFs_Header));
+        const u64 bss_size_64 = bss_size;
+        std::memcpy(key_data.data() + sizeof(ExeFs_Header), &bss_size_64, sizeof(u64));
+        key_data.back() = is_compressed;
+        key_data.insert(key_data.end(), patch.path.begin(), patch.path.end());
+        key_data.insert(key_data.end(), patch.data.begin(), patch.data.end());
+        cache_key = Common::ComputeHash64(key_data.data(), key_data.size());
+
+        if (auto cached = TitleCache::LoadCode(ncch_header.program_id, cache_key)) {
+            LOG_DEBUG(Service_FS, "Loaded .code of {:016X} from the title cache",
+                      ncch_header.program_id);
+            code = std::move(*cached);
+            return Loader::ResultStatus::Success;
+        }
+    }
+
+    result = LoadSectionExeFS(".code", code);
+    if (result != Loader::ResultStatus::Success)
+        return result;
+    code.resize(code.size() + bss_size, 0);
+    if (has_patch && !apply_patch())
+        return Loader::ResultStatus::Error;
+
+    if (use_cache) {
+        TitleCache::StoreCode(ncch_header.program_id, cache_key, code);
+    }
+    return Loader::ResultStatus::Success;
+}
+
+Loader::ResultStatus NCCHContainer::ReadCodePatch(CodePatch& patch) const {
     const auto mods_path =
         fmt::format("{}mods/{:016X}/", FileUtil::GetUserPath(FileUtil::UserPath::LoadDir),
                     GetModId(ncch_header.program_id));
-    const std::array<PatchLocation, 6> patch_paths{{
-        {mods_path + "exefs/code.ips", Patch::ApplyIpsPatch},
-        {mods_path + "exefs/code.bps", Patch::ApplyBpsPatch},
-        {mods_path + "code.ips", Patch::ApplyIpsPatch},
-        {mods_path + "code.bps", Patch::ApplyBpsPatch},
-        {filepath + ".exefsdir/code.ips", Patch::ApplyIpsPatch},
-        {filepath + ".exefsdir/code.bps", Patch::ApplyBpsPatch},
+    const std::array<CodePatch, 6> patch_paths{{
+        {mods_path + "exefs/code.ips", {}, Patch::ApplyIpsPatch},
+        {mods_path + "exefs/code.bps", {}, Patch::ApplyBpsPatch},
+        {mods_path + "code.ips", {}, Patch::ApplyIpsPatch},
+        {mods_path + "code.bps", {}, Patch::ApplyBpsPatch},
+        {filepath + ".exefsdir/code.ips", {}, Patch::ApplyIpsPatch},
+        {filepath + ".exefsdir/code.bps", {}, Patch::ApplyBpsPatch},
     }};
 
-    for (const PatchLocation& info : patch_paths) {
+    for (const CodePatch& info : patch_paths) {
         FileUtil::IOFile file{info.path, "rb"};
         if (!file)
             continue;
 
-        std::vector<u8> patch(file.GetSize());
-        if (file.ReadBytes(patch.data(), patch.size()) != patch.size())
-            return Loader::ResultStatus::Error;
-
-        LOG_INFO(Service_FS, "File {} patching code.bin", info.path);
-        if (!info.patch_fn(patch, code))
+        patch = info;
+        patch.data.resize(file.GetSize());
+        if (file.ReadBytes(patch.data.data(), patch.data.size()) != patch.data.size())
             return Loader::ResultStatus::Error;
 
         return Loader::ResultStatus::Success;
@@ -678,7 +728,7 @@ Loader::ResultStatus NCCHContainer::ReadRomFS(std::shared_ptr<RomFSReader>& romf
         return Loader::ResultStatus::Error;
 
     // We reopen the file, to allow its position to be independent from file's
-    FileUtil::IOFile romfs_file_inner(filepath, "rb");
+    ImageFile romfs_file_inner(filepath);
     if (!romfs_file_inner.IsOpen())
         return Loader::ResultStatus::Error;
 
@@ -687,9 +737,18 @@ Loader::ResultStatus NCCHContainer::ReadRomFS(std::shared_ptr<RomFSReader>& romf
         direct_romfs =
             std::make_shared<DirectRomFSReader>(std::move(romfs_file_inner), romfs_offset,
                                                 romfs_size, secondary_key, romfs_ctr, 0x1000);
-    } else {
+    } else if (romfs_file_inner.IsCompressed()) {
         direct_romfs = std::make_shared<DirectRomFSReader>(std::move(romfs_file_inner),
                                                            romfs_offset, romfs_size);
+    } else {
+        // Decrypted images can be read straight out of the page cache.
+        auto mapped_romfs = std::make_shared<MappedRomFSReader>(filepath, romfs_offset, romfs_size);
+        if (mapped_romfs->IsOpen()) {
+            direct_romfs = std::move(mapped_romfs);
+        } else {
+            direct_romfs = std::make_shared<DirectRomFSReader>(std::move(romfs_file_inner),
+                                                               romfs_offset, romfs_size);
+        }
     }
 
     const auto path =
@@ -730,8 +789,14 @@ Loader::ResultStatus NCCHContainer::ReadOverrideRomFS(std::shared_ptr<RomFSReade
         if (romfs_file_inner.IsOpen()) {
             LOG_WARNING(Service_FS, "File {} overriding built-in RomFS; LayeredFS not enabled",
                         split_filepath);
-            romfs_file = std::make_shared<DirectRomFSReader>(std::move(romfs_file_inner), 0,
-                                                             romfs_file_inner.GetSize());
+            const std::size_t romfs_size = romfs_file_inner.GetSize();
+            auto mapped_romfs = std::make_shared<MappedRomFSReader>(split_filepath, 0, romfs_size);
+            if (mapped_romfs->IsOpen()) {
+                romfs_file = std::move(mapped_romfs);
+            } else {
+                romfs_file = std::make_shared<DirectRomFSReader>(std::move(romfs_file_inner), 0,
+                                                                 romfs_size);
+            }
             return Loader::ResultStatus::Success;
         }
     }
@@ -13,6 +13,7 @@
 #include "common/file_util.h"
 #include "common/swap.h"
 #include "core/core.h"
+#include "core/file_sys/compressed_image.h"
 #include "core/file_sys/romfs_reader.h"
 
 enum NCSDContentIndex { Main = 0, Manual = 1, DLP = 2, New3DSUpdate = 6, Update = 7 };
@@ -317,11 +318,14 @@ public:
     Loader::ResultStatus ReadExtdataId(u64& extdata_id);
 
     /**
-     * Apply a patch for .code (if it exists).
-     * This should only be called after allocating .bss.
-     * @return ResultStatus success if a patch was applied, ErrorNotUsed if no patch was found
+     * Loads the .code section, allocates .bss after it and applies a patch for .code (if it
+     * exists). With the title cache enabled, the result is kept on disk so that later boots can
+     * skip decrypting, decompressing and patching it.
+     * @param code Vector to load the code into
+     * @param bss_size Size of .bss in bytes
+     * @return ResultStatus result of function
      */
-    Loader::ResultStatus ApplyCodePatch(std::vector<u8>& code) const;
+    Loader::ResultStatus LoadCode(std::vector<u8>& code, std::size_t bss_size);
 
     /**
      * Checks whether the NCCH container contains an ExeFS
@@ -346,6 +350,18 @@ public:
     ExHeader_Header exheader_header;
 
 private:
+    struct CodePatch {
+        std::string path;
+        std::vector<u8> data;
+        bool (*patch_fn)(const std::vector<u8>& patch, std::vector<u8>& code);
+    };
+
+    /**
+     * Reads the patch for .code (if it exists).
+     * @return ResultStatus success if a patch was read, ErrorNotUsed if no patch was found
+     */
+    Loader::ResultStatus ReadCodePatch(CodePatch& patch) const;
+
     bool has_header = false;
     bool has_exheader = false;
     bool has_exefs = false;
@@ -368,8 +384,8 @@ private:
     u32 partition = 0;
 
     std::string filepath;
-    FileUtil::IOFile file;
-    FileUtil::IOFile exefs_file;
+    ImageFile file;
+    ImageFile exefs_file;
 };
 
 } // namespace FileSys
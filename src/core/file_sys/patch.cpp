@@ -280,4 +280,18 @@ bool ApplyBpsPatch(const std::vector<u8>& patch, std::vector<u8>& buffer) {
     return applier.Apply();
 }
 
+std::optional<std::size_t> GetBpsPatchedSize(const std::vector<u8>& patch_header,
+                                             std::size_t original_size) {
+    Bps::Stream patch_stream{patch_header.data(), patch_header.size()};
+
+    const auto magic = patch_stream.Read<std::array<char, Bps::MagicSize>>();
+    if (!magic || std::string_view(magic->data(), magic->size()) != "BPS1") {
+        return std::nullopt;
+    }
+
+    const Bps::Number source_size = patch_stream.ReadNumber();
+    const Bps::Number target_size = patch_stream.ReadNumber();
+    return target_size > source_size ? target_size : original_size;
+}
+
 } // namespace FileSys::Patch
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <optional>
 #include <vector>
 
 #include "common/common_types.h"
@@ -14,4 +15,12 @@ bool ApplyIpsPatch(const std::vector<u8>& patch, std::vector<u8>& buffer);
 
 bool ApplyBpsPatch(const std::vector<u8>& patch, std::vector<u8>& buffer);
 
+/**
+ * Gets the size ApplyBpsPatch resizes a file of original_size bytes to. The sizes are stored at the
+ * start of the patch, so only the first few bytes of it are needed.
+ * @return The patched size, or std::nullopt if this is not a BPS patch
+ */
+std::optional<std::size_t> GetBpsPatchedSize(const std::vector<u8>& patch_header,
+                                             std::size_t original_size);
+
 } // namespace FileSys::Patch
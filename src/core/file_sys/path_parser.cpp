@@ -4,8 +4,8 @@
 
 #include <algorithm>
 #include <set>
-#include "common/file_util.h"
 #include "common/string_util.h"
+#include "core/file_sys/host_directory_cache.h"
 #include "core/file_sys/path_parser.h"
 
 namespace FileSys {
@@ -58,8 +58,10 @@ PathParser::PathParser(const Path& path) {
 }
 
 PathParser::HostStatus PathParser::GetHostStatus(std::string_view mount_point) const {
+    using HostDirectoryCache::EntryType;
+
     std::string path{mount_point};
-    if (!FileUtil::IsDirectory(path))
+    if (HostDirectoryCache::GetEntryType(path) != EntryType::Directory)
         return InvalidMountPoint;
     if (path_sequence.empty()) {
         return DirectoryFound;
@@ -70,18 +72,25 @@ PathParser::HostStatus PathParser::GetHostStatus(std::string_view mount_point) c
             path += '/';
         path += *iter;
 
-        if (!FileUtil::Exists(path))
+        switch (HostDirectoryCache::GetEntryType(path)) {
+        case EntryType::None:
             return PathNotFound;
-        if (FileUtil::IsDirectory(path))
-            continue;
-        return FileInPath;
+        case EntryType::File:
+            return FileInPath;
+        case EntryType::Directory:
+            break;
+        }
     }
 
     path += "/" + path_sequence.back();
-    if (!FileUtil::Exists(path))
+    switch (HostDirectoryCache::GetEntryType(path)) {
+    case EntryType::None:
         return NotFound;
-    if (FileUtil::IsDirectory(path))
+    case EntryType::Directory:
         return DirectoryFound;
+    case EntryType::File:
+        break;
+    }
     return FileFound;
 }
 
@@ -46,7 +46,10 @@ public:
         NotFound        // "/a/b/c" when "a/b/" exists but "c" doesn't exist
     };
 
-    /// Checks the status of the specified file / directory by the Path on the host file system.
+    /**
+     * Checks the status of the specified file / directory by the Path on the host file system.
+     * The lookups go through HostDirectoryCache, so archives have to report their changes to it.
+     */
     HostStatus GetHostStatus(std::string_view mount_point) const;
 
     /// Builds a full path on the host file system.
@@ -1,25 +1,288 @@
 #include <algorithm>
+#include <cstring>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
 #include "common/archives.h"
+#include "common/logging/log.h"
+#include "common/thread_pool.h"
 #include "core/file_sys/romfs_reader.h"
+#include "core/hw/aes/bulk_decrypt.h"
 
 SERIALIZE_EXPORT_IMPL(FileSys::DirectRomFSReader)
+SERIALIZE_EXPORT_IMPL(FileSys::MappedRomFSReader)
 
 namespace FileSys {
 
+namespace {
+
+/// Reads spanning more blocks than this are served straight from the file, as caching them would
+/// only flush out everything else.
+constexpr std::size_t max_cached_read_blocks =
+    RomFSBlockCache::default_capacity / DirectRomFSReader::block_size / 8;
+/// Number of reads in a row that have to continue where the previous one ended before readahead
+/// kicks in.
+constexpr u32 readahead_threshold = 2;
+/// Number of blocks read ahead of a sequential stream.
+constexpr std::size_t readahead_blocks = 4;
+/// Amount of data ahead of a sequential stream that the OS is asked to page in.
+constexpr std::size_t mapped_readahead_size = readahead_blocks * DirectRomFSReader::block_size;
+
+Common::ThreadPool& ReadaheadThread() {
+    static Common::ThreadPool thread(1, "RomFS Readahead");
+    return thread;
+}
+
+/// Gives each reader its own range of keys in the RomFSBlockCache.
+u64 NextCacheId() {
+    static std::atomic<u64> next_id{0};
+    return next_id++;
+}
+
+} // Anonymous namespace
+
+RomFSBlockCache::RomFSBlockCache(std::size_t capacity) : capacity(capacity) {}
+
+RomFSBlockCache& RomFSBlockCache::Instance() {
+    static RomFSBlockCache cache(default_capacity);
+    return cache;
+}
+
+RomFSBlockCache::Block RomFSBlockCache::Find(u64 reader_id, u64 index) {
+    std::lock_guard lock{mutex};
+    const auto it = entry_map.find({reader_id, index});
+    if (it == entry_map.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return entries.front().block;
+}
+
+bool RomFSBlockCache::Contains(u64 reader_id, u64 index) const {
+    std::lock_guard lock{mutex};
+    return entry_map.count({reader_id, index}) != 0;
+}
+
+void RomFSBlockCache::Insert(u64 reader_id, u64 index, Block block) {
+    std::lock_guard lock{mutex};
+    const Key key{reader_id, index};
+    if (const auto it = entry_map.find(key); it != entry_map.end()) {
+        size -= it->second->block->size();
+        entries.erase(it->second);
+        entry_map.erase(it);
+    }
+    size += block->size();
+    entries.push_front({key, std::move(block)});
+    entry_map[key] = entries.begin();
+
+    // Blocks that are still being copied from stay alive through their shared pointers.
+    while (size > capacity && entries.size() > 1) {
+        size -= entries.back().block->size();
+        entry_map.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+void RomFSBlockCache::Erase(u64 reader_id) {
+    std::lock_guard lock{mutex};
+    auto it = entry_map.lower_bound({reader_id, 0});
+    while (it != entry_map.end() && it->first.first == reader_id) {
+        size -= it->second->block->size();
+        entries.erase(it->second);
+        it = entry_map.erase(it);
+    }
+}
+
+std::size_t RomFSBlockCache::GetSize() const {
+    std::lock_guard lock{mutex};
+    return size;
+}
+
+DirectRomFSReader::DirectRomFSReader()
+    : is_encrypted(false), file_offset(0), crypto_offset(0), data_size(0),
+      cache_id(NextCacheId()) {}
+
+DirectRomFSReader::DirectRomFSReader(ImageFile&& file, std::size_t file_offset,
+                                     std::size_t data_size)
+    : is_encrypted(false), file(std::move(file)), file_offset(file_offset), crypto_offset(0),
+      data_size(data_size), cache_id(NextCacheId()) {}
+
+DirectRomFSReader::DirectRomFSReader(ImageFile&& file, std::size_t file_offset,
+                                     std::size_t data_size, const std::array<u8, 16>& key,
+                                     const std::array<u8, 16>& ctr, std::size_t crypto_offset)
+    : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
+      crypto_offset(crypto_offset), data_size(data_size), cache_id(NextCacheId()) {}
+
+DirectRomFSReader::~DirectRomFSReader() {
+    if (readahead.valid()) {
+        readahead.wait();
+    }
+    RomFSBlockCache::Instance().Erase(cache_id);
+    if (stats.hits + stats.misses > 0) {
+        LOG_DEBUG(Service_FS, "RomFS cache: {:.1f}% hit rate, {} bytes read from the host",
+                  stats.HitRate() * 100.0, stats.host_bytes_read);
+    }
+}
+
 std::size_t DirectRomFSReader::ReadFile(std::size_t offset, std::size_t length, u8* buffer) {
-    if (length == 0)
+    LOG_TRACE(Service_FS, "RomFS read offset=0x{:x} length=0x{:x}", offset, length);
+    if (length == 0 || offset >= data_size)
         return 0; // Crypto++ does not like zero size buffer
+    length = std::min(length, static_cast<std::size_t>(data_size) - offset);
+
+    std::lock_guard lock{mutex};
+
+    const u64 first_block = offset / block_size;
+    const u64 last_block = (offset + length - 1) / block_size;
+    if (last_block - first_block >= max_cached_read_blocks) {
+        return ReadUncached(offset, length, buffer);
+    }
+
+    std::size_t read_length = 0;
+    for (u64 index = first_block; index <= last_block; index++) {
+        const RomFSBlockCache::Block block = GetBlock(index);
+        const std::size_t block_offset = index == first_block ? offset % block_size : 0;
+        if (block_offset >= block->size()) {
+            break; // The host file is shorter than the RomFS claims to be
+        }
+        const std::size_t count = std::min(block->size() - block_offset, length - read_length);
+        std::memcpy(buffer + read_length, block->data() + block_offset, count);
+        read_length += count;
+        if (block->size() < block_size) {
+            break;
+        }
+    }
+
+    UpdateReadahead(offset, length);
+    return read_length;
+}
+
+DirectRomFSReader::CacheStats DirectRomFSReader::GetCacheStats() const {
+    std::lock_guard lock{mutex};
+    return stats;
+}
+
+RomFSBlockCache::Block DirectRomFSReader::GetBlock(u64 index) {
+    if (RomFSBlockCache::Block block = RomFSBlockCache::Instance().Find(cache_id, index)) {
+        stats.hits++;
+        return block;
+    }
+    stats.misses++;
+    return LoadBlock(index);
+}
+
+RomFSBlockCache::Block DirectRomFSReader::LoadBlock(u64 index) {
+    const u64 offset = index * block_size;
+    auto data = std::make_shared<std::vector<u8>>(std::min<u64>(block_size, data_size - offset));
+    data->resize(ReadUncached(offset, data->size(), data->data()));
+    RomFSBlockCache::Instance().Insert(cache_id, index, data);
+    return data;
+}
+
+std::size_t DirectRomFSReader::ReadUncached(u64 offset, std::size_t length, u8* buffer) {
     file.Seek(file_offset + offset, SEEK_SET);
-    std::size_t read_length = std::min(length, static_cast<std::size_t>(data_size) - offset);
-    read_length = file.ReadBytes(buffer, read_length);
-    if (is_encrypted) {
-        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), ctr.data());
-        d.Seek(crypto_offset + offset);
-        d.ProcessData(buffer, buffer, read_length);
+    const std::size_t read_length = file.ReadBytes(buffer, length);
+    stats.host_bytes_read += read_length;
+    if (is_encrypted && read_length > block_size) {
+        // Reads that bypass the cache are large enough to be worth decrypting in parallel.
+        HW::AES::DecryptCTR(key, ctr, crypto_offset + offset, buffer, read_length);
+    } else if (is_encrypted && read_length > 0) {
+        if (!decryption) {
+            decryption = std::make_unique<CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption>(
+                key.data(), key.size(), ctr.data());
+        }
+        decryption->Seek(crypto_offset + offset);
+        decryption->ProcessData(buffer, buffer, read_length);
     }
     return read_length;
 }
 
+void DirectRomFSReader::UpdateReadahead(u64 offset, std::size_t length) {
+    sequential_reads = offset == sequential_end ? sequential_reads + 1 : 0;
+    sequential_end = offset + length;
+    if (sequential_reads < readahead_threshold || sequential_end >= data_size) {
+        return;
+    }
+
+    // Only one readahead is in flight at a time; a stream that outruns it just reads on demand.
+    if (readahead.valid() &&
+        readahead.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    const u64 next_block = (sequential_end + block_size - 1) / block_size;
+    readahead =
+        ReadaheadThread().Push([this, next_block] { Prefetch(next_block, readahead_blocks); });
+}
+
+void DirectRomFSReader::Prefetch(u64 first, std::size_t count) {
+    for (u64 index = first; index < first + count; index++) {
+        // The lock is taken per block so that reads from the emulated program are not held up
+        // behind the whole readahead.
+        std::lock_guard lock{mutex};
+        if (index * block_size >= data_size) {
+            return;
+        }
+        if (RomFSBlockCache::Instance().Contains(cache_id, index)) {
+            continue;
+        }
+        LoadBlock(index);
+        stats.readahead_blocks++;
+    }
+}
+
+MappedRomFSReader::MappedRomFSReader() = default;
+
+MappedRomFSReader::MappedRomFSReader(const std::string& path, std::size_t file_offset,
+                                     std::size_t data_size)
+    : mapping(path, file_offset, data_size) {}
+
+MappedRomFSReader::~MappedRomFSReader() = default;
+
+std::size_t MappedRomFSReader::ReadFile(std::size_t offset, std::size_t length, u8* buffer) {
+    if (offset >= mapping.Size()) {
+        return 0;
+    }
+    const std::size_t read_length = std::min(length, mapping.Size() - offset);
+    if (!mapping.IsOpen()) {
+        return ReadUnmapped(offset, read_length, buffer);
+    }
+    AdviseRead(offset, read_length);
+    std::memcpy(buffer, mapping.Data() + offset, read_length);
+    return read_length;
+}
+
+const u8* MappedRomFSReader::GetDirectPointer(std::size_t offset, std::size_t length) {
+    if (!mapping.IsOpen() || offset > mapping.Size() || length > mapping.Size() - offset) {
+        return nullptr;
+    }
+    AdviseRead(offset, length);
+    return mapping.Data() + offset;
+}
+
+void MappedRomFSReader::AdviseRead(std::size_t offset, std::size_t length) {
+    LOG_TRACE(Service_FS, "RomFS read offset=0x{:x} length=0x{:x}", offset, length);
+
+    // Start paging the data in, along with what follows if this continues a sequential stream.
+    // The kernel reads ahead of page faults by itself, but far less than a streaming read wants.
+    std::size_t advise_length = length;
+    if (offset == sequential_end.exchange(offset + length)) {
+        advise_length += mapped_readahead_size;
+    }
+    mapping.Advise(offset, advise_length, FileUtil::MappedFile::Advice::WillNeed);
+}
+
+std::size_t MappedRomFSReader::ReadUnmapped(std::size_t offset, std::size_t length, u8* buffer) {
+    std::lock_guard lock{unmapped_mutex};
+    if (!unmapped_file.IsOpen()) {
+        unmapped_file = FileUtil::IOFile(mapping.GetFilename(), "rb");
+        if (!unmapped_file.IsOpen()) {
+            LOG_ERROR(Service_FS, "Could not open {} to read the RomFS", mapping.GetFilename());
+            return 0;
+        }
+    }
+    if (!unmapped_file.Seek(mapping.GetOffset() + offset, SEEK_SET)) {
+        return 0;
+    }
+    return unmapped_file.ReadBytes(buffer, length);
+}
+
 } // namespace FileSys
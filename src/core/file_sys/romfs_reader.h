@@ -1,11 +1,25 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <boost/serialization/array.hpp>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/export.hpp>
 #include "common/common_types.h"
 #include "common/file_util.h"
+#include "common/mapped_file.h"
+#include "core/file_sys/compressed_image.h"
+
+namespace CryptoPP {
+class SymmetricCipher;
+}
 
 namespace FileSys {
 
@@ -17,30 +31,111 @@ public:
     virtual ~RomFSReader() = default;
 
     virtual std::size_t GetSize() const = 0;
+
+    /**
+     * Reads RomFS data. All files of a RomFS share its reader, and Service::FS reads them on its
+     * I/O thread while the emulation thread may be reading other files, so this must be safe to
+     * call from several threads at once.
+     */
     virtual std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) = 0;
 
+    /**
+     * Gets a pointer that `length` bytes of data at `offset` can be copied from directly, for
+     * readers that hold the whole RomFS in (mapped) memory. The pointer is valid for as long as
+     * the reader exists.
+     * @return Pointer to the data, or nullptr if this reader can't provide one for that range
+     */
+    virtual const u8* GetDirectPointer(std::size_t offset, std::size_t length) {
+        return nullptr;
+    }
+
 private:
     template <class Archive>
     void serialize(Archive& ar, const unsigned int file_version) {}
     friend class boost::serialization::access;
 };
 
+/**
+ * An LRU cache of decrypted RomFS blocks that every DirectRomFSReader in the process shares, so
+ * that the memory it takes is bounded by one budget however many RomFS are open.
+ */
+class RomFSBlockCache {
+public:
+    using Block = std::shared_ptr<const std::vector<u8>>;
+
+    /// Budget of the cache that the readers share.
+    static constexpr std::size_t default_capacity = 32 * 1024 * 1024;
+
+    explicit RomFSBlockCache(std::size_t capacity);
+
+    /// Returns the cache shared by the readers.
+    static RomFSBlockCache& Instance();
+
+    /// Returns a block of the given reader and marks it as recently used, or nullptr if it is not
+    /// cached.
+    Block Find(u64 reader_id, u64 index);
+
+    bool Contains(u64 reader_id, u64 index) const;
+
+    /// Adds a block, evicting the least recently used blocks of any reader to stay in budget.
+    void Insert(u64 reader_id, u64 index, Block block);
+
+    /// Drops every block of the given reader.
+    void Erase(u64 reader_id);
+
+    /// Returns the number of bytes held by the cached blocks.
+    std::size_t GetSize() const;
+
+    std::size_t GetCapacity() const {
+        return capacity;
+    }
+
+private:
+    using Key = std::pair<u64, u64>;
+
+    struct Entry {
+        Key key;
+        Block block;
+    };
+
+    mutable std::mutex mutex;
+    /// Cached blocks, the most recently used first
+    std::list<Entry> entries;
+    std::map<Key, std::list<Entry>::iterator> entry_map;
+    std::size_t size = 0;
+    const std::size_t capacity;
+};
+
 /**
  * A RomFS reader that directly reads the RomFS file.
+ *
+ * The (decrypted) data is kept in fixed-size blocks in the RomFSBlockCache, and sequential
+ * streams are read ahead of time on a worker thread.
  */
 class DirectRomFSReader : public RomFSReader {
 public:
-    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size)
-        : is_encrypted(false), file(std::move(file)), file_offset(file_offset),
-          data_size(data_size) {}
+    struct CacheStats {
+        u64 hits = 0;             ///< Blocks that were found in the cache
+        u64 misses = 0;           ///< Blocks that had to be read from the host file on demand
+        u64 readahead_blocks = 0; ///< Blocks read ahead of a sequential stream
+        u64 host_bytes_read = 0;  ///< Bytes read from the host file, including readahead
+
+        double HitRate() const {
+            const u64 total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+        }
+    };
+
+    /// Size of the blocks the cache is made of.
+    static constexpr std::size_t block_size = 64 * 1024;
+
+    DirectRomFSReader(ImageFile&& file, std::size_t file_offset, std::size_t data_size);
 
-    DirectRomFSReader(FileUtil::IOFile&& file, std::size_t file_offset, std::size_t data_size,
+    DirectRomFSReader(ImageFile&& file, std::size_t file_offset, std::size_t data_size,
                       const std::array<u8, 16>& key, const std::array<u8, 16>& ctr,
-                      std::size_t crypto_offset)
-        : is_encrypted(true), file(std::move(file)), key(key), ctr(ctr), file_offset(file_offset),
-          crypto_offset(crypto_offset), data_size(data_size) {}
+                      std::size_t crypto_offset);
 
-    ~DirectRomFSReader() override = default;
+    ~DirectRomFSReader() override;
 
     std::size_t GetSize() const override {
         return data_size;
@@ -48,19 +143,48 @@ public:
 
     std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override;
 
+    CacheStats GetCacheStats() const;
+
 private:
+    /// Returns the given block, reading it from the host file if it is not cached yet.
+    RomFSBlockCache::Block GetBlock(u64 index);
+
+    /// Reads a block that is not cached yet into the cache.
+    RomFSBlockCache::Block LoadBlock(u64 index);
+
+    /// Reads and decrypts `length` bytes at `offset` into `buffer`, bypassing the cache.
+    std::size_t ReadUncached(u64 offset, std::size_t length, u8* buffer);
+
+    /// Detects sequential reads and queues readahead of the blocks that follow them.
+    void UpdateReadahead(u64 offset, std::size_t length);
+
+    /// Loads blocks [first, first + count) into the cache. Runs on the readahead thread.
+    void Prefetch(u64 first, std::size_t count);
+
     bool is_encrypted;
-    FileUtil::IOFile file;
+    ImageFile file;
     std::array<u8, 16> key;
     std::array<u8, 16> ctr;
     u64 file_offset;
     u64 crypto_offset;
     u64 data_size;
+    /// Identifies the blocks of this reader in the RomFSBlockCache
+    const u64 cache_id;
+
+    /// Protects everything below as well as the file, which the readahead thread reads from too.
+    mutable std::mutex mutex;
+    std::unique_ptr<CryptoPP::SymmetricCipher> decryption;
+    CacheStats stats;
+    /// Offset just past the previous read, and the number of reads in a row that continued there
+    u64 sequential_end = 0;
+    u32 sequential_reads = 0;
+    std::future<void> readahead;
 
-    DirectRomFSReader() = default;
+    DirectRomFSReader();
 
     template <class Archive>
     void serialize(Archive& ar, const unsigned int) {
+        std::lock_guard lock{mutex};
         ar& boost::serialization::base_object<RomFSReader>(*this);
         ar& is_encrypted;
         ar& file;
@@ -73,6 +197,53 @@ private:
     friend class boost::serialization::access;
 };
 
+/**
+ * A RomFS reader for unencrypted images that serves reads straight out of a memory mapping of the
+ * file. As the data lives in the host page cache, it is shared with every other process that has
+ * the same image open instead of being copied into each one.
+ */
+class MappedRomFSReader : public RomFSReader {
+public:
+    MappedRomFSReader(const std::string& path, std::size_t file_offset, std::size_t data_size);
+    ~MappedRomFSReader() override;
+
+    /// Whether the file could be mapped. If not, DirectRomFSReader has to be used instead.
+    bool IsOpen() const {
+        return mapping.IsOpen();
+    }
+
+    std::size_t GetSize() const override {
+        return mapping.Size();
+    }
+
+    std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override;
+
+    const u8* GetDirectPointer(std::size_t offset, std::size_t length) override;
+
+private:
+    /// Asks the OS to page in a range that is about to be read, and whatever follows a stream.
+    void AdviseRead(std::size_t offset, std::size_t length);
+
+    /// Reads from the file itself, for when it could not be mapped again after loading a state.
+    std::size_t ReadUnmapped(std::size_t offset, std::size_t length, u8* buffer);
+
+    FileUtil::MappedFile mapping;
+    std::mutex unmapped_mutex;
+    FileUtil::IOFile unmapped_file;
+    /// Offset just past the previous read, to detect sequential streams
+    std::atomic<u64> sequential_end{0};
+
+    MappedRomFSReader();
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& boost::serialization::base_object<RomFSReader>(*this);
+        ar& mapping;
+    }
+    friend class boost::serialization::access;
+};
+
 } // namespace FileSys
 
 BOOST_CLASS_EXPORT_KEY(FileSys::DirectRomFSReader)
+BOOST_CLASS_EXPORT_KEY(FileSys::MappedRomFSReader)
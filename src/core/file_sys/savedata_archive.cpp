@@ -6,6 +6,7 @@
 #include "common/file_util.h"
 #include "core/file_sys/disk_archive.h"
 #include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
 #include "core/file_sys/path_parser.h"
 #include "core/file_sys/savedata_archive.h"
 
@@ -80,6 +81,7 @@ ResultVal<std::unique_ptr<FileBackend>> SaveDataArchive::OpenFile(const Path& pa
         } else {
             // Create the file
             FileUtil::CreateEmptyFile(full_path);
+            HostDirectoryCache::AddEntry(full_path, false);
         }
         break;
     case PathParser::FileFound:
@@ -89,6 +91,7 @@ ResultVal<std::unique_ptr<FileBackend>> SaveDataArchive::OpenFile(const Path& pa
     FileUtil::IOFile file(full_path, mode.write_flag ? "r+b" : "rb");
     if (!file.IsOpen()) {
         LOG_CRITICAL(Service_FS, "(unreachable) Unknown error opening {}", full_path);
+        HostDirectoryCache::Invalidate(full_path);
         return ERROR_FILE_NOT_FOUND;
     }
 
@@ -124,9 +127,11 @@ ResultCode SaveDataArchive::DeleteFile(const Path& path) const {
     }
 
     if (FileUtil::Delete(full_path)) {
+        HostDirectoryCache::RemoveEntry(full_path);
         return RESULT_SUCCESS;
     }
 
+    HostDirectoryCache::Invalidate(full_path);
     LOG_CRITICAL(Service_FS, "(unreachable) Unknown error deleting {}", full_path);
     return ERROR_FILE_NOT_FOUND;
 }
@@ -151,6 +156,8 @@ ResultCode SaveDataArchive::RenameFile(const Path& src_path, const Path& dest_pa
     const auto dest_path_full = path_parser_dest.BuildHostPath(mount_point);
 
     if (FileUtil::Rename(src_path_full, dest_path_full)) {
+        HostDirectoryCache::Invalidate(src_path_full);
+        HostDirectoryCache::Invalidate(dest_path_full);
         return RESULT_SUCCESS;
     }
 
@@ -192,9 +199,12 @@ static ResultCode DeleteDirectoryHelper(const Path& path, const std::string& mou
     }
 
     if (deleter(full_path)) {
+        HostDirectoryCache::RemoveEntry(full_path);
         return RESULT_SUCCESS;
     }
 
+    // A recursive delete can fail halfway through.
+    HostDirectoryCache::Invalidate(full_path);
     LOG_ERROR(Service_FS, "Directory not empty {}", full_path);
     return ERROR_DIRECTORY_NOT_EMPTY;
 }
@@ -238,6 +248,7 @@ ResultCode SaveDataArchive::CreateFile(const FileSys::Path& path, u64 size) cons
 
     if (size == 0) {
         FileUtil::CreateEmptyFile(full_path);
+        HostDirectoryCache::AddEntry(full_path, false);
         return RESULT_SUCCESS;
     }
 
@@ -245,9 +256,11 @@ ResultCode SaveDataArchive::CreateFile(const FileSys::Path& path, u64 size) cons
     // Creates a sparse file (or a normal file on filesystems without the concept of sparse files)
     // We do this by seeking to the right size, then writing a single null byte.
     if (file.Seek(size - 1, SEEK_SET) && file.WriteBytes("", 1) == 1) {
+        HostDirectoryCache::AddEntry(full_path, false);
         return RESULT_SUCCESS;
     }
 
+    HostDirectoryCache::Invalidate(full_path);
     LOG_ERROR(Service_FS, "Too large file");
     return ResultCode(ErrorDescription::TooLarge, ErrorModule::FS, ErrorSummary::OutOfResource,
                       ErrorLevel::Info);
@@ -282,6 +295,7 @@ ResultCode SaveDataArchive::CreateDirectory(const Path& path) const {
     }
 
     if (FileUtil::CreateDir(mount_point + path.AsString())) {
+        HostDirectoryCache::AddEntry(full_path, true);
         return RESULT_SUCCESS;
     }
 
@@ -310,6 +324,8 @@ ResultCode SaveDataArchive::RenameDirectory(const Path& src_path, const Path& de
     const auto dest_path_full = path_parser_dest.BuildHostPath(mount_point);
 
     if (FileUtil::Rename(src_path_full, dest_path_full)) {
+        HostDirectoryCache::Invalidate(src_path_full);
+        HostDirectoryCache::Invalidate(dest_path_full);
         return RESULT_SUCCESS;
     }
 
@@ -0,0 +1,88 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <string>
+#include <fmt/format.h>
+#include "common/common_paths.h"
+#include "common/file_util.h"
+#include "common/hash.h"
+#include "common/logging/log.h"
+#include "common/string_util.h"
+#include "common/swap.h"
+#include "core/file_sys/title_cache.h"
+
+namespace FileSys::TitleCache {
+
+namespace {
+
+constexpr u32 entry_magic = 0x43435443; // "CTCC"
+/// Bumped whenever the layout of an entry or what goes into it changes
+constexpr u32 entry_version = 1;
+
+struct EntryHeader {
+    u32_le magic;
+    u32_le version;
+    u64_le key;
+    u64_le size;
+    u64_le data_hash; // Detects entries that were only partially written
+};
+static_assert(sizeof(EntryHeader) == 0x20, "EntryHeader has incorrect size");
+
+std::string GetCodePath(u64 program_id) {
+    return fmt::format("{}titles{}{:016X}.code",
+                       FileUtil::GetUserPath(FileUtil::UserPath::CacheDir), DIR_SEP, program_id);
+}
+
+} // Anonymous namespace
+
+std::optional<std::vector<u8>> LoadCode(u64 program_id, u64 key) {
+    const std::string path = GetCodePath(program_id);
+    FileUtil::IOFile file(path, "rb");
+    if (!file) {
+        return std::nullopt;
+    }
+
+    EntryHeader header;
+    if (file.ReadBytes(&header, sizeof(header)) != sizeof(header) || header.magic != entry_magic ||
+        header.version != entry_version || header.key != key ||
+        header.size != file.GetSize() - sizeof(header)) {
+        LOG_DEBUG(Loader, "Title cache entry {} is out of date", path);
+        return std::nullopt;
+    }
+
+    std::vector<u8> code(header.size);
+    if (file.ReadBytes(code.data(), code.size()) != code.size() ||
+        Common::ComputeHash64(code.data(), code.size()) != header.data_hash) {
+        LOG_WARNING(Loader, "Title cache entry {} is corrupted", path);
+        return std::nullopt;
+    }
+    return code;
+}
+
+void StoreCode(u64 program_id, u64 key, const std::vector<u8>& code) {
+    const std::string path = GetCodePath(program_id);
+    std::string folder;
+    Common::SplitPath(path, &folder, nullptr, nullptr);
+    if (!FileUtil::CreateFullPath(folder)) {
+        LOG_WARNING(Loader, "Could not create title cache folder {}", folder);
+        return;
+    }
+
+    EntryHeader header{};
+    header.magic = entry_magic;
+    header.version = entry_version;
+    header.key = key;
+    header.size = code.size();
+    header.data_hash = Common::ComputeHash64(code.data(), code.size());
+
+    FileUtil::IOFile file(path, "wb");
+    if (!file || file.WriteBytes(&header, sizeof(header)) != sizeof(header) ||
+        file.WriteBytes(code.data(), code.size()) != code.size()) {
+        LOG_WARNING(Loader, "Could not write title cache entry {}", path);
+        file.Close();
+        FileUtil::Delete(path);
+    }
+}
+
+} // namespace FileSys::TitleCache
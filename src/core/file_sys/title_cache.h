@@ -0,0 +1,34 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <optional>
+#include <vector>
+#include "common/common_types.h"
+
+/**
+ * Disk cache of title contents that are expensive to produce at boot. Currently this is the .code
+ * section after decompression and patching. There is one entry per title in cache/titles/. It is
+ * only used if it was built from exactly the same inputs, which the caller hashes into a key.
+ */
+namespace FileSys::TitleCache {
+
+/**
+ * Loads the cached code of a title.
+ * @param program_id Program ID of the title
+ * @param key Hash of everything the code was built from
+ * @return The code, or std::nullopt if there is no valid entry for this key
+ */
+std::optional<std::vector<u8>> LoadCode(u64 program_id, u64 key);
+
+/**
+ * Saves the code of a title, replacing any previous entry for the title.
+ * @param program_id Program ID of the title
+ * @param key Hash of everything the code was built from
+ * @param code The code to save
+ */
+void StoreCode(u64 program_id, u64 key, const std::vector<u8>& code);
+
+} // namespace FileSys::TitleCache
@@ -147,14 +147,23 @@ void KernelSystem::HandleSpecialMapping(VMManager& address_space, const AddressM
         return;
     }
 
-    auto target_pointer = memory.GetPhysicalRef(area->paddr_base + offset_into_region);
-
     // TODO(yuriks): This flag seems to have some other effect, but it's unknown what
     MemoryState memory_state = mapping.unk_flag ? MemoryState::Static : MemoryState::IO;
 
-    auto vma =
-        address_space.MapBackingMemory(mapping.address, target_pointer, mapping.size, memory_state)
-            .Unwrap();
+    VMManager::VMAHandle vma;
+    auto dsp_handler = memory.GetDspMemoryHandler();
+    if (area->paddr_base == DSP_RAM_PADDR && dsp_handler) {
+        // The DSP writes its memory from another thread, so every access has to go through it.
+        vma = address_space
+                  .MapMMIO(mapping.address, area->paddr_base + offset_into_region, mapping.size,
+                           memory_state, std::move(dsp_handler))
+                  .Unwrap();
+    } else {
+        auto target_pointer = memory.GetPhysicalRef(area->paddr_base + offset_into_region);
+        vma = address_space
+                  .MapBackingMemory(mapping.address, target_pointer, mapping.size, memory_state)
+                  .Unwrap();
+    }
     address_space.Reprotect(vma,
                             mapping.read_only ? VMAPermission::Read : VMAPermission::ReadWrite);
 }
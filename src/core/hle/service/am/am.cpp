@@ -3,18 +3,21 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <chrono>
 #include <cinttypes>
 #include <cstddef>
 #include <cstring>
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
+#include <future>
+#include <cryptopp/sha.h>
 #include <fmt/format.h>
 #include "common/common_paths.h"
 #include "common/file_util.h"
 #include "common/logging/log.h"
 #include "common/string_util.h"
+#include "common/thread_pool.h"
 #include "core/core.h"
 #include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
 #include "core/file_sys/ncch_container.h"
 #include "core/file_sys/title_metadata.h"
 #include "core/hle/ipc.h"
@@ -32,6 +35,7 @@
 #include "core/hle/service/am/am_u.h"
 #include "core/hle/service/fs/archive.h"
 #include "core/hle/service/fs/fs_user.h"
+#include "core/hw/aes/bulk_decrypt.h"
 #include "core/loader/loader.h"
 #include "core/loader/smdh.h"
 
@@ -80,7 +84,39 @@ static_assert(sizeof(TicketInfo) == 0x18, "Ticket info structure size is wrong")
 
 class CIAFile::DecryptionState {
 public:
-    std::vector<CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption> content;
+    ~DecryptionState() {
+        WaitForHash();
+    }
+
+    /**
+     * Adds `data` to the hash of a content on a worker thread, so that hashing overlaps with
+     * writing the data out and decrypting the next buffer.
+     */
+    void Hash(std::size_t index, std::shared_ptr<const std::vector<u8>> data) {
+        static Common::ThreadPool hash_thread(1, "CIA Hash");
+        WaitForHash();
+        pending_hash = hash_thread.Push([this, index, data = std::move(data)] {
+            content_hash[index].Update(data->data(), data->size());
+        });
+    }
+
+    /// Finishes the hash of a content and compares it against the one in the TMD.
+    bool VerifyHash(std::size_t index, const std::array<u8, 0x20>& expected) {
+        WaitForHash();
+        std::array<u8, CryptoPP::SHA256::DIGESTSIZE> hash;
+        content_hash[index].Final(hash.data());
+        return hash == expected;
+    }
+
+    void WaitForHash() {
+        if (pending_hash.valid()) {
+            pending_hash.get();
+        }
+    }
+
+    std::vector<HW::AES::CBCStreamDecryptor> content;
+    std::vector<CryptoPP::SHA256> content_hash;
+    std::future<void> pending_hash;
 };
 
 CIAFile::CIAFile(Service::FS::MediaType media_type)
@@ -137,11 +173,11 @@ ResultCode CIAFile::WriteTitleMetadata() {
     if (auto title_key = container.GetTicket().GetTitleKey()) {
         decryption_state->content.resize(content_count);
         for (std::size_t i = 0; i < content_count; ++i) {
-            auto ctr = tmd.GetContentCTRByIndex(i);
-            decryption_state->content[i].SetKeyWithIV(title_key->data(), title_key->size(),
-                                                      ctr.data());
+            decryption_state->content[i] =
+                HW::AES::CBCStreamDecryptor(*title_key, tmd.GetContentCTRByIndex(i));
         }
     }
+    decryption_state->content_hash.resize(content_count);
 
     install_state = CIAInstallState::TMDLoaded;
 
@@ -179,20 +215,40 @@ ResultVal<std::size_t> CIAFile::WriteContentData(u64 offset, std::size_t length,
                 return FileSys::ERROR_INSUFFICIENT_SPACE;
             }
 
-            std::vector<u8> temp(buffer + (range_min - offset),
-                                 buffer + (range_min - offset) + available_to_write);
-
+            const u8* data = buffer + (range_min - offset);
+            std::shared_ptr<std::vector<u8>> temp;
             if ((tmd.GetContentTypeByIndex(i) & FileSys::TMDContentTypeFlag::Encrypted) != 0) {
-                decryption_state->content[i].ProcessData(temp.data(), temp.data(), temp.size());
+                // The guest may write in pieces that split a block. Those bytes are held back
+                // until the rest of the block arrives, so the output can lag behind the input.
+                auto& decryptor = decryption_state->content[i];
+                temp = std::make_shared<std::vector<u8>>(
+                    decryptor.Process(data, static_cast<std::size_t>(available_to_write)));
+                if (content_written[i] + available_to_write == size) {
+                    const auto remainder = decryptor.TakeRemainder();
+                    if (!remainder.empty()) {
+                        LOG_ERROR(Service_AM, "Content {} does not end on an AES block boundary",
+                                  i);
+                        temp->insert(temp->end(), remainder.begin(), remainder.end());
+                    }
+                }
+            } else {
+                temp = std::make_shared<std::vector<u8>>(data, data + available_to_write);
             }
 
-            file.WriteBytes(temp.data(), temp.size());
+            decryption_state->Hash(i, temp);
+            file.WriteBytes(temp->data(), temp->size());
 
             // Keep tabs on how much of this content ID has been written so new range_min
             // values can be calculated.
             content_written[i] += available_to_write;
             LOG_DEBUG(Service_AM, "Wrote {:x} to content {}, total {:x}", available_to_write, i,
                       content_written[i]);
+
+            if (content_written[i] == size &&
+                !decryption_state->VerifyHash(i, tmd.GetContentHashByIndex(i))) {
+                LOG_WARNING(Service_AM, "Hash mismatch for content {} of title {:016X}", i,
+                            tmd.GetTitleID());
+            }
         }
     }
 
@@ -288,7 +344,10 @@ bool CIAFile::Close() const {
     // Install aborted
     if (!complete) {
         LOG_ERROR(Service_AM, "CIAFile closed prematurely, aborting install...");
-        FileUtil::DeleteDir(GetTitlePath(media_type, container.GetTitleMetadata().GetTitleID()));
+        const std::string title_path =
+            GetTitlePath(media_type, container.GetTitleMetadata().GetTitleID());
+        FileUtil::DeleteDir(title_path);
+        FileSys::HostDirectoryCache::Invalidate(title_path);
         return true;
     }
 
@@ -318,15 +377,21 @@ bool CIAFile::Close() const {
             if (abort)
                 break;
 
-            FileUtil::Delete(GetTitleContentPath(media_type, old_tmd.GetTitleID(), old_index));
+            const std::string old_content_path =
+                GetTitleContentPath(media_type, old_tmd.GetTitleID(), old_index);
+            FileUtil::Delete(old_content_path);
+            FileSys::HostDirectoryCache::Invalidate(old_content_path);
         }
 
         FileUtil::Delete(old_tmd_path);
+        FileSys::HostDirectoryCache::Invalidate(old_tmd_path);
     }
     return true;
 }
 
-void CIAFile::Flush() const {}
+ResultCode CIAFile::Flush() const {
+    return RESULT_SUCCESS;
+}
 
 InstallStatus InstallCIA(const std::string& path,
                          std::function<ProgressCallback>&& update_callback) {
@@ -357,6 +422,7 @@ InstallStatus InstallCIA(const std::string& path,
         if (!file.IsOpen())
             return InstallStatus::ErrorFailedToOpenFile;
 
+        const auto start_time = std::chrono::steady_clock::now();
         std::array<u8, 0x10000> buffer;
         std::size_t total_bytes_read = 0;
         while (total_bytes_read != file.GetSize()) {
@@ -375,7 +441,10 @@ InstallStatus InstallCIA(const std::string& path,
         }
         installFile.Close();
 
-        LOG_INFO(Service_AM, "Installed {} successfully.", path);
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start_time;
+        LOG_INFO(Service_AM, "Installed {} successfully ({:.1f} MB/s).", path,
+                 total_bytes_read / elapsed.count() / 0x100000);
 
         const FileUtil::DirectoryEntryCallable callback =
             [&callback](u64* num_entries_out, const std::string& directory,
@@ -814,6 +883,7 @@ void Module::Interface::DeleteUserProgram(Kernel::HLERequestContext& ctx) {
         return;
     }
     bool success = FileUtil::DeleteDirRecursively(path);
+    FileSys::HostDirectoryCache::Invalidate(path);
     am->ScanForAllTitles();
     rb.Push(RESULT_SUCCESS);
     if (!success)
@@ -1163,7 +1233,9 @@ public:
     bool Close() const override {
         return false;
     }
-    void Flush() const override {}
+    ResultCode Flush() const override {
+        return RESULT_SUCCESS;
+    }
 
 private:
     std::shared_ptr<Service::FS::File> file;
@@ -1408,6 +1480,7 @@ void Module::Interface::DeleteProgram(Kernel::HLERequestContext& ctx) {
         return;
     }
     bool success = FileUtil::DeleteDirRecursively(path);
+    FileSys::HostDirectoryCache::Invalidate(path);
     am->ScanForAllTitles();
     rb.Push(RESULT_SUCCESS);
     if (!success)
@@ -81,7 +81,7 @@ public:
     u64 GetSize() const override;
     bool SetSize(u64 size) const override;
     bool Close() const override;
-    void Flush() const override;
+    ResultCode Flush() const override;
 
 private:
     // Whether it's installing an update, and what step of installation it is at
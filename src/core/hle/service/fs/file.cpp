@@ -2,9 +2,12 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/unique_ptr.hpp>
+#include <boost/serialization/vector.hpp>
 #include "common/archives.h"
 #include "common/logging/log.h"
+#include "common/thread_pool.h"
 #include "core/core.h"
 #include "core/file_sys/errors.h"
 #include "core/file_sys/file_backend.h"
@@ -14,17 +17,112 @@
 #include "core/hle/kernel/event.h"
 #include "core/hle/kernel/server_session.h"
 #include "core/hle/service/fs/file.h"
+#include "core/movie.h"
 
 SERIALIZE_EXPORT_IMPL(Service::FS::File)
 SERIALIZE_EXPORT_IMPL(Service::FS::FileSessionSlot)
 
 namespace Service::FS {
 
+namespace {
+
+/**
+ * Thread that file reads are handed to while the client thread sleeps for the emulated read
+ * delay. There is deliberately only one: files opened from the same archive can share a single
+ * host file handle (the RomFS reader, for example), so backends must never be read concurrently.
+ */
+Common::ThreadPool& IOThread() {
+    static Common::ThreadPool thread(1, "FS I/O");
+    return thread;
+}
+
+} // Anonymous namespace
+
+/// Completes an asynchronous read once the emulated read delay has passed.
+class File::ReadCallback : public Kernel::HLERequestContext::WakeupCallback {
+public:
+    /// Completes a read that was queued on the I/O thread.
+    ReadCallback(u32 buffer_id, std::shared_ptr<std::vector<u8>> data,
+                 std::shared_future<ResultVal<std::size_t>> pending)
+        : buffer_id(buffer_id), data(std::move(data)), pending(std::move(pending)) {}
+
+    /// Completes a read by copying from a view of the backend's memory.
+    ReadCallback(u32 buffer_id, std::shared_ptr<const u8> view, u32 view_length)
+        : buffer_id(buffer_id), view(std::move(view)), view_length(view_length) {}
+
+    void WakeUp(std::shared_ptr<Kernel::Thread> thread, Kernel::HLERequestContext& ctx,
+                Kernel::ThreadWakeupReason reason) override {
+        auto& buffer = ctx.GetMappedBuffer(buffer_id);
+        IPC::RequestBuilder rb(ctx, 0x0802, 2, 2);
+        if (view) {
+            buffer.Write(view.get(), 0, view_length);
+            rb.Push(RESULT_SUCCESS);
+            rb.Push<u32>(view_length);
+            rb.PushMappedBuffer(buffer);
+            return;
+        }
+
+        // This only blocks if the host took longer than the emulated console would have.
+        Resolve();
+        if (result.IsError()) {
+            rb.Push(result);
+            rb.Push<u32>(0);
+        } else {
+            buffer.Write(data->data(), 0, data->size());
+            rb.Push(RESULT_SUCCESS);
+            rb.Push<u32>(static_cast<u32>(data->size()));
+        }
+        rb.PushMappedBuffer(buffer);
+    }
+
+private:
+    /// Finishes the read, leaving its outcome in `data` and `result`.
+    void Resolve() {
+        if (view) {
+            data = std::make_shared<std::vector<u8>>(view.get(), view.get() + view_length);
+            result = RESULT_SUCCESS;
+            view.reset();
+            return;
+        }
+        if (!pending.valid()) {
+            return;
+        }
+        const ResultVal<std::size_t> read = pending.get();
+        result = read.Code();
+        data->resize(read.Succeeded() ? *read : 0);
+        pending = {};
+    }
+
+    u32 buffer_id = 0;
+    std::shared_ptr<std::vector<u8>> data;
+    ResultCode result = RESULT_SUCCESS;
+    std::shared_future<ResultVal<std::size_t>> pending;
+    std::shared_ptr<const u8> view;
+    u32 view_length = 0;
+
+    ReadCallback() = default;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        // The read itself cannot be saved, so finish it and save the data instead.
+        Resolve();
+        ar& boost::serialization::base_object<Kernel::HLERequestContext::WakeupCallback>(*this);
+        ar& buffer_id;
+        ar& data;
+        ar& result.raw;
+    }
+    friend class boost::serialization::access;
+};
+
 template <class Archive>
 void File::serialize(Archive& ar, const unsigned int) {
+    WaitForPendingRead();
     ar& boost::serialization::base_object<Kernel::SessionRequestHandler>(*this);
     ar& path;
     ar& backend;
+    if (Archive::is_loading::value && backend) {
+        backend_size = backend->GetSize();
+    }
 }
 
 File::File() : File(Core::Global<Kernel::KernelSystem>()) {}
@@ -34,6 +132,7 @@ File::File(Kernel::KernelSystem& kernel, std::unique_ptr<FileSys::FileBackend>&&
     : File(kernel) {
     this->backend = std::move(backend);
     this->path = path;
+    backend_size = this->backend->GetSize();
 }
 
 File::File(Kernel::KernelSystem& kernel)
@@ -53,6 +152,16 @@ File::File(Kernel::KernelSystem& kernel)
     RegisterHandlers(functions);
 }
 
+File::~File() {
+    WaitForPendingRead();
+}
+
+void File::WaitForPendingRead() {
+    if (pending_read.valid()) {
+        pending_read.wait();
+    }
+}
+
 void File::Read(Kernel::HLERequestContext& ctx) {
     IPC::RequestParser rp(ctx, 0x0802, 3, 2);
     u64 offset = rp.Pop<u64>();
@@ -70,28 +179,63 @@ void File::Read(Kernel::HLERequestContext& ctx) {
     // This file session might have a specific offset from where to start reading, apply it.
     offset += file->offset;
 
-    if (offset + length > backend->GetSize()) {
+    if (offset + length > backend_size) {
         LOG_ERROR(Service_FS,
                   "Reading from out of bounds offset=0x{:x} length=0x{:08X} file_size=0x{:x}",
-                  offset, length, backend->GetSize());
+                  offset, length, backend_size);
     }
 
-    IPC::RequestBuilder rb = rp.MakeBuilder(2, 2);
+    std::chrono::nanoseconds read_timeout_ns{backend->GetReadDelayNs(length)};
 
-    std::vector<u8> data(length);
-    ResultVal<std::size_t> read = backend->Read(offset, data.size(), data.data());
-    if (read.Failed()) {
-        rb.Push(read.Code());
-        rb.Push<u32>(0);
-    } else {
-        buffer.Write(data.data(), 0, *read);
-        rb.Push(RESULT_SUCCESS);
-        rb.Push<u32>(static_cast<u32>(*read));
+    // Backends that keep the file in memory can be copied from straight into guest memory.
+    std::shared_ptr<const u8> view = backend->GetDirectView(offset, length);
+
+    // Recorded movies were made with the data landing in guest memory before the client thread
+    // goes to sleep, so keep doing that while one is recording or playing back.
+    if (Core::Movie::GetInstance().GetPlayMode() != Core::Movie::PlayMode::None ||
+        read_timeout_ns.count() <= 0) {
+        WaitForPendingRead();
+
+        IPC::RequestBuilder rb = rp.MakeBuilder(2, 2);
+
+        if (view) {
+            buffer.Write(view.get(), 0, length);
+            rb.Push(RESULT_SUCCESS);
+            rb.Push<u32>(length);
+        } else {
+            std::vector<u8> data(length);
+            ResultVal<std::size_t> read = backend->Read(offset, data.size(), data.data());
+            if (read.Failed()) {
+                rb.Push(read.Code());
+                rb.Push<u32>(0);
+            } else {
+                buffer.Write(data.data(), 0, *read);
+                rb.Push(RESULT_SUCCESS);
+                rb.Push<u32>(static_cast<u32>(*read));
+            }
+        }
+        rb.PushMappedBuffer(buffer);
+
+        ctx.SleepClientThread("file::read", read_timeout_ns, nullptr);
+        return;
     }
-    rb.PushMappedBuffer(buffer);
 
-    std::chrono::nanoseconds read_timeout_ns{backend->GetReadDelayNs(length)};
-    ctx.SleepClientThread("file::read", read_timeout_ns, nullptr);
+    // Otherwise the host read overlaps with the emulated delay, and the reply is only built once
+    // the client thread wakes up.
+    if (view) {
+        // There is nothing for the I/O thread to do. The backend is already paging the data in.
+        ctx.SleepClientThread("file::read", read_timeout_ns,
+                              std::make_shared<ReadCallback>(buffer.GetId(), std::move(view),
+                                                             length));
+        return;
+    }
+
+    auto data = std::make_shared<std::vector<u8>>(length);
+    pending_read = IOThread().Push([backend = backend.get(), offset, data] {
+        return backend->Read(offset, data->size(), data->data());
+    });
+    ctx.SleepClientThread("file::read", read_timeout_ns,
+                          std::make_shared<ReadCallback>(buffer.GetId(), data, pending_read));
 }
 
 void File::Write(Kernel::HLERequestContext& ctx) {
@@ -115,12 +259,15 @@ void File::Write(Kernel::HLERequestContext& ctx) {
         return;
     }
 
+    WaitForPendingRead();
+
     std::vector<u8> data(length);
     buffer.Read(data.data(), 0, data.size());
     ResultVal<std::size_t> written = backend->Write(offset, data.size(), flush != 0, data.data());
 
     // Update file size
-    file->size = backend->GetSize();
+    backend_size = backend->GetSize();
+    file->size = backend_size;
 
     if (written.Failed()) {
         rb.Push(written.Code());
@@ -156,8 +303,10 @@ void File::SetSize(Kernel::HLERequestContext& ctx) {
         return;
     }
 
+    WaitForPendingRead();
     file->size = size;
     backend->SetSize(size);
+    backend_size = size;
     rb.Push(RESULT_SUCCESS);
 }
 
@@ -169,6 +318,7 @@ void File::Close(Kernel::HLERequestContext& ctx) {
         LOG_WARNING(Service_FS, "Closing File backend but {} clients still connected",
                     connected_sessions.size());
 
+    WaitForPendingRead();
     backend->Close();
     IPC::RequestBuilder rb = rp.MakeBuilder(1, 0);
     rb.Push(RESULT_SUCCESS);
@@ -187,8 +337,8 @@ void File::Flush(Kernel::HLERequestContext& ctx) {
         return;
     }
 
-    backend->Flush();
-    rb.Push(RESULT_SUCCESS);
+    WaitForPendingRead();
+    rb.Push(backend->Flush());
 }
 
 void File::SetPriority(Kernel::HLERequestContext& ctx) {
@@ -224,7 +374,7 @@ void File::OpenLinkFile(Kernel::HLERequestContext& ctx) {
 
     slot->priority = original_file->priority;
     slot->offset = 0;
-    slot->size = backend->GetSize();
+    slot->size = backend_size;
     slot->subfile = false;
 
     rb.Push(RESULT_SUCCESS);
@@ -282,7 +432,7 @@ std::shared_ptr<Kernel::ClientSession> File::Connect() {
     FileSessionSlot* slot = GetSessionData(std::move(server));
     slot->priority = 0;
     slot->offset = 0;
-    slot->size = backend->GetSize();
+    slot->size = backend_size;
     slot->subfile = false;
 
     return client;
@@ -301,3 +451,5 @@ std::size_t File::GetSessionFileSize(std::shared_ptr<Kernel::ServerSession> sess
 }
 
 } // namespace Service::FS
+
+SERIALIZE_EXPORT_IMPL(Service::FS::File::ReadCallback)
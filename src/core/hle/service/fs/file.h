@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <future>
 #include <memory>
 #include <boost/serialization/base_object.hpp>
 #include "core/file_sys/archive_backend.h"
@@ -41,7 +42,7 @@ class File final : public ServiceFramework<File, FileSessionSlot> {
 public:
     File(Kernel::KernelSystem& kernel, std::unique_ptr<FileSys::FileBackend>&& backend,
          const FileSys::Path& path);
-    ~File() = default;
+    ~File();
 
     std::string GetName() const {
         return "Path: " + path.DebugStr();
@@ -61,6 +62,8 @@ public:
     // OpenSubFile.
     std::size_t GetSessionFileSize(std::shared_ptr<Kernel::ServerSession> session);
 
+    class ReadCallback;
+
 private:
     void Read(Kernel::HLERequestContext& ctx);
     void Write(Kernel::HLERequestContext& ctx);
@@ -73,8 +76,19 @@ private:
     void OpenLinkFile(Kernel::HLERequestContext& ctx);
     void OpenSubFile(Kernel::HLERequestContext& ctx);
 
+    /// Blocks until the I/O thread is no longer reading from the backend.
+    void WaitForPendingRead();
+
     Kernel::KernelSystem& kernel;
 
+    /// Size of the backend, kept up to date by Write and SetSize so that the size is never asked
+    /// of the backend while the I/O thread may be reading from it.
+    u64 backend_size = 0;
+
+    /// The most recent read queued on the I/O thread. Reads are run in order, so once this one
+    /// has completed every earlier read of this file has as well.
+    std::shared_future<ResultVal<std::size_t>> pending_read;
+
     File(Kernel::KernelSystem& kernel);
     File();
 
@@ -87,3 +101,4 @@ private:
 
 BOOST_CLASS_EXPORT_KEY(Service::FS::FileSessionSlot)
 BOOST_CLASS_EXPORT_KEY(Service::FS::File)
+BOOST_CLASS_EXPORT_KEY(Service::FS::File::ReadCallback)
@@ -0,0 +1,126 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+#include "common/assert.h"
+#include "common/logging/log.h"
+#include "common/thread_pool.h"
+#include "core/hw/aes/bulk_decrypt.h"
+
+namespace HW::AES {
+
+namespace {
+
+/// Amount of data each thread decrypts at once. Large enough that setting up the cipher is noise.
+constexpr std::size_t chunk_size = 256 * 1024;
+
+Common::ThreadPool& DecryptionThreads() {
+    static Common::ThreadPool threads = [] {
+        // Crypto++ picks the fastest implementation available at runtime. Building it without
+        // the assembly/intrinsics makes that plain C++, which is an order of magnitude slower.
+        LOG_INFO(HW_AES, "Using the {} AES implementation",
+                 CryptoPP::AES::Decryption().AlgorithmProvider());
+        return Common::ThreadPool(Common::ThreadPool::DefaultThreadCount(8), "AES");
+    }();
+    return threads;
+}
+
+std::size_t NumChunks(std::size_t size) {
+    return (size + chunk_size - 1) / chunk_size;
+}
+
+} // Anonymous namespace
+
+void DecryptCTR(const AESKey& key, const AESKey& ctr, u64 stream_offset, u8* data,
+                std::size_t size) {
+    const auto decrypt_chunk = [&](std::size_t chunk) {
+        const std::size_t offset = chunk * chunk_size;
+        const std::size_t length = std::min(chunk_size, size - offset);
+        CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(), ctr.data());
+        d.Seek(stream_offset + offset);
+        d.ProcessData(data + offset, data + offset, length);
+    };
+
+    const std::size_t num_chunks = NumChunks(size);
+    if (num_chunks <= 1) {
+        if (size > 0) {
+            decrypt_chunk(0);
+        }
+        return;
+    }
+    DecryptionThreads().ParallelFor(num_chunks, decrypt_chunk);
+}
+
+void DecryptCBC(const AESKey& key, AESKey& iv, u8* data, std::size_t size) {
+    ASSERT_MSG(size % AES_BLOCK_SIZE == 0, "CBC data must be a whole number of blocks");
+    if (size == 0) {
+        return;
+    }
+
+    // Each chunk is chained to the last ciphertext block of the chunk before it, which has to be
+    // saved up front as the chunks are decrypted in place.
+    const std::size_t num_chunks = NumChunks(size);
+    std::vector<AESKey> chunk_ivs(num_chunks);
+    chunk_ivs[0] = iv;
+    for (std::size_t chunk = 1; chunk < num_chunks; chunk++) {
+        std::memcpy(chunk_ivs[chunk].data(), data + chunk * chunk_size - AES_BLOCK_SIZE,
+                    AES_BLOCK_SIZE);
+    }
+    std::memcpy(iv.data(), data + size - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+
+    const auto decrypt_chunk = [&](std::size_t chunk) {
+        const std::size_t offset = chunk * chunk_size;
+        const std::size_t length = std::min(chunk_size, size - offset);
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption d(key.data(), key.size(),
+                                                        chunk_ivs[chunk].data());
+        d.ProcessData(data + offset, data + offset, length);
+    };
+
+    if (num_chunks == 1) {
+        decrypt_chunk(0);
+        return;
+    }
+    DecryptionThreads().ParallelFor(num_chunks, decrypt_chunk);
+}
+
+CBCStreamDecryptor::CBCStreamDecryptor(const AESKey& key, const AESKey& iv) : key(key), iv(iv) {}
+
+std::vector<u8> CBCStreamDecryptor::Process(const u8* data, std::size_t size) {
+    const std::size_t total = partial_size + size;
+    std::vector<u8> out;
+    out.reserve(total - total % AES_BLOCK_SIZE);
+
+    if (partial_size > 0) {
+        const std::size_t fill = std::min(AES_BLOCK_SIZE - partial_size, size);
+        std::memcpy(partial_block.data() + partial_size, data, fill);
+        partial_size += fill;
+        data += fill;
+        size -= fill;
+        if (partial_size < AES_BLOCK_SIZE) {
+            return out;
+        }
+        out.insert(out.end(), partial_block.begin(), partial_block.end());
+        partial_size = 0;
+    }
+
+    const std::size_t whole = size - size % AES_BLOCK_SIZE;
+    out.insert(out.end(), data, data + whole);
+    partial_size = size - whole;
+    std::memcpy(partial_block.data(), data + whole, partial_size);
+
+    DecryptCBC(key, iv, out.data(), out.size());
+    return out;
+}
+
+std::vector<u8> CBCStreamDecryptor::TakeRemainder() {
+    std::vector<u8> remainder(partial_block.begin(), partial_block.begin() + partial_size);
+    partial_size = 0;
+    return remainder;
+}
+
+} // namespace HW::AES
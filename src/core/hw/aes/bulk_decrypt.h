@@ -0,0 +1,67 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "common/common_types.h"
+#include "core/hw/aes/key.h"
+
+namespace HW::AES {
+
+/**
+ * Decrypts AES-128-CTR data in place. Large buffers are split into chunks that are decrypted in
+ * parallel, each one with a counter computed from its position in the stream.
+ * @param key The key to decrypt with
+ * @param ctr The counter at the start of the stream
+ * @param stream_offset Byte offset of `data` from the start of the stream
+ * @param data The data to decrypt
+ * @param size Size of `data` in bytes
+ */
+void DecryptCTR(const AESKey& key, const AESKey& ctr, u64 stream_offset, u8* data,
+                std::size_t size);
+
+/**
+ * Decrypts AES-128-CBC data in place. Unlike encryption, CBC decryption of a block only depends on
+ * the ciphertext, so large buffers are decrypted in parallel chunks as well.
+ * @param key The key to decrypt with
+ * @param iv The IV, or the last ciphertext block when continuing a stream. It is updated to the
+ *           last ciphertext block of `data`, so that the next call continues where this one ended.
+ * @param data The data to decrypt
+ * @param size Size of `data` in bytes, which must be a multiple of AES_BLOCK_SIZE
+ */
+void DecryptCBC(const AESKey& key, AESKey& iv, u8* data, std::size_t size);
+
+/**
+ * Decrypts an AES-128-CBC stream that is received in pieces of any size, such as a CIA written by
+ * the guest. Bytes that do not complete a block are held back until the rest of the block arrives.
+ */
+class CBCStreamDecryptor {
+public:
+    CBCStreamDecryptor() = default;
+    CBCStreamDecryptor(const AESKey& key, const AESKey& iv);
+
+    /**
+     * Decrypts the next piece of the stream.
+     * @param data The next piece of ciphertext
+     * @param size Size of `data` in bytes
+     * @returns The plaintext of the blocks completed by this piece, including the bytes held back
+     *          from earlier pieces.
+     */
+    std::vector<u8> Process(const u8* data, std::size_t size);
+
+    /// Returns the ciphertext held back so far and forgets it. It is not a whole block.
+    std::vector<u8> TakeRemainder();
+
+private:
+    AESKey key{};
+    /// The IV, or the last ciphertext block once the first block has been decrypted
+    AESKey iv{};
+    std::array<u8, AES_BLOCK_SIZE> partial_block{};
+    std::size_t partial_size = 0;
+};
+
+} // namespace HW::AES
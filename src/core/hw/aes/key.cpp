@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <cryptopp/aes.h>
@@ -87,6 +88,9 @@ struct KeySlot {
     }
 };
 
+// Keys are set up on the emulation thread, but titles can be loaded on others (e.g. by the game
+// list). Loading the keys opens NCCH archives, which may come back here, so the lock is recursive.
+std::recursive_mutex key_mutex;
 std::array<KeySlot, KeySlotID::MaxKeySlotID> key_slots;
 std::array<std::optional<AESKey>, 6> common_key_y_slots;
 
@@ -495,6 +499,7 @@ void LoadPresetKeys() {
 } // namespace
 
 void InitKeys() {
+    std::lock_guard lock{key_mutex};
     static bool initialized = false;
     if (initialized)
         return;
@@ -508,26 +513,42 @@ void InitKeys() {
 }
 
 void SetKeyX(std::size_t slot_id, const AESKey& key) {
+    std::lock_guard lock{key_mutex};
     key_slots.at(slot_id).SetKeyX(key);
 }
 
 void SetKeyY(std::size_t slot_id, const AESKey& key) {
+    std::lock_guard lock{key_mutex};
     key_slots.at(slot_id).SetKeyY(key);
 }
 
 void SetNormalKey(std::size_t slot_id, const AESKey& key) {
+    std::lock_guard lock{key_mutex};
     key_slots.at(slot_id).SetNormalKey(key);
 }
 
 bool IsNormalKeyAvailable(std::size_t slot_id) {
+    std::lock_guard lock{key_mutex};
     return key_slots.at(slot_id).normal.has_value();
 }
 
 AESKey GetNormalKey(std::size_t slot_id) {
+    std::lock_guard lock{key_mutex};
     return key_slots.at(slot_id).normal.value_or(AESKey{});
 }
 
+std::optional<AESKey> DeriveNormalKey(std::size_t slot_id, const AESKey& key_y) {
+    KeySlot slot;
+    {
+        std::lock_guard lock{key_mutex};
+        slot = key_slots.at(slot_id);
+    }
+    slot.SetKeyY(key_y);
+    return slot.normal;
+}
+
 void SelectCommonKeyIndex(u8 index) {
+    std::lock_guard lock{key_mutex};
     key_slots[KeySlotID::TicketCommonKey].SetKeyY(common_key_y_slots.at(index));
 }
 
@@ -6,6 +6,7 @@
 
 #include <array>
 #include <cstddef>
+#include <optional>
 #include "common/common_types.h"
 
 namespace HW::AES {
@@ -62,6 +63,12 @@ void SetNormalKey(std::size_t slot_id, const AESKey& key);
 bool IsNormalKeyAvailable(std::size_t slot_id);
 AESKey GetNormalKey(std::size_t slot_id);
 
+/**
+ * Derives the normal key a key slot would have with the given KeyY, without changing the slot, so
+ * that it can be used from any thread. Returns nothing if the slot has no KeyX.
+ */
+std::optional<AESKey> DeriveNormalKey(std::size_t slot_id, const AESKey& key_y);
+
 void SelectCommonKeyIndex(u8 index);
 
 } // namespace HW::AES
@@ -0,0 +1,72 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include "core/hw/async_work.h"
+#include "core/memory.h"
+
+namespace GPU {
+
+AsyncWork::AsyncWork(MarkPageFunc mark_page) : mark_page(std::move(mark_page)) {}
+
+void AsyncWork::Queue(u64 fence, const std::vector<Region>& regions) {
+    for (const Region& region : regions) {
+        if (region.size == 0) {
+            continue;
+        }
+        const PAddr start = region.start;
+        const PAddr end = start + region.size;
+        MarkPages(start, end, true);
+        writes.push_back({fence, start, end});
+    }
+    last_queued = fence;
+}
+
+void AsyncWork::Complete(u64 fence) {
+    fence = std::min(fence, last_queued);
+    // Work completes in order, so the writes of completed work are at the front
+    auto it = writes.begin();
+    while (it != writes.end() && it->fence <= fence) {
+        const Write write = *it;
+        it = writes.erase(it);
+        MarkPages(write.start, write.end, false);
+    }
+    last_completed = std::max(last_completed, fence);
+}
+
+void AsyncWork::HoldInterrupt(u64 fence, Service::GSP::InterruptId interrupt_id) {
+    std::lock_guard lock{interrupts_mutex};
+    interrupts.emplace_back(fence, interrupt_id);
+}
+
+std::vector<Service::GSP::InterruptId> AsyncWork::TakeInterrupts(u64 fence) {
+    std::vector<Service::GSP::InterruptId> taken;
+    std::lock_guard lock{interrupts_mutex};
+    while (!interrupts.empty() && interrupts.front().first <= fence) {
+        taken.push_back(interrupts.front().second);
+        interrupts.pop_front();
+    }
+    return taken;
+}
+
+void AsyncWork::Clear() {
+    writes.clear();
+    last_queued = 0;
+    last_completed = 0;
+    std::lock_guard lock{interrupts_mutex};
+    interrupts.clear();
+}
+
+void AsyncWork::MarkPages(PAddr start, PAddr end, bool cached) {
+    for (PAddr page = start & ~Memory::PAGE_MASK; page < end; page += Memory::PAGE_SIZE) {
+        const bool shared = std::any_of(writes.begin(), writes.end(), [page](const Write& write) {
+            return write.start < page + Memory::PAGE_SIZE && write.end > page;
+        });
+        if (!shared) {
+            mark_page(page, cached);
+        }
+    }
+}
+
+} // namespace GPU
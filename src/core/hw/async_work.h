@@ -0,0 +1,98 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <boost/serialization/deque.hpp>
+#include <boost/serialization/utility.hpp>
+#include "common/common_types.h"
+
+namespace Service::GSP {
+enum class InterruptId : u8;
+}
+
+namespace GPU {
+
+/**
+ * Keeps track of the work queued on the GPU thread until the emulation thread sees it complete.
+ * The pages the work writes are marked as cached, like the surfaces of the hardware renderer, so
+ * that the memory hooks wait for the work before the CPU accesses them. The interrupts the work
+ * raises are held back, so that they are signalled at a point in emulated time rather than
+ * whenever the GPU thread gets to them.
+ */
+class AsyncWork {
+public:
+    /// Marks or unmarks a page of physical memory as cached
+    using MarkPageFunc = std::function<void(PAddr page, bool cached)>;
+
+    /// A region of physical memory that queued work writes.
+    struct Region {
+        PAddr start;
+        u32 size;
+    };
+
+    explicit AsyncWork(MarkPageFunc mark_page);
+
+    /// Whether work was queued that has not been completed yet. Emulation thread only.
+    bool Busy() const {
+        return last_completed < last_queued;
+    }
+
+    /**
+     * Records work queued with the given fence, and marks the pages of the regions it writes as
+     * cached. Fences increase with every piece of work. Emulation thread only.
+     */
+    void Queue(u64 fence, const std::vector<Region>& writes);
+
+    /**
+     * Forgets the work up to the given fence, which has completed, and unmarks the pages that no
+     * later work writes. Emulation thread only.
+     */
+    void Complete(u64 fence);
+
+    /// Holds back an interrupt raised by the work with the given fence. Any thread.
+    void HoldInterrupt(u64 fence, Service::GSP::InterruptId interrupt_id);
+
+    /**
+     * Returns the held interrupts raised by the work up to the given fence in the order they were
+     * raised, and forgets them. Any thread.
+     */
+    std::vector<Service::GSP::InterruptId> TakeInterrupts(u64 fence);
+
+    /// Forgets all work and interrupts without unmarking any pages.
+    void Clear();
+
+private:
+    struct Write {
+        u64 fence;
+        PAddr start;
+        PAddr end;
+    };
+
+    /// Marks or unmarks the pages of [start, end) that no recorded write is on.
+    void MarkPages(PAddr start, PAddr end, bool cached);
+
+    MarkPageFunc mark_page;
+    std::vector<Write> writes;
+    u64 last_queued = 0;
+    u64 last_completed = 0;
+
+    std::mutex interrupts_mutex;
+    std::deque<std::pair<u64, Service::GSP::InterruptId>> interrupts;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        // Saved once the GPU thread is idle, so only the held interrupts are left
+        std::lock_guard lock{interrupts_mutex};
+        ar& interrupts;
+    }
+    friend class boost::serialization::access;
+};
+
+} // namespace GPU
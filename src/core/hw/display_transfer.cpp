@@ -0,0 +1,566 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstring>
+#include "common/color.h"
+#include "common/logging/log.h"
+#include "common/swap.h"
+#include "common/vector_math.h"
+#include "core/hw/display_transfer.h"
+#include "video_core/utils.h"
+
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
+namespace GPU {
+
+namespace {
+
+using ScalingMode = Regs::DisplayTransferConfig::ScalingMode;
+
+// The tiled path converts pixels through RGBA8 packed into a u32 as r | g << 8 | b << 16 | a << 24.
+// Decoders and encoders are called on whole rows of a tile or on whole tiles, so counts are always
+// a multiple of 8.
+using DecodeFunc = void (*)(const u8* src, u32* dst, std::size_t count);
+using EncodeFunc = void (*)(const u32* src, u8* dst, std::size_t count);
+
+constexpr u32 Pack(const Common::Vec4<u8>& color) {
+    return color.r() | color.g() << 8 | color.b() << 16 | static_cast<u32>(color.a()) << 24;
+}
+
+constexpr Common::Vec4<u8> Unpack(u32 color) {
+    return {static_cast<u8>(color), static_cast<u8>(color >> 8), static_cast<u8>(color >> 16),
+            static_cast<u8>(color >> 24)};
+}
+
+#ifdef ARCHITECTURE_x86_64
+
+__m128i ByteSwap32(__m128i value) {
+    // Swap the halves of every word, then the bytes of every half
+    value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, 0xB1), 0xB1);
+    return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+
+/// Packs eight pixels, given as one 8-bit component per 16-bit lane, into dst.
+void StoreComponents(__m128i r, __m128i g, __m128i b, __m128i a, u32* dst) {
+    const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    const __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), _mm_unpackhi_epi16(rg, ba));
+}
+
+/// Narrows words holding 16-bit values to halfwords and stores them into dst.
+void Store16(__m128i lo, __m128i hi, u8* dst) {
+    // Sign-extend so that the saturating pack keeps every value as is
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(lo, hi));
+}
+
+#endif // ARCHITECTURE_x86_64
+
+void DecodeRGBA8(const u8* src, u32* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    for (; i < count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), ByteSwap32(pixels));
+    }
+#endif
+    for (; i < count; i++) {
+        u32 pixel;
+        std::memcpy(&pixel, src + 4 * i, sizeof(pixel));
+        dst[i] = Common::swap32(pixel);
+    }
+}
+
+void DecodeRGB8(const u8* src, u32* dst, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        dst[i] = src[3 * i + 2] | src[3 * i + 1] << 8 | src[3 * i] << 16 | 0xFF000000;
+    }
+}
+
+void DecodeRGB565(const u8* src, u32* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    for (; i < count; i += 8) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        const __m128i r = _mm_srli_epi16(pixels, 11);
+        const __m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 5), mask6);
+        const __m128i b = _mm_and_si128(pixels, mask5);
+        StoreComponents(_mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2)),
+                        _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4)),
+                        _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2)),
+                        _mm_set1_epi16(0xFF), dst + i);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = Pack(Color::DecodeRGB565(src + 2 * i));
+    }
+}
+
+void DecodeRGB5A1(const u8* src, u32* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    for (; i < count; i += 8) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        const __m128i r = _mm_srli_epi16(pixels, 11);
+        const __m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 6), mask5);
+        const __m128i b = _mm_and_si128(_mm_srli_epi16(pixels, 1), mask5);
+        const __m128i a = _mm_sub_epi16(_mm_setzero_si128(),
+                                        _mm_and_si128(pixels, _mm_set1_epi16(1)));
+        StoreComponents(_mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2)),
+                        _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2)),
+                        _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2)),
+                        _mm_srli_epi16(a, 8), dst + i);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = Pack(Color::DecodeRGB5A1(src + 2 * i));
+    }
+}
+
+void DecodeRGBA4(const u8* src, u32* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const __m128i mask4 = _mm_set1_epi16(0xF);
+    for (; i < count; i += 8) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        const __m128i r = _mm_srli_epi16(pixels, 12);
+        const __m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 8), mask4);
+        const __m128i b = _mm_and_si128(_mm_srli_epi16(pixels, 4), mask4);
+        const __m128i a = _mm_and_si128(pixels, mask4);
+        StoreComponents(_mm_or_si128(_mm_slli_epi16(r, 4), r),
+                        _mm_or_si128(_mm_slli_epi16(g, 4), g),
+                        _mm_or_si128(_mm_slli_epi16(b, 4), b),
+                        _mm_or_si128(_mm_slli_epi16(a, 4), a), dst + i);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = Pack(Color::DecodeRGBA4(src + 2 * i));
+    }
+}
+
+void EncodeRGBA8(const u32* src, u8* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    for (; i < count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), ByteSwap32(pixels));
+    }
+#endif
+    for (; i < count; i++) {
+        const u32 pixel = Common::swap32(src[i]);
+        std::memcpy(dst + 4 * i, &pixel, sizeof(pixel));
+    }
+}
+
+void EncodeRGB8(const u32* src, u8* dst, std::size_t count) {
+    const auto to_bgr = [](u32 color) -> u64 {
+        return (color >> 16 & 0xFF) | (color & 0xFF00) | (color & 0xFF) << 16;
+    };
+    // Two pixels per 8-byte store. The two bytes past them are overwritten by the next store.
+    std::size_t i = 0;
+    for (; i + 2 < count; i += 2) {
+        const u64 pixels = to_bgr(src[i]) | to_bgr(src[i + 1]) << 24;
+        std::memcpy(dst + 3 * i, &pixels, sizeof(pixels));
+    }
+    for (; i < count; i++) {
+        const u32 pixel = static_cast<u32>(to_bgr(src[i]));
+        std::memcpy(dst + 3 * i, &pixel, 3);
+    }
+}
+
+void EncodeRGB565(const u32* src, u8* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const auto encode = [](__m128i pixels) {
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        const __m128i r = _mm_and_si128(pixels, mask);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(r, 3), 11),
+                                         _mm_slli_epi32(_mm_srli_epi32(g, 2), 5)),
+                            _mm_srli_epi32(b, 3));
+    };
+    for (; i < count; i += 8) {
+        Store16(encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))),
+                encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4))),
+                dst + 2 * i);
+    }
+#endif
+    for (; i < count; i++) {
+        Color::EncodeRGB565(Unpack(src[i]), dst + 2 * i);
+    }
+}
+
+void EncodeRGB5A1(const u32* src, u8* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const auto encode = [](__m128i pixels) {
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        const __m128i r = _mm_and_si128(pixels, mask);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        const __m128i a = _mm_srli_epi32(pixels, 24);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(r, 3), 11),
+                                         _mm_slli_epi32(_mm_srli_epi32(g, 3), 6)),
+                            _mm_or_si128(_mm_slli_epi32(_mm_srli_epi32(b, 3), 1),
+                                         _mm_srli_epi32(a, 7)));
+    };
+    for (; i < count; i += 8) {
+        Store16(encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))),
+                encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4))),
+                dst + 2 * i);
+    }
+#endif
+    for (; i < count; i++) {
+        Color::EncodeRGB5A1(Unpack(src[i]), dst + 2 * i);
+    }
+}
+
+void EncodeRGBA4(const u32* src, u8* dst, std::size_t count) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const auto encode = [](__m128i pixels) {
+        // The top nibble of every component, moved into place
+        const __m128i mask = _mm_set1_epi32(0xF0);
+        const __m128i r = _mm_and_si128(pixels, mask);
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        const __m128i a = _mm_srli_epi32(pixels, 28);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 8), _mm_slli_epi32(g, 4)),
+                            _mm_or_si128(b, a));
+    };
+    for (; i < count; i += 8) {
+        Store16(encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))),
+                encode(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4))),
+                dst + 2 * i);
+    }
+#endif
+    for (; i < count; i++) {
+        Color::EncodeRGBA4(Unpack(src[i]), dst + 2 * i);
+    }
+}
+
+constexpr std::array<DecodeFunc, 5> decoders{DecodeRGBA8, DecodeRGB8, DecodeRGB565, DecodeRGB5A1,
+                                             DecodeRGBA4};
+constexpr std::array<EncodeFunc, 5> encoders{EncodeRGBA8, EncodeRGB8, EncodeRGB565, EncodeRGB5A1,
+                                             EncodeRGBA4};
+
+/// Averages two pixels component-wise, rounding down like the generic path.
+u32 Average2(u32 a, u32 b) {
+    const u32 even = ((a & 0x00FF00FF) + (b & 0x00FF00FF)) >> 1;
+    const u32 odd = ((a >> 8 & 0x00FF00FF) + (b >> 8 & 0x00FF00FF)) >> 1;
+    return (even & 0x00FF00FF) | (odd & 0x00FF00FF) << 8;
+}
+
+/// Averages four pixels component-wise, rounding down like the generic path.
+u32 Average4(u32 a, u32 b, u32 c, u32 d) {
+    const u32 even =
+        ((a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF)) >> 2;
+    const u32 odd = ((a >> 8 & 0x00FF00FF) + (b >> 8 & 0x00FF00FF) + (c >> 8 & 0x00FF00FF) +
+                     (d >> 8 & 0x00FF00FF)) >>
+                    2;
+    return (even & 0x00FF00FF) | (odd & 0x00FF00FF) << 8;
+}
+
+/**
+ * For every pixel of an output tile, in row-major order, the index of the first input pixel it is
+ * made of. Input tiles are decoded one after the other: the tile itself, the two side by side when
+ * scaling horizontally, or the 2x2 tiles when scaling both ways. The other input pixels of an
+ * output pixel follow the first one, as they are next to it in Morton order.
+ */
+constexpr std::array<u8, 64> MakeSourceTable(ScalingMode scaling) {
+    std::array<u8, 64> table{};
+    for (u32 y = 0; y < 8; y++) {
+        for (u32 x = 0; x < 8; x++) {
+            u32 index = 0;
+            switch (scaling) {
+            case ScalingMode::NoScale:
+                index = VideoCore::MortonInterleave(x, y);
+                break;
+            case ScalingMode::ScaleX:
+                index = x / 4 * 64 + VideoCore::MortonInterleave(2 * x % 8, y);
+                break;
+            case ScalingMode::ScaleXY:
+                index = (x / 4 + y / 4 * 2) * 64 +
+                        VideoCore::MortonInterleave(2 * x % 8, 2 * y % 8);
+                break;
+            }
+            table[x + y * 8] = static_cast<u8>(index);
+        }
+    }
+    return table;
+}
+
+template <bool tiled_input, bool tiled_output, ScalingMode scaling>
+void TransferTiles(const Regs::DisplayTransferConfig& config, const u8* src, u8* dst) {
+    constexpr u32 horizontal_scale = scaling != ScalingMode::NoScale ? 1 : 0;
+    constexpr u32 vertical_scale = scaling == ScalingMode::ScaleXY ? 1 : 0;
+    constexpr std::size_t num_input_tiles = 1 << (horizontal_scale + vertical_scale);
+    constexpr std::array<u8, 64> source_table = MakeSourceTable(scaling);
+    constexpr std::array<u8, 64> morton_table = MakeSourceTable(ScalingMode::NoScale);
+
+    const DecodeFunc decode = decoders[static_cast<std::size_t>(config.input_format.Value())];
+    const EncodeFunc encode = encoders[static_cast<std::size_t>(config.output_format.Value())];
+    const u32 input_bpp = Regs::BytesPerPixel(config.input_format);
+    const u32 output_bpp = Regs::BytesPerPixel(config.output_format);
+    const u32 input_width = config.input_width;
+    const u32 output_width = config.output_width >> horizontal_scale;
+    const u32 output_height = config.output_height >> vertical_scale;
+    const bool flip = config.flip_vertically;
+
+    std::array<u32, 64 * num_input_tiles> decoded;
+    std::array<u32, 64> tile;
+    std::array<u32, 64> swizzled;
+
+    for (u32 tile_y = 0; tile_y < output_height; tile_y += 8) {
+        // First output row of the tile once flipped, which reverses the rows within the tile
+        const u32 output_y = flip ? output_height - 8 - tile_y : tile_y;
+
+        for (u32 tile_x = 0; tile_x < output_width; tile_x += 8) {
+            if constexpr (tiled_input) {
+                const u32 input_x = tile_x << horizontal_scale;
+                const u32 input_y = tile_y << vertical_scale;
+                for (std::size_t i = 0; i < num_input_tiles; i++) {
+                    const u32 x = input_x + static_cast<u32>(i % 2) * 8;
+                    const u32 y = input_y + static_cast<u32>(i / 2) * 8;
+                    decode(src + (x * 8 + y * input_width) * input_bpp, &decoded[i * 64], 64);
+                }
+                for (std::size_t i = 0; i < 64; i++) {
+                    const u32* pixels = &decoded[source_table[i]];
+                    if constexpr (scaling == ScalingMode::NoScale) {
+                        tile[i] = pixels[0];
+                    } else if constexpr (scaling == ScalingMode::ScaleX) {
+                        tile[i] = Average2(pixels[0], pixels[1]);
+                    } else {
+                        tile[i] = Average4(pixels[0], pixels[1], pixels[2], pixels[3]);
+                    }
+                }
+            } else {
+                for (u32 y = 0; y < 8; y++) {
+                    decode(src + ((tile_y + y) * input_width + tile_x) * input_bpp, &tile[y * 8],
+                           8);
+                }
+            }
+
+            if constexpr (tiled_output) {
+                for (u32 y = 0; y < 8; y++) {
+                    const u32 row = flip ? 7 - y : y;
+                    for (u32 x = 0; x < 8; x++) {
+                        swizzled[morton_table[x + row * 8]] = tile[x + y * 8];
+                    }
+                }
+                encode(swizzled.data(), dst + (tile_x * 8 + output_y * output_width) * output_bpp,
+                       64);
+            } else {
+                for (u32 y = 0; y < 8; y++) {
+                    const u32 row = output_y + (flip ? 7 - y : y);
+                    encode(&tile[y * 8], dst + (row * output_width + tile_x) * output_bpp, 8);
+                }
+            }
+        }
+    }
+}
+
+using TransferFunc = void (*)(const Regs::DisplayTransferConfig&, const u8*, u8*);
+
+/// Kernels for tiled input, by whether the output is tiled too and by scaling mode
+constexpr std::array<std::array<TransferFunc, 3>, 2> tiled_input_kernels{{
+    {TransferTiles<true, false, ScalingMode::NoScale>,
+     TransferTiles<true, false, ScalingMode::ScaleX>,
+     TransferTiles<true, false, ScalingMode::ScaleXY>},
+    {TransferTiles<true, true, ScalingMode::NoScale>,
+     TransferTiles<true, true, ScalingMode::ScaleX>,
+     TransferTiles<true, true, ScalingMode::ScaleXY>},
+}};
+
+Common::Vec4<u8> DecodePixel(Regs::PixelFormat input_format, const u8* src_pixel) {
+    switch (input_format) {
+    case Regs::PixelFormat::RGBA8:
+        return Color::DecodeRGBA8(src_pixel);
+
+    case Regs::PixelFormat::RGB8:
+        return Color::DecodeRGB8(src_pixel);
+
+    case Regs::PixelFormat::RGB565:
+        return Color::DecodeRGB565(src_pixel);
+
+    case Regs::PixelFormat::RGB5A1:
+        return Color::DecodeRGB5A1(src_pixel);
+
+    case Regs::PixelFormat::RGBA4:
+        return Color::DecodeRGBA4(src_pixel);
+
+    default:
+        LOG_ERROR(HW_GPU, "Unknown source framebuffer format {:x}",
+                  static_cast<u32>(input_format));
+        return {0, 0, 0, 0};
+    }
+}
+
+} // Anonymous namespace
+
+void PerformDisplayTransfer(const Regs::DisplayTransferConfig& config, const u8* src, u8* dst) {
+    if (!PerformDisplayTransferTiled(config, src, dst)) {
+        PerformDisplayTransferGeneric(config, src, dst);
+    }
+}
+
+bool PerformDisplayTransferTiled(const Regs::DisplayTransferConfig& config, const u8* src,
+                                 u8* dst) {
+    const auto input_format = static_cast<std::size_t>(config.input_format.Value());
+    const auto output_format = static_cast<std::size_t>(config.output_format.Value());
+    if (input_format >= decoders.size() || output_format >= encoders.size() ||
+        config.scaling > ScalingMode::ScaleXY ||
+        (config.input_linear && config.scaling != ScalingMode::NoScale)) {
+        return false;
+    }
+
+    const u32 horizontal_scale = config.scaling != ScalingMode::NoScale ? 1 : 0;
+    const u32 vertical_scale = config.scaling == ScalingMode::ScaleXY ? 1 : 0;
+    const u32 output_width = config.output_width >> horizontal_scale;
+    const u32 output_height = config.output_height >> vertical_scale;
+    if (output_width == 0 || output_height == 0 || output_width % 8 != 0 ||
+        output_height % 8 != 0) {
+        return false;
+    }
+
+    const bool tiled_output = config.input_linear != config.dont_swizzle;
+    if (config.input_linear) {
+        if (tiled_output) {
+            TransferTiles<false, true, ScalingMode::NoScale>(config, src, dst);
+        } else {
+            TransferTiles<false, false, ScalingMode::NoScale>(config, src, dst);
+        }
+    } else {
+        tiled_input_kernels[tiled_output][config.scaling](config, src, dst);
+    }
+    return true;
+}
+
+void PerformDisplayTransferGeneric(const Regs::DisplayTransferConfig& config, const u8* src,
+                                   u8* dst) {
+    int horizontal_scale = config.scaling != config.NoScale ? 1 : 0;
+    int vertical_scale = config.scaling == config.ScaleXY ? 1 : 0;
+
+    u32 output_width = config.output_width >> horizontal_scale;
+    u32 output_height = config.output_height >> vertical_scale;
+
+    for (u32 y = 0; y < output_height; ++y) {
+        for (u32 x = 0; x < output_width; ++x) {
+            Common::Vec4<u8> src_color;
+
+            // Calculate the [x,y] position of the input image
+            // based on the current output position and the scale
+            u32 input_x = x << horizontal_scale;
+            u32 input_y = y << vertical_scale;
+
+            u32 output_y;
+            if (config.flip_vertically) {
+                // Flip the y value of the output data,
+                // we do this after calculating the [x,y] position of the input image
+                // to account for the scaling options.
+                output_y = output_height - y - 1;
+            } else {
+                output_y = y;
+            }
+
+            u32 dst_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.output_format);
+            u32 src_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.input_format);
+            u32 src_offset;
+            u32 dst_offset;
+
+            if (config.input_linear) {
+                if (!config.dont_swizzle) {
+                    // Interpret the input as linear and the output as tiled
+                    u32 coarse_y = output_y & ~7;
+                    u32 stride = output_width * dst_bytes_per_pixel;
+
+                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
+                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
+                                 coarse_y * stride;
+                } else {
+                    // Both input and output are linear
+                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
+                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
+                }
+            } else {
+                if (!config.dont_swizzle) {
+                    // Interpret the input as tiled and the output as linear
+                    u32 coarse_y = input_y & ~7;
+                    u32 stride = config.input_width * src_bytes_per_pixel;
+
+                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
+                                 coarse_y * stride;
+                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
+                } else {
+                    // Both input and output are tiled
+                    u32 out_coarse_y = output_y & ~7;
+                    u32 out_stride = output_width * dst_bytes_per_pixel;
+
+                    u32 in_coarse_y = input_y & ~7;
+                    u32 in_stride = config.input_width * src_bytes_per_pixel;
+
+                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
+                                 in_coarse_y * in_stride;
+                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
+                                 out_coarse_y * out_stride;
+                }
+            }
+
+            const u8* src_pixel = src + src_offset;
+            src_color = DecodePixel(config.input_format, src_pixel);
+            if (config.scaling == config.ScaleX) {
+                Common::Vec4<u8> pixel =
+                    DecodePixel(config.input_format, src_pixel + src_bytes_per_pixel);
+                src_color = ((src_color + pixel) / 2).Cast<u8>();
+            } else if (config.scaling == config.ScaleXY) {
+                Common::Vec4<u8> pixel1 =
+                    DecodePixel(config.input_format, src_pixel + 1 * src_bytes_per_pixel);
+                Common::Vec4<u8> pixel2 =
+                    DecodePixel(config.input_format, src_pixel + 2 * src_bytes_per_pixel);
+                Common::Vec4<u8> pixel3 =
+                    DecodePixel(config.input_format, src_pixel + 3 * src_bytes_per_pixel);
+                src_color = (((src_color + pixel1) + (pixel2 + pixel3)) / 4).Cast<u8>();
+            }
+
+            u8* dst_pixel = dst + dst_offset;
+            switch (config.output_format) {
+            case Regs::PixelFormat::RGBA8:
+                Color::EncodeRGBA8(src_color, dst_pixel);
+                break;
+
+            case Regs::PixelFormat::RGB8:
+                Color::EncodeRGB8(src_color, dst_pixel);
+                break;
+
+            case Regs::PixelFormat::RGB565:
+                Color::EncodeRGB565(src_color, dst_pixel);
+                break;
+
+            case Regs::PixelFormat::RGB5A1:
+                Color::EncodeRGB5A1(src_color, dst_pixel);
+                break;
+
+            case Regs::PixelFormat::RGBA4:
+                Color::EncodeRGBA4(src_color, dst_pixel);
+                break;
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown destination framebuffer format {:x}",
+                          static_cast<u32>(config.output_format.Value()));
+                break;
+            }
+        }
+    }
+}
+
+} // namespace GPU
@@ -0,0 +1,30 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "common/common_types.h"
+#include "core/hw/gpu.h"
+
+namespace GPU {
+
+/**
+ * Converts the pixels of a display transfer from src to dst. The configuration must already have
+ * been validated: non-zero sizes, known formats, and scaling only with tiled input.
+ */
+void PerformDisplayTransfer(const Regs::DisplayTransferConfig& config, const u8* src, u8* dst);
+
+/**
+ * Converts a display transfer an 8x8 tile at a time, with the format conversions done on whole
+ * rows or tiles. Handles every transfer whose output is made of whole tiles.
+ * @return false if the transfer is not supported, in which case nothing was written
+ */
+bool PerformDisplayTransferTiled(const Regs::DisplayTransferConfig& config, const u8* src,
+                                 u8* dst);
+
+/// Converts a display transfer pixel by pixel. Handles any transfer.
+void PerformDisplayTransferGeneric(const Regs::DisplayTransferConfig& config, const u8* src,
+                                   u8* dst);
+
+} // namespace GPU
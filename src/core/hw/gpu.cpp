@@ -2,27 +2,36 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
+#include <limits>
 #include <numeric>
+#include <optional>
 #include <type_traits>
+#include <vector>
 #include "common/alignment.h"
-#include "common/color.h"
+#include "common/archives.h"
 #include "common/common_types.h"
 #include "common/logging/log.h"
 #include "common/microprofile.h"
-#include "common/vector_math.h"
 #include "core/core.h"
 #include "core/core_timing.h"
 #include "core/hle/service/gsp/gsp.h"
+#include "core/hw/async_work.h"
+#include "core/hw/display_transfer.h"
 #include "core/hw/gpu.h"
 #include "core/hw/hw.h"
+#include "core/hw/memory_fill.h"
 #include "core/memory.h"
 #include "core/tracer/recorder.h"
+#include "video_core/command_list_cache.h"
 #include "video_core/command_processor.h"
 #include "video_core/debug_utils/debug_utils.h"
+#include "video_core/gpu_thread.h"
+#include "video_core/pica_state.h"
 #include "video_core/rasterizer_interface.h"
 #include "video_core/renderer_base.h"
-#include "video_core/utils.h"
 #include "video_core/video_core.h"
 
 namespace GPU {
@@ -32,42 +41,206 @@ Memory::MemorySystem* g_memory;
 
 /// Event id for CoreTiming
 static Core::TimingEventType* vblank_event;
+static Core::TimingEventType* async_interrupt_event;
+
+/**
+ * Emulated time between queuing work on the GPU thread and signalling the interrupts it raised.
+ * The CPU keeps running in the meantime; a game that waits for the interrupt idles the CPU, so
+ * the wait is skipped ahead to straight away.
+ */
+constexpr u64 async_interrupt_delay = BASE_CLOCK_RATE_ARM11 / 1000;
+
+/**
+ * Memory fills of the software path that have not been written to memory yet. Fills are only
+ * deferred without a GPU thread, so this is only used on the emulation thread.
+ */
+static DeferredMemoryFills pending_fills{
+    [](PAddr address) { return g_memory->GetPhysicalPointer(address); },
+    [](PAddr page, bool cached) {
+        g_memory->RasterizerMarkRegionCached(page, Memory::PAGE_SIZE, cached);
+    }};
+
+/// Work queued on the GPU thread, the memory it writes and the interrupts it raised
+static AsyncWork async_work{[](PAddr page, bool cached) {
+    g_memory->RasterizerMarkRegionCached(page, Memory::PAGE_SIZE, cached);
+}};
+
+/**
+ * The framebuffer registers as the command lists queued on the GPU thread leave them, which is
+ * where the lists after them draw to. Only valid while work is queued.
+ */
+static Pica::FramebufferRegs::FramebufferConfig queued_framebuffer;
+
+/// Whether GPU work is queued on the GPU thread rather than run right away.
+static bool UseGPUThread() {
+    // The OpenGL context belongs to the emulation thread, and the tracer records memory accesses
+    // and register writes in order.
+    return VideoCore::g_gpu_thread && !VideoCore::g_hw_renderer_enabled &&
+           !(Pica::g_debug_context && Pica::g_debug_context->recorder);
+}
 
-template <typename T>
-inline void Read(T& var, const u32 raw_addr) {
-    u32 addr = raw_addr - HW::VADDR_GPU;
-    u32 index = addr / 4;
+/**
+ * Runs GPU work on the GPU thread if it is in use, or on the calling thread otherwise.
+ * @param writes Memory the work writes, which the CPU must not access until it has completed, or
+ *               std::nullopt if that is not known ahead of time and the work has to run right away
+ */
+static void RunGPUWork(std::optional<std::vector<AsyncWork::Region>> writes,
+                       std::function<void()> work) {
+    if (!UseGPUThread() || !writes) {
+        // Work that was queued before switching renderers still goes first
+        WaitIdle();
+        if (VideoCore::g_hw_renderer_enabled) {
+            // The hardware renderer marks the pages of its surfaces as cached too
+            FlushAllPendingFills();
+        }
+        work();
+        return;
+    }
+    const u64 fence = VideoCore::g_gpu_thread->Submit(std::move(work));
+    async_work.Queue(fence, *writes);
+    Core::System::GetInstance().CoreTiming().ScheduleEvent(async_interrupt_delay,
+                                                           async_interrupt_event, fence);
+}
 
-    // Reads other than u32 are untested, so I'd rather have them abort than silently fail
-    if (index >= Regs::NumIds() || !std::is_same<T, u32>::value) {
-        LOG_ERROR(HW_GPU, "unknown Read{} @ {:#010X}", sizeof(var) * 8, addr);
+/**
+ * Returns the color and depth buffers a command list may draw to, or std::nullopt if the list
+ * can't be decoded ahead of time or jumps to another command buffer.
+ */
+static std::optional<std::vector<AsyncWork::Region>> GetCommandListWrites(PAddr address,
+                                                                          u32 size) {
+    static std::vector<Pica::CommandProcessor::DecodedCommand> commands;
+    const u32* list = reinterpret_cast<const u32*>(g_memory->GetPhysicalPointer(address));
+    if (list == nullptr || !Pica::CommandProcessor::DecodeCommandList(list, size / sizeof(u32),
+                                                                      commands)) {
+        return std::nullopt;
+    }
+    if (!commands.empty() && Pica::CommandProcessor::IsCommandBufferJump(commands.back().id)) {
+        return std::nullopt;
+    }
+
+    if (!async_work.Busy()) {
+        // Nothing is queued that could change the registers
+        queued_framebuffer = Pica::g_state.regs.framebuffer.framebuffer;
+    }
+
+    std::vector<AsyncWork::Region> writes;
+    const auto add_buffers = [&writes] {
+        // Up to four bytes per pixel, whatever the formats
+        const u32 size = queued_framebuffer.GetWidth() * queued_framebuffer.GetHeight() * 4;
+        writes.push_back({queued_framebuffer.GetColorBufferPhysicalAddress(), size});
+        writes.push_back({queued_framebuffer.GetDepthBufferPhysicalAddress(), size});
+    };
+    add_buffers();
+
+    constexpr u32 first_id = PICA_REG_INDEX(framebuffer.framebuffer);
+    constexpr u32 num_ids = sizeof(queued_framebuffer) / sizeof(u32);
+    for (const auto& command : commands) {
+        if (command.id < first_id || command.id >= first_id + num_ids) {
+            continue;
+        }
+        u32& reg = reinterpret_cast<u32*>(&queued_framebuffer)[command.id - first_id];
+        const u32 write_mask = Pica::CommandProcessor::expand_bits_to_bytes[command.mask];
+        reg = (reg & ~write_mask) | (command.value & write_mask);
+        add_buffers();
+    }
+    return writes;
+}
+
+/// Returns the memory a display transfer or texture copy writes.
+static AsyncWork::Region GetTransferOutput(const Regs::DisplayTransferConfig& config) {
+    const PAddr address = config.GetPhysicalOutputAddress();
+    if (config.is_texture_copy) {
+        const u32 size = config.texture_copy.size;
+        const u32 width = config.texture_copy.output_width * 16;
+        const u32 gap = config.texture_copy.output_gap * 16;
+        if (width == 0 || gap == 0) {
+            return {address, size};
+        }
+        const u32 lines = (size + width - 1) / width;
+        return {address, lines * (width + gap)};
+    }
+    // Up to four bytes per pixel, whatever the format
+    return {address, config.output_width * config.output_height * 4};
+}
+
+/// Signals the interrupts raised by the work up to `fence`, once that work has completed.
+static void SignalAsyncInterrupts(u64 fence) {
+    if (VideoCore::g_gpu_thread) {
+        VideoCore::g_gpu_thread->WaitFor(fence);
+    }
+    async_work.Complete(fence);
+    for (const auto interrupt_id : async_work.TakeInterrupts(fence)) {
+        Service::GSP::SignalInterrupt(interrupt_id);
+    }
+}
+
+static void AsyncInterruptCallback(u64 fence, s64 cycles_late) {
+    SignalAsyncInterrupts(fence);
+}
+
+void SignalInterrupt(Service::GSP::InterruptId interrupt_id) {
+    if (VideoCore::g_gpu_thread && VideoCore::g_gpu_thread->IsGPUThread()) {
+        async_work.HoldInterrupt(VideoCore::g_gpu_thread->GetCurrentFence(), interrupt_id);
         return;
     }
+    Service::GSP::SignalInterrupt(interrupt_id);
+}
 
-    var = g_regs[addr / 4];
+/// Whether a memory fill over [start, end) can be recorded rather than written right away.
+static bool CanDeferFill(PAddr start, PAddr end) {
+    // The tracer records memory as it is written
+    if (VideoCore::g_gpu_thread || VideoCore::g_hw_renderer_enabled ||
+        (Pica::g_debug_context && Pica::g_debug_context->recorder)) {
+        return false;
+    }
+    // Only VRAM, like the surfaces of the hardware renderer. The DSP, the audio decoders and HLE
+    // services access FCRAM through raw pointers that bypass the memory hooks.
+    return start >= Memory::VRAM_PADDR && end <= Memory::VRAM_PADDR_END;
 }
 
-static Common::Vec4<u8> DecodePixel(Regs::PixelFormat input_format, const u8* src_pixel) {
-    switch (input_format) {
-    case Regs::PixelFormat::RGBA8:
-        return Color::DecodeRGBA8(src_pixel);
+void FlushPendingFills(PAddr start, u32 size) {
+    if (!pending_fills.Empty()) {
+        pending_fills.Flush(start, start + size);
+    }
+}
 
-    case Regs::PixelFormat::RGB8:
-        return Color::DecodeRGB8(src_pixel);
+void InvalidatePendingFills(PAddr start, u32 size) {
+    if (!pending_fills.Empty()) {
+        pending_fills.Invalidate(start, start + size);
+    }
+}
 
-    case Regs::PixelFormat::RGB565:
-        return Color::DecodeRGB565(src_pixel);
+void FlushAllPendingFills() {
+    if (!pending_fills.Empty()) {
+        pending_fills.FlushAll();
+    }
+}
 
-    case Regs::PixelFormat::RGB5A1:
-        return Color::DecodeRGB5A1(src_pixel);
+void WaitIdle() {
+    // Work running on the GPU thread does not wait for itself, and the pages belong to the
+    // emulation thread.
+    if (VideoCore::g_gpu_thread && !VideoCore::g_gpu_thread->IsGPUThread()) {
+        VideoCore::g_gpu_thread->WaitForIdle();
+        async_work.Complete(std::numeric_limits<u64>::max());
+    }
+}
 
-    case Regs::PixelFormat::RGBA4:
-        return Color::DecodeRGBA4(src_pixel);
+template <typename T>
+inline void Read(T& var, const u32 raw_addr) {
+    u32 addr = raw_addr - HW::VADDR_GPU;
+    u32 index = addr / 4;
 
-    default:
-        LOG_ERROR(HW_GPU, "Unknown source framebuffer format {:x}", input_format);
-        return {0, 0, 0, 0};
+    // Reads other than u32 are untested, so I'd rather have them abort than silently fail
+    if (index >= Regs::NumIds() || !std::is_same<T, u32>::value) {
+        LOG_ERROR(HW_GPU, "unknown Read{} @ {:#010X}", sizeof(var) * 8, addr);
+        return;
     }
+
+    // The registers tell whether fills and transfers are done, which they only should be once
+    // their results can be seen.
+    WaitIdle();
+
+    var = g_regs[addr / 4];
 }
 
 MICROPROFILE_DEFINE(GPU_DisplayTransfer, "GPU", "DisplayTransfer", MP_RGB(100, 100, 255));
@@ -94,36 +267,18 @@ static void MemoryFill(const Regs::MemoryFillConfig& config) {
         return;
     }
 
-    u8* start = g_memory->GetPhysicalPointer(start_addr);
-    u8* end = g_memory->GetPhysicalPointer(end_addr);
-
     if (VideoCore::g_renderer->Rasterizer()->AccelerateFill(config))
         return;
 
-    Memory::RasterizerInvalidateRegion(config.GetStartAddress(),
-                                       config.GetEndAddress() - config.GetStartAddress());
+    const u32 size = GetMemoryFillSize(config);
+    Memory::RasterizerInvalidateRegion(start_addr, size);
 
-    if (config.fill_24bit) {
-        // fill with 24-bit values
-        for (u8* ptr = start; ptr < end; ptr += 3) {
-            ptr[0] = config.value_24bit_r;
-            ptr[1] = config.value_24bit_g;
-            ptr[2] = config.value_24bit_b;
-        }
-    } else if (config.fill_32bit) {
-        // fill with 32-bit values
-        if (end > start) {
-            u32 value = config.value_32bit;
-            std::size_t len = (end - start) / sizeof(u32);
-            for (std::size_t i = 0; i < len; ++i)
-                memcpy(&start[i * sizeof(u32)], &value, sizeof(u32));
-        }
-    } else {
-        // fill with 16-bit values
-        u16 value_16bit = config.value_16bit.Value();
-        for (u8* ptr = start; ptr < end; ptr += sizeof(u16))
-            memcpy(ptr, &value_16bit, sizeof(u16));
+    if (CanDeferFill(start_addr, start_addr + size)) {
+        pending_fills.Add(config);
+        return;
     }
+
+    PerformMemoryFill(config, g_memory->GetPhysicalPointer(start_addr));
 }
 
 static void DisplayTransfer(const Regs::DisplayTransferConfig& config) {
@@ -193,113 +348,7 @@ static void DisplayTransfer(const Regs::DisplayTransferConfig& config) {
     Memory::RasterizerFlushRegion(config.GetPhysicalInputAddress(), input_size);
     Memory::RasterizerInvalidateRegion(config.GetPhysicalOutputAddress(), output_size);
 
-    for (u32 y = 0; y < output_height; ++y) {
-        for (u32 x = 0; x < output_width; ++x) {
-            Common::Vec4<u8> src_color;
-
-            // Calculate the [x,y] position of the input image
-            // based on the current output position and the scale
-            u32 input_x = x << horizontal_scale;
-            u32 input_y = y << vertical_scale;
-
-            u32 output_y;
-            if (config.flip_vertically) {
-                // Flip the y value of the output data,
-                // we do this after calculating the [x,y] position of the input image
-                // to account for the scaling options.
-                output_y = output_height - y - 1;
-            } else {
-                output_y = y;
-            }
-
-            u32 dst_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.output_format);
-            u32 src_bytes_per_pixel = GPU::Regs::BytesPerPixel(config.input_format);
-            u32 src_offset;
-            u32 dst_offset;
-
-            if (config.input_linear) {
-                if (!config.dont_swizzle) {
-                    // Interpret the input as linear and the output as tiled
-                    u32 coarse_y = output_y & ~7;
-                    u32 stride = output_width * dst_bytes_per_pixel;
-
-                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
-                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
-                                 coarse_y * stride;
-                } else {
-                    // Both input and output are linear
-                    src_offset = (input_x + input_y * config.input_width) * src_bytes_per_pixel;
-                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
-                }
-            } else {
-                if (!config.dont_swizzle) {
-                    // Interpret the input as tiled and the output as linear
-                    u32 coarse_y = input_y & ~7;
-                    u32 stride = config.input_width * src_bytes_per_pixel;
-
-                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
-                                 coarse_y * stride;
-                    dst_offset = (x + output_y * output_width) * dst_bytes_per_pixel;
-                } else {
-                    // Both input and output are tiled
-                    u32 out_coarse_y = output_y & ~7;
-                    u32 out_stride = output_width * dst_bytes_per_pixel;
-
-                    u32 in_coarse_y = input_y & ~7;
-                    u32 in_stride = config.input_width * src_bytes_per_pixel;
-
-                    src_offset = VideoCore::GetMortonOffset(input_x, input_y, src_bytes_per_pixel) +
-                                 in_coarse_y * in_stride;
-                    dst_offset = VideoCore::GetMortonOffset(x, output_y, dst_bytes_per_pixel) +
-                                 out_coarse_y * out_stride;
-                }
-            }
-
-            const u8* src_pixel = src_pointer + src_offset;
-            src_color = DecodePixel(config.input_format, src_pixel);
-            if (config.scaling == config.ScaleX) {
-                Common::Vec4<u8> pixel =
-                    DecodePixel(config.input_format, src_pixel + src_bytes_per_pixel);
-                src_color = ((src_color + pixel) / 2).Cast<u8>();
-            } else if (config.scaling == config.ScaleXY) {
-                Common::Vec4<u8> pixel1 =
-                    DecodePixel(config.input_format, src_pixel + 1 * src_bytes_per_pixel);
-                Common::Vec4<u8> pixel2 =
-                    DecodePixel(config.input_format, src_pixel + 2 * src_bytes_per_pixel);
-                Common::Vec4<u8> pixel3 =
-                    DecodePixel(config.input_format, src_pixel + 3 * src_bytes_per_pixel);
-                src_color = (((src_color + pixel1) + (pixel2 + pixel3)) / 4).Cast<u8>();
-            }
-
-            u8* dst_pixel = dst_pointer + dst_offset;
-            switch (config.output_format) {
-            case Regs::PixelFormat::RGBA8:
-                Color::EncodeRGBA8(src_color, dst_pixel);
-                break;
-
-            case Regs::PixelFormat::RGB8:
-                Color::EncodeRGB8(src_color, dst_pixel);
-                break;
-
-            case Regs::PixelFormat::RGB565:
-                Color::EncodeRGB565(src_color, dst_pixel);
-                break;
-
-            case Regs::PixelFormat::RGB5A1:
-                Color::EncodeRGB5A1(src_color, dst_pixel);
-                break;
-
-            case Regs::PixelFormat::RGBA4:
-                Color::EncodeRGBA4(src_color, dst_pixel);
-                break;
-
-            default:
-                LOG_ERROR(HW_GPU, "Unknown destination framebuffer format {:x}",
-                          static_cast<u32>(config.output_format.Value()));
-                break;
-            }
-        }
-    }
+    PerformDisplayTransfer(config, src_pointer, dst_pointer);
 }
 
 static void TextureCopy(const Regs::DisplayTransferConfig& config) {
@@ -406,19 +455,22 @@ inline void Write(u32 addr, const T data) {
         auto& config = g_regs.memory_fill_config[is_second_filler];
 
         if (config.trigger) {
-            MemoryFill(config);
-            LOG_TRACE(HW_GPU, "MemoryFill from {:#010X} to {:#010X}", config.GetStartAddress(),
-                      config.GetEndAddress());
-
-            // It seems that it won't signal interrupt if "address_start" is zero.
-            // TODO: hwtest this
-            if (config.GetStartAddress() != 0) {
-                if (!is_second_filler) {
-                    Service::GSP::SignalInterrupt(Service::GSP::InterruptId::PSC0);
-                } else {
-                    Service::GSP::SignalInterrupt(Service::GSP::InterruptId::PSC1);
+            const AsyncWork::Region fill{config.GetStartAddress(), GetMemoryFillSize(config)};
+            RunGPUWork(std::vector{fill}, [config = config, is_second_filler] {
+                MemoryFill(config);
+                LOG_TRACE(HW_GPU, "MemoryFill from {:#010X} to {:#010X}",
+                          config.GetStartAddress(), config.GetEndAddress());
+
+                // It seems that it won't signal interrupt if "address_start" is zero.
+                // TODO: hwtest this
+                if (config.GetStartAddress() != 0) {
+                    if (!is_second_filler) {
+                        GPU::SignalInterrupt(Service::GSP::InterruptId::PSC0);
+                    } else {
+                        GPU::SignalInterrupt(Service::GSP::InterruptId::PSC1);
+                    }
                 }
-            }
+            });
 
             // Reset "trigger" flag and set the "finish" flag
             // NOTE: This was confirmed to happen on hardware even if "address_start" is zero.
@@ -429,8 +481,6 @@ inline void Write(u32 addr, const T data) {
     }
 
     case GPU_REG_INDEX(display_transfer_config.trigger): {
-        MICROPROFILE_SCOPE(GPU_DisplayTransfer);
-
         const auto& config = g_regs.display_transfer_config;
         if (config.trigger & 1) {
 
@@ -438,28 +488,34 @@ inline void Write(u32 addr, const T data) {
                 Pica::g_debug_context->OnEvent(Pica::DebugContext::Event::IncomingDisplayTransfer,
                                                nullptr);
 
-            if (config.is_texture_copy) {
-                TextureCopy(config);
-                LOG_TRACE(HW_GPU,
-                          "TextureCopy: {:#X} bytes from {:#010X}({}+{})-> "
-                          "{:#010X}({}+{}), flags {:#010X}",
-                          config.texture_copy.size, config.GetPhysicalInputAddress(),
-                          config.texture_copy.input_width * 16, config.texture_copy.input_gap * 16,
-                          config.GetPhysicalOutputAddress(), config.texture_copy.output_width * 16,
-                          config.texture_copy.output_gap * 16, config.flags);
-            } else {
-                DisplayTransfer(config);
-                LOG_TRACE(HW_GPU,
-                          "DisplayTransfer: {:#010X}({}x{})-> "
-                          "{:#010X}({}x{}), dst format {:x}, flags {:#010X}",
-                          config.GetPhysicalInputAddress(), config.input_width.Value(),
-                          config.input_height.Value(), config.GetPhysicalOutputAddress(),
-                          config.output_width.Value(), config.output_height.Value(),
-                          static_cast<u32>(config.output_format.Value()), config.flags);
-            }
+            RunGPUWork(std::vector{GetTransferOutput(config)}, [config = config] {
+                MICROPROFILE_SCOPE(GPU_DisplayTransfer);
+
+                if (config.is_texture_copy) {
+                    TextureCopy(config);
+                    LOG_TRACE(HW_GPU,
+                              "TextureCopy: {:#X} bytes from {:#010X}({}+{})-> "
+                              "{:#010X}({}+{}), flags {:#010X}",
+                              config.texture_copy.size, config.GetPhysicalInputAddress(),
+                              config.texture_copy.input_width * 16,
+                              config.texture_copy.input_gap * 16, config.GetPhysicalOutputAddress(),
+                              config.texture_copy.output_width * 16,
+                              config.texture_copy.output_gap * 16, config.flags);
+                } else {
+                    DisplayTransfer(config);
+                    LOG_TRACE(HW_GPU,
+                              "DisplayTransfer: {:#010X}({}x{})-> "
+                              "{:#010X}({}x{}), dst format {:x}, flags {:#010X}",
+                              config.GetPhysicalInputAddress(), config.input_width.Value(),
+                              config.input_height.Value(), config.GetPhysicalOutputAddress(),
+                              config.output_width.Value(), config.output_height.Value(),
+                              static_cast<u32>(config.output_format.Value()), config.flags);
+                }
+
+                GPU::SignalInterrupt(Service::GSP::InterruptId::PPF);
+            });
 
             g_regs.display_transfer_config.trigger = 0;
-            Service::GSP::SignalInterrupt(Service::GSP::InterruptId::PPF);
         }
         break;
     }
@@ -468,9 +524,19 @@ inline void Write(u32 addr, const T data) {
     case GPU_REG_INDEX(command_processor_config.trigger): {
         const auto& config = g_regs.command_processor_config;
         if (config.trigger & 1) {
-            MICROPROFILE_SCOPE(GPU_CmdlistProcessing);
+            const PAddr address = config.GetPhysicalAddress();
+            const u32 size = config.size;
+            std::optional<std::vector<AsyncWork::Region>> writes;
+            if (UseGPUThread()) {
+                writes = GetCommandListWrites(address, size);
+            }
+            RunGPUWork(std::move(writes), [address, size] {
+                MICROPROFILE_SCOPE(GPU_CmdlistProcessing);
 
-            Pica::CommandProcessor::ProcessCommandList(config.GetPhysicalAddress(), config.size);
+                // The software rasterizer reads and writes memory directly
+                FlushAllPendingFills();
+                Pica::CommandProcessor::ProcessCommandList(address, size);
+            });
 
             g_regs.command_processor_config.trigger = 0;
         }
@@ -504,6 +570,11 @@ template void Write<u8>(u32 addr, const u8 data);
 
 /// Update hardware
 static void VBlankCallback(u64 userdata, s64 cycles_late) {
+    // The frame is presented from memory that queued work may still be drawing to
+    WaitIdle();
+    if (VideoCore::g_hw_renderer_enabled) {
+        FlushAllPendingFills();
+    }
     VideoCore::g_renderer->SwapBuffers();
 
     // Signal to GSP that GPU interrupt has occurred
@@ -551,14 +622,32 @@ void Init(Memory::MemorySystem& memory) {
 
     Core::Timing& timing = Core::System::GetInstance().CoreTiming();
     vblank_event = timing.RegisterEvent("GPU::VBlankCallback", VBlankCallback);
+    async_interrupt_event =
+        timing.RegisterEvent("GPU::AsyncInterruptCallback", AsyncInterruptCallback);
     timing.ScheduleEvent(frame_ticks, vblank_event);
 
     LOG_DEBUG(HW_GPU, "initialized OK");
 }
 
+template <class Archive>
+void serialize(Archive& ar, const unsigned int) {
+    // The GPU thread is idle while saving. The fences of the held interrupts and of the scheduled
+    // events that signal them carry on after loading.
+    u64 last_fence = VideoCore::g_gpu_thread ? VideoCore::g_gpu_thread->GetLastFence() : 0;
+    ar& last_fence;
+    ar& async_work;
+    if (Archive::is_loading::value && VideoCore::g_gpu_thread) {
+        VideoCore::g_gpu_thread->ContinueFrom(last_fence);
+    }
+}
+
 /// Shutdown hardware
 void Shutdown() {
+    async_work.Clear();
+    pending_fills.Clear();
     LOG_DEBUG(HW_GPU, "shutdown OK");
 }
 
 } // namespace GPU
+
+SERIALIZE_IMPL(GPU)
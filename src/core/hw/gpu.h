@@ -18,6 +18,10 @@ namespace Memory {
 class MemorySystem;
 }
 
+namespace Service::GSP {
+enum class InterruptId : u8;
+}
+
 namespace GPU {
 
 // Measured on hardware to be 2240568 timer cycles or 4481136 ARM11 cycles
@@ -320,6 +324,34 @@ void Read(T& var, const u32 addr);
 template <typename T>
 void Write(u32 addr, const T data);
 
+/**
+ * Signals an interrupt raised by GPU work. On the GPU thread, the interrupt is held back until
+ * the emulation thread sees the work complete.
+ */
+void SignalInterrupt(Service::GSP::InterruptId interrupt_id);
+
+/**
+ * Waits for the work queued on the GPU thread to complete, so that the CPU can see its results.
+ * The interrupts it raised are still signalled at their scheduled time.
+ */
+void WaitIdle();
+
+/// Writes the memory fills deferred on the software path that overlap the region.
+void FlushPendingFills(PAddr start, u32 size);
+
+/**
+ * Drops the deferred memory fills that the region is about to overwrite entirely, and writes the
+ * ones that overlap it.
+ */
+void InvalidatePendingFills(PAddr start, u32 size);
+
+/// Writes all the memory fills deferred on the software path.
+void FlushAllPendingFills();
+
+/// Saves or restores the interrupts held back for work on the GPU thread.
+template <class Archive>
+void serialize(Archive& ar, const unsigned int file_version);
+
 /// Initialize hardware
 void Init(Memory::MemorySystem& memory);
 
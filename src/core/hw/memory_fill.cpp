@@ -0,0 +1,132 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include "core/hw/memory_fill.h"
+#include "core/memory.h"
+
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
+namespace GPU {
+
+namespace {
+
+/// 48 bytes hold a whole number of 16-, 24- and 32-bit values.
+using FillPattern = std::array<u8, 48>;
+
+void FillWithPattern(u8* dst, std::size_t length, const FillPattern& pattern) {
+    std::size_t i = 0;
+#ifdef ARCHITECTURE_x86_64
+    const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.data()));
+    const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.data() + 16));
+    const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.data() + 32));
+    for (; i + pattern.size() <= length; i += pattern.size()) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+    }
+#endif
+    for (; i + pattern.size() <= length; i += pattern.size()) {
+        std::memcpy(dst + i, pattern.data(), pattern.size());
+    }
+    // i is a multiple of the pattern size, so the pattern starts over here
+    std::memcpy(dst + i, pattern.data(), length - i);
+}
+
+} // Anonymous namespace
+
+u32 GetMemoryFillSize(const Regs::MemoryFillConfig& config) {
+    const u32 size = config.GetEndAddress() - config.GetStartAddress();
+    if (config.fill_24bit) {
+        return (size + 2) / 3 * 3;
+    } else if (config.fill_32bit) {
+        return size / sizeof(u32) * sizeof(u32);
+    } else {
+        return (size + 1) / sizeof(u16) * sizeof(u16);
+    }
+}
+
+void PerformMemoryFill(const Regs::MemoryFillConfig& config, u8* dst) {
+    std::array<u8, 4> value{};
+    std::size_t value_size;
+    if (config.fill_24bit) {
+        value = {static_cast<u8>(config.value_24bit_r), static_cast<u8>(config.value_24bit_g),
+                 static_cast<u8>(config.value_24bit_b)};
+        value_size = 3;
+    } else if (config.fill_32bit) {
+        const u32 value_32bit = config.value_32bit;
+        std::memcpy(value.data(), &value_32bit, sizeof(u32));
+        value_size = sizeof(u32);
+    } else {
+        const u16 value_16bit = config.value_16bit.Value();
+        std::memcpy(value.data(), &value_16bit, sizeof(u16));
+        value_size = sizeof(u16);
+    }
+
+    FillPattern pattern;
+    for (std::size_t i = 0; i < pattern.size(); i++) {
+        pattern[i] = value[i % value_size];
+    }
+    FillWithPattern(dst, GetMemoryFillSize(config), pattern);
+}
+
+DeferredMemoryFills::DeferredMemoryFills(GetPointerFunc get_pointer, MarkPageFunc mark_page)
+    : get_pointer(std::move(get_pointer)), mark_page(std::move(mark_page)) {}
+
+void DeferredMemoryFills::Add(const Regs::MemoryFillConfig& config) {
+    const PAddr start = config.GetStartAddress();
+    const PAddr end = start + GetMemoryFillSize(config);
+    MarkPages(start, end, true);
+    fills.push_back({config, start, end});
+}
+
+void DeferredMemoryFills::Flush(PAddr start, PAddr end) {
+    Retire(start, end, false);
+}
+
+void DeferredMemoryFills::Invalidate(PAddr start, PAddr end) {
+    Retire(start, end, true);
+}
+
+void DeferredMemoryFills::FlushAll() {
+    Retire(0, std::numeric_limits<PAddr>::max(), false);
+}
+
+void DeferredMemoryFills::Clear() {
+    fills.clear();
+}
+
+void DeferredMemoryFills::Retire(PAddr start, PAddr end, bool discard_covered) {
+    auto it = fills.begin();
+    while (it != fills.end()) {
+        if (it->start >= end || it->end <= start) {
+            ++it;
+            continue;
+        }
+        const Fill fill = *it;
+        it = fills.erase(it);
+        if (!discard_covered || fill.start < start || fill.end > end) {
+            PerformMemoryFill(fill.config, get_pointer(fill.start));
+        }
+        MarkPages(fill.start, fill.end, false);
+    }
+}
+
+void DeferredMemoryFills::MarkPages(PAddr start, PAddr end, bool cached) {
+    for (PAddr page = start & ~Memory::PAGE_MASK; page < end; page += Memory::PAGE_SIZE) {
+        const bool shared = std::any_of(fills.begin(), fills.end(), [page](const Fill& fill) {
+            return fill.start < page + Memory::PAGE_SIZE && fill.end > page;
+        });
+        if (!shared) {
+            mark_page(page, cached);
+        }
+    }
+}
+
+} // namespace GPU
@@ -0,0 +1,76 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "common/common_types.h"
+#include "core/hw/gpu.h"
+
+namespace GPU {
+
+/**
+ * Returns the number of bytes written by a memory fill. 24-bit fills write the last value whole
+ * even if it crosses the end address.
+ */
+u32 GetMemoryFillSize(const Regs::MemoryFillConfig& config);
+
+/// Writes the value of a memory fill over the GetMemoryFillSize(config) bytes at dst.
+void PerformMemoryFill(const Regs::MemoryFillConfig& config, u8* dst);
+
+/**
+ * Memory fills that were recorded instead of written. Their pages are marked as cached, like the
+ * surfaces of the hardware renderer, so that the memory hooks of the rasterizer write them before
+ * anything reads them. A buffer that is cleared again before being read is never written.
+ */
+class DeferredMemoryFills {
+public:
+    /// Returns a pointer to the physical memory at an address
+    using GetPointerFunc = std::function<u8*(PAddr address)>;
+    /// Marks or unmarks a page of physical memory as cached
+    using MarkPageFunc = std::function<void(PAddr page, bool cached)>;
+
+    DeferredMemoryFills(GetPointerFunc get_pointer, MarkPageFunc mark_page);
+
+    bool Empty() const {
+        return fills.empty();
+    }
+
+    /// Records a fill instead of writing it, and marks its pages as cached.
+    void Add(const Regs::MemoryFillConfig& config);
+
+    /// Writes and forgets the fills that overlap [start, end).
+    void Flush(PAddr start, PAddr end);
+
+    /**
+     * Forgets the fills that lie entirely within [start, end), which is about to be overwritten,
+     * and writes and forgets the others that overlap it.
+     */
+    void Invalidate(PAddr start, PAddr end);
+
+    /// Writes and forgets all fills.
+    void FlushAll();
+
+    /// Forgets all fills without writing them or unmarking their pages.
+    void Clear();
+
+private:
+    struct Fill {
+        Regs::MemoryFillConfig config;
+        PAddr start;
+        PAddr end; ///< End of the bytes the fill writes
+    };
+
+    void Retire(PAddr start, PAddr end, bool discard_covered);
+
+    /// Marks or unmarks the pages of [start, end) that no recorded fill is on.
+    void MarkPages(PAddr start, PAddr end, bool cached);
+
+    GetPointerFunc get_pointer;
+    MarkPageFunc mark_page;
+    std::vector<Fill> fills;
+};
+
+} // namespace GPU
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstring>
 #include <memory>
 #include "common/assert.h"
 #include "common/color.h"
@@ -15,16 +16,138 @@
 #include "core/hw/y2r.h"
 #include "core/memory.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
 namespace HW::Y2R {
 
 using namespace Service::Y2R;
 
 static const std::size_t MAX_TILES = 1024 / 8;
 static const std::size_t TILE_SIZE = 8 * 8;
-using ImageTile = std::array<u32, TILE_SIZE>;
 
-/// Converts a image strip from the source YUV format into individual 8x8 RGB32 tiles.
-static void ConvertYUVToRGB(InputFormat input_format, const u8* input_Y, const u8* input_U,
+#ifdef ARCHITECTURE_x86_64
+
+/// Coefficients of ConvertPixels, as pairs of 16-bit values to multiply pairs of components with.
+struct SIMDCoefficients {
+    explicit SIMDCoefficients(const CoefficientSet& c)
+        : y{Pair(c[0], 0)}, yv{Pair(c[0], c[1])}, vu{Pair(c[2], c[3])}, yu{Pair(c[0], c[4])},
+          r_offset{_mm_set1_epi32(c[5] + rounding_offset)},
+          g_offset{_mm_set1_epi32(c[6] + rounding_offset)},
+          b_offset{_mm_set1_epi32(c[7] + rounding_offset)} {}
+
+    static __m128i Pair(s16 low, s16 high) {
+        return _mm_setr_epi16(low, high, low, high, low, high, low, high);
+    }
+
+    static constexpr s32 rounding_offset = 0x18;
+
+    __m128i y, yv, vu, yu;
+    __m128i r_offset, g_offset, b_offset;
+};
+
+/// Converts one 32-bit component per lane to its final 8-bit value, kept in the 32-bit lane.
+static __m128i FinishComponent(__m128i value, __m128i offset) {
+    return _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(value, 3), offset), 5);
+}
+
+/**
+ * Converts eight pixels, given as one component per 16-bit lane, and stores them as RGB32. Every
+ * product is computed exactly by _mm_madd_epi16, so the result matches the scalar conversion.
+ */
+static void ConvertPixels(__m128i Y, __m128i U, __m128i V, const SIMDCoefficients& c,
+                          u32* output) {
+    __m128i r[2], g[2], b[2];
+    for (int half = 0; half < 2; half++) {
+        const __m128i yv = half ? _mm_unpackhi_epi16(Y, V) : _mm_unpacklo_epi16(Y, V);
+        const __m128i yu = half ? _mm_unpackhi_epi16(Y, U) : _mm_unpacklo_epi16(Y, U);
+        const __m128i vu = half ? _mm_unpackhi_epi16(V, U) : _mm_unpacklo_epi16(V, U);
+        const __m128i cY = _mm_madd_epi16(yv, c.y);
+        r[half] = FinishComponent(_mm_madd_epi16(yv, c.yv), c.r_offset);
+        g[half] = FinishComponent(_mm_sub_epi32(cY, _mm_madd_epi16(vu, c.vu)), c.g_offset);
+        b[half] = FinishComponent(_mm_madd_epi16(yu, c.yu), c.b_offset);
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(0xFF);
+    const auto clamp = [&](const __m128i(&value)[2]) {
+        return _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(value[0], value[1]), zero), max);
+    };
+    const __m128i rg = _mm_or_si128(_mm_slli_epi16(clamp(r), 8), clamp(g));
+    const __m128i b0 = _mm_slli_epi16(clamp(b), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_unpacklo_epi16(b0, rg));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4), _mm_unpackhi_epi16(b0, rg));
+}
+
+/// Loads four 8-bit chroma values and repeats each of them for two pixels.
+static __m128i LoadChroma(const u8* input) {
+    u32 values;
+    std::memcpy(&values, input, sizeof(values));
+    const __m128i chroma = _mm_unpacklo_epi8(_mm_cvtsi32_si128(values), _mm_setzero_si128());
+    return _mm_unpacklo_epi16(chroma, chroma);
+}
+
+template <InputFormat input_format>
+static void ConvertYUVToRGBSSE2(const u8* input_Y, const u8* input_U, const u8* input_V,
+                                ImageTile output[], unsigned int width, unsigned int height,
+                                const CoefficientSet& coefficients) {
+    const SIMDCoefficients c(coefficients);
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; x += 8) {
+            __m128i Y, U, V;
+            if constexpr (input_format == InputFormat::YUYV422_Interleaved) {
+                // Y0 U0 Y1 V0, with the chroma of each pair of pixels in the high bytes
+                const u8* input = input_Y + (y * width + x) * 2;
+                const __m128i yuyv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+                const __m128i uv = _mm_srli_epi16(yuyv, 8);
+                const __m128i low_half = _mm_set1_epi32(0xFFFF);
+                Y = _mm_and_si128(yuyv, _mm_set1_epi16(0xFF));
+                U = _mm_or_si128(_mm_and_si128(uv, low_half), _mm_slli_epi32(uv, 16));
+                V = _mm_or_si128(_mm_srli_epi32(uv, 16), _mm_andnot_si128(low_half, uv));
+            } else {
+                Y = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input_Y + y * width + x)),
+                    _mm_setzero_si128());
+                const unsigned int chroma_y =
+                    input_format == InputFormat::YUV420_Indiv8 ? y / 2 : y;
+                U = LoadChroma(input_U + (chroma_y * width + x) / 2);
+                V = LoadChroma(input_V + (chroma_y * width + x) / 2);
+            }
+            ConvertPixels(Y, U, V, c, &output[x / 8][y * 8]);
+        }
+    }
+}
+
+#endif // ARCHITECTURE_x86_64
+
+void ConvertYUVToRGB(InputFormat input_format, const u8* input_Y, const u8* input_U,
+                     const u8* input_V, ImageTile output[], unsigned int width,
+                     unsigned int height, const CoefficientSet& coefficients) {
+#ifdef ARCHITECTURE_x86_64
+    // The 16-bit formats are narrowed to 8 bits as they are received
+    switch (input_format) {
+    case InputFormat::YUV422_Indiv8:
+    case InputFormat::YUV422_Indiv16:
+        ConvertYUVToRGBSSE2<InputFormat::YUV422_Indiv8>(input_Y, input_U, input_V, output, width,
+                                                        height, coefficients);
+        return;
+    case InputFormat::YUV420_Indiv8:
+    case InputFormat::YUV420_Indiv16:
+        ConvertYUVToRGBSSE2<InputFormat::YUV420_Indiv8>(input_Y, input_U, input_V, output, width,
+                                                        height, coefficients);
+        return;
+    case InputFormat::YUYV422_Interleaved:
+        ConvertYUVToRGBSSE2<InputFormat::YUYV422_Interleaved>(input_Y, input_U, input_V, output,
+                                                              width, height, coefficients);
+        return;
+    }
+#endif
+    ConvertYUVToRGBGeneric(input_format, input_Y, input_U, input_V, output, width, height,
+                           coefficients);
+}
+
+void ConvertYUVToRGBGeneric(InputFormat input_format, const u8* input_Y, const u8* input_U,
                             const u8* input_V, ImageTile output[], unsigned int width,
                             unsigned int height, const CoefficientSet& coefficients) {
 
@@ -87,8 +210,12 @@ static void ReceiveData(Memory::MemorySystem& memory, u8* output, ConversionBuff
     ASSERT(amount_of_data % output_unit == 0);
 
     while (amount_of_data > 0) {
-        for (std::size_t i = 0; i < output_unit; ++i) {
-            output[i] = input[i * N];
+        if constexpr (N == 1) {
+            std::memcpy(output, input, output_unit);
+        } else {
+            for (std::size_t i = 0; i < output_unit; ++i) {
+                output[i] = input[i * N];
+            }
         }
 
         output += output_unit;
@@ -100,6 +227,141 @@ static void ReceiveData(Memory::MemorySystem& memory, u8* output, ConversionBuff
     }
 }
 
+static constexpr std::size_t BytesPerPixel(OutputFormat output_format) {
+    switch (output_format) {
+    case OutputFormat::RGBA8:
+        return 4;
+    case OutputFormat::RGB8:
+        return 3;
+    case OutputFormat::RGB5A1:
+    case OutputFormat::RGB565:
+        return 2;
+    }
+    return 0;
+}
+
+#ifdef ARCHITECTURE_x86_64
+
+/// Encodes four RGB32 pixels, one per 32-bit lane, to 16-bit values kept in the lanes.
+template <OutputFormat output_format>
+static __m128i Encode16(__m128i color, __m128i alpha) {
+    const __m128i mask5 = _mm_set1_epi32(0x1F);
+    const __m128i r = _mm_srli_epi32(color, 27);
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(color, 11), mask5);
+    if constexpr (output_format == OutputFormat::RGB5A1) {
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(color, 19), mask5);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 6)),
+                            _mm_or_si128(_mm_slli_epi32(b, 1), alpha));
+    } else {
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(color, 18), _mm_set1_epi32(0x3F));
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 11), _mm_slli_epi32(g, 5)), b);
+    }
+}
+
+#endif // ARCHITECTURE_x86_64
+
+template <OutputFormat output_format>
+static void EncodePixels(const u32* input, u8* output, std::size_t count, u8 alpha) {
+    std::size_t i = 0;
+    if constexpr (output_format == OutputFormat::RGBA8) {
+#ifdef ARCHITECTURE_x86_64
+        const __m128i rgb_mask = _mm_set1_epi32(0xFFFFFF00);
+        const __m128i alpha_lanes = _mm_set1_epi32(alpha);
+        for (; i + 4 <= count; i += 4) {
+            const __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 4),
+                             _mm_or_si128(_mm_and_si128(color, rgb_mask), alpha_lanes));
+        }
+#endif
+        for (; i < count; ++i) {
+            const u32 pixel = (input[i] & 0xFFFFFF00) | alpha;
+            std::memcpy(output + i * 4, &pixel, sizeof(pixel));
+        }
+    } else if constexpr (output_format == OutputFormat::RGB8) {
+        // Two pixels per 8-byte store. The two bytes past them are overwritten by the next store.
+        for (; i + 2 < count; i += 2) {
+            const u64 pixels = (input[i] >> 8) | static_cast<u64>(input[i + 1] >> 8) << 24;
+            std::memcpy(output + i * 3, &pixels, sizeof(pixels));
+        }
+        for (; i < count; ++i) {
+            const u32 pixel = input[i] >> 8;
+            std::memcpy(output + i * 3, &pixel, 3);
+        }
+    } else {
+        const u16 alpha_bit = output_format == OutputFormat::RGB5A1 ? alpha >> 7 : 0;
+#ifdef ARCHITECTURE_x86_64
+        const __m128i alpha_lanes = _mm_set1_epi32(alpha_bit);
+        for (; i + 8 <= count; i += 8) {
+            const __m128i low = Encode16<output_format>(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)), alpha_lanes);
+            const __m128i high = Encode16<output_format>(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 4)), alpha_lanes);
+            // Sign-extend so that the saturating pack keeps every value as is
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 2),
+                             _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(low, 16), 16),
+                                             _mm_srai_epi32(_mm_slli_epi32(high, 16), 16)));
+        }
+#endif
+        for (; i < count; ++i) {
+            const u32 color = input[i];
+            u16 pixel;
+            if constexpr (output_format == OutputFormat::RGB5A1) {
+                pixel = static_cast<u16>((color >> 27) << 11 | (color >> 19 & 0x1F) << 6 |
+                                         (color >> 11 & 0x1F) << 1 | alpha_bit);
+            } else {
+                pixel = static_cast<u16>((color >> 27) << 11 | (color >> 18 & 0x3F) << 5 |
+                                         (color >> 11 & 0x1F));
+            }
+            std::memcpy(output + i * 2, &pixel, sizeof(pixel));
+        }
+    }
+}
+
+void EncodeRGB(OutputFormat output_format, const u32* input, u8* output, std::size_t count,
+               u8 alpha) {
+    switch (output_format) {
+    case OutputFormat::RGBA8:
+        EncodePixels<OutputFormat::RGBA8>(input, output, count, alpha);
+        break;
+    case OutputFormat::RGB8:
+        EncodePixels<OutputFormat::RGB8>(input, output, count, alpha);
+        break;
+    case OutputFormat::RGB5A1:
+        EncodePixels<OutputFormat::RGB5A1>(input, output, count, alpha);
+        break;
+    case OutputFormat::RGB565:
+        EncodePixels<OutputFormat::RGB565>(input, output, count, alpha);
+        break;
+    }
+}
+
+void EncodeRGBGeneric(OutputFormat output_format, const u32* input, u8* output,
+                      std::size_t count, u8 alpha) {
+    for (std::size_t i = 0; i < count; ++i) {
+        u32 color = input[i];
+        Common::Vec4<u8> col_vec{(u8)(color >> 24), (u8)(color >> 16), (u8)(color >> 8), alpha};
+
+        switch (output_format) {
+        case OutputFormat::RGBA8:
+            Color::EncodeRGBA8(col_vec, output);
+            output += 4;
+            break;
+        case OutputFormat::RGB8:
+            Color::EncodeRGB8(col_vec, output);
+            output += 3;
+            break;
+        case OutputFormat::RGB5A1:
+            Color::EncodeRGB5A1(col_vec, output);
+            output += 2;
+            break;
+        case OutputFormat::RGB565:
+            Color::EncodeRGB565(col_vec, output);
+            output += 2;
+            break;
+        }
+    }
+}
+
 /// Convert intermediate RGB32 format to the final output format while simulating an outgoing CDMA
 /// transfer.
 static void SendData(Memory::MemorySystem& memory, const u32* input, ConversionBuffer& buf,
@@ -107,33 +369,15 @@ static void SendData(Memory::MemorySystem& memory, const u32* input, ConversionB
 
     u8* output = memory.GetPointer(buf.address);
 
-    while (amount_of_data > 0) {
-        u8* unit_end = output + buf.transfer_unit;
-        while (output < unit_end) {
-            u32 color = *input++;
-            Common::Vec4<u8> col_vec{(u8)(color >> 24), (u8)(color >> 16), (u8)(color >> 8), alpha};
-
-            switch (output_format) {
-            case OutputFormat::RGBA8:
-                Color::EncodeRGBA8(col_vec, output);
-                output += 4;
-                break;
-            case OutputFormat::RGB8:
-                Color::EncodeRGB8(col_vec, output);
-                output += 3;
-                break;
-            case OutputFormat::RGB5A1:
-                Color::EncodeRGB5A1(col_vec, output);
-                output += 2;
-                break;
-            case OutputFormat::RGB565:
-                Color::EncodeRGB565(col_vec, output);
-                output += 2;
-                break;
-            }
+    // Every transfer unit is made of whole pixels, the last one possibly crossing its end
+    const std::size_t bytes_per_pixel = BytesPerPixel(output_format);
+    const std::size_t unit_pixels = (buf.transfer_unit + bytes_per_pixel - 1) / bytes_per_pixel;
 
-            amount_of_data -= 1;
-        }
+    while (amount_of_data > 0) {
+        EncodeRGB(output_format, input, output, unit_pixels, alpha);
+        input += unit_pixels;
+        output += unit_pixels * bytes_per_pixel;
+        amount_of_data -= static_cast<int>(unit_pixels);
 
         output += buf.gap;
         buf.address += buf.transfer_unit + buf.gap;
@@ -204,9 +448,7 @@ static void RotateTile270(const ImageTile& input, ImageTile& output, int height,
 
 static void WriteTileToOutput(u32* output, const ImageTile& tile, int height, int line_stride) {
     for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < 8; ++x) {
-            output[y * line_stride + x] = tile[y * 8 + x];
-        }
+        std::memcpy(&output[y * line_stride], &tile[y * 8], 8 * sizeof(u32));
     }
 }
 
@@ -323,8 +565,6 @@ void PerformConversion(Memory::MemorySystem& memory, ConversionConfiguration& cv
             break;
         }
 
-        // Note(yuriks): If additional optimization is required, input_format can be moved to a
-        // template parameter, so that its dispatch can be moved to outside the inner loop.
         ConvertYUVToRGB(cvt.input_format, input_Y, input_U, input_V, tiles.get(),
                         cvt.input_line_width, row_height, cvt.coefficients);
 
@@ -333,10 +573,16 @@ void PerformConversion(Memory::MemorySystem& memory, ConversionConfiguration& cv
         for (std::size_t i = 0; i < num_tiles; ++i) {
             int image_strip_width = 0;
             int output_stride = 0;
+            const ImageTile* tile = &tmp_tile;
 
             switch (cvt.rotation) {
             case Rotation::None:
-                RotateTile0(tiles[i], tmp_tile, row_height, tile_remap);
+                if (cvt.block_alignment == BlockAlignment::Linear) {
+                    // Linear output keeps the pixels of the tile in order
+                    tile = &tiles[i];
+                } else {
+                    RotateTile0(tiles[i], tmp_tile, row_height, tile_remap);
+                }
                 image_strip_width = cvt.input_line_width;
                 output_stride = 8;
                 break;
@@ -361,18 +607,16 @@ void PerformConversion(Memory::MemorySystem& memory, ConversionConfiguration& cv
 
             switch (cvt.block_alignment) {
             case BlockAlignment::Linear:
-                WriteTileToOutput(output_buffer, tmp_tile, row_height, image_strip_width);
+                WriteTileToOutput(output_buffer, *tile, row_height, image_strip_width);
                 output_buffer += output_stride;
                 break;
             case BlockAlignment::Block8x8:
-                WriteTileToOutput(output_buffer, tmp_tile, 8, 8);
+                WriteTileToOutput(output_buffer, *tile, 8, 8);
                 output_buffer += TILE_SIZE;
                 break;
             }
         }
 
-        // Note(yuriks): If additional optimization is required, output_format can be moved to a
-        // template parameter, so that its dispatch can be moved to outside the inner loop.
         SendData(memory, reinterpret_cast<u32*>(data_buffer.get()), cvt.dst, (int)row_data_size,
                  cvt.output_format, (u8)cvt.alpha);
     }
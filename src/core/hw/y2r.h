@@ -4,14 +4,42 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include "common/common_types.h"
+#include "core/hle/service/y2r_u.h"
+
 namespace Memory {
 class MemorySystem;
 }
 
-namespace Service::Y2R {
-struct ConversionConfiguration;
-} // namespace Service::Y2R
-
 namespace HW::Y2R {
+
+/// An 8x8 tile of converted pixels, each stored as 0xRRGGBB00.
+using ImageTile = std::array<u32, 8 * 8>;
+
+/**
+ * Converts an image strip from the source YUV format into individual 8x8 RGB32 tiles, with SIMD
+ * kernels where available. The width must be a multiple of 8.
+ */
+void ConvertYUVToRGB(Service::Y2R::InputFormat input_format, const u8* input_Y, const u8* input_U,
+                     const u8* input_V, ImageTile output[], unsigned int width,
+                     unsigned int height, const Service::Y2R::CoefficientSet& coefficients);
+
+/// Converts an image strip like ConvertYUVToRGB, a pixel at a time.
+void ConvertYUVToRGBGeneric(Service::Y2R::InputFormat input_format, const u8* input_Y,
+                            const u8* input_U, const u8* input_V, ImageTile output[],
+                            unsigned int width, unsigned int height,
+                            const Service::Y2R::CoefficientSet& coefficients);
+
+/// Encodes RGB32 pixels to the output format, with SIMD kernels where available.
+void EncodeRGB(Service::Y2R::OutputFormat output_format, const u32* input, u8* output,
+               std::size_t count, u8 alpha);
+
+/// Encodes RGB32 pixels like EncodeRGB, a pixel at a time.
+void EncodeRGBGeneric(Service::Y2R::OutputFormat output_format, const u32* input, u8* output,
+                      std::size_t count, u8 alpha);
+
 void PerformConversion(Memory::MemorySystem& memory, Service::Y2R::ConversionConfiguration& cvt);
+
 } // namespace HW::Y2R
@@ -314,8 +314,14 @@ ResultStatus AppLoader_THREEDSX::ReadRomFS(std::shared_ptr<FileSys::RomFSReader>
         if (!romfs_file_inner.IsOpen())
             return ResultStatus::Error;
 
-        romfs_file = std::make_shared<FileSys::DirectRomFSReader>(std::move(romfs_file_inner),
-                                                                  romfs_offset, romfs_size);
+        auto mapped_romfs =
+            std::make_shared<FileSys::MappedRomFSReader>(filepath, romfs_offset, romfs_size);
+        if (mapped_romfs->IsOpen()) {
+            romfs_file = std::move(mapped_romfs);
+        } else {
+            romfs_file = std::make_shared<FileSys::DirectRomFSReader>(
+                std::move(romfs_file_inner), romfs_offset, romfs_size);
+        }
 
         return ResultStatus::Success;
     }
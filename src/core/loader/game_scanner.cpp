@@ -0,0 +1,307 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <sstream>
+#include <unordered_map>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/vector.hpp>
+#include "common/archives.h"
+#include "common/common_paths.h"
+#include "common/file_util.h"
+#include "common/logging/log.h"
+#include "common/string_util.h"
+#include "common/thread_pool.h"
+#include "common/zstd_compression.h"
+#include "core/hle/service/am/am.h"
+#include "core/hle/service/fs/archive.h"
+#include "core/loader/game_scanner.h"
+#include "core/loader/smdh.h"
+
+namespace Loader {
+
+namespace {
+
+/// Number of files opened in parallel before the games among them are reported.
+constexpr std::size_t batch_size = 64;
+
+bool HasSupportedFileExtension(const std::string& path) {
+    std::string extension;
+    Common::SplitPath(path, nullptr, nullptr, &extension);
+    const FileType type = GuessFromExtension(extension);
+    // CIAs are installed rather than booted.
+    return type != FileType::Unknown && type != FileType::CIA;
+}
+
+} // Anonymous namespace
+
+struct GameScanner::Entry {
+    u64 size = 0;
+    s64 modification_time = 0;
+    /// Whether the file is a game. The index also remembers the files that are not.
+    bool is_game = false;
+    FileType file_type = FileType::Unknown;
+    u64 program_id = 0;
+    u64 extdata_id = 0;
+    /// SMDH of the file itself, empty if it does not have a valid one
+    std::vector<u8> smdh;
+    /// Whether the file was looked at since the index was loaded. Not saved.
+    bool used = false;
+    /// Whether the file could not be decrypted. These are not saved either, as adding the keys
+    /// changes what is read out of them.
+    bool is_encrypted = false;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& size;
+        ar& modification_time;
+        ar& is_game;
+        ar& file_type;
+        ar& program_id;
+        ar& extdata_id;
+        ar& smdh;
+    }
+};
+
+struct GameScanner::Index {
+    /// Bumped whenever what goes into an entry changes
+    static constexpr u32 current_version = 1;
+
+    u32 version = current_version;
+    std::unordered_map<std::string, Entry> entries;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int) {
+        ar& version;
+        ar& entries;
+    }
+};
+
+GameScanner::GameScanner(std::size_t num_threads, std::string index_path)
+    : threads(std::make_unique<Common::ThreadPool>(num_threads, "Game Scanner")),
+      index_path(std::move(index_path)) {}
+
+GameScanner::~GameScanner() {
+    SaveIndex();
+}
+
+std::string GameScanner::DefaultIndexPath() {
+    return FileUtil::GetUserPath(FileUtil::UserPath::CacheDir) + "game_list.bin";
+}
+
+void GameScanner::Scan(const std::string& directory, unsigned int recursion,
+                       const std::function<void(GameInfo&&)>& on_game,
+                       const std::function<void(const std::string&)>& on_directory) {
+    LoadIndex();
+
+    std::vector<std::string> files;
+    FindFiles(directory, recursion, files, on_directory);
+
+    std::vector<std::optional<GameInfo>> games(batch_size);
+    for (std::size_t first = 0; first < files.size() && !stop_processing; first += batch_size) {
+        const std::size_t count = std::min(batch_size, files.size() - first);
+        threads->ParallelFor(count, [&](std::size_t i) {
+            games[i] = stop_processing ? std::nullopt : GetGame(files[first + i]);
+        });
+        for (std::size_t i = 0; i < count && !stop_processing; i++) {
+            if (games[i]) {
+                on_game(std::move(*games[i]));
+            }
+        }
+    }
+}
+
+void GameScanner::Cancel() {
+    stop_processing = true;
+}
+
+void GameScanner::SaveIndex() {
+    std::lock_guard lock{mutex};
+    if (index_path.empty() || !index) {
+        return;
+    }
+    if (!stop_processing) {
+        for (auto it = index->entries.begin(); it != index->entries.end();) {
+            if (it->second.used) {
+                ++it;
+            } else {
+                it = index->entries.erase(it);
+                index_changed = true;
+            }
+        }
+    }
+    if (!index_changed) {
+        return;
+    }
+
+    std::ostringstream stream;
+    {
+        oarchive oa{stream};
+        oa << *index;
+    }
+    const std::string serialized = stream.str();
+    const std::vector<u8> compressed = Common::Compression::CompressDataZSTDDefault(
+        reinterpret_cast<const u8*>(serialized.data()), serialized.size());
+
+    std::string index_folder;
+    Common::SplitPath(index_path, &index_folder, nullptr, nullptr);
+    if (compressed.empty() || !FileUtil::CreateFullPath(index_folder)) {
+        LOG_WARNING(Loader, "Could not write game list index {}", index_path);
+        return;
+    }
+    FileUtil::IOFile file(index_path, "wb");
+    if (!file || file.WriteBytes(compressed.data(), compressed.size()) != compressed.size()) {
+        LOG_WARNING(Loader, "Could not write game list index {}", index_path);
+        return;
+    }
+    index_changed = false;
+}
+
+GameScanner::Stats GameScanner::GetStats() const {
+    std::lock_guard lock{mutex};
+    return stats;
+}
+
+void GameScanner::LoadIndex() {
+    std::lock_guard lock{mutex};
+    if (index) {
+        return;
+    }
+    index = std::make_unique<Index>();
+    if (index_path.empty()) {
+        return;
+    }
+
+    FileUtil::IOFile file(index_path, "rb");
+    if (!file) {
+        return;
+    }
+    std::vector<u8> compressed(file.GetSize());
+    if (file.ReadBytes(compressed.data(), compressed.size()) != compressed.size()) {
+        return;
+    }
+    const std::vector<u8> serialized = Common::Compression::DecompressDataZSTD(compressed);
+    try {
+        std::istringstream stream(std::string(serialized.begin(), serialized.end()));
+        iarchive ia{stream};
+        ia >> *index;
+    } catch (const std::exception& e) {
+        LOG_WARNING(Loader, "Game list index {} is invalid: {}", index_path, e.what());
+        index->entries.clear();
+    }
+    if (index->version != Index::current_version) {
+        index = std::make_unique<Index>();
+    }
+}
+
+std::optional<GameInfo> GameScanner::GetGame(const std::string& path) {
+    Entry entry = GetEntry(path);
+    {
+        std::lock_guard lock{mutex};
+        stats.files++;
+    }
+    if (!entry.is_game) {
+        return std::nullopt;
+    }
+
+    GameInfo game;
+    game.path = path;
+    game.size = entry.size;
+    game.file_type = entry.file_type;
+    game.program_id = entry.program_id;
+    game.extdata_id = entry.extdata_id;
+
+    // Look for an update icon if available
+    if (!(entry.program_id & ~0x00040000FFFFFFFF)) {
+        const std::string update_path = Service::AM::GetTitleContentPath(
+            Service::FS::MediaType::SDMC, entry.program_id | 0x0000000E00000000);
+        if (FileUtil::Exists(update_path)) {
+            game.smdh = GetEntry(update_path).smdh;
+        }
+    }
+    if (game.smdh.empty()) {
+        game.smdh = std::move(entry.smdh);
+    }
+    return game;
+}
+
+GameScanner::Entry GameScanner::GetEntry(const std::string& path) {
+    const u64 size = FileUtil::GetSize(path);
+    const s64 modification_time = FileUtil::GetModificationTime(path);
+    {
+        std::lock_guard lock{mutex};
+        const auto it = index->entries.find(path);
+        if (it != index->entries.end() && it->second.size == size &&
+            it->second.modification_time == modification_time) {
+            it->second.used = true;
+            return it->second;
+        }
+    }
+
+    Entry entry = ReadEntry(path);
+    entry.size = size;
+    entry.modification_time = modification_time;
+    entry.used = true;
+
+    std::lock_guard lock{mutex};
+    stats.opened++;
+    if (!entry.is_encrypted) {
+        index->entries[path] = entry;
+        index_changed = true;
+    }
+    return entry;
+}
+
+GameScanner::Entry GameScanner::ReadEntry(const std::string& path) {
+    Entry entry;
+    std::unique_ptr<AppLoader> loader = GetLoader(path);
+    if (!loader) {
+        return entry;
+    }
+
+    bool executable = false;
+    const auto res = loader->IsExecutable(executable);
+    if (!executable && res != ResultStatus::ErrorEncrypted) {
+        return entry;
+    }
+
+    entry.is_game = true;
+    entry.is_encrypted = res == ResultStatus::ErrorEncrypted;
+    entry.file_type = loader->GetFileType();
+    loader->ReadProgramId(entry.program_id);
+    loader->ReadExtdataId(entry.extdata_id);
+    loader->ReadIcon(entry.smdh);
+    if (!IsValidSMDH(entry.smdh)) {
+        entry.smdh.clear();
+    }
+    return entry;
+}
+
+void GameScanner::FindFiles(const std::string& directory, unsigned int recursion,
+                            std::vector<std::string>& files,
+                            const std::function<void(const std::string&)>& on_directory) {
+    if (on_directory) {
+        on_directory(directory);
+    }
+
+    const auto callback = [&](u64* num_entries_out, const std::string& directory,
+                              const std::string& virtual_name) -> bool {
+        if (stop_processing) {
+            // Breaks the callback loop.
+            return false;
+        }
+
+        const std::string physical_name = directory + DIR_SEP + virtual_name;
+        const bool is_dir = FileUtil::IsDirectory(physical_name);
+        if (!is_dir && HasSupportedFileExtension(physical_name)) {
+            files.push_back(physical_name);
+        } else if (is_dir && recursion > 0) {
+            FindFiles(physical_name, recursion - 1, files, on_directory);
+        }
+        return true;
+    };
+    FileUtil::ForeachDirectoryEntry(nullptr, directory, callback);
+}
+
+} // namespace Loader
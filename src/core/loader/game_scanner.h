@@ -0,0 +1,116 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "common/common_types.h"
+#include "core/loader/loader.h"
+
+namespace Common {
+class ThreadPool;
+}
+
+namespace Loader {
+
+/// What the game list shows about a bootable file.
+struct GameInfo {
+    std::string path;
+    u64 size = 0;
+    FileType file_type = FileType::Unknown;
+    u64 program_id = 0;
+    u64 extdata_id = 0;
+    /// SMDH of the installed update if there is one, otherwise of the title itself. This is empty
+    /// if neither has a valid one.
+    std::vector<u8> smdh;
+};
+
+/**
+ * Finds bootable files in directories and reads their metadata, opening several files at once on
+ * a thread pool. The metadata is kept in an index on disk, keyed by the path, size and
+ * modification time of each file, so that files that did not change are not opened again.
+ */
+class GameScanner {
+public:
+    struct Stats {
+        u64 files = 0;  ///< Files with a supported extension that were looked at
+        u64 opened = 0; ///< Files that were not in the index and had to be opened
+    };
+
+    /**
+     * @param num_threads Number of threads opening files, besides the one calling Scan
+     * @param index_path File the index is kept in, or an empty string to not keep one. It is only
+     *                   loaded once the first scan starts.
+     */
+    GameScanner(std::size_t num_threads, std::string index_path);
+
+    /// Saves the index.
+    ~GameScanner();
+
+    /// Default location of the index, in the cache directory.
+    static std::string DefaultIndexPath();
+
+    /**
+     * Scans a directory for bootable files. Games are reported on the calling thread, in the
+     * order in which they are found.
+     * @param directory Directory to scan
+     * @param recursion Depth of subdirectories to scan as well
+     * @param on_game Called for every game found
+     * @param on_directory Called for every directory that was scanned, including `directory`
+     */
+    void Scan(const std::string& directory, unsigned int recursion,
+              const std::function<void(GameInfo&&)>& on_game,
+              const std::function<void(const std::string&)>& on_directory = {});
+
+    /// Makes a scan in progress return as soon as possible. Thread-safe.
+    void Cancel();
+
+    /**
+     * Writes the index to disk if anything in it changed. Files that were not looked at since the
+     * index was loaded are dropped from it, unless a scan was cancelled.
+     */
+    void SaveIndex();
+
+    Stats GetStats() const;
+
+private:
+    struct Entry;
+    struct Index;
+
+    /// Loads the index from disk, unless that was already done.
+    void LoadIndex();
+
+    /// Reads the metadata of a game, or returns std::nullopt if the file is not one.
+    std::optional<GameInfo> GetGame(const std::string& path);
+
+    /// Reads the metadata of a file out of the index, or out of the file if it is not up to date.
+    Entry GetEntry(const std::string& path);
+
+    /// Opens a file to read its metadata.
+    static Entry ReadEntry(const std::string& path);
+
+    /// Finds the bootable files in a directory and its subdirectories.
+    void FindFiles(const std::string& directory, unsigned int recursion,
+                   std::vector<std::string>& files,
+                   const std::function<void(const std::string&)>& on_directory);
+
+    std::unique_ptr<Common::ThreadPool> threads;
+    std::string index_path;
+
+    /// Protects the index and the stats, which are updated from the pool.
+    mutable std::mutex mutex;
+    std::unique_ptr<Index> index;
+    bool index_changed = false;
+    Stats stats;
+
+    std::atomic_bool stop_processing{false};
+};
+
+} // namespace Loader
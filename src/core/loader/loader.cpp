@@ -48,10 +48,10 @@ FileType GuessFromExtension(const std::string& extension_) {
     if (extension == ".elf" || extension == ".axf")
         return FileType::ELF;
 
-    if (extension == ".cci" || extension == ".3ds")
+    if (extension == ".cci" || extension == ".3ds" || extension == ".zcci")
         return FileType::CCI;
 
-    if (extension == ".cxi" || extension == ".app")
+    if (extension == ".cxi" || extension == ".app" || extension == ".zcxi")
         return FileType::CXI;
 
     if (extension == ".3dsx")
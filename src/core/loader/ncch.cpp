@@ -14,6 +14,7 @@
 #include "common/string_util.h"
 #include "common/swap.h"
 #include "core/core.h"
+#include "core/file_sys/compressed_image.h"
 #include "core/file_sys/ncch_container.h"
 #include "core/file_sys/title_metadata.h"
 #include "core/hle/kernel/process.h"
@@ -36,9 +37,16 @@ static const u64 UPDATE_MASK = 0x0000000e00000000;
 
 FileType AppLoader_NCCH::IdentifyType(FileUtil::IOFile& file) {
     u32 magic;
-    file.Seek(0x100, SEEK_SET);
-    if (1 != file.ReadArray<u32>(&magic, 1))
-        return FileType::Error;
+    if (FileSys::CompressedImage::IsCompressedImage(file)) {
+        // Compressed images are identified by the NCSD or NCCH they hold
+        if (FileSys::CompressedImage::ReadOnce(file, 0x100, sizeof(magic),
+                                               reinterpret_cast<u8*>(&magic)) != sizeof(magic))
+            return FileType::Error;
+    } else {
+        file.Seek(0x100, SEEK_SET);
+        if (1 != file.ReadArray<u32>(&magic, 1))
+            return FileType::Error;
+    }
 
     if (MakeMagic('N', 'C', 'S', 'D') == magic)
         return FileType::CCI;
@@ -83,8 +91,15 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
 
     std::vector<u8> code;
     u64_le program_id;
-    if (ResultStatus::Success == ReadCode(code) &&
-        ResultStatus::Success == ReadProgramId(program_id)) {
+    // TODO(yuriks): Not sure if the bss size is added to the page-aligned .data size or just
+    //               to the regular size. Playing it safe for now.
+    const u32 bss_page_size =
+        (overlay_ncch->exheader_header.codeset_info.bss_size + 0xFFF) & ~0xFFF;
+    const ResultStatus code_result = overlay_ncch->LoadCode(code, bss_page_size);
+    if (code_result != ResultStatus::Success)
+        return code_result;
+
+    if (ResultStatus::Success == ReadProgramId(program_id)) {
         std::string process_name = Common::StringFromFixedZeroTerminatedBuffer(
             (const char*)overlay_ncch->exheader_header.codeset_info.name, 8);
 
@@ -102,11 +117,6 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
         codeset->RODataSegment().size =
             overlay_ncch->exheader_header.codeset_info.ro.num_max_pages * Memory::PAGE_SIZE;
 
-        // TODO(yuriks): Not sure if the bss size is added to the page-aligned .data size or just
-        //               to the regular size. Playing it safe for now.
-        u32 bss_page_size = (overlay_ncch->exheader_header.codeset_info.bss_size + 0xFFF) & ~0xFFF;
-        code.resize(code.size() + bss_page_size, 0);
-
         codeset->DataSegment().offset =
             codeset->RODataSegment().offset + codeset->RODataSegment().size;
         codeset->DataSegment().addr = overlay_ncch->exheader_header.codeset_info.data.address;
@@ -114,11 +124,6 @@ ResultStatus AppLoader_NCCH::LoadExec(std::shared_ptr<Kernel::Process>& process)
             overlay_ncch->exheader_header.codeset_info.data.num_max_pages * Memory::PAGE_SIZE +
             bss_page_size;
 
-        // Apply patches now that the entire codeset (including .bss) has been allocated
-        const ResultStatus patch_result = overlay_ncch->ApplyCodePatch(code);
-        if (patch_result != ResultStatus::Success && patch_result != ResultStatus::ErrorNotUsed)
-            return patch_result;
-
         codeset->entrypoint = codeset->CodeSegment().addr;
         codeset->memory = std::move(code);
 
@@ -18,6 +18,7 @@
 #include "core/hle/kernel/memory.h"
 #include "core/hle/kernel/process.h"
 #include "core/hle/lock.h"
+#include "core/hw/gpu.h"
 #include "core/memory.h"
 #include "core/settings.h"
 #include "video_core/renderer_base.h"
@@ -406,6 +407,9 @@ u8* MemorySystem::GetPointer(const VAddr vaddr) {
 
     if (impl->current_page_table->attributes[vaddr >> PAGE_BITS] ==
         PageType::RasterizerCachedMemory) {
+        // The caller may access any amount of memory through the pointer, bypassing the hooks
+        GPU::WaitIdle();
+        GPU::FlushAllPendingFills();
         return GetPointerForRasterizerCache(vaddr);
     }
 
@@ -422,6 +426,9 @@ const u8* MemorySystem::GetPointer(const VAddr vaddr) const {
 
     if (impl->current_page_table->attributes[vaddr >> PAGE_BITS] ==
         PageType::RasterizerCachedMemory) {
+        // The caller may access any amount of memory through the pointer, bypassing the hooks
+        GPU::WaitIdle();
+        GPU::FlushAllPendingFills();
         return GetPointerForRasterizerCache(vaddr);
     }
 
@@ -575,6 +582,8 @@ void MemorySystem::RasterizerMarkRegionCached(PAddr start, u32 size, bool cached
 }
 
 void RasterizerFlushRegion(PAddr start, u32 size) {
+    GPU::FlushPendingFills(start, size);
+
     if (VideoCore::g_renderer == nullptr) {
         return;
     }
@@ -583,6 +592,8 @@ void RasterizerFlushRegion(PAddr start, u32 size) {
 }
 
 void RasterizerInvalidateRegion(PAddr start, u32 size) {
+    GPU::InvalidatePendingFills(start, size);
+
     if (VideoCore::g_renderer == nullptr) {
         return;
     }
@@ -591,6 +602,8 @@ void RasterizerInvalidateRegion(PAddr start, u32 size) {
 }
 
 void RasterizerFlushAndInvalidateRegion(PAddr start, u32 size) {
+    GPU::FlushPendingFills(start, size);
+
     // Since pages are unmapped on shutdown after video core is shutdown, the renderer may be
     // null here
     if (VideoCore::g_renderer == nullptr) {
@@ -601,6 +614,9 @@ void RasterizerFlushAndInvalidateRegion(PAddr start, u32 size) {
 }
 
 void RasterizerClearAll(bool flush) {
+    // Deferred fills are not kept anywhere else, so they are written even when not flushing
+    GPU::FlushAllPendingFills();
+
     // Since pages are unmapped on shutdown after video core is shutdown, the renderer may be
     // null here
     if (VideoCore::g_renderer == nullptr) {
@@ -611,6 +627,9 @@ void RasterizerClearAll(bool flush) {
 }
 
 void RasterizerFlushVirtualRegion(VAddr start, u32 size, FlushMode mode) {
+    // The GPU thread may still be writing to the region
+    GPU::WaitIdle();
+
     // Since pages are unmapped on shutdown after video core is shutdown, the renderer may be
     // null here
     if (VideoCore::g_renderer == nullptr) {
@@ -633,12 +652,15 @@ void RasterizerFlushVirtualRegion(VAddr start, u32 size, FlushMode mode) {
         auto* rasterizer = VideoCore::g_renderer->Rasterizer();
         switch (mode) {
         case FlushMode::Flush:
+            GPU::FlushPendingFills(physical_start, overlap_size);
             rasterizer->FlushRegion(physical_start, overlap_size);
             break;
         case FlushMode::Invalidate:
+            GPU::InvalidatePendingFills(physical_start, overlap_size);
             rasterizer->InvalidateRegion(physical_start, overlap_size);
             break;
         case FlushMode::FlushAndInvalidate:
+            GPU::FlushPendingFills(physical_start, overlap_size);
             rasterizer->FlushAndInvalidateRegion(physical_start, overlap_size);
             break;
         }
@@ -954,4 +976,8 @@ void MemorySystem::SetDSP(AudioCore::DspInterface& dsp) {
     impl->dsp = &dsp;
 }
 
+MMIORegionPointer MemorySystem::GetDspMemoryHandler() const {
+    return impl->dsp ? impl->dsp->GetDspMemoryHandler() : nullptr;
+}
+
 } // namespace Memory
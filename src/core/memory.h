@@ -377,6 +377,9 @@ public:
 
     void SetDSP(AudioCore::DspInterface& dsp);
 
+    /// Returns the handler DSP memory has to be mapped through, or nullptr to map it directly.
+    MMIORegionPointer GetDspMemoryHandler() const;
+
 private:
     template <typename T>
     T Read(const VAddr vaddr);
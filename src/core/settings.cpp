@@ -49,6 +49,8 @@ void Apply() {
         system.CoreTiming().UpdateClockSpeed(values.cpu_clock_percentage);
         Core::DSP().SetSink(values.sink_id, values.audio_device_id);
         Core::DSP().EnableStretching(values.enable_audio_stretching);
+        Core::DSP().SetStretchingMode(values.audio_stretching_mode,
+                                      values.audio_target_latency_ms);
 
         auto hid = Service::HID::GetModule(system);
         if (hid) {
@@ -86,6 +88,8 @@ void LogSettings() {
     log_setting("Renderer_SeparableShader", values.separable_shader);
     log_setting("Renderer_ShadersAccurateMul", values.shaders_accurate_mul);
     log_setting("Renderer_UseShaderJit", values.use_shader_jit);
+    log_setting("Renderer_UseAsyncGpu", values.use_async_gpu);
+    log_setting("Renderer_AsyncGpuQueueDepth", values.async_gpu_queue_depth);
     log_setting("Renderer_UseResolutionFactor", values.resolution_factor);
     log_setting("Renderer_FrameLimit", values.frame_limit);
     log_setting("Renderer_UseFrameLimitAlternate", values.use_frame_limit_alternate);
@@ -101,11 +105,16 @@ void LogSettings() {
     log_setting("Layout_UprightScreen", values.upright_screen);
     log_setting("Utility_DumpTextures", values.dump_textures);
     log_setting("Utility_CustomTextures", values.custom_textures);
+    log_setting("Utility_UseTitleCache", values.use_title_cache);
     log_setting("Utility_UseDiskShaderCache", values.use_disk_shader_cache);
     log_setting("Audio_EnableDspLle", values.enable_dsp_lle);
     log_setting("Audio_EnableDspLleMultithread", values.enable_dsp_lle_multithread);
+    log_setting("Audio_EnableDspLleDecoupled", values.enable_dsp_lle_decoupled);
+    log_setting("Audio_EnableDspHleMultithread", values.enable_dsp_hle_multithread);
     log_setting("Audio_OutputEngine", values.sink_id);
     log_setting("Audio_EnableAudioStretching", values.enable_audio_stretching);
+    log_setting("Audio_StretchingMode", values.audio_stretching_mode);
+    log_setting("Audio_TargetLatencyMs", values.audio_target_latency_ms);
     log_setting("Audio_OutputDevice", values.audio_device_id);
     log_setting("Audio_InputDeviceType", values.mic_input_type);
     log_setting("Audio_InputDevice", values.mic_input_device);
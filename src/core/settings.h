@@ -34,6 +34,11 @@ enum class LayoutOption {
     MobileLandscape,
 };
 
+enum class AudioStretchingMode {
+    SoundTouch = 0,
+    LatencyTargeting = 1,
+};
+
 enum class MicInputType {
     None,
     Real,
@@ -171,6 +176,8 @@ struct Values {
     bool use_disk_shader_cache;
     bool shaders_accurate_mul;
     bool use_shader_jit;
+    bool use_async_gpu;
+    u16 async_gpu_queue_depth;
     u16 resolution_factor;
     bool use_frame_limit_alternate;
     u16 frame_limit;
@@ -207,14 +214,19 @@ struct Values {
     bool dump_textures;
     bool custom_textures;
     bool preload_textures;
+    bool use_title_cache;
 
     bool use_vsync_new;
 
     // Audio
     bool enable_dsp_lle;
     bool enable_dsp_lle_multithread;
+    bool enable_dsp_lle_decoupled;
+    bool enable_dsp_hle_multithread;
     std::string sink_id;
     bool enable_audio_stretching;
+    AudioStretchingMode audio_stretching_mode;
+    u16 audio_target_latency_ms;
     std::string audio_device_id;
     float volume;
     MicInputType mic_input_type;
@@ -0,0 +1,175 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include "common/common_types.h"
+#include "common/file_util.h"
+#include "common/logging/backend.h"
+#include "common/logging/log.h"
+#include "common/scm_rev.h"
+#include "common/string_util.h"
+#include "core/file_sys/compressed_image.h"
+
+#undef _UNICODE
+#include <getopt.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+static void PrintHelp(const char* argv0) {
+    std::cout << "Usage: " << argv0
+              << " [options] <input> [output]\n"
+                 "Compresses a CCI (.3ds) or CXI image into a .zcci or .zcxi that Citra can load\n"
+                 "directly, or decompresses one again.\n"
+                 "-l, --level        Compression level, from 1 to 22 (default 12)\n"
+                 "-f, --frame-size   Size of the independently compressed frames in KiB\n"
+                 "                   (default 64). Smaller frames make random reads cheaper.\n"
+                 "-t, --threads      Number of compression threads (default: all cores)\n"
+                 "-d, --decompress   Decompress a compressed image\n"
+                 "-h, --help         Display this help and exit\n"
+                 "-v, --version      Output version information and exit\n";
+}
+
+static void PrintVersion() {
+    std::cout << "Citra image compressor " << Common::g_scm_branch << " " << Common::g_scm_desc
+              << std::endl;
+}
+
+/// Picks the name of the output from the extension of the input.
+static std::string OutputPath(const std::string& input, bool decompress) {
+    std::string path, filename, extension;
+    Common::SplitPath(input, &path, &filename, &extension);
+    extension = Common::ToLower(extension);
+    if (decompress) {
+        extension = extension == ".zcxi" ? ".cxi" : ".cci";
+    } else {
+        extension = extension == ".cxi" || extension == ".app" ? ".zcxi" : ".zcci";
+    }
+    return path + filename + extension;
+}
+
+static bool Decompress(const std::string& input, const std::string& output) {
+    FileSys::CompressedImage image(input);
+    if (!image.IsOpen()) {
+        return false;
+    }
+    FileUtil::IOFile file(output, "wb");
+    if (!file) {
+        LOG_ERROR(Frontend, "Could not create {}", output);
+        return false;
+    }
+
+    std::vector<u8> buffer(16 * 1024 * 1024);
+    for (u64 offset = 0; offset < image.GetSize(); offset += buffer.size()) {
+        const std::size_t length = image.Read(offset, buffer.size(), buffer.data());
+        if (length == 0 || file.WriteBytes(buffer.data(), length) != length) {
+            file.Close();
+            FileUtil::Delete(output);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Application entry point
+int main(int argc, char** argv) {
+    Log::AddBackend(std::make_unique<Log::ColorConsoleBackend>());
+    int option_index = 0;
+    char* endarg;
+
+    // This is just to be able to link against core
+    gladLoadGL();
+
+    int level = 12;
+    std::size_t frame_size = FileSys::CompressedImage::default_frame_size;
+    std::size_t threads = std::max(std::thread::hardware_concurrency(), 1U);
+    bool decompress = false;
+
+    static struct option long_options[] = {
+        {"level", required_argument, 0, 'l'},
+        {"frame-size", required_argument, 0, 'f'},
+        {"threads", required_argument, 0, 't'},
+        {"decompress", no_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {"version", no_argument, 0, 'v'},
+        {0, 0, 0, 0},
+    };
+
+    while (optind < argc) {
+        int arg = getopt_long(argc, argv, "l:f:t:dhv", long_options, &option_index);
+        if (arg == -1) {
+            break;
+        }
+        switch (static_cast<char>(arg)) {
+        case 'l':
+        case 'f':
+        case 't': {
+            const unsigned long value = strtoul(optarg, &endarg, 0);
+            if (endarg == optarg || *endarg != '\0' || value == 0) {
+                std::cout << "invalid value: " << optarg << "\n\n";
+                PrintHelp(argv[0]);
+                return -1;
+            }
+            if (arg == 'l') {
+                level = static_cast<int>(value);
+            } else if (arg == 'f') {
+                frame_size = value * 1024;
+            } else {
+                threads = value;
+            }
+            break;
+        }
+        case 'd':
+            decompress = true;
+            break;
+        case 'h':
+            PrintHelp(argv[0]);
+            return 0;
+        case 'v':
+            PrintVersion();
+            return 0;
+        default:
+            PrintHelp(argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind >= argc || argc - optind > 2) {
+        PrintHelp(argv[0]);
+        return -1;
+    }
+    const std::string input = argv[optind];
+    const std::string output = optind + 1 < argc ? argv[optind + 1] : OutputPath(input, decompress);
+
+    const auto start = std::chrono::steady_clock::now();
+    bool success;
+    if (decompress) {
+        success = Decompress(input, output);
+    } else {
+        success = FileSys::CompressImage(
+            input, output, frame_size, level, threads, [](u64 done, u64 total) {
+                std::cout << "\r" << done * 100 / total << "% (" << (done >> 20) << " of "
+                          << (total >> 20) << " MiB)" << std::flush;
+            });
+        std::cout << std::endl;
+    }
+    if (!success) {
+        std::cout << "Failed to " << (decompress ? "decompress " : "compress ") << input
+                  << std::endl;
+        return -1;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Wrote " << output << " (" << (FileUtil::GetSize(output) >> 20) << " MiB) in "
+              << elapsed.count() << "s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "audio_core/hle/hle.h"
+#include "audio_core/hle/shared_memory.h"
+#include "core/core_timing.h"
+#include "core/memory.h"
+
+namespace AudioCore::HLE {
+
+namespace {
+
+using Region = std::vector<u8>;
+
+constexpr u32 buffer_samples = 14 * 1024;
+constexpr std::size_t buffer_bytes = buffer_samples; // Large enough for every format below.
+
+/// ARM11 cycles per audio frame, as scheduled by DspHle.
+constexpr u64 audio_frame_ticks = samples_per_frame * 4096 * 2ull;
+
+/**
+ * Plays every source of a DspHle through its mixers. The sources are configured in region 1,
+ * which the DSP reads from while the frame counters of both regions are 0, so every frame is
+ * written to region 0.
+ */
+class DspFixture {
+public:
+    DspFixture(Memory::MemorySystem& memory, bool multithread)
+        : timing(1, 100), dsp(memory, timing, multithread) {
+        u8* const fcram = memory.GetFCRAMPointer(0);
+        u32 seed = 12345;
+        for (std::size_t i = 0; i < buffer_bytes * num_sources; i++) {
+            seed = seed * 1103515245 + 12345;
+            fcram[i] = static_cast<u8>(seed >> 16);
+        }
+
+        SharedMemory& shared = GetRegion(region1_offset);
+        for (std::size_t i = 0; i < num_sources; i++) {
+            ConfigureSource(shared, i);
+        }
+
+        DspConfiguration& config = shared.dsp_configuration;
+        config.volume[0] = 0.5f;
+        config.volume[1] = 0.3f;
+        config.volume[2] = 0.2f;
+        config.volume_0_dirty.Assign(1);
+        config.volume_1_dirty.Assign(1);
+        config.volume_2_dirty.Assign(1);
+    }
+
+    /// Runs the DSP for a number of audio frames and returns the region it wrote in each.
+    std::vector<Region> Run(std::size_t num_frames) {
+        std::vector<Region> result;
+        for (std::size_t frame = 0; frame < num_frames; frame++) {
+            RunFrame();
+            const u8* const written = dsp.GetDspMemory().data() + region0_offset;
+            result.emplace_back(written, written + sizeof(SharedMemory));
+        }
+        return result;
+    }
+
+    /// Advances emulated time by one audio frame, which ticks the DSP once.
+    void RunFrame() {
+        Core::Timing::Timer& timer = *timing.GetTimer(0);
+        const u64 end_ticks = timer.GetTicks() + audio_frame_ticks;
+        while (timer.GetTicks() < end_ticks) {
+            timer.AddTicks(timer.GetDowncount());
+            timer.Advance();
+            timer.SetNextSlice();
+        }
+    }
+
+private:
+    SharedMemory& GetRegion(u32 offset) {
+        return *reinterpret_cast<SharedMemory*>(dsp.GetDspMemory().data() + offset);
+    }
+
+    static void ConfigureSource(SharedMemory& shared, std::size_t i) {
+        using Config = SourceConfiguration::Configuration;
+        Config& config = shared.source_configurations.config[i];
+
+        // Mostly ADPCM, as that is the most expensive format to decode.
+        const bool adpcm = i % 4 != 0;
+        config.physical_address = static_cast<u32>(Memory::FCRAM_PADDR + i * buffer_bytes);
+        config.length = adpcm ? buffer_samples : buffer_samples / 4;
+        config.format.Assign(adpcm ? Config::Format::ADPCM : Config::Format::PCM16);
+        config.mono_or_stereo.Assign(adpcm ? Config::MonoOrStereo::Mono
+                                           : Config::MonoOrStereo::Stereo);
+        config.is_looping.Assign(1);
+        config.buffer_id = static_cast<u16>(i + 1);
+        config.enable = 1;
+        config.rate_multiplier = 0.5f + 0.05f * i;
+        config.interpolation_mode = static_cast<Config::InterpolationMode>(i % 3);
+        for (std::size_t mix = 0; mix < 3; mix++) {
+            for (std::size_t channel = 0; channel < 4; channel++) {
+                config.gain[mix][channel] = 0.1f * ((i + mix + channel) % 7);
+            }
+        }
+        for (std::size_t c = 0; c < 16; c++) {
+            shared.adpcm_coefficients.coeff[i][c] = static_cast<s16>((c % 2 ? -1 : 1) * 900);
+        }
+
+        config.embedded_buffer_dirty.Assign(1);
+        config.enable_dirty.Assign(1);
+        config.rate_multiplier_dirty.Assign(1);
+        config.interpolation_dirty.Assign(1);
+        config.gain_0_dirty.Assign(1);
+        config.gain_1_dirty.Assign(1);
+        config.gain_2_dirty.Assign(1);
+        config.adpcm_coefficients_dirty.Assign(adpcm ? 1 : 0);
+    }
+
+    Core::Timing timing;
+    DspHle dsp;
+};
+
+} // Anonymous namespace
+
+TEST_CASE("DSP HLE - multithreaded mixing is bit-identical to serial", "[audio_core][hle]") {
+    constexpr std::size_t num_frames = 100;
+
+    std::vector<Region> serial;
+    {
+        Memory::MemorySystem memory;
+        serial = DspFixture(memory, false).Run(num_frames);
+    }
+    std::vector<Region> multithread;
+    {
+        Memory::MemorySystem memory;
+        multithread = DspFixture(memory, true).Run(num_frames);
+    }
+
+    REQUIRE(serial.size() == num_frames);
+    REQUIRE(multithread.size() == num_frames);
+    // The sources play and are mixed into the output
+    const auto& last_frame = *reinterpret_cast<const SharedMemory*>(serial.back().data());
+    REQUIRE(last_frame.source_statuses.status[1].is_enabled != 0);
+    REQUIRE(std::any_of(std::begin(last_frame.final_samples.pcm16),
+                        std::end(last_frame.final_samples.pcm16),
+                        [](const auto& sample) { return sample[0] != 0 || sample[1] != 0; }));
+    for (std::size_t frame = 0; frame < num_frames; frame++) {
+        INFO("Frame " << frame);
+        REQUIRE(serial[frame] == multithread[frame]);
+    }
+}
+
+TEST_CASE("DSP HLE - benchmark", "[.][benchmark][audio_core][hle]") {
+    Memory::MemorySystem memory;
+    DspFixture serial(memory, false);
+    DspFixture multithread(memory, true);
+
+    BENCHMARK("24 sources, serial") {
+        serial.RunFrame();
+    };
+    BENCHMARK("24 sources, multithreaded") {
+        multithread.RunFrame();
+    };
+}
+
+} // namespace AudioCore::HLE
@@ -0,0 +1,154 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "audio_core/interpolate.h"
+
+namespace AudioCore::AudioInterp {
+
+namespace {
+
+using Interpolator = void (*)(State&, StereoBuffer16&, float, StereoFrame16&, std::size_t&);
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double amplitude = 16000.0;
+
+/// Linear sine sweep from f0 to f1 (in cycles per input sample) over `length` input samples.
+double Sweep(double t, double f0, double f1, double length) {
+    return amplitude * std::sin(2 * pi * (f0 * t + (f1 - f0) * t * t / (2 * length)));
+}
+
+/**
+ * Resamples a sine sweep frame by frame, the same way Source does, and returns the signal to noise
+ * ratio in dB of the output compared against the analytically resampled sweep.
+ */
+double MeasureSNR(Interpolator interpolator, double predelay, float rate, double f0, double f1) {
+    constexpr std::size_t num_frames = 200;
+    const double length = num_frames * samples_per_frame * rate;
+
+    StereoBuffer16 input;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(length) + 64; i++) {
+        const double t = static_cast<double>(i);
+        const s16 sample = static_cast<s16>(std::lround(Sweep(t, f0, f1, length)));
+        input.push_back({sample, sample});
+    }
+
+    State state;
+    std::vector<s16> output;
+    StereoFrame16 frame;
+    for (std::size_t f = 0; f < num_frames; f++) {
+        std::size_t outputi = 0;
+        interpolator(state, input, rate, frame, outputi);
+        for (std::size_t i = 0; i < outputi; i++) {
+            REQUIRE(frame[i][0] == frame[i][1]);
+            output.push_back(frame[i][0]);
+        }
+    }
+
+    // Interpolation uses the same 24-bit fixed point step as the implementation.
+    const double step = static_cast<double>(static_cast<u64>(rate * (1 << 24))) / (1 << 24);
+
+    double signal = 0;
+    double noise = 0;
+    // Skip the start-up transient while the filter history fills.
+    for (std::size_t i = 32; i < output.size(); i++) {
+        const double expected = Sweep(i * step - predelay, f0, f1, length);
+        signal += expected * expected;
+        noise += (output[i] - expected) * (output[i] - expected);
+    }
+    return 10 * std::log10(signal / noise);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("AudioInterp::Polyphase - passes samples through at unity rate", "[audio_core]") {
+    StereoBuffer16 input;
+    for (s16 i = 0; i < 400; i++) {
+        input.push_back({static_cast<s16>(i * 50), static_cast<s16>(-i * 50)});
+    }
+
+    State state;
+    StereoFrame16 frame;
+    std::size_t outputi = 0;
+    Polyphase(state, input, 1.0f, frame, outputi);
+
+    REQUIRE(outputi == frame.size());
+    // Eight-sample predelay: the history is zero-filled.
+    for (std::size_t i = 0; i < 8; i++) {
+        REQUIRE(frame[i][0] == 0);
+    }
+    for (std::size_t i = 8; i < frame.size(); i++) {
+        REQUIRE(frame[i][0] == static_cast<s16>((i - 8) * 50));
+        REQUIRE(frame[i][1] == static_cast<s16>(-static_cast<int>(i - 8) * 50));
+    }
+}
+
+TEST_CASE("AudioInterp::Polyphase - sine sweep SNR", "[audio_core]") {
+    // Sweep up to 0.3 cycles per sample (~10kHz at the native rate) of whichever of the input and
+    // output rates is lower.
+    for (const float rate : {0.67f, 0.9f, 1.3f}) {
+        const double f1 = 0.3 / std::max(rate, 1.0f);
+        const double polyphase = MeasureSNR(Polyphase, 8.0, rate, 0.001, f1);
+        const double linear = MeasureSNR(Linear, 2.0, rate, 0.001, f1);
+        INFO("rate=" << rate << " polyphase=" << polyphase << "dB linear=" << linear << "dB");
+        REQUIRE(polyphase > 60.0);
+        REQUIRE(polyphase > linear + 30.0);
+    }
+}
+
+TEST_CASE("AudioInterp::Polyphase - every kernel computes the same samples", "[audio_core]") {
+    const auto kernels = GetPolyphaseKernels();
+    REQUIRE(std::string(kernels.front().first) == "generic");
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> sample(-32768, 32767);
+    // Small enough that no sum of products overflows, large enough for the output to saturate.
+    std::uniform_int_distribution<int> coeff(-2048, 2047);
+    alignas(32) std::array<s16, polyphase_taps> coeffs;
+    // The input is read from an odd offset, as the kernels do not require it to be aligned.
+    std::array<s16, polyphase_taps + 1> left;
+    std::array<s16, polyphase_taps + 1> right;
+    for (int i = 0; i < 10000; i++) {
+        std::generate(coeffs.begin(), coeffs.end(), [&] { return static_cast<s16>(coeff(rng)); });
+        std::generate(left.begin(), left.end(), [&] { return static_cast<s16>(sample(rng)); });
+        std::generate(right.begin(), right.end(), [&] { return static_cast<s16>(sample(rng)); });
+
+        const auto expected = kernels.front().second(&left[1], &right[1], coeffs.data());
+        for (const auto& [name, kernel] : kernels) {
+            INFO("Kernel: " << name);
+            REQUIRE(kernel(&left[1], &right[1], coeffs.data()) == expected);
+        }
+    }
+}
+
+TEST_CASE("AudioInterp::Polyphase - benchmark", "[.][benchmark][audio_core]") {
+    // One audio frame's worth of resampling for every one of the 24 DSP sources.
+    constexpr std::size_t num_sources = 24;
+    constexpr float rate = 0.6734f;
+
+    std::vector<State> states(num_sources);
+    std::vector<StereoBuffer16> inputs(num_sources);
+    StereoFrame16 frame;
+
+    BENCHMARK("24 sources, one frame") {
+        for (std::size_t i = 0; i < num_sources; i++) {
+            if (inputs[i].size() < 512) {
+                for (s16 j = 0; j < 4096; j++) {
+                    inputs[i].push_back({static_cast<s16>(j * 7), static_cast<s16>(j * 13)});
+                }
+            }
+            std::size_t outputi = 0;
+            Polyphase(states[i], inputs[i], rate, frame, outputi);
+        }
+        return frame[0][0];
+    };
+}
+
+} // namespace AudioCore::AudioInterp
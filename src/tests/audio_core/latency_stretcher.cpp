@@ -0,0 +1,179 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "audio_core/latency_stretcher.h"
+#include "audio_core/null_sink.h"
+#include "audio_core/time_stretch.h"
+#include "common/ring_buffer.h"
+
+namespace AudioCore {
+
+namespace {
+
+using Fifo = Common::RingBuffer<s16, 0x2000, 2>;
+
+constexpr std::size_t callback_frames = 512;
+
+struct SimulationResult {
+    double mean_latency_ms = 0.0;
+    double max_latency_ms = 0.0;
+    std::size_t underruns = 0;
+};
+
+/**
+ * Emulates DspInterface feeding a sink: the emulated DSP pushes whole audio frames in bursts once
+ * per emulated video frame at `speed` times real time, while the sink pulls fixed-size callbacks
+ * at its native rate. Each interval of either is off by up to `jitter` times its length, as the
+ * emulator and the audio backend are both scheduled by the host. Only the second half of the run is
+ * measured, to let the controller settle.
+ */
+SimulationResult Simulate(LatencyStretcher& stretcher, double speed, double seconds,
+                          double jitter = 0.0) {
+    NullSink sink{""};
+    const double rate = sink.GetNativeSampleRate();
+    const double video_frame_time = 1.0 / 60.0;
+    const double callback_time = callback_frames / rate;
+
+    Fifo fifo;
+    std::array<s16, 2 * callback_frames> out;
+    StereoFrame16 frame;
+    double phase = 0.0;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> jittered(1.0 - jitter, 1.0 + jitter);
+
+    SimulationResult result;
+    std::size_t measured_callbacks = 0;
+    double produced_frames = 0.0;
+    double next_video_frame = 0.0;
+    double next_callback = 0.0;
+    while (next_callback < seconds) {
+        if (next_video_frame <= next_callback) {
+            // Everything the DSP generated since the last video frame arrives at once.
+            const double interval = video_frame_time * jittered(rng);
+            produced_frames += interval * speed * rate / frame.size();
+            for (; produced_frames >= 1.0; produced_frames -= 1.0) {
+                for (auto& sample : frame) {
+                    phase += 2 * 3.14159265358979323846 * 440.0 / rate;
+                    sample[0] = sample[1] = static_cast<s16>(8000.0 * std::sin(phase));
+                }
+                fifo.Push(frame.data(), frame.size());
+            }
+            next_video_frame += interval;
+            continue;
+        }
+
+        const bool measuring = next_callback > seconds / 2;
+        if (measuring) {
+            const double latency_ms =
+                (fifo.Size() + stretcher.BufferedFrames()) * 1000.0 / rate;
+            result.mean_latency_ms += latency_ms;
+            result.max_latency_ms = std::max(result.max_latency_ms, latency_ms);
+            measured_callbacks++;
+        }
+        if (stretcher.Process(fifo, out.data(), callback_frames) < callback_frames && measuring) {
+            result.underruns++;
+        }
+        next_callback += callback_time * jittered(rng);
+    }
+    result.mean_latency_ms /= measured_callbacks;
+    return result;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("LatencyStretcher - settles at the target latency", "[audio_core]") {
+    for (const double speed : {0.75, 0.95, 1.0, 1.1}) {
+        LatencyStretcher stretcher;
+        stretcher.SetTargetLatency(40);
+        const SimulationResult result = Simulate(stretcher, speed, 30.0);
+        INFO("speed=" << speed << " mean=" << result.mean_latency_ms
+                      << "ms max=" << result.max_latency_ms << "ms");
+        REQUIRE(result.underruns == 0);
+        REQUIRE(std::abs(result.mean_latency_ms - 40.0) < 8.0);
+        REQUIRE(std::abs(stretcher.Tempo() - speed) < 0.05);
+    }
+}
+
+TEST_CASE("LatencyStretcher - targets are at least the minimum latency", "[audio_core]") {
+    LatencyStretcher stretcher;
+    // A target of zero would have the stretcher try to keep the FIFO empty
+    stretcher.SetTargetLatency(0);
+    const SimulationResult result = Simulate(stretcher, 1.0, 30.0);
+    INFO("mean=" << result.mean_latency_ms << "ms max=" << result.max_latency_ms << "ms");
+    REQUIRE(std::abs(result.mean_latency_ms - LatencyStretcher::min_target_latency_ms) < 8.0);
+}
+
+TEST_CASE("LatencyStretcher - converges to the target with jittery timing", "[audio_core]") {
+    // Includes a target below the minimum, which the stretcher raises to the minimum
+    for (const u32 target : {0u, 40u, 80u}) {
+        LatencyStretcher stretcher;
+        stretcher.SetTargetLatency(target);
+        const SimulationResult result = Simulate(stretcher, 1.0, 30.0, 0.3);
+        const double expected = std::max(target, LatencyStretcher::min_target_latency_ms);
+        INFO("target=" << target << "ms mean=" << result.mean_latency_ms
+                       << "ms max=" << result.max_latency_ms << "ms");
+        REQUIRE(std::abs(result.mean_latency_ms - expected) < 10.0);
+    }
+}
+
+TEST_CASE("LatencyStretcher - drops a large backlog", "[audio_core]") {
+    LatencyStretcher stretcher;
+    stretcher.SetTargetLatency(40);
+
+    Fifo fifo;
+    const std::vector<s16> silence(2 * 8000, 0);
+    fifo.Push(silence);
+
+    std::array<s16, 2 * callback_frames> out;
+    REQUIRE(stretcher.Process(fifo, out.data(), callback_frames) == callback_frames);
+    const double latency_ms =
+        (fifo.Size() + stretcher.BufferedFrames()) * 1000.0 / native_sample_rate;
+    REQUIRE(latency_ms < 60.0);
+}
+
+TEST_CASE("LatencyStretcher - benchmark", "[.][benchmark][audio_core]") {
+    // The latency reached at a few emulation speeds, with the timing jitter of a loaded host
+    for (const double speed : {0.8, 1.0, 1.2}) {
+        LatencyStretcher stretcher;
+        stretcher.SetTargetLatency(40);
+        const SimulationResult result = Simulate(stretcher, speed, 30.0, 0.3);
+        std::printf("Speed %.1f, 40ms target: mean latency %.1fms, max %.1fms, %zu underruns\n",
+                    speed, result.mean_latency_ms, result.max_latency_ms, result.underruns);
+    }
+
+    // CPU cost of one sink callback with the FIFO kept topped up, for both stretchers.
+    Fifo fifo;
+    const std::vector<s16> input(2 * callback_frames, 1000);
+    std::array<s16, 2 * callback_frames> out;
+
+    LatencyStretcher latency_stretcher;
+    BENCHMARK("LatencyStretcher, 512 frame callback") {
+        fifo.Push(input);
+        return latency_stretcher.Process(fifo, out.data(), callback_frames);
+    };
+
+    TimeStretcher time_stretcher;
+    fifo.Discard();
+    BENCHMARK("TimeStretcher (SoundTouch), 512 frame callback") {
+        fifo.Push(input);
+        const std::size_t num_in = fifo.Size();
+        if (time_stretcher.UpdateRatio(num_in, callback_frames)) {
+            fifo.Consume([&](const s16* in, std::size_t count) {
+                time_stretcher.PushSamples(in, count);
+            });
+        } else {
+            fifo.Discard(num_in);
+        }
+        return time_stretcher.ReceiveSamples(out.data(), callback_frames);
+    };
+}
+
+} // namespace AudioCore
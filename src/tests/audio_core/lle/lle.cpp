@@ -0,0 +1,182 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "audio_core/lle/lle.h"
+#include "common/file_util.h"
+#include "core/core_timing.h"
+#include "core/memory.h"
+
+namespace AudioCore {
+
+namespace {
+
+using Threading = DspLle::Threading;
+
+constexpr std::pair<Threading, const char*> threading_modes[] = {
+    {Threading::SingleThread, "single thread"},
+    {Threading::Lockstep, "lockstep"},
+    {Threading::Decoupled, "decoupled"},
+};
+
+/// One slice of the DSP is 16384 DSP cycles, or 32768 CPU cycles.
+constexpr u64 cpu_cycles_per_slice = 2 * 16384;
+
+/// Loads the DSP firmware, which is copyrighted, so it has to be dumped from a console.
+std::optional<std::vector<u8>> LoadFirmware() {
+    const char* firmware_path = std::getenv("CITRA_DSP_FIRMWARE");
+    if (firmware_path == nullptr) {
+        return std::nullopt;
+    }
+    FileUtil::IOFile file(firmware_path, "rb");
+    REQUIRE(file.IsOpen());
+    std::vector<u8> firmware(file.GetSize());
+    REQUIRE(file.ReadBytes(firmware.data(), firmware.size()) == firmware.size());
+    return firmware;
+}
+
+/// Advances emulated time by the given number of DSP slices. The emulated CPU does nothing else.
+void RunSlices(Core::Timing& timing, u64 num_slices) {
+    Core::Timing::Timer& timer = *timing.GetTimer(0);
+    const u64 end_ticks = timer.GetTicks() + num_slices * cpu_cycles_per_slice;
+    while (timer.GetTicks() < end_ticks) {
+        timer.AddTicks(timer.GetDowncount());
+        timer.Advance();
+        timer.SetNextSlice();
+    }
+}
+
+/// Advances emulated time until the DSP has written at least `size` bytes to the pipe.
+bool WaitForPipe(DspLle& dsp, Core::Timing& timing, DspPipe pipe, std::size_t size) {
+    for (int i = 0; i < 1000; i++) {
+        if (dsp.GetPipeReadableSize(pipe) >= size) {
+            return true;
+        }
+        RunSlices(timing, 1);
+    }
+    return false;
+}
+
+/**
+ * Changes the state of the audio pipe and reads the DSP's reply, which lists the addresses of
+ * the structures shared with the application.
+ */
+std::vector<u16> ChangeAudioState(DspLle& dsp, Core::Timing& timing, u8 state_change) {
+    dsp.PipeWrite(DspPipe::Audio, {state_change, 0, 0, 0});
+    REQUIRE(WaitForPipe(dsp, timing, DspPipe::Audio, sizeof(u16)));
+    u16 count;
+    std::memcpy(&count, dsp.PipeRead(DspPipe::Audio, sizeof(u16)).data(), sizeof(u16));
+    REQUIRE(count > 0);
+    REQUIRE(WaitForPipe(dsp, timing, DspPipe::Audio, count * sizeof(u16)));
+    const std::vector<u8> data = dsp.PipeRead(DspPipe::Audio, count * sizeof(u16));
+    std::vector<u16> addresses(count);
+    std::memcpy(addresses.data(), data.data(), data.size());
+    REQUIRE(dsp.GetPipeReadableSize(DspPipe::Audio) == 0);
+    return addresses;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DSP LLE - pipe replies arrive in order", "[audio_core][lle]") {
+    const auto firmware = LoadFirmware();
+    if (!firmware) {
+        WARN("Set CITRA_DSP_FIRMWARE to the path of a dumped dspfirm.cdc to run this test");
+        return;
+    }
+
+    constexpr u8 initialize = 0;
+    constexpr u8 shutdown = 1;
+    constexpr u8 wakeup = 2;
+
+    std::optional<std::vector<u16>> expected;
+    for (const auto& [threading, name] : threading_modes) {
+        INFO("Threading: " << name);
+        Memory::MemorySystem memory;
+        Core::Timing timing(1, 100);
+        DspLle dsp(memory, timing, threading);
+        dsp.LoadComponent(*firmware);
+
+        // Each reply is read whole before the next request is written, so a reply that is
+        // reordered or torn by the DSP thread shows up as a different list of addresses
+        const std::vector<u16> addresses = ChangeAudioState(dsp, timing, initialize);
+        dsp.PipeWrite(DspPipe::Audio, {shutdown, 0, 0, 0});
+        RunSlices(timing, 16);
+        REQUIRE(ChangeAudioState(dsp, timing, wakeup) == addresses);
+
+        dsp.UnloadComponent();
+
+        // Every threading mode sees the same replies
+        if (expected) {
+            REQUIRE(addresses == *expected);
+        } else {
+            expected = addresses;
+        }
+    }
+}
+
+TEST_CASE("DSP LLE - CPU accesses to DSP memory are locked in decoupled mode",
+          "[audio_core][lle]") {
+    for (const auto& [threading, name] : threading_modes) {
+        INFO("Threading: " << name);
+        Memory::MemorySystem memory;
+        Core::Timing timing(1, 100);
+        DspLle dsp(memory, timing, threading);
+        const Memory::MMIORegionPointer handler = dsp.GetDspMemoryHandler();
+        if (threading != Threading::Decoupled) {
+            // The DSP only runs while the emulated CPU waits, so memory is mapped directly
+            REQUIRE(handler == nullptr);
+            continue;
+        }
+        REQUIRE(handler != nullptr);
+
+        constexpr VAddr offset = 0x40010;
+        constexpr VAddr addr = Memory::DSP_RAM_VADDR + offset;
+        REQUIRE(handler->IsValidAddress(addr));
+        REQUIRE_FALSE(handler->IsValidAddress(Memory::DSP_RAM_VADDR + Memory::DSP_RAM_SIZE));
+
+        handler->Write32(addr, 0x12345678);
+        u32 stored;
+        std::memcpy(&stored, dsp.GetDspMemory().data() + offset, sizeof(stored));
+        REQUIRE(stored == 0x12345678);
+        REQUIRE(handler->Read32(addr) == 0x12345678);
+        REQUIRE(handler->Read16(addr + 2) == 0x1234);
+
+        // Blocks past the end of DSP memory are refused rather than clipped
+        std::array<u8, 8> block{};
+        REQUIRE_FALSE(handler->ReadBlock(Memory::DSP_RAM_VADDR + Memory::DSP_RAM_SIZE - 4,
+                                         block.data(), block.size()));
+    }
+}
+
+TEST_CASE("DSP LLE - benchmark", "[.][benchmark][audio_core][lle]") {
+    const auto firmware = LoadFirmware();
+    if (!firmware) {
+        WARN("Set CITRA_DSP_FIRMWARE to the path of a dumped dspfirm.cdc to run this benchmark");
+        return;
+    }
+
+    // Measures how fast the DSP itself runs with each scheduling mode. Running in real time takes
+    // 1000 slices in 1000 * 32768 / BASE_CLOCK_RATE_ARM11 seconds, about 122 ms.
+    constexpr u64 num_slices = 1000;
+    for (const auto& [threading, name] : threading_modes) {
+        Memory::MemorySystem memory;
+        Core::Timing timing(1, 100);
+        DspLle dsp(memory, timing, threading);
+        dsp.LoadComponent(*firmware);
+
+        BENCHMARK(name) {
+            RunSlices(timing, num_slices);
+        };
+
+        dsp.UnloadComponent();
+    }
+}
+
+} // namespace AudioCore
@@ -0,0 +1,134 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/ring_buffer.h"
+
+namespace Common {
+
+TEST_CASE("RingBuffer: Basic Tests", "[common]") {
+    RingBuffer<char, 4, 1> buf;
+
+    // Pushing values into a ring buffer with space should succeed.
+    for (std::size_t i = 0; i < 4; i++) {
+        const char elem = static_cast<char>(i);
+        const std::size_t count = buf.Push(&elem, 1);
+        REQUIRE(count == 1);
+    }
+
+    REQUIRE(buf.Size() == 4);
+
+    // Pushing values into a full ring buffer should fail.
+    {
+        const char elem = static_cast<char>(42);
+        const std::size_t count = buf.Push(&elem, 1);
+        REQUIRE(count == 0);
+    }
+
+    REQUIRE(buf.Size() == 4);
+
+    // Popping multiple values from a ring buffer with values should succeed.
+    {
+        const std::vector<char> popped = buf.Pop(2);
+        REQUIRE(popped.size() == 2);
+        REQUIRE(popped[0] == 0);
+        REQUIRE(popped[1] == 1);
+    }
+
+    REQUIRE(buf.Size() == 2);
+
+    // Pushing two values wraps around the end of the storage.
+    {
+        const std::array<char, 2> elems{5, 6};
+        REQUIRE(buf.Push(elems.data(), elems.size()) == 2);
+    }
+
+    REQUIRE(buf.Size() == 4);
+
+    // Consuming sees the wrapped contents as two contiguous runs, without copying.
+    {
+        std::vector<std::size_t> runs;
+        std::vector<char> consumed;
+        const std::size_t count = buf.Consume([&](const char* slots, std::size_t slot_count) {
+            runs.push_back(slot_count);
+            consumed.insert(consumed.end(), slots, slots + slot_count);
+        });
+        REQUIRE(count == 4);
+        REQUIRE(runs == std::vector<std::size_t>{2, 2});
+        REQUIRE(consumed == std::vector<char>{2, 3, 5, 6});
+    }
+
+    REQUIRE(buf.Size() == 0);
+
+    // Discarding only drops as much as is available.
+    {
+        const char elem = static_cast<char>(7);
+        buf.Push(&elem, 1);
+        REQUIRE(buf.Discard(3) == 1);
+        REQUIRE(buf.Size() == 0);
+    }
+}
+
+TEST_CASE("RingBuffer: Threaded Test", "[common]") {
+    RingBuffer<char, 8, 2> buf;
+    const char seed = 42;
+    const std::size_t count = 1000000;
+    std::size_t full = 0;
+    std::size_t empty = 0;
+    // Catch assertions are not thread-safe, so mismatches are only counted on the threads.
+    std::size_t mismatches = 0;
+
+    const auto next_value = [](std::array<char, 2>& value) {
+        value[0] += 1;
+        value[1] += 2;
+    };
+
+    std::thread producer{[&] {
+        std::array<char, 2> value = {seed, 1};
+        std::size_t i = 0;
+        while (i < count) {
+            if (buf.Push(&value[0], 1) > 0) {
+                i++;
+                next_value(value);
+            } else {
+                full++;
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    std::thread consumer{[&] {
+        std::array<char, 2> value = {seed, 1};
+        std::size_t i = 0;
+        while (i < count) {
+            const std::size_t c = buf.Consume([&](const char* slots, std::size_t slot_count) {
+                for (std::size_t j = 0; j < slot_count; j++) {
+                    if (slots[2 * j + 0] != value[0] || slots[2 * j + 1] != value[1]) {
+                        mismatches++;
+                    }
+                    next_value(value);
+                }
+            });
+            if (c > 0) {
+                i += c;
+            } else {
+                empty++;
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    producer.join();
+    consumer.join();
+
+    CAPTURE(full, empty);
+    REQUIRE(mismatches == 0);
+    REQUIRE(buf.Size() == 0);
+}
+
+} // namespace Common
@@ -0,0 +1,292 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/compressed_image.h"
+#include "core/file_sys/ncch_container.h"
+#include "core/file_sys/romfs_reader.h"
+#include "core/loader/loader.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/// Data that compresses about as well as a title image: runs of padding between random bytes.
+std::vector<u8> MakeImage(std::size_t size) {
+    std::mt19937 rng(static_cast<u32>(size));
+    std::vector<u8> data(size, 0xFF);
+    for (std::size_t offset = 0; offset < size; offset += 4096) {
+        const std::size_t length = std::min<std::size_t>(rng() % 4096, size - offset);
+        for (std::size_t i = 0; i < length; i++) {
+            data[offset + i] = static_cast<u8>(rng() % 16);
+        }
+    }
+    return data;
+}
+
+class TestImage {
+public:
+    explicit TestImage(const std::vector<u8>& data)
+        : dir("compressed_image_test"), path(dir.Path("image.cci")),
+          compressed_path(path + ".z") {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    Tests::TempDirectory dir;
+    std::string path;
+    std::string compressed_path;
+};
+
+/// The sections of the NCCH made by MakeNcch.
+struct NcchContents {
+    u64 program_id;
+    std::vector<u8> code;
+    std::vector<u8> icon;
+    std::vector<u8> romfs;
+};
+
+/// Lays out a decrypted NCCH with an ExHeader, an ExeFS holding .code and icon, and a RomFS.
+std::vector<u8> MakeNcch(const NcchContents& contents) {
+    constexpr u32 media_unit = 0x200;
+    const auto align = [](std::size_t value, std::size_t alignment) {
+        return static_cast<u32>((value + alignment - 1) / alignment * alignment);
+    };
+    const u32 exefs_offset = sizeof(NCCH_Header) + sizeof(ExHeader_Header);
+    const u32 icon_offset = align(contents.code.size(), media_unit);
+    const u32 exefs_size = align(sizeof(ExeFs_Header) + icon_offset + contents.icon.size(), 0x1000);
+    const u32 romfs_offset = exefs_offset + exefs_size;
+    // The RomFS data starts after a 0x1000 byte IVFC header
+    const u32 romfs_size = align(0x1000 + contents.romfs.size(), media_unit);
+    std::vector<u8> ncch(romfs_offset + romfs_size, 0);
+
+    NCCH_Header header{};
+    header.magic = Loader::MakeMagic('N', 'C', 'C', 'H');
+    header.content_size = static_cast<u32>(ncch.size() / media_unit);
+    header.program_id = contents.program_id;
+    header.extended_header_size = 0x400;
+    header.is_executable.Assign(1);
+    header.no_crypto.Assign(1);
+    header.exefs_offset = exefs_offset / media_unit;
+    header.exefs_size = exefs_size / media_unit;
+    header.romfs_offset = romfs_offset / media_unit;
+    header.romfs_size = romfs_size / media_unit;
+    std::memcpy(ncch.data(), &header, sizeof(header));
+
+    ExHeader_Header exheader{};
+    std::memcpy(exheader.codeset_info.name, "test", 4);
+    exheader.codeset_info.text.code_size = static_cast<u32>(contents.code.size());
+    exheader.system_info.jump_id = contents.program_id;
+    exheader.arm11_system_local_caps.program_id = contents.program_id;
+    std::memcpy(ncch.data() + sizeof(NCCH_Header), &exheader, sizeof(exheader));
+
+    ExeFs_Header exefs{};
+    std::strcpy(exefs.section[0].name, ".code");
+    exefs.section[0].size = static_cast<u32>(contents.code.size());
+    std::strcpy(exefs.section[1].name, "icon");
+    exefs.section[1].offset = icon_offset;
+    exefs.section[1].size = static_cast<u32>(contents.icon.size());
+    std::memcpy(ncch.data() + exefs_offset, &exefs, sizeof(exefs));
+    std::copy(contents.code.begin(), contents.code.end(),
+              ncch.begin() + exefs_offset + sizeof(ExeFs_Header));
+    std::copy(contents.icon.begin(), contents.icon.end(),
+              ncch.begin() + exefs_offset + sizeof(ExeFs_Header) + icon_offset);
+    std::copy(contents.romfs.begin(), contents.romfs.end(), ncch.begin() + romfs_offset + 0x1000);
+    return ncch;
+}
+
+/// Reads the sections of a title through the loader, as booting it would.
+NcchContents LoadNcch(const std::string& path) {
+    const auto loader = Loader::GetLoader(path);
+    REQUIRE(loader != nullptr);
+    NcchContents contents;
+    REQUIRE(loader->ReadProgramId(contents.program_id) == Loader::ResultStatus::Success);
+    REQUIRE(loader->ReadCode(contents.code) == Loader::ResultStatus::Success);
+    REQUIRE(loader->ReadIcon(contents.icon) == Loader::ResultStatus::Success);
+
+    std::shared_ptr<RomFSReader> romfs;
+    REQUIRE(loader->ReadRomFS(romfs) == Loader::ResultStatus::Success);
+    contents.romfs.resize(romfs->GetSize());
+    REQUIRE(romfs->ReadFile(0, contents.romfs.size(), contents.romfs.data()) ==
+            contents.romfs.size());
+    return contents;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("CompressedImage - random reads match the original", "[core][file_sys]") {
+    constexpr std::size_t frame_size = 64 * 1024;
+    const std::vector<u8> data = MakeImage(20 * frame_size + 1234);
+    const TestImage test_image(data);
+    u64 progress = 0;
+    REQUIRE(CompressImage(test_image.path, test_image.compressed_path, frame_size, 3, 3,
+                          [&](u64 done, u64 total) {
+                              REQUIRE(total == data.size());
+                              progress = done;
+                          }));
+    REQUIRE(progress == data.size());
+    REQUIRE(fs::file_size(test_image.compressed_path) < data.size() / 2);
+
+    FileUtil::IOFile raw(test_image.path, "rb");
+    FileUtil::IOFile compressed(test_image.compressed_path, "rb");
+    REQUIRE(!CompressedImage::IsCompressedImage(raw));
+    REQUIRE(CompressedImage::IsCompressedImage(compressed));
+
+    CompressedImage image(test_image.compressed_path);
+    REQUIRE(image.IsOpen());
+    REQUIRE(image.GetSize() == data.size());
+
+    std::mt19937 rng(42);
+    std::vector<u8> buffer(3 * frame_size);
+    for (int i = 0; i < 200; i++) {
+        const std::size_t offset = rng() % data.size();
+        const std::size_t length =
+            std::min<std::size_t>(rng() % buffer.size(), data.size() - offset);
+        REQUIRE(image.Read(offset, length, buffer.data()) == length);
+        REQUIRE(std::equal(buffer.begin(), buffer.begin() + length, data.begin() + offset));
+    }
+    // Reads are cut off at the end of the image.
+    REQUIRE(image.Read(data.size() - 10, 100, buffer.data()) == 10);
+    REQUIRE(image.Read(data.size(), 100, buffer.data()) == 0);
+
+    REQUIRE(CompressedImage::ReadOnce(compressed, frame_size - 2, 4, buffer.data()) == 4);
+    REQUIRE(std::equal(buffer.begin(), buffer.begin() + 4, data.begin() + frame_size - 2));
+}
+
+TEST_CASE("ImageFile - reads compressed and plain images alike", "[core][file_sys]") {
+    const std::vector<u8> data = MakeImage(300000);
+    const TestImage test_image(data);
+    REQUIRE(CompressImage(test_image.path, test_image.compressed_path, 4096, 3, 1));
+
+    for (const auto& path : {test_image.path, test_image.compressed_path}) {
+        ImageFile file(path);
+        REQUIRE(file.IsOpen());
+        REQUIRE(file.IsCompressed() == (path == test_image.compressed_path));
+        REQUIRE(file.GetSize() == data.size());
+
+        std::vector<u8> buffer(10000);
+        REQUIRE(file.Seek(12345, SEEK_SET));
+        REQUIRE(file.ReadBytes(buffer.data(), 5000) == 5000);
+        REQUIRE(file.ReadBytes(buffer.data() + 5000, 5000) == 5000);
+        REQUIRE(std::equal(buffer.begin(), buffer.end(), data.begin() + 12345));
+
+        REQUIRE(file.Seek(-100, SEEK_END));
+        REQUIRE(file.ReadBytes(buffer.data(), buffer.size()) == 100);
+        REQUIRE(std::equal(buffer.begin(), buffer.begin() + 100, data.end() - 100));
+    }
+}
+
+TEST_CASE("CompressedImage - a compressed title loads like the original", "[core][file_sys]") {
+    NcchContents expected;
+    expected.program_id = 0x00040000'0C0DE000;
+    expected.code = MakeImage(0x23456);
+    expected.icon = std::vector<u8>(0x36C0, 0x5A);
+    expected.romfs = MakeImage(300000);
+
+    const Tests::TempDirectory dir("compressed_image_test");
+    const std::string path = dir.Path("title.cxi");
+    const std::string compressed_path = dir.Path("title.zcxi");
+    const std::vector<u8> ncch = MakeNcch(expected);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(ncch.data()), ncch.size());
+    }
+    REQUIRE(CompressImage(path, compressed_path, 4096, 3, 1));
+    REQUIRE(fs::file_size(compressed_path) < ncch.size());
+    REQUIRE(Loader::IdentifyFile(compressed_path) == Loader::FileType::CXI);
+
+    for (const auto& title_path : {path, compressed_path}) {
+        INFO("Title: " << title_path);
+        const NcchContents contents = LoadNcch(title_path);
+        REQUIRE(contents.program_id == expected.program_id);
+        REQUIRE(contents.code == expected.code);
+        REQUIRE(contents.icon == expected.icon);
+        // The RomFS is padded to the media unit
+        REQUIRE(contents.romfs.size() >= expected.romfs.size());
+        REQUIRE(std::equal(expected.romfs.begin(), expected.romfs.end(), contents.romfs.begin()));
+    }
+}
+
+TEST_CASE("CompressedImage - a damaged seek table is rejected", "[core][file_sys]") {
+    const TestImage test_image(MakeImage(100000));
+    REQUIRE(CompressImage(test_image.path, test_image.compressed_path, 4096, 3, 1));
+    {
+        std::fstream file(test_image.compressed_path,
+                          std::ios::binary | std::ios::in | std::ios::out);
+        // The top byte of the compressed size of the last frame
+        file.seekp(-14, std::ios::end);
+        file.put(0x7F);
+    }
+    REQUIRE(!CompressedImage(test_image.compressed_path).IsOpen());
+}
+
+TEST_CASE("CompressedImage - benchmark", "[.][benchmark][core][file_sys]") {
+    constexpr int num_reads = 20000;
+    constexpr std::size_t read_size = 16 * 1024;
+
+    // A real image if there is one, as generated data says little about the compression ratio.
+    std::vector<u8> data;
+    if (const char* ncch_path = std::getenv("CITRA_NCCH")) {
+        FileUtil::IOFile file(ncch_path, "rb");
+        data.resize(file.GetSize());
+        file.ReadBytes(data.data(), data.size());
+    } else {
+        WARN("Set CITRA_NCCH to the path of a title image to benchmark with real data");
+        data = MakeImage(256 * 1024 * 1024);
+    }
+    const TestImage test_image(data);
+
+    BENCHMARK("Compress, 1 thread") {
+        CompressImage(test_image.path, test_image.compressed_path,
+                      CompressedImage::default_frame_size, 3, 1);
+    };
+    BENCHMARK("Compress, 8 threads") {
+        CompressImage(test_image.path, test_image.compressed_path,
+                      CompressedImage::default_frame_size, 3, 8);
+    };
+    std::printf("Compressed image: %.1f%% of the original size\n",
+                100.0 * fs::file_size(test_image.compressed_path) / data.size());
+
+    const auto random_reads = [&](auto&& read) {
+        std::mt19937 rng(42);
+        std::vector<u8> buffer(read_size);
+        for (int i = 0; i < num_reads; i++) {
+            read(rng() % (data.size() - read_size), buffer.data());
+        }
+        return buffer[0];
+    };
+
+    FileUtil::IOFile raw(test_image.path, "rb");
+    BENCHMARK("20000 random reads of 16 KiB, raw file") {
+        return random_reads([&](u64 offset, u8* buffer) {
+            raw.Seek(offset, SEEK_SET);
+            raw.ReadBytes(buffer, read_size);
+        });
+    };
+    CompressedImage image(test_image.compressed_path);
+    BENCHMARK("20000 random reads of 16 KiB, compressed image") {
+        return random_reads([&](u64 offset, u8* buffer) { image.Read(offset, read_size, buffer); });
+    };
+    DirectRomFSReader romfs(ImageFile(test_image.compressed_path), 0, data.size());
+    BENCHMARK("20000 random reads of 16 KiB, RomFS reader over a compressed image") {
+        return random_reads(
+            [&](u64 offset, u8* buffer) { romfs.ReadFile(offset, read_size, buffer); });
+    };
+}
+
+} // namespace FileSys
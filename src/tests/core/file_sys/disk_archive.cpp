@@ -0,0 +1,207 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/disk_archive.h"
+#include "core/file_sys/errors.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<DiskFile> OpenDiskFile(const std::string& path) {
+    Mode mode;
+    mode.hex = 0;
+    mode.read_flag.Assign(1);
+    mode.write_flag.Assign(1);
+    return std::make_unique<DiskFile>(FileUtil::IOFile(path, "r+b"), mode, nullptr);
+}
+
+class TestFile {
+public:
+    TestFile() : dir("disk_file_test"), path(dir.Path("file")) {
+        FileUtil::IOFile(path, "wb");
+    }
+
+    std::unique_ptr<DiskFile> Open() const {
+        return OpenDiskFile(path);
+    }
+
+    std::vector<u8> HostContents() const {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    Tests::TempDirectory dir;
+    std::string path;
+};
+
+} // Anonymous namespace
+
+TEST_CASE("DiskFile - buffered writes are read back and reach the host", "[core][file_sys]") {
+    const TestFile test_file;
+    auto file = test_file.Open();
+
+    std::vector<u8> expected(3000);
+    for (std::size_t offset = 0; offset < expected.size(); offset += 100) {
+        std::vector<u8> chunk(100, static_cast<u8>(offset / 100 + 1));
+        REQUIRE(file->Write(offset, chunk.size(), true, chunk.data()).Unwrap() == chunk.size());
+        std::copy(chunk.begin(), chunk.end(), expected.begin() + offset);
+    }
+    // Overwrites part of the buffered range.
+    const std::vector<u8> patch(50, 0xAA);
+    file->Write(1025, patch.size(), true, patch.data());
+    std::copy(patch.begin(), patch.end(), expected.begin() + 1025);
+    REQUIRE(file->GetSize() == expected.size());
+
+    std::vector<u8> read(expected.size());
+    REQUIRE(file->Read(0, read.size(), read.data()).Unwrap() == read.size());
+    REQUIRE(read == expected);
+
+    // A write elsewhere, larger than the buffer, and one past the end.
+    const std::vector<u8> large(DiskFile::write_buffer_size, 0x55);
+    file->Write(0, large.size(), false, large.data());
+    expected.resize(large.size() + 10, 0);
+    std::copy(large.begin(), large.end(), expected.begin());
+    file->Write(large.size() + 8, 2, false, patch.data());
+    expected[large.size() + 8] = expected[large.size() + 9] = 0xAA;
+    REQUIRE(file->GetSize() == expected.size());
+
+    file->Close();
+    REQUIRE(test_file.HostContents() == expected);
+}
+
+TEST_CASE("DiskFile - small writes reach the host in fewer writes", "[core][file_sys]") {
+    constexpr std::size_t num_writes = 1024;
+    const TestFile test_file;
+
+    // Writes at least as large as the buffer go straight to the host, one write each
+    const std::vector<u8> large(DiskFile::write_buffer_size, 0x55);
+    auto unbuffered = test_file.Open();
+    for (std::size_t i = 0; i < 16; i++) {
+        unbuffered->Write(i * large.size(), large.size(), true, large.data());
+    }
+    REQUIRE(unbuffered->GetHostWriteCount() == 16);
+    unbuffered->Close();
+
+    // Small flushed writes in a row are coalesced, so the host sees one write per buffer-full
+    const std::vector<u8> chunk(64, 0x42);
+    auto buffered = test_file.Open();
+    for (std::size_t i = 0; i < num_writes; i++) {
+        buffered->Write(i * chunk.size(), chunk.size(), true, chunk.data());
+    }
+    buffered->Close();
+    const u64 host_writes = buffered->GetHostWriteCount();
+    REQUIRE(host_writes < num_writes);
+    REQUIRE(host_writes <= num_writes * chunk.size() / DiskFile::write_buffer_size + 1);
+}
+
+TEST_CASE("DiskFile - buffered writes are flushed after a delay", "[core][file_sys]") {
+    const TestFile test_file;
+    auto file = test_file.Open();
+    const std::vector<u8> data(16, 0x42);
+    file->Write(0, data.size(), false, data.data());
+    REQUIRE(test_file.HostContents().empty());
+
+    const auto deadline = std::chrono::steady_clock::now() + 3 * DiskFile::write_back_delay;
+    while (test_file.HostContents().empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(test_file.HostContents() == data);
+}
+
+TEST_CASE("DiskFile - shutting down the flusher writes out buffered writes", "[core][file_sys]") {
+    const TestFile test_file;
+    auto file = test_file.Open();
+    const std::vector<u8> data(16, 0x42);
+    file->Write(0, data.size(), false, data.data());
+    DiskFile::ShutdownFlusher();
+    REQUIRE(test_file.HostContents() == data);
+
+    // A later buffered write starts it again
+    file->Write(data.size(), data.size(), false, data.data());
+    const auto deadline = std::chrono::steady_clock::now() + 3 * DiskFile::write_back_delay;
+    while (test_file.HostContents().size() < 2 * data.size() &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(test_file.HostContents().size() == 2 * data.size());
+}
+
+TEST_CASE("DiskFile - failing to write out the buffer is reported later", "[core][file_sys]") {
+    // Writes to /dev/full fail with ENOSPC. Only available on Linux.
+    if (!fs::exists("/dev/full")) {
+        return;
+    }
+    const std::vector<u8> data(16, 0x42);
+
+    SECTION("by a flush") {
+        auto file = OpenDiskFile("/dev/full");
+        REQUIRE(file->Write(0, data.size(), false, data.data()).Unwrap() == data.size());
+        REQUIRE(file->Flush() == ERROR_INSUFFICIENT_SPACE);
+    }
+
+    SECTION("by the next write, after the flusher wrote the buffer out") {
+        auto file = OpenDiskFile("/dev/full");
+        REQUIRE(file->Write(0, data.size(), false, data.data()).Unwrap() == data.size());
+        DiskFile::ShutdownFlusher();
+        REQUIRE(file->Write(0, data.size(), false, data.data()).Code() ==
+                ERROR_INSUFFICIENT_SPACE);
+        // Reported once
+        REQUIRE(file->Write(0, data.size(), false, data.data()).Unwrap() == data.size());
+    }
+
+    SECTION("by closing") {
+        auto file = OpenDiskFile("/dev/full");
+        REQUIRE(file->Write(0, data.size(), false, data.data()).Unwrap() == data.size());
+        REQUIRE_FALSE(file->Close());
+    }
+}
+
+TEST_CASE("DiskFile - benchmark", "[.][benchmark][core][file_sys]") {
+    constexpr std::size_t num_writes = 16384;
+    constexpr std::size_t chunk_size = 64;
+    const TestFile test_file;
+    const std::vector<u8> chunk(chunk_size, 0x42);
+
+    // What DiskFile::Write did before it had a buffer.
+    FileUtil::IOFile host_file(test_file.path, "r+b");
+    BENCHMARK("16384 writes of 64 bytes with flush, unbuffered") {
+        for (std::size_t i = 0; i < num_writes; i++) {
+            host_file.Seek(i * chunk_size, SEEK_SET);
+            host_file.WriteBytes(chunk.data(), chunk.size());
+            host_file.Flush();
+        }
+    };
+    host_file.Close();
+
+    auto file = test_file.Open();
+    u64 runs = 0;
+    BENCHMARK("16384 writes of 64 bytes with flush, write-back buffer") {
+        runs++;
+        for (std::size_t i = 0; i < num_writes; i++) {
+            file->Write(i * chunk_size, chunk.size(), true, chunk.data());
+        }
+    };
+    file->Close();
+    // The unbuffered loop makes one host write per write
+    const u64 buffered_writes = file->GetHostWriteCount() / std::max<u64>(runs, 1);
+    std::printf("DiskFile: host writes per run: %zu unbuffered, %llu with write-back buffer\n",
+                num_writes, static_cast<unsigned long long>(buffered_writes));
+}
+
+} // namespace FileSys
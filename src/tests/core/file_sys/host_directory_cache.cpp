@@ -0,0 +1,151 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/file_util.h"
+#include "core/file_sys/directory_backend.h"
+#include "core/file_sys/errors.h"
+#include "core/file_sys/host_directory_cache.h"
+#include "core/file_sys/path_parser.h"
+#include "core/file_sys/savedata_archive.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/// Temporary save data directory, with the cache forgotten at both ends.
+class TestSaveData {
+public:
+    TestSaveData() : dir("host_directory_cache_test") {
+        HostDirectoryCache::Clear();
+    }
+
+    ~TestSaveData() {
+        HostDirectoryCache::Clear();
+    }
+
+    std::string MountPoint() const {
+        return dir.Root().string() + '/';
+    }
+
+    Tests::TempDirectory dir;
+};
+
+Mode ReadMode() {
+    Mode mode;
+    mode.hex = 0;
+    mode.read_flag.Assign(1);
+    return mode;
+}
+
+u32 CountEntries(const SaveDataArchive& archive, const char* path) {
+    auto directory = archive.OpenDirectory(Path(path)).Unwrap();
+    std::vector<Entry> entries(64);
+    return directory->Read(static_cast<u32>(entries.size()), entries.data());
+}
+
+} // Anonymous namespace
+
+TEST_CASE("HostDirectoryCache - archive changes are seen by lookups", "[core][file_sys]") {
+    const TestSaveData save_data;
+    const SaveDataArchive archive(save_data.MountPoint());
+
+    REQUIRE(archive.OpenFile(Path("/a"), ReadMode()).Code() == ERROR_FILE_NOT_FOUND);
+    REQUIRE(archive.CreateFile(Path("/a"), 16) == RESULT_SUCCESS);
+    REQUIRE(archive.OpenFile(Path("/a"), ReadMode()).Succeeded());
+    REQUIRE(archive.CreateFile(Path("/a"), 16) == ERROR_FILE_ALREADY_EXISTS);
+
+    REQUIRE(archive.CreateDirectory(Path("/dir")) == RESULT_SUCCESS);
+    REQUIRE(archive.CreateFile(Path("/dir/b"), 0) == RESULT_SUCCESS);
+    REQUIRE(CountEntries(archive, "/dir") == 1);
+    REQUIRE(archive.RenameFile(Path("/dir/b"), Path("/dir/c")) == RESULT_SUCCESS);
+    REQUIRE(archive.OpenFile(Path("/dir/b"), ReadMode()).Code() == ERROR_FILE_NOT_FOUND);
+    REQUIRE(archive.OpenFile(Path("/dir/c"), ReadMode()).Succeeded());
+
+    REQUIRE(archive.RenameDirectory(Path("/dir"), Path("/moved")) == RESULT_SUCCESS);
+    REQUIRE(archive.OpenFile(Path("/dir/c"), ReadMode()).Code() == ERROR_PATH_NOT_FOUND);
+    REQUIRE(archive.OpenFile(Path("/moved/c"), ReadMode()).Succeeded());
+
+    REQUIRE(archive.DeleteDirectoryRecursively(Path("/moved")) == RESULT_SUCCESS);
+    REQUIRE(archive.OpenFile(Path("/moved/c"), ReadMode()).Code() == ERROR_PATH_NOT_FOUND);
+    REQUIRE(archive.DeleteFile(Path("/a")) == RESULT_SUCCESS);
+    REQUIRE(archive.DeleteFile(Path("/a")) == ERROR_FILE_NOT_FOUND);
+    REQUIRE(CountEntries(archive, "/") == 0);
+}
+
+TEST_CASE("HostDirectoryCache - entries created behind its back are found", "[core][file_sys]") {
+    const TestSaveData save_data;
+    const SaveDataArchive archive(save_data.MountPoint());
+    const PathParser parser(Path("/dir/file"));
+    REQUIRE(parser.GetHostStatus(save_data.MountPoint()) == PathParser::PathNotFound);
+
+    fs::create_directories(save_data.dir / "dir");
+    REQUIRE(parser.GetHostStatus(save_data.MountPoint()) == PathParser::NotFound);
+    FileUtil::CreateEmptyFile((save_data.dir / "dir" / "file").string());
+    REQUIRE(parser.GetHostStatus(save_data.MountPoint()) == PathParser::FileFound);
+
+    // Deleting without an archive needs an explicit invalidation.
+    fs::remove_all(save_data.dir / "dir");
+    HostDirectoryCache::Invalidate((save_data.dir / "dir").string());
+    REQUIRE(parser.GetHostStatus(save_data.MountPoint()) == PathParser::PathNotFound);
+}
+
+TEST_CASE("HostDirectoryCache - benchmark", "[.][benchmark][core][file_sys]") {
+    constexpr int num_files = 500;
+    constexpr int num_lookups = 20000;
+    const TestSaveData save_data;
+    const SaveDataArchive archive(save_data.MountPoint());
+    for (int i = 0; i < num_files; i++) {
+        const std::string path = "/dir" + std::to_string(i % 10);
+        archive.CreateDirectory(Path(path.c_str()));
+        archive.CreateFile(Path((path + "/file" + std::to_string(i)).c_str()), 0);
+    }
+    const auto file_path = [](int i) {
+        return "/dir" + std::to_string(i % 10) + "/file" + std::to_string(i % num_files);
+    };
+
+    const auto lookup_all = [&](auto&& lookup) {
+        for (int i = 0; i < num_lookups; i++) {
+            lookup(file_path(i));
+        }
+    };
+
+    // What each lookup used to do: a stat call per component, twice for all but the mount point.
+    BENCHMARK("Host stat calls, 20000 lookups") {
+        lookup_all([&](const std::string& path) {
+            std::string host_path = save_data.MountPoint();
+            FileUtil::IsDirectory(host_path);
+            std::size_t start = 1;
+            while (start < path.size()) {
+                const std::size_t end = std::min(path.find('/', start), path.size());
+                host_path += '/' + path.substr(start, end - start);
+                FileUtil::Exists(host_path);
+                FileUtil::IsDirectory(host_path);
+                start = end + 1;
+            }
+        });
+    };
+    BENCHMARK("PathParser::GetHostStatus, 20000 lookups") {
+        lookup_all([&](const std::string& path) {
+            PathParser(Path(path.c_str())).GetHostStatus(save_data.MountPoint());
+        });
+    };
+    BENCHMARK("SaveDataArchive::OpenFile, 20000 lookups") {
+        lookup_all([&](const std::string& path) {
+            archive.OpenFile(Path(path.c_str()), ReadMode());
+        });
+    };
+
+    BENCHMARK("OpenDirectory and Read, 50 entries") {
+        return CountEntries(archive, "/dir0");
+    };
+}
+
+} // namespace FileSys
@@ -0,0 +1,291 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/crc.hpp>
+#include <catch2/catch.hpp>
+#include "core/file_sys/layered_fs.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/// A RomFS holding nothing but the root directory.
+class EmptyRomFS : public RomFSReader {
+public:
+    EmptyRomFS() : data(0x50, 0xFF) {
+        RomFSHeader header{};
+        header.header_length = sizeof(RomFSHeader);
+        header.directory_hash_table = {0x28, 4};
+        header.directory_metadata_table = {0x2C, 0x18};
+        header.file_hash_table = {0x44, 4};
+        header.file_metadata_table = {0x48, 0};
+        header.file_data_offset = 0x50;
+        std::memcpy(data.data(), &header, sizeof(header));
+        // Root directory: no parent, siblings, children or files, and an empty name
+        std::memset(data.data() + 0x28, 0, 4);
+        std::memset(data.data() + 0x2C, 0, 4);
+        std::memset(data.data() + 0x2C + 0x14, 0, 4);
+    }
+
+    std::size_t GetSize() const override {
+        return data.size();
+    }
+
+    std::size_t ReadFile(std::size_t offset, std::size_t length, u8* buffer) override {
+        std::memcpy(buffer, data.data() + offset, length);
+        return length;
+    }
+
+private:
+    std::vector<u8> data;
+};
+
+std::vector<u8> MakeData(std::size_t size, u8 seed) {
+    std::vector<u8> data(size);
+    for (std::size_t i = 0; i < size; i++) {
+        data[i] = static_cast<u8>(seed + i * 7);
+    }
+    return data;
+}
+
+void WriteFile(const fs::path& path, const std::vector<u8>& data) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+std::vector<u8> ReadFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+/// A BPS patch that writes `target` out in full, regardless of the source.
+std::vector<u8> MakeBpsPatch(const std::vector<u8>& source, const std::vector<u8>& target) {
+    std::vector<u8> patch{'B', 'P', 'S', '1'};
+    const auto write_number = [&patch](u64 value) {
+        while (true) {
+            const u8 x = value & 0x7F;
+            value >>= 7;
+            if (value == 0) {
+                patch.push_back(0x80 | x);
+                break;
+            }
+            patch.push_back(x);
+            value--;
+        }
+    };
+    const auto write_u32 = [&patch](u32 value) {
+        for (int i = 0; i < 4; i++) {
+            patch.push_back(static_cast<u8>(value >> (8 * i)));
+        }
+    };
+    const auto crc32 = [](const std::vector<u8>& data) {
+        boost::crc_32_type result;
+        result.process_bytes(data.data(), data.size());
+        return result.checksum();
+    };
+
+    write_number(source.size());
+    write_number(target.size());
+    write_number(0); // Metadata size
+    write_number(((target.size() - 1) << 2) | 1); // TargetRead
+    patch.insert(patch.end(), target.begin(), target.end());
+    write_u32(crc32(source));
+    write_u32(crc32(target));
+    write_u32(crc32(patch));
+    return patch;
+}
+
+/// Layers the base and mod directories over an empty RomFS and dumps the result to "out".
+void Dump(const Tests::TempDirectory& dir) {
+    fs::remove_all(dir / "out");
+    auto base = std::make_shared<LayeredFS>(
+        std::make_shared<EmptyRomFS>(), dir.DirectoryPath("base"), dir.DirectoryPath("base_ext"));
+    auto modded = std::make_shared<LayeredFS>(base, dir.DirectoryPath("mod/romfs"),
+                                              dir.DirectoryPath("mod/romfs_ext"));
+    // Dumping extracts the original files, so the modded RomFS is wrapped once more.
+    LayeredFS(modded, "", "", false).DumpRomFS(dir.DirectoryPath("out"));
+}
+
+} // Anonymous namespace
+
+TEST_CASE("LayeredFS - replacements, patches and stubs", "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    const auto replaced = MakeData(2000, 1);
+    const auto bps_source = MakeData(300, 2);
+    const auto bps_target = MakeData(400, 3);
+    auto ips_patched = MakeData(64, 4);
+    WriteFile(dir / "base/a.bin", MakeData(1000, 5));
+    WriteFile(dir / "base/b.bin", bps_source);
+    WriteFile(dir / "base/c.bin", MakeData(50, 6));
+    WriteFile(dir / "base/d.bin", ips_patched);
+
+    WriteFile(dir / "mod/romfs/a.bin", replaced);
+    WriteFile(dir / "mod/romfs_ext/b.bin.bps", MakeBpsPatch(bps_source, bps_target));
+    WriteFile(dir / "mod/romfs_ext/c.bin.stub", {});
+    WriteFile(dir / "mod/romfs_ext/d.bin.ips",
+              {'P', 'A', 'T', 'C', 'H', 0, 0, 4, 0, 4, 'W', 'X', 'Y', 'Z', 'E', 'O', 'F'});
+    std::memcpy(ips_patched.data() + 4, "WXYZ", 4);
+    // More files than there are handles in the pool
+    for (u8 i = 0; i < 2 * LayeredFS::max_open_files; i++) {
+        WriteFile(dir / "mod/romfs/new" / (std::to_string(i) + ".bin"), MakeData(100 + i, i));
+    }
+
+    Dump(dir);
+
+    REQUIRE(ReadFile(dir / "out/a.bin") == replaced);
+    REQUIRE(ReadFile(dir / "out/b.bin") == bps_target);
+    REQUIRE(!fs::exists(dir / "out/c.bin"));
+    REQUIRE(ReadFile(dir / "out/d.bin") == ips_patched);
+    for (u8 i = 0; i < 2 * LayeredFS::max_open_files; i++) {
+        REQUIRE(ReadFile(dir / "out/new" / (std::to_string(i) + ".bin")) ==
+                MakeData(100 + i, i));
+    }
+}
+
+TEST_CASE("LayeredFS - index is reused until a mod directory changes", "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    WriteFile(dir / "base/a.bin", MakeData(100, 1));
+    WriteFile(dir / "mod/romfs/dir/b.bin", MakeData(200, 2));
+
+    // Some file systems only keep modification times to the second, so they are moved out of the
+    // way.
+    const auto mod_dir = dir / "mod/romfs/dir";
+    const auto old_time = fs::last_write_time(mod_dir) - std::chrono::hours(1);
+    fs::last_write_time(mod_dir, old_time);
+    Dump(dir);
+    REQUIRE(fs::is_directory(dir / "cache/layeredfs"));
+    REQUIRE(ReadFile(dir / "out/dir/b.bin") == MakeData(200, 2));
+
+    // A stale index does not know about the new file.
+    WriteFile(mod_dir / "c.bin", MakeData(300, 3));
+    fs::last_write_time(mod_dir, old_time);
+    Dump(dir);
+    REQUIRE(!fs::exists(dir / "out/dir/c.bin"));
+
+    fs::last_write_time(mod_dir, old_time + std::chrono::minutes(1));
+    Dump(dir);
+    REQUIRE(ReadFile(dir / "out/dir/c.bin") == MakeData(300, 3));
+}
+
+TEST_CASE("LayeredFS - replacement files overwritten in place are picked up", "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    WriteFile(dir / "base/a.bin", MakeData(100, 1));
+    const auto mod_dir = dir / "mod/romfs";
+    WriteFile(mod_dir / "a.bin", MakeData(200, 2));
+    const auto old_time = fs::last_write_time(mod_dir) - std::chrono::hours(1);
+    fs::last_write_time(mod_dir, old_time);
+    Dump(dir);
+    REQUIRE(ReadFile(dir / "out/a.bin") == MakeData(200, 2));
+
+    // The index is still up to date, but the file is read with its new size
+    WriteFile(mod_dir / "a.bin", MakeData(300, 3));
+    fs::last_write_time(mod_dir, old_time);
+    Dump(dir);
+    REQUIRE(ReadFile(dir / "out/a.bin") == MakeData(300, 3));
+}
+
+TEST_CASE("LayeredFS - replacement files keep their size while the game runs", "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    const auto base =
+        std::make_shared<LayeredFS>(std::make_shared<EmptyRomFS>(), dir.DirectoryPath("base"), "");
+    WriteFile(dir / "mod/romfs/a.bin", MakeData(200, 1));
+    LayeredFS layered_fs(base, dir.DirectoryPath("mod/romfs"), dir.DirectoryPath("mod/romfs_ext"));
+    const std::size_t size = layered_fs.GetSize();
+
+    // The data of the only file is at the end, aligned to 16 bytes
+    const std::size_t data_offset = size - 208;
+    WriteFile(dir / "mod/romfs/a.bin", MakeData(150, 2));
+    std::vector<u8> data(200, 0xFF);
+    REQUIRE(layered_fs.ReadFile(data_offset, data.size(), data.data()) == data.size());
+    auto expected = MakeData(150, 2);
+    expected.resize(200, 0);
+    REQUIRE(data == expected);
+    REQUIRE(layered_fs.GetSize() == size);
+}
+
+TEST_CASE("LayeredFS - replacement files are kept open in a bounded pool", "[core][file_sys]") {
+    constexpr std::size_t num_files = 3 * LayeredFS::max_open_files;
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    WriteFile(dir / "base/a.bin", MakeData(100, 1));
+    for (std::size_t i = 0; i < num_files; i++) {
+        WriteFile(dir / "mod/romfs" / (std::to_string(i) + ".bin"),
+                  MakeData(100 + i, static_cast<u8>(i)));
+    }
+
+    const auto base =
+        std::make_shared<LayeredFS>(std::make_shared<EmptyRomFS>(), dir.DirectoryPath("base"), "");
+    LayeredFS layered_fs(base, dir.DirectoryPath("mod/romfs"), "");
+    REQUIRE(layered_fs.GetOpenFileCount() == 0);
+
+    // Reading every replacement file, twice over, never holds more than the pool allows
+    std::vector<u8> buffer(layered_fs.GetSize());
+    for (int pass = 0; pass < 2; pass++) {
+        REQUIRE(layered_fs.ReadFile(0, buffer.size(), buffer.data()) == buffer.size());
+        REQUIRE(layered_fs.GetOpenFileCount() == LayeredFS::max_open_files);
+    }
+}
+
+TEST_CASE("LayeredFS - benchmark", "[.][benchmark][core][file_sys]") {
+    constexpr std::size_t num_files = 10000;
+    constexpr std::size_t file_size = 16 * 1024;
+    const Tests::TempCacheDirectory dir("layered_fs_test");
+    WriteFile(dir / "base/a.bin", MakeData(100, 1));
+    for (std::size_t i = 0; i < num_files; i++) {
+        WriteFile(dir / "mod/romfs" / std::to_string(i / 100) / (std::to_string(i) + ".bin"),
+                  MakeData(file_size, static_cast<u8>(i)));
+    }
+
+    const auto base =
+        std::make_shared<LayeredFS>(std::make_shared<EmptyRomFS>(), dir.DirectoryPath("base"), "");
+    const auto load = [&] {
+        return LayeredFS(base, dir.DirectoryPath("mod/romfs"), dir.DirectoryPath("mod/romfs_ext"))
+            .GetSize();
+    };
+
+    BENCHMARK("Load 10000 files, without index") {
+        // The index is written to the cache directory by every load
+        fs::remove_all(dir / "cache");
+        return load();
+    };
+    BENCHMARK("Load 10000 files, with index") {
+        return load();
+    };
+
+    // Resident set size in pages. Only available on Linux, elsewhere this reports 0.
+    const auto resident_pages = [] {
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0, resident = 0;
+        statm >> size >> resident;
+        return resident;
+    };
+    const std::size_t pages_before = resident_pages();
+    LayeredFS layered_fs(base, dir.DirectoryPath("mod/romfs"), dir.DirectoryPath("mod/romfs_ext"));
+    std::vector<u8> buffer(1024 * 1024);
+    BENCHMARK("Read 10000 files") {
+        for (std::size_t offset = 0; offset < layered_fs.GetSize(); offset += buffer.size()) {
+            const std::size_t length = std::min(buffer.size(), layered_fs.GetSize() - offset);
+            layered_fs.ReadFile(offset, length, buffer.data());
+        }
+        return buffer[0];
+    };
+    std::printf("LayeredFS, %zu files: %zd pages of RSS, %zu files open\n", num_files,
+                static_cast<std::ptrdiff_t>(resident_pages() - pages_before),
+                layered_fs.GetOpenFileCount());
+}
+
+} // namespace FileSys
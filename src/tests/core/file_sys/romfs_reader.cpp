@@ -0,0 +1,332 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+#include "common/file_util.h"
+#include "core/file_sys/romfs_reader.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+constexpr std::size_t file_offset = 0x1000;
+constexpr std::array<u8, 16> key{0x5A, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+constexpr std::array<u8, 16> ctr{0xC3, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+constexpr std::size_t crypto_offset = 0x2000;
+
+/**
+ * Temporary files holding `file_offset` bytes of header followed by `data_size` bytes of data,
+ * once as is and once encrypted the way NCCH RomFS are.
+ */
+class TestImage {
+public:
+    explicit TestImage(std::size_t data_size)
+        : dir("romfs_reader_test"), path(dir.Path("image.bin")),
+          encrypted_path(dir.Path("encrypted.bin")), data(data_size) {
+        std::mt19937 rng(42);
+        for (u8& byte : data) {
+            byte = static_cast<u8>(rng());
+        }
+        Write(path, data);
+
+        // Encrypted with Crypto++ directly, so that the reader is checked against data it did
+        // not produce itself.
+        std::vector<u8> encrypted(data_size);
+        CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption encryption(key.data(), key.size(),
+                                                                 ctr.data());
+        encryption.Seek(crypto_offset);
+        encryption.ProcessData(encrypted.data(), data.data(), data.size());
+        Write(encrypted_path, encrypted);
+    }
+
+    std::unique_ptr<DirectRomFSReader> Open(bool encrypted) const {
+        if (encrypted) {
+            return std::make_unique<DirectRomFSReader>(FileUtil::IOFile(encrypted_path, "rb"),
+                                                       file_offset, data.size(), key, ctr,
+                                                       crypto_offset);
+        }
+        return std::make_unique<DirectRomFSReader>(FileUtil::IOFile(path, "rb"), file_offset,
+                                                   data.size());
+    }
+
+    Tests::TempDirectory dir;
+    std::string path;
+    std::string encrypted_path;
+    std::vector<u8> data;
+
+private:
+    static void Write(const std::string& path, const std::vector<u8>& contents) {
+        FileUtil::IOFile file(path, "wb");
+        const std::vector<u8> header(file_offset, 0xFF);
+        file.WriteBytes(header.data(), header.size());
+        file.WriteBytes(contents.data(), contents.size());
+    }
+};
+
+/// Returns a block of the given size whose bytes are all `value`.
+RomFSBlockCache::Block MakeBlock(std::size_t size, u8 value) {
+    return std::make_shared<const std::vector<u8>>(size, value);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DirectRomFSReader - cached reads", "[core][file_sys]") {
+    constexpr std::size_t data_size = 80 * DirectRomFSReader::block_size + 1234;
+    const TestImage image(data_size);
+
+    for (const bool encrypted : {false, true}) {
+        INFO("Encrypted: " << encrypted);
+        auto reader = image.Open(encrypted);
+        const std::vector<u8>& expected = image.data;
+
+        // Reads this large bypass the cache and are decrypted in bulk
+        std::vector<u8> whole(data_size);
+        REQUIRE(reader->ReadFile(0, data_size, whole.data()) == data_size);
+        REQUIRE(whole == expected);
+
+        std::mt19937 rng(1234);
+        std::vector<u8> buffer(3 * DirectRomFSReader::block_size);
+        for (int i = 0; i < 1000; i++) {
+            const std::size_t offset = rng() % data_size;
+            const std::size_t length = rng() % buffer.size() + 1;
+            const std::size_t expected_length = std::min(length, data_size - offset);
+            REQUIRE(reader->ReadFile(offset, length, buffer.data()) == expected_length);
+            REQUIRE(std::equal(buffer.begin(), buffer.begin() + expected_length,
+                               expected.begin() + offset));
+        }
+        REQUIRE(reader->GetCacheStats().hits > 0);
+    }
+}
+
+TEST_CASE("RomFSBlockCache - one budget for every reader", "[core][file_sys]") {
+    constexpr std::size_t block_size = 1000;
+    RomFSBlockCache cache(4 * block_size);
+
+    cache.Insert(0, 0, MakeBlock(block_size, 1));
+    cache.Insert(0, 1, MakeBlock(block_size, 2));
+    cache.Insert(1, 0, MakeBlock(block_size, 3));
+    cache.Insert(1, 1, MakeBlock(block_size, 4));
+    REQUIRE(cache.GetSize() == 4 * block_size);
+
+    // The same index of different readers are different blocks
+    REQUIRE(cache.Find(0, 0)->front() == 1);
+    REQUIRE(cache.Find(1, 0)->front() == 3);
+
+    // Going over budget evicts the least recently used block, whichever reader it belongs to
+    cache.Insert(2, 0, MakeBlock(block_size, 5));
+    REQUIRE(cache.GetSize() == 4 * block_size);
+    REQUIRE(!cache.Contains(0, 1));
+    REQUIRE(cache.Contains(0, 0));
+    REQUIRE(cache.Contains(1, 1));
+
+    // A block that is evicted while in use stays valid for its user
+    const RomFSBlockCache::Block held = cache.Find(1, 1);
+    for (u64 index = 1; index <= 4; index++) {
+        cache.Insert(2, index, MakeBlock(block_size, 6));
+    }
+    REQUIRE(cache.GetSize() <= cache.GetCapacity());
+    REQUIRE(!cache.Contains(1, 1));
+    REQUIRE(held->size() == block_size);
+    REQUIRE(held->front() == 4);
+
+    // Closing a reader drops its blocks only
+    cache.Erase(2);
+    REQUIRE(cache.GetSize() == 0);
+    cache.Insert(3, 0, MakeBlock(block_size, 7));
+    cache.Insert(4, 0, MakeBlock(block_size, 8));
+    cache.Erase(3);
+    REQUIRE(!cache.Contains(3, 0));
+    REQUIRE(cache.Contains(4, 0));
+    REQUIRE(cache.GetSize() == block_size);
+}
+
+TEST_CASE("DirectRomFSReader - readers share the block cache", "[core][file_sys]") {
+    constexpr std::size_t data_size = 8 * DirectRomFSReader::block_size;
+    const TestImage image(data_size);
+    RomFSBlockCache& cache = RomFSBlockCache::Instance();
+    const std::size_t initial_size = cache.GetSize();
+    {
+        auto plain = image.Open(false);
+        auto encrypted = image.Open(true);
+        std::vector<u8> plain_buffer(0x100);
+        std::vector<u8> encrypted_buffer(0x100);
+        for (std::size_t offset = 0; offset < data_size; offset += DirectRomFSReader::block_size) {
+            REQUIRE(plain->ReadFile(offset + 0x10, 0x100, plain_buffer.data()) == 0x100);
+            REQUIRE(encrypted->ReadFile(offset + 0x10, 0x100, encrypted_buffer.data()) == 0x100);
+            REQUIRE(plain_buffer == encrypted_buffer);
+        }
+        // Both readers keep their own blocks, and the whole cache stays in budget
+        REQUIRE(cache.GetSize() == initial_size + 2 * data_size);
+        REQUIRE(cache.GetSize() <= cache.GetCapacity());
+    }
+    REQUIRE(cache.GetSize() == initial_size);
+}
+
+TEST_CASE("DirectRomFSReader - sequential reads", "[core][file_sys]") {
+    constexpr std::size_t data_size = 16 * DirectRomFSReader::block_size;
+    const TestImage image(data_size);
+    auto reader = image.Open(true);
+
+    std::vector<u8> buffer(0x1000);
+    for (std::size_t offset = 0; offset < data_size; offset += buffer.size()) {
+        REQUIRE(reader->ReadFile(offset, buffer.size(), buffer.data()) == buffer.size());
+    }
+
+    // Whether a block came from readahead or was read on demand, it is only read once.
+    const DirectRomFSReader::CacheStats stats = reader->GetCacheStats();
+    REQUIRE(stats.host_bytes_read == data_size);
+    REQUIRE(stats.hits + stats.misses == data_size / buffer.size());
+    REQUIRE(stats.HitRate() > 0.9);
+}
+
+TEST_CASE("DirectRomFSReader - concurrent reads", "[core][file_sys]") {
+    constexpr std::size_t data_size = 24 * DirectRomFSReader::block_size + 77;
+    const TestImage image(data_size);
+    auto reader = image.Open(false);
+
+    // Service::FS reads on its I/O thread while the emulation thread reads other files of the
+    // same RomFS, and readahead runs on a thread of its own.
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (unsigned seed = 0; seed < 4; seed++) {
+        threads.emplace_back([&, seed] {
+            std::mt19937 rng(seed);
+            std::vector<u8> buffer(2 * DirectRomFSReader::block_size);
+            for (int i = 0; i < 500; i++) {
+                const std::size_t offset = rng() % data_size;
+                const std::size_t length = std::min(rng() % buffer.size() + 1, data_size - offset);
+                if (reader->ReadFile(offset, length, buffer.data()) != length ||
+                    !std::equal(buffer.begin(), buffer.begin() + length,
+                                image.data.begin() + offset)) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("MappedRomFSReader", "[core][file_sys]") {
+    constexpr std::size_t data_size = 3 * DirectRomFSReader::block_size + 5;
+    const TestImage image(data_size);
+    MappedRomFSReader reader(image.path, file_offset, data_size);
+    REQUIRE(reader.IsOpen());
+    REQUIRE(reader.GetSize() == data_size);
+
+    std::vector<u8> buffer(0x3000);
+    for (std::size_t offset = 0; offset < data_size; offset += buffer.size()) {
+        const std::size_t expected_length = std::min(buffer.size(), data_size - offset);
+        REQUIRE(reader.ReadFile(offset, buffer.size(), buffer.data()) == expected_length);
+        REQUIRE(std::equal(buffer.begin(), buffer.begin() + expected_length,
+                           image.data.begin() + offset));
+    }
+
+    const u8* direct = reader.GetDirectPointer(0x1234, 0x100);
+    REQUIRE(direct != nullptr);
+    REQUIRE(std::equal(direct, direct + 0x100, image.data.begin() + 0x1234));
+    REQUIRE(reader.GetDirectPointer(data_size - 4, 5) == nullptr);
+
+    REQUIRE(!MappedRomFSReader(image.path, file_offset, data_size + 1).IsOpen());
+}
+
+TEST_CASE("MappedRomFSReader - reads fall back to the file when it is not mapped",
+          "[core][file_sys]") {
+    constexpr std::size_t data_size = 2 * DirectRomFSReader::block_size;
+    const TestImage image(data_size);
+    // The file is too short for the mapping, like a file that changed before a state was loaded
+    MappedRomFSReader reader(image.path, file_offset, data_size + 0x10);
+    REQUIRE(!reader.IsOpen());
+
+    std::vector<u8> buffer(0x3000);
+    REQUIRE(reader.ReadFile(0x1234, buffer.size(), buffer.data()) == buffer.size());
+    REQUIRE(std::equal(buffer.begin(), buffer.end(), image.data.begin() + 0x1234));
+    REQUIRE(reader.ReadFile(data_size - 0x10, buffer.size(), buffer.data()) == 0x10);
+    REQUIRE(std::equal(buffer.begin(), buffer.begin() + 0x10, image.data.end() - 0x10));
+    REQUIRE(reader.GetDirectPointer(0x1234, 0x100) == nullptr);
+}
+
+TEST_CASE("DirectRomFSReader - benchmark", "[.][benchmark][core][file_sys]") {
+    // A trace can be recorded with the log filter set to Service_FS:Trace; every line with an
+    // "offset=0x... length=0x..." read is replayed. Without one, a synthetic trace is used that
+    // streams through some large files while repeatedly reading small assets from a hot set.
+    std::vector<std::pair<std::size_t, std::size_t>> trace;
+    std::size_t data_size = 64 * 1024 * 1024;
+    if (const char* trace_path = std::getenv("CITRA_ROMFS_TRACE")) {
+        std::ifstream trace_file(trace_path);
+        REQUIRE(trace_file.is_open());
+        data_size = 0;
+        std::string line;
+        while (std::getline(trace_file, line)) {
+            const std::size_t offset_pos = line.find("offset=0x");
+            const std::size_t length_pos = line.find("length=0x");
+            if (offset_pos == std::string::npos || length_pos == std::string::npos) {
+                continue;
+            }
+            const std::size_t offset = std::stoull(line.substr(offset_pos + 9), nullptr, 16);
+            const std::size_t length = std::stoull(line.substr(length_pos + 9), nullptr, 16);
+            trace.emplace_back(offset, length);
+            data_size = std::max(data_size, offset + length);
+        }
+    } else {
+        std::mt19937 rng(42);
+        std::size_t stream_offset = 0;
+        while (trace.size() < 50000) {
+            if (rng() % 4 == 0) {
+                trace.emplace_back(stream_offset, 0x8000);
+                stream_offset = (stream_offset + 0x8000) % (data_size / 2);
+            } else {
+                const std::size_t asset = rng() % 512;
+                trace.emplace_back(data_size / 2 + asset * 0x3000, 0x200 + asset * 8);
+            }
+        }
+    }
+
+    const TestImage image(data_size);
+    std::vector<u8> buffer;
+    const auto replay = [&](auto&& read) {
+        std::size_t bytes_read = 0;
+        for (const auto& [offset, length] : trace) {
+            buffer.resize(std::max(buffer.size(), length));
+            bytes_read += read(offset, length);
+        }
+        return bytes_read;
+    };
+
+    // Every run starts with a new reader, and so with an empty cache
+    BENCHMARK("Host file reads") {
+        FileUtil::IOFile file(image.path, "rb");
+        return replay([&](std::size_t offset, std::size_t length) {
+            file.Seek(file_offset + offset, SEEK_SET);
+            return file.ReadBytes(buffer.data(), length);
+        });
+    };
+    for (const bool encrypted : {false, true}) {
+        BENCHMARK(encrypted ? "DirectRomFSReader, encrypted" : "DirectRomFSReader") {
+            const auto reader = image.Open(encrypted);
+            return replay([&](std::size_t offset, std::size_t length) {
+                return reader->ReadFile(offset, length, buffer.data());
+            });
+        };
+    }
+}
+
+} // namespace FileSys
@@ -0,0 +1,102 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/file_sys/ncch_container.h"
+#include "core/file_sys/title_cache.h"
+#include "core/settings.h"
+#include "tests/temp_directory.h"
+
+namespace FileSys {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr u64 test_program_id = 0x0004000000123400;
+
+std::vector<u8> MakeCode(std::size_t size) {
+    std::vector<u8> code(size);
+    for (std::size_t i = 0; i < size; i++) {
+        code[i] = static_cast<u8>(i * 13 + 5);
+    }
+    return code;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("TitleCache - code is only returned for the key it was stored with",
+          "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("title_cache_test");
+    const auto code = MakeCode(0x12345);
+
+    REQUIRE(!TitleCache::LoadCode(test_program_id, 1));
+    TitleCache::StoreCode(test_program_id, 1, code);
+    REQUIRE(TitleCache::LoadCode(test_program_id, 1) == code);
+    REQUIRE(!TitleCache::LoadCode(test_program_id, 2));
+    REQUIRE(!TitleCache::LoadCode(test_program_id + 0x100, 1));
+
+    // A new entry replaces the old one.
+    TitleCache::StoreCode(test_program_id, 2, MakeCode(0x100));
+    REQUIRE(!TitleCache::LoadCode(test_program_id, 1));
+    REQUIRE(TitleCache::LoadCode(test_program_id, 2) == MakeCode(0x100));
+}
+
+TEST_CASE("TitleCache - damaged entries are rejected", "[core][file_sys]") {
+    const Tests::TempCacheDirectory dir("title_cache_test");
+    const auto code = MakeCode(0x1000);
+    TitleCache::StoreCode(test_program_id, 1, code);
+    const fs::path entry = dir / "cache/titles" / "0004000000123400.code";
+    REQUIRE(fs::exists(entry));
+
+    SECTION("corrupted") {
+        std::fstream file(entry, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(0x800);
+        file.put('\x42');
+    }
+    SECTION("truncated") {
+        fs::resize_file(entry, fs::file_size(entry) - 1);
+    }
+    REQUIRE(!TitleCache::LoadCode(test_program_id, 1));
+}
+
+TEST_CASE("TitleCache - benchmark", "[.][benchmark][core][file_sys]") {
+    // Games are copyrighted, so a decrypted dump has to be provided to run this.
+    const char* ncch_path = std::getenv("CITRA_NCCH");
+    if (ncch_path == nullptr) {
+        WARN("Set CITRA_NCCH to the path of a decrypted CXI to run this benchmark");
+        return;
+    }
+
+    const Tests::TempCacheDirectory dir("title_cache_test");
+    const auto load_code = [ncch_path] {
+        NCCHContainer ncch(ncch_path);
+        std::vector<u8> code;
+        ncch.LoadCode(code, 0);
+        return code;
+    };
+
+    Settings::values.use_title_cache = false;
+    REQUIRE(!load_code().empty());
+    BENCHMARK("Load .code, cache disabled") {
+        return load_code();
+    };
+
+    Settings::values.use_title_cache = true;
+    BENCHMARK("Load .code, cold cache") {
+        fs::remove_all(dir / "cache");
+        return load_code();
+    };
+    BENCHMARK("Load .code, warm cache") {
+        return load_code();
+    };
+    Settings::values.use_title_cache = false;
+}
+
+} // namespace FileSys
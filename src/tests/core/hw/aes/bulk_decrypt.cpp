@@ -0,0 +1,123 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/hw/aes/bulk_decrypt.h"
+
+namespace HW::AES {
+
+namespace {
+
+constexpr AESKey test_key{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                          0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+constexpr AESKey test_iv{0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+                         0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+
+std::vector<u8> RandomData(std::size_t size) {
+    std::mt19937 rng(size);
+    std::uniform_int_distribution<int> dist(0, 0xFF);
+    std::vector<u8> data(size);
+    std::generate(data.begin(), data.end(), [&] { return static_cast<u8>(dist(rng)); });
+    return data;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DecryptCTR - parallel chunks match a sequential decryption", "[core][aes]") {
+    const std::vector<u8> original = RandomData(3 * 1024 * 1024 + 37);
+    constexpr u64 stream_offset = 0x1234;
+
+    std::vector<u8> parallel = original;
+    DecryptCTR(test_key, test_iv, stream_offset, parallel.data(), parallel.size());
+    REQUIRE(parallel != original);
+
+    // Small, unaligned pieces are each decrypted on the calling thread.
+    std::vector<u8> sequential = original;
+    constexpr std::size_t piece_size = 4097;
+    for (std::size_t offset = 0; offset < sequential.size(); offset += piece_size) {
+        const std::size_t length = std::min(piece_size, sequential.size() - offset);
+        DecryptCTR(test_key, test_iv, stream_offset + offset, sequential.data() + offset, length);
+    }
+    REQUIRE(parallel == sequential);
+
+    // CTR is its own inverse.
+    DecryptCTR(test_key, test_iv, stream_offset, parallel.data(), parallel.size());
+    REQUIRE(parallel == original);
+}
+
+TEST_CASE("DecryptCBC - parallel chunks match a sequential decryption", "[core][aes]") {
+    const std::vector<u8> original = RandomData(3 * 1024 * 1024 + 16 * 5);
+
+    std::vector<u8> parallel = original;
+    AESKey parallel_iv = test_iv;
+    DecryptCBC(test_key, parallel_iv, parallel.data(), parallel.size());
+    REQUIRE(parallel != original);
+
+    std::vector<u8> sequential = original;
+    AESKey sequential_iv = test_iv;
+    constexpr std::size_t piece_size = 16 * 257;
+    for (std::size_t offset = 0; offset < sequential.size(); offset += piece_size) {
+        const std::size_t length = std::min(piece_size, sequential.size() - offset);
+        DecryptCBC(test_key, sequential_iv, sequential.data() + offset, length);
+    }
+    REQUIRE(parallel == sequential);
+    REQUIRE(parallel_iv == sequential_iv);
+    REQUIRE(std::equal(parallel_iv.begin(), parallel_iv.end(), original.end() - AES_BLOCK_SIZE));
+}
+
+TEST_CASE("CBCStreamDecryptor - unaligned pieces match a one-shot decryption", "[core][aes]") {
+    const std::vector<u8> original = RandomData(1024 * 1024 + 16 * 3);
+
+    std::vector<u8> one_shot = original;
+    AESKey iv = test_iv;
+    DecryptCBC(test_key, iv, one_shot.data(), one_shot.size());
+
+    // Piece sizes that split blocks, including pieces that do not complete the held back one.
+    std::mt19937 rng(0xCB5);
+    std::uniform_int_distribution<std::size_t> piece_size(1, 70000);
+    CBCStreamDecryptor decryptor(test_key, test_iv);
+    std::vector<u8> streamed;
+    std::size_t offset = 0;
+    while (offset < original.size()) {
+        const std::size_t length = std::min(
+            offset % 3 == 0 ? piece_size(rng) % 20 + 1 : piece_size(rng), original.size() - offset);
+        const std::vector<u8> plaintext = decryptor.Process(original.data() + offset, length);
+        offset += length;
+        REQUIRE(plaintext.size() % AES_BLOCK_SIZE == 0);
+        REQUIRE(streamed.size() + plaintext.size() == offset - offset % AES_BLOCK_SIZE);
+        streamed.insert(streamed.end(), plaintext.begin(), plaintext.end());
+    }
+    REQUIRE(decryptor.TakeRemainder().empty());
+    REQUIRE(streamed == one_shot);
+}
+
+TEST_CASE("CBCStreamDecryptor - an incomplete last block is returned as is", "[core][aes]") {
+    const std::vector<u8> original = RandomData(16 * 4 + 5);
+
+    CBCStreamDecryptor decryptor(test_key, test_iv);
+    const std::vector<u8> plaintext = decryptor.Process(original.data(), original.size());
+    REQUIRE(plaintext.size() == 16 * 4);
+    REQUIRE(decryptor.TakeRemainder() == std::vector<u8>(original.end() - 5, original.end()));
+    REQUIRE(decryptor.TakeRemainder().empty());
+}
+
+TEST_CASE("DecryptCTR/DecryptCBC - benchmark", "[.][benchmark][core][aes]") {
+    // Roughly the size of the reads a CIA install or a large RomFS read makes.
+    std::vector<u8> data = RandomData(16 * 1024 * 1024);
+
+    BENCHMARK("AES-CTR, 16 MiB") {
+        DecryptCTR(test_key, test_iv, 0, data.data(), data.size());
+        return data[0];
+    };
+    AESKey iv = test_iv;
+    BENCHMARK("AES-CBC, 16 MiB") {
+        DecryptCBC(test_key, iv, data.data(), data.size());
+        return data[0];
+    };
+}
+
+} // namespace HW::AES
@@ -0,0 +1,62 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <atomic>
+#include <thread>
+#include <catch2/catch.hpp>
+#include "core/hw/aes/key.h"
+
+namespace HW::AES {
+
+namespace {
+
+constexpr AESKey key_x{0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                       0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+constexpr AESKey key_y_a{0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                         0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+constexpr AESKey key_y_b{0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+                         0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+
+} // Anonymous namespace
+
+TEST_CASE("AES key - deriving a normal key leaves the slot alone", "[core][hw][aes]") {
+    constexpr std::size_t slot_id = KeySlotID::NCCHSecure1;
+    SetKeyX(slot_id, key_x);
+    SetKeyY(slot_id, key_y_a);
+    const AESKey normal_a = GetNormalKey(slot_id);
+    SetKeyY(slot_id, key_y_b);
+    const AESKey normal_b = GetNormalKey(slot_id);
+    REQUIRE(normal_a != normal_b);
+
+    REQUIRE(DeriveNormalKey(slot_id, key_y_a) == normal_a);
+    REQUIRE(GetNormalKey(slot_id) == normal_b);
+
+    // A slot without a KeyX has no normal key
+    REQUIRE_FALSE(DeriveNormalKey(KeySlotID::MaxKeySlotID - 1, key_y_a).has_value());
+}
+
+TEST_CASE("AES key - normal keys are derived while the slot changes", "[core][hw][aes]") {
+    constexpr std::size_t slot_id = KeySlotID::NCCHSecure2;
+    SetKeyX(slot_id, key_x);
+    SetKeyY(slot_id, key_y_a);
+    const AESKey normal_a = GetNormalKey(slot_id);
+
+    // Like a game list scan next to the emulation thread setting keys
+    std::atomic<bool> stop{false};
+    std::thread emulation_thread([&] {
+        while (!stop) {
+            SetKeyY(slot_id, key_y_b);
+            SetKeyY(slot_id, key_y_a);
+        }
+    });
+    bool all_match = true;
+    for (int i = 0; i < 10000; i++) {
+        all_match &= DeriveNormalKey(slot_id, key_y_a) == normal_a;
+    }
+    stop = true;
+    emulation_thread.join();
+    REQUIRE(all_match);
+}
+
+} // namespace HW::AES
@@ -0,0 +1,126 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <map>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/hle/service/gsp/gsp_gpu.h"
+#include "core/hw/async_work.h"
+#include "core/memory.h"
+
+namespace GPU {
+
+namespace {
+
+using Service::GSP::InterruptId;
+using Interrupts = std::vector<InterruptId>;
+using Marks = std::map<PAddr, int>;
+
+constexpr PAddr page0 = Memory::VRAM_PADDR;
+constexpr PAddr page1 = page0 + Memory::PAGE_SIZE;
+constexpr PAddr page2 = page0 + 2 * Memory::PAGE_SIZE;
+
+/// Queued work along with how many times each page was marked, less the times it was unmarked.
+struct TestWork {
+    Marks marked;
+    AsyncWork work{[this](PAddr page, bool cached) { marked[page] += cached ? 1 : -1; }};
+};
+
+} // Anonymous namespace
+
+TEST_CASE("AsyncWork - pages are marked until the work writing them completes", "[core][hw]") {
+    TestWork test;
+    REQUIRE_FALSE(test.work.Busy());
+
+    // Over the end of page 0 and the start of page 1
+    test.work.Queue(1, {{page1 - 0x80, 0x100}});
+    REQUIRE(test.work.Busy());
+    REQUIRE(test.marked == Marks{{page0, 1}, {page1, 1}});
+
+    // Work that writes nothing still has to complete
+    test.work.Queue(2, {});
+    test.work.Complete(1);
+    REQUIRE(test.work.Busy());
+    REQUIRE(test.marked == Marks{{page0, 0}, {page1, 0}});
+
+    test.work.Complete(2);
+    REQUIRE_FALSE(test.work.Busy());
+}
+
+TEST_CASE("AsyncWork - pages stay marked while later work writes them", "[core][hw]") {
+    TestWork test;
+
+    test.work.Queue(1, {{page0, 0x100}, {page1, 0x100}});
+    test.work.Queue(2, {{page0 + 0x800, 0x100}});
+    test.work.Queue(3, {{page1 + 0x800, Memory::PAGE_SIZE}});
+    // Each page is marked once, however much work writes it
+    REQUIRE(test.marked == Marks{{page0, 1}, {page1, 1}, {page2, 1}});
+
+    test.work.Complete(1);
+    REQUIRE(test.marked == Marks{{page0, 1}, {page1, 1}, {page2, 1}});
+    test.work.Complete(2);
+    REQUIRE(test.marked == Marks{{page0, 0}, {page1, 1}, {page2, 1}});
+
+    // Completing everything, as waiting for the GPU thread to be idle does
+    test.work.Complete(~0ull);
+    REQUIRE_FALSE(test.work.Busy());
+    REQUIRE(test.marked == Marks{{page0, 0}, {page1, 0}, {page2, 0}});
+}
+
+TEST_CASE("AsyncWork - interrupts are held until their work is signalled", "[core][hw]") {
+    TestWork test;
+
+    test.work.HoldInterrupt(1, InterruptId::PSC0);
+    test.work.HoldInterrupt(2, InterruptId::PPF);
+    test.work.HoldInterrupt(2, InterruptId::P3D);
+    test.work.HoldInterrupt(4, InterruptId::PSC1);
+
+    // Completing work does not signal its interrupts
+    test.work.Queue(4, {});
+    test.work.Complete(4);
+
+    REQUIRE(test.work.TakeInterrupts(0).empty());
+    REQUIRE(test.work.TakeInterrupts(1) == Interrupts{InterruptId::PSC0});
+    // In the order they were raised, each only once
+    REQUIRE(test.work.TakeInterrupts(3) == Interrupts{InterruptId::PPF, InterruptId::P3D});
+    REQUIRE(test.work.TakeInterrupts(3).empty());
+    REQUIRE(test.work.TakeInterrupts(~0ull) == Interrupts{InterruptId::PSC1});
+}
+
+TEST_CASE("AsyncWork - interrupts can be held from another thread", "[core][hw]") {
+    TestWork test;
+    constexpr u64 num_fences = 1000;
+
+    std::thread gpu_thread([&test] {
+        for (u64 fence = 1; fence <= num_fences; fence++) {
+            test.work.HoldInterrupt(fence, InterruptId::P3D);
+        }
+    });
+    std::size_t taken = 0;
+    for (u64 fence = 1; fence <= num_fences; fence++) {
+        taken += test.work.TakeInterrupts(fence).size();
+    }
+    gpu_thread.join();
+    taken += test.work.TakeInterrupts(num_fences).size();
+    REQUIRE(taken == num_fences);
+}
+
+TEST_CASE("AsyncWork - clearing forgets work without unmarking", "[core][hw]") {
+    TestWork test;
+
+    test.work.Queue(1, {{page0, 0x100}});
+    test.work.HoldInterrupt(1, InterruptId::PPF);
+    test.work.Clear();
+    REQUIRE_FALSE(test.work.Busy());
+    REQUIRE(test.work.TakeInterrupts(~0ull).empty());
+    REQUIRE(test.marked == Marks{{page0, 1}});
+
+    // Fences start over
+    test.work.Queue(1, {{page1, 0x100}});
+    test.work.Complete(1);
+    REQUIRE(test.marked == Marks{{page0, 1}, {page1, 0}});
+}
+
+} // namespace GPU
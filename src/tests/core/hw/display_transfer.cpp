@@ -0,0 +1,138 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/hw/display_transfer.h"
+
+namespace GPU {
+
+namespace {
+
+using ScalingMode = Regs::DisplayTransferConfig::ScalingMode;
+
+constexpr Regs::PixelFormat pixel_formats[] = {
+    Regs::PixelFormat::RGBA8, Regs::PixelFormat::RGB8, Regs::PixelFormat::RGB565,
+    Regs::PixelFormat::RGB5A1, Regs::PixelFormat::RGBA4,
+};
+
+std::vector<u8> RandomData(std::size_t size) {
+    std::mt19937 rng(static_cast<u32>(size));
+    std::uniform_int_distribution<int> dist(0, 0xFF);
+    std::vector<u8> data(size);
+    std::generate(data.begin(), data.end(), [&] { return static_cast<u8>(dist(rng)); });
+    return data;
+}
+
+Regs::DisplayTransferConfig MakeConfig(u32 output_width, u32 output_height, ScalingMode scaling,
+                                       Regs::PixelFormat input_format,
+                                       Regs::PixelFormat output_format) {
+    Regs::DisplayTransferConfig config{};
+    config.scaling.Assign(scaling);
+    config.input_format.Assign(input_format);
+    config.output_format.Assign(output_format);
+    // The output size is given before scaling, and so is the same as the input size
+    config.output_width.Assign(output_width);
+    config.output_height.Assign(output_height);
+    config.input_width.Assign(output_width);
+    config.input_height.Assign(output_height);
+    return config;
+}
+
+/// Runs the transfer with both implementations and checks that they write the same bytes.
+void CheckTransfer(const Regs::DisplayTransferConfig& config) {
+    const std::size_t input_size = config.input_width * config.input_height *
+                                   Regs::BytesPerPixel(config.input_format);
+    const std::size_t output_size = config.output_width * config.output_height *
+                                    Regs::BytesPerPixel(config.output_format);
+    const std::vector<u8> src = RandomData(input_size);
+    std::vector<u8> expected(output_size, 0xCD);
+    std::vector<u8> actual(output_size, 0xCD);
+
+    PerformDisplayTransferGeneric(config, src.data(), expected.data());
+    REQUIRE(PerformDisplayTransferTiled(config, src.data(), actual.data()));
+    REQUIRE(actual == expected);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("DisplayTransfer - tiled kernels match the generic path", "[core][hw]") {
+    const auto flip = GENERATE(false, true);
+    for (const auto input_format : pixel_formats) {
+        for (const auto output_format : pixel_formats) {
+            INFO("input format " << static_cast<u32>(input_format) << ", output format "
+                                 << static_cast<u32>(output_format) << ", flip " << flip);
+
+            for (const auto scaling : {ScalingMode::NoScale, ScalingMode::ScaleX,
+                                       ScalingMode::ScaleXY}) {
+                for (const bool dont_swizzle : {false, true}) {
+                    auto config = MakeConfig(32, 48, scaling, input_format, output_format);
+                    config.flip_vertically.Assign(flip);
+                    config.dont_swizzle.Assign(dont_swizzle);
+                    CheckTransfer(config);
+                }
+            }
+
+            for (const bool dont_swizzle : {false, true}) {
+                auto config = MakeConfig(24, 16, ScalingMode::NoScale, input_format, output_format);
+                config.flip_vertically.Assign(flip);
+                config.input_linear.Assign(1);
+                config.dont_swizzle.Assign(dont_swizzle);
+                CheckTransfer(config);
+            }
+        }
+    }
+}
+
+TEST_CASE("DisplayTransfer - unsupported transfers are left to the generic path", "[core][hw]") {
+    const std::vector<u8> src = RandomData(64 * 64 * 4);
+    std::vector<u8> dst(64 * 64 * 4, 0xCD);
+    const std::vector<u8> untouched = dst;
+
+    // Output sizes that are not made of whole tiles
+    auto config = MakeConfig(12, 16, ScalingMode::NoScale, Regs::PixelFormat::RGBA8,
+                             Regs::PixelFormat::RGBA8);
+    REQUIRE(!PerformDisplayTransferTiled(config, src.data(), dst.data()));
+    config = MakeConfig(16, 8, ScalingMode::ScaleXY, Regs::PixelFormat::RGBA8,
+                        Regs::PixelFormat::RGBA8);
+    REQUIRE(!PerformDisplayTransferTiled(config, src.data(), dst.data()));
+
+    // Scaling linear input
+    config = MakeConfig(16, 16, ScalingMode::ScaleX, Regs::PixelFormat::RGBA8,
+                        Regs::PixelFormat::RGBA8);
+    config.input_linear.Assign(1);
+    REQUIRE(!PerformDisplayTransferTiled(config, src.data(), dst.data()));
+
+    REQUIRE(dst == untouched);
+}
+
+TEST_CASE("DisplayTransfer - benchmark", "[.][benchmark][core][hw]") {
+    // The top screen framebuffer, rotated and tiled, copied out to the linear RGB8 display format
+    constexpr std::pair<ScalingMode, const char*> modes[] = {
+        {ScalingMode::NoScale, "RGBA8 -> RGB8"},
+        {ScalingMode::ScaleXY, "RGBA8 -> RGB8 with ScaleXY"},
+    };
+    for (const auto& [scaling, name] : modes) {
+        const u32 scale = scaling == ScalingMode::ScaleXY ? 2 : 1;
+        const auto config = MakeConfig(240 * scale, 400 * scale, scaling, Regs::PixelFormat::RGBA8,
+                                       Regs::PixelFormat::RGB8);
+        const std::vector<u8> src = RandomData(config.input_width * config.input_height * 4);
+        std::vector<u8> dst(240 * 400 * 3);
+
+        BENCHMARK(std::string(name) + ", generic") {
+            PerformDisplayTransferGeneric(config, src.data(), dst.data());
+            return dst[0];
+        };
+        BENCHMARK(std::string(name) + ", tiled") {
+            PerformDisplayTransferTiled(config, src.data(), dst.data());
+            return dst[0];
+        };
+    }
+}
+
+} // namespace GPU
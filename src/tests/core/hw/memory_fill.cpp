@@ -0,0 +1,188 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/hw/memory_fill.h"
+#include "core/memory.h"
+
+namespace GPU {
+
+namespace {
+
+Regs::MemoryFillConfig MakeConfig(u32 size, u32 value, bool fill_24bit, bool fill_32bit,
+                                  PAddr start = 0) {
+    Regs::MemoryFillConfig config{};
+    // Addresses are given in units of 8 bytes
+    config.address_start = start / 8;
+    config.address_end = (start + size) / 8;
+    config.value_32bit = value;
+    config.fill_24bit.Assign(fill_24bit);
+    config.fill_32bit.Assign(fill_32bit);
+    return config;
+}
+
+/// Fills memory a value at a time, like memory fills originally did.
+void ReferenceFill(const Regs::MemoryFillConfig& config, u8* start, u8* end) {
+    if (config.fill_24bit) {
+        for (u8* ptr = start; ptr < end; ptr += 3) {
+            ptr[0] = config.value_24bit_r;
+            ptr[1] = config.value_24bit_g;
+            ptr[2] = config.value_24bit_b;
+        }
+    } else if (config.fill_32bit) {
+        u32 value = config.value_32bit;
+        std::size_t len = (end - start) / sizeof(u32);
+        for (std::size_t i = 0; i < len; ++i)
+            std::memcpy(&start[i * sizeof(u32)], &value, sizeof(u32));
+    } else {
+        u16 value_16bit = config.value_16bit.Value();
+        for (u8* ptr = start; ptr < end; ptr += sizeof(u16))
+            std::memcpy(ptr, &value_16bit, sizeof(u16));
+    }
+}
+
+/// A few pages of VRAM, with the number of times each page is marked as cached.
+struct TestMemory {
+    static constexpr PAddr base = Memory::VRAM_PADDR;
+
+    TestMemory() : data(4 * Memory::PAGE_SIZE, 0x55) {}
+
+    u8* Pointer(PAddr address) {
+        return data.data() + (address - base);
+    }
+
+    DeferredMemoryFills MakeFills() {
+        return DeferredMemoryFills{[this](PAddr address) { return Pointer(address); },
+                                   [this](PAddr page, bool cached) {
+                                       marked[page] += cached ? 1 : -1;
+                                   }};
+    }
+
+    /// Whether the bytes of [start, end) all hold a value
+    bool Holds(PAddr start, PAddr end, u8 value) {
+        return std::all_of(Pointer(start), Pointer(end), [value](u8 b) { return b == value; });
+    }
+
+    std::vector<u8> data;
+    std::map<PAddr, int> marked;
+};
+
+constexpr PAddr page0 = TestMemory::base;
+constexpr PAddr page1 = TestMemory::base + Memory::PAGE_SIZE;
+constexpr PAddr page2 = TestMemory::base + 2 * Memory::PAGE_SIZE;
+
+} // Anonymous namespace
+
+TEST_CASE("MemoryFill - fills match filling a value at a time", "[core][hw]") {
+    const bool fill_24bit = GENERATE(false, true);
+    const bool fill_32bit = GENERATE(false, true);
+    for (u32 size = 8; size <= 400; size += 8) {
+        INFO("size " << size << ", 24-bit " << fill_24bit << ", 32-bit " << fill_32bit);
+        const auto config = MakeConfig(size, 0x89ABCDEF, fill_24bit, fill_32bit);
+
+        // Leave room for the last 24-bit value crossing the end
+        std::vector<u8> expected(size + 16, 0x55);
+        std::vector<u8> actual(size + 16, 0x55);
+        ReferenceFill(config, expected.data(), expected.data() + size);
+        PerformMemoryFill(config, actual.data());
+        REQUIRE(actual == expected);
+
+        const u32 written = GetMemoryFillSize(config);
+        REQUIRE(written >= size - 3);
+        REQUIRE(actual[written] == 0x55);
+        REQUIRE(actual[written - 1] != 0x55);
+    }
+}
+
+TEST_CASE("DeferredMemoryFills - fills are recorded, then written when flushed", "[core][hw]") {
+    TestMemory memory;
+    auto fills = memory.MakeFills();
+
+    // A fill over the end of page 0 and the start of page 1
+    fills.Add(MakeConfig(0x100, 0x11111111, false, true, page1 - 0x80));
+    REQUIRE_FALSE(fills.Empty());
+    REQUIRE(memory.Holds(page0, page2, 0x55));
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 1}, {page1, 1}});
+
+    // Flushing a region away from the fill leaves it recorded
+    fills.Flush(page2, page2 + 0x10);
+    REQUIRE(memory.Holds(page0, page2, 0x55));
+
+    fills.Flush(page1, page1 + 4);
+    REQUIRE(fills.Empty());
+    REQUIRE(memory.Holds(page1 - 0x80, page1 + 0x80, 0x11));
+    REQUIRE(memory.Holds(page0, page1 - 0x80, 0x55));
+    REQUIRE(memory.Holds(page1 + 0x80, page2, 0x55));
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 0}, {page1, 0}});
+}
+
+TEST_CASE("DeferredMemoryFills - overwritten fills are discarded", "[core][hw]") {
+    TestMemory memory;
+    auto fills = memory.MakeFills();
+
+    fills.Add(MakeConfig(0x100, 0x11111111, false, true, page0));
+    fills.Add(MakeConfig(0x100, 0x22222222, false, true, page0 + 0x200));
+
+    // The first fill lies within the invalidated region and is never written. The second one only
+    // overlaps it, so the part outside the region still has to be written.
+    fills.Invalidate(page0, page0 + 0x280);
+    REQUIRE(fills.Empty());
+    REQUIRE(memory.Holds(page0, page0 + 0x200, 0x55));
+    REQUIRE(memory.Holds(page0 + 0x200, page0 + 0x300, 0x22));
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 0}});
+}
+
+TEST_CASE("DeferredMemoryFills - pages stay marked while a fill is on them", "[core][hw]") {
+    TestMemory memory;
+    auto fills = memory.MakeFills();
+
+    fills.Add(MakeConfig(0x100, 0x11111111, false, true, page0));
+    fills.Add(MakeConfig(0x100, 0x22222222, false, true, page0 + 0x400));
+    fills.Add(MakeConfig(Memory::PAGE_SIZE, 0x33333333, false, true, page0 + 0x800));
+    // Each page is marked once, however many fills are on it
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 1}, {page1, 1}});
+
+    fills.Flush(page0, page0 + 0x100);
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 1}, {page1, 1}});
+    fills.Flush(page0 + 0x400, page0 + 0x500);
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 1}, {page1, 1}});
+
+    fills.FlushAll();
+    REQUIRE(fills.Empty());
+    REQUIRE(memory.marked == std::map<PAddr, int>{{page0, 0}, {page1, 0}});
+    REQUIRE(memory.Holds(page0, page0 + 0x100, 0x11));
+    REQUIRE(memory.Holds(page0 + 0x400, page0 + 0x500, 0x22));
+    REQUIRE(memory.Holds(page0 + 0x800, page1 + 0x800, 0x33));
+}
+
+TEST_CASE("MemoryFill - benchmark", "[.][benchmark][core][hw]") {
+    // Clearing a 400x240 framebuffer
+    constexpr u32 size = 400 * 240 * 4;
+    std::vector<u8> buffer(size + 16);
+
+    const auto fill_16bit = MakeConfig(size, 0x1234, false, false);
+    const auto fill_24bit = MakeConfig(size, 0x123456, true, false);
+    const auto fill_32bit = MakeConfig(size, 0x12345678, false, true);
+    for (const auto& [fill, name] : {std::pair{&fill_16bit, "16-bit"},
+                                     std::pair{&fill_24bit, "24-bit"},
+                                     std::pair{&fill_32bit, "32-bit"}}) {
+        const Regs::MemoryFillConfig& config = *fill;
+        BENCHMARK(std::string(name) + ", value at a time") {
+            ReferenceFill(config, buffer.data(), buffer.data() + size);
+            return buffer[0];
+        };
+        BENCHMARK(std::string(name) + ", vectorized") {
+            PerformMemoryFill(config, buffer.data());
+            return buffer[0];
+        };
+    }
+}
+
+} // namespace GPU
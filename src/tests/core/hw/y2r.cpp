@@ -0,0 +1,294 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <fmt/format.h>
+#include "common/memory_ref.h"
+#include "core/core.h"
+#include "core/core_timing.h"
+#include "core/hle/kernel/process.h"
+#include "core/hle/service/y2r_u.h"
+#include "core/hw/y2r.h"
+#include "core/memory.h"
+
+namespace HW::Y2R {
+
+using namespace Service::Y2R;
+
+namespace {
+
+constexpr InputFormat input_formats[] = {
+    InputFormat::YUV422_Indiv8,  InputFormat::YUV420_Indiv8,       InputFormat::YUV422_Indiv16,
+    InputFormat::YUV420_Indiv16, InputFormat::YUYV422_Interleaved,
+};
+
+constexpr OutputFormat output_formats[] = {
+    OutputFormat::RGBA8,
+    OutputFormat::RGB8,
+    OutputFormat::RGB5A1,
+    OutputFormat::RGB565,
+};
+
+std::vector<u8> RandomData(std::size_t size, u32 seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(0, 0xFF);
+    std::vector<u8> data(size);
+    std::generate(data.begin(), data.end(), [&] { return static_cast<u8>(dist(rng)); });
+    return data;
+}
+
+std::vector<CoefficientSet> TestCoefficients() {
+    std::vector<CoefficientSet> sets;
+    for (const auto standard : {StandardCoefficient::ITU_Rec601, StandardCoefficient::ITU_Rec709,
+                                StandardCoefficient::ITU_Rec601_Scaling,
+                                StandardCoefficient::ITU_Rec709_Scaling}) {
+        ConversionConfiguration cvt{};
+        REQUIRE(cvt.SetStandardCoefficient(standard) == RESULT_SUCCESS);
+        sets.push_back(cvt.coefficients);
+    }
+    // Games can set any coefficients, so check the extremes and values that overflow components
+    sets.push_back({-0x8000, -0x8000, -0x8000, -0x8000, -0x8000, -0x8000, -0x8000, -0x8000});
+    sets.push_back({0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF});
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> dist(-0x8000, 0x7FFF);
+    for (int i = 0; i < 8; i++) {
+        CoefficientSet set;
+        std::generate(set.begin(), set.end(), [&] { return static_cast<s16>(dist(rng)); });
+        sets.push_back(set);
+    }
+    return sets;
+}
+
+bool Is16Bit(InputFormat input_format) {
+    return input_format == InputFormat::YUV422_Indiv16 ||
+           input_format == InputFormat::YUV420_Indiv16;
+}
+
+bool Is420(InputFormat input_format) {
+    return input_format == InputFormat::YUV420_Indiv8 ||
+           input_format == InputFormat::YUV420_Indiv16;
+}
+
+/// A process with buffers mapped at fixed addresses, to run conversions from and to.
+struct ConversionEnvironment {
+    static constexpr VAddr input_address = 0x10000000;
+    static constexpr VAddr output_address = 0x10800000;
+    static constexpr u32 buffer_size = 0x400000;
+    // Offsets of the individual components in the input buffer
+    static constexpr u32 offset_U = 0x100000;
+    static constexpr u32 offset_V = 0x200000;
+
+    ConversionEnvironment()
+        : timing(1, 100), kernel(
+                              memory, timing, [] {}, 0, 1, 0) {
+        process = kernel.CreateProcess(kernel.CreateCodeSet("", 0));
+        kernel.SetCurrentProcess(process);
+        for (const VAddr address : {input_address, output_address}) {
+            auto buffer = std::make_shared<BufferMem>(buffer_size);
+            REQUIRE(process->vm_manager
+                        .MapBackingMemory(address, MemoryRef{buffer}, buffer_size,
+                                          Kernel::MemoryState::Private)
+                        .Code() == RESULT_SUCCESS);
+        }
+    }
+
+    /// Sets up a whole image to be converted from the input buffer to the output buffer, a row
+    /// per transfer unit.
+    static ConversionConfiguration MakeConfig(InputFormat input_format,
+                                              OutputFormat output_format, u16 width, u16 height) {
+        ConversionConfiguration cvt{};
+        cvt.input_format = input_format;
+        cvt.output_format = output_format;
+        cvt.rotation = Rotation::None;
+        cvt.block_alignment = BlockAlignment::Linear;
+        REQUIRE(cvt.SetInputLineWidth(width) == RESULT_SUCCESS);
+        REQUIRE(cvt.SetInputLines(height) == RESULT_SUCCESS);
+        REQUIRE(cvt.SetStandardCoefficient(StandardCoefficient::ITU_Rec601) == RESULT_SUCCESS);
+        cvt.alpha = 0xFF;
+
+        const auto set_buffer = [](ConversionBuffer& buf, VAddr address, u32 transfer_unit) {
+            buf.address = address;
+            buf.image_size = buffer_size;
+            buf.transfer_unit = static_cast<u16>(transfer_unit);
+            buf.gap = 0;
+        };
+        const u32 component_size = Is16Bit(input_format) ? 2 : 1;
+        const u32 chroma_width = Is420(input_format) ? width / 4 : width / 2;
+        set_buffer(cvt.src_Y, input_address, width * component_size);
+        set_buffer(cvt.src_U, input_address + offset_U, chroma_width * component_size);
+        set_buffer(cvt.src_V, input_address + offset_V, chroma_width * component_size);
+        set_buffer(cvt.src_YUYV, input_address, width * 2);
+        set_buffer(cvt.dst, output_address, width * BytesPerPixel(output_format));
+        return cvt;
+    }
+
+    static u32 BytesPerPixel(OutputFormat output_format) {
+        switch (output_format) {
+        case OutputFormat::RGBA8:
+            return 4;
+        case OutputFormat::RGB8:
+            return 3;
+        default:
+            return 2;
+        }
+    }
+
+    Core::Timing timing;
+    Memory::MemorySystem memory;
+    Kernel::KernelSystem kernel;
+    std::shared_ptr<Kernel::Process> process;
+};
+
+/// Converts an image with the scalar reference kernels, a strip at a time like PerformConversion.
+std::vector<u8> ReferenceConversion(const ConversionConfiguration& cvt, const u8* input) {
+    const unsigned int width = cvt.input_line_width;
+    const std::size_t step = Is16Bit(cvt.input_format) ? 2 : 1;
+    // 16-bit components are converted from their low byte
+    const auto gather = [step](std::vector<u8>& strip, const u8* source, std::size_t count) {
+        for (std::size_t i = 0; i < count; i++) {
+            strip[i] = source[i * step];
+        }
+    };
+
+    std::vector<u8> result;
+    for (unsigned int y = 0; y < cvt.input_lines; y += 8) {
+        const unsigned int height = std::min(cvt.input_lines - y, 8u);
+        std::vector<u8> strip_Y(width * 8 * 2), strip_U(width * 4), strip_V(width * 4);
+        if (cvt.input_format == InputFormat::YUYV422_Interleaved) {
+            std::copy_n(input + y * width * 2, width * height * 2, strip_Y.begin());
+        } else {
+            // 4:2:0 chroma has half as many rows as 4:2:2 chroma
+            const std::size_t chroma_divisor = Is420(cvt.input_format) ? 4 : 2;
+            const std::size_t chroma_start = y * width / chroma_divisor;
+            const std::size_t chroma_size = width * height / chroma_divisor;
+            gather(strip_Y, input + y * width * step, width * height);
+            gather(strip_U, input + ConversionEnvironment::offset_U + chroma_start * step,
+                   chroma_size);
+            gather(strip_V, input + ConversionEnvironment::offset_V + chroma_start * step,
+                   chroma_size);
+        }
+
+        std::vector<ImageTile> tiles(width / 8);
+        ConvertYUVToRGBGeneric(cvt.input_format, strip_Y.data(), strip_U.data(), strip_V.data(),
+                               tiles.data(), width, height, cvt.coefficients);
+        std::vector<u32> pixels;
+        for (unsigned int row = 0; row < height; row++) {
+            for (const auto& tile : tiles) {
+                pixels.insert(pixels.end(), tile.begin() + row * 8, tile.begin() + row * 8 + 8);
+            }
+        }
+        std::vector<u8> encoded(pixels.size() * 4);
+        EncodeRGBGeneric(cvt.output_format, pixels.data(), encoded.data(), pixels.size(),
+                         static_cast<u8>(cvt.alpha));
+        encoded.resize(pixels.size() * ConversionEnvironment::BytesPerPixel(cvt.output_format));
+        result.insert(result.end(), encoded.begin(), encoded.end());
+    }
+    return result;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("Y2R - SIMD conversion matches the scalar reference", "[core][hw]") {
+    const auto coefficient_sets = TestCoefficients();
+    for (const auto input_format : input_formats) {
+        for (const unsigned int width : {8u, 16u, 48u, 400u}) {
+            // The largest strip any input format needs, in bytes
+            const std::vector<u8> input = RandomData(width * 8 * 2, width);
+            const u8* input_Y = input.data();
+            const u8* input_U = input_Y + 8 * width;
+            const u8* input_V = input_U + 8 * width / 2;
+
+            for (unsigned int height = 1; height <= 8; height++) {
+                for (const auto& coefficients : coefficient_sets) {
+                    INFO("input format " << static_cast<int>(input_format) << ", width " << width
+                                         << ", height " << height);
+                    std::vector<ImageTile> expected(width / 8);
+                    std::vector<ImageTile> actual(width / 8);
+                    ConvertYUVToRGBGeneric(input_format, input_Y, input_U, input_V,
+                                           expected.data(), width, height, coefficients);
+                    ConvertYUVToRGB(input_format, input_Y, input_U, input_V, actual.data(), width,
+                                    height, coefficients);
+                    for (std::size_t tile = 0; tile < expected.size(); tile++) {
+                        REQUIRE(std::equal(expected[tile].begin(),
+                                           expected[tile].begin() + height * 8,
+                                           actual[tile].begin()));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Y2R - SIMD encoding matches the scalar reference", "[core][hw]") {
+    std::vector<u32> input(64);
+    std::mt19937 rng(5678);
+    // Converted pixels are 0xRRGGBB00
+    std::generate(input.begin(), input.end(), [&] { return static_cast<u32>(rng()) << 8; });
+
+    for (const auto output_format : output_formats) {
+        for (const u8 alpha : {0x00, 0x7F, 0x80, 0xFF}) {
+            for (std::size_t count = 0; count <= input.size(); count++) {
+                INFO("output format " << static_cast<int>(output_format) << ", alpha "
+                                      << static_cast<int>(alpha) << ", count " << count);
+                std::vector<u8> expected(input.size() * 4, 0xCD);
+                std::vector<u8> actual(input.size() * 4, 0xCD);
+                EncodeRGBGeneric(output_format, input.data(), expected.data(), count, alpha);
+                EncodeRGB(output_format, input.data(), actual.data(), count, alpha);
+                REQUIRE(actual == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("Y2R - PerformConversion converts whole images", "[core][hw]") {
+    ConversionEnvironment env;
+    constexpr u16 width = 64;
+    constexpr u16 height = 20;
+
+    for (const auto input_format : input_formats) {
+        const std::vector<u8> input = RandomData(ConversionEnvironment::buffer_size,
+                                                 static_cast<u32>(input_format));
+        env.memory.WriteBlock(*env.process, ConversionEnvironment::input_address, input.data(),
+                              input.size());
+        for (const auto output_format : output_formats) {
+            INFO("input format " << static_cast<int>(input_format) << ", output format "
+                                 << static_cast<int>(output_format));
+            auto cvt = ConversionEnvironment::MakeConfig(input_format, output_format, width,
+                                                         height);
+            const std::vector<u8> expected = ReferenceConversion(cvt, input.data());
+
+            PerformConversion(env.memory, cvt);
+            std::vector<u8> actual(expected.size());
+            env.memory.ReadBlock(*env.process, ConversionEnvironment::output_address,
+                                 actual.data(), actual.size());
+            REQUIRE(actual == expected);
+        }
+    }
+}
+
+TEST_CASE("Y2R - benchmark", "[.][benchmark][core][hw]") {
+    // A 400x240 video frame, as converted by titles that play FMVs
+    constexpr u16 width = 400;
+    constexpr u16 height = 240;
+    ConversionEnvironment env;
+
+    for (const auto input_format : {InputFormat::YUV420_Indiv8, InputFormat::YUV422_Indiv8,
+                                    InputFormat::YUYV422_Interleaved}) {
+        for (const auto output_format : {OutputFormat::RGBA8, OutputFormat::RGB565}) {
+            BENCHMARK(fmt::format("Input format {}, output format {}",
+                                  static_cast<int>(input_format),
+                                  static_cast<int>(output_format))) {
+                auto cvt = ConversionEnvironment::MakeConfig(input_format, output_format, width,
+                                                             height);
+                PerformConversion(env.memory, cvt);
+            };
+        }
+    }
+}
+
+} // namespace HW::Y2R
@@ -0,0 +1,188 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "common/common_paths.h"
+#include "common/file_util.h"
+#include "common/thread_pool.h"
+#include "core/loader/game_scanner.h"
+#include "core/loader/smdh.h"
+#include "tests/temp_directory.h"
+
+namespace Loader {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void WriteFile(const fs::path& path, const std::vector<u8>& data) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+/// A 3DSX without any code, and with an SMDH if `with_smdh` is set.
+std::vector<u8> Make3DSX(bool with_smdh) {
+    constexpr u32 header_size = 44;
+    std::vector<u8> data(header_size);
+    const u32 magic = MakeMagic('3', 'D', 'S', 'X');
+    std::memcpy(data.data(), &magic, sizeof(magic));
+    std::memcpy(data.data() + 4, &header_size, 2);
+    if (with_smdh) {
+        const u32 smdh_offset = header_size;
+        const u32 smdh_size = sizeof(SMDH);
+        std::memcpy(data.data() + 0x20, &smdh_offset, sizeof(smdh_offset));
+        std::memcpy(data.data() + 0x24, &smdh_size, sizeof(smdh_size));
+        data.resize(header_size + smdh_size);
+        const u32 smdh_magic = MakeMagic('S', 'M', 'D', 'H');
+        std::memcpy(data.data() + header_size, &smdh_magic, sizeof(smdh_magic));
+    }
+    return data;
+}
+
+/// Scans `directory` and returns the names of the games found, relative to it.
+std::vector<std::string> Scan(GameScanner& scanner, const std::string& directory,
+                              unsigned int recursion) {
+    std::vector<std::string> games;
+    scanner.Scan(directory, recursion, [&](GameInfo&& game) {
+        REQUIRE(game.file_type == FileType::THREEDSX);
+        games.push_back(game.path.substr(directory.size() + 1) +
+                        (IsValidSMDH(game.smdh) ? " with icon" : ""));
+    });
+    return games;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("GameScanner - finds games in order", "[core][loader]") {
+    const Tests::TempDirectory dir("game_scanner_test");
+    const std::string games_path = dir.Path("games");
+    // Name of each game as Scan reports it, by its path relative to the games directory
+    std::map<std::string, std::string> names;
+    const auto write_game = [&](const std::string& path, bool with_smdh) {
+        WriteFile(dir / "games" / path, Make3DSX(with_smdh));
+        names[path] = path + (with_smdh ? " with icon" : "");
+    };
+    write_game("a.3dsx", true);
+    write_game("b.3dsx", false);
+    write_game(std::string("sub") + DIR_SEP + "c.3dsx", true);
+    // Enough games that the threads opening them finish out of order
+    for (int i = 0; i < 16; i++) {
+        write_game("game" + std::to_string(i) + ".3dsx", i % 2 == 0);
+    }
+    WriteFile(dir / "games/broken.3ds", {1, 2, 3});
+    WriteFile(dir / "games/readme.txt", {1, 2, 3});
+
+    GameScanner scanner(2, "");
+    std::vector<std::string> directories;
+    scanner.Scan(games_path, 0, [](GameInfo&&) {},
+                 [&](const std::string& directory) { directories.push_back(directory); });
+    REQUIRE(directories == std::vector<std::string>{games_path});
+
+    // The games in the order the host lists the directories, depth first
+    const auto host_order = [&](unsigned int recursion) {
+        std::vector<std::string> games;
+        std::function<void(const std::string&, unsigned int)> list;
+        list = [&](const std::string& directory, unsigned int depth) {
+            FileUtil::ForeachDirectoryEntry(
+                nullptr, directory,
+                [&](u64*, const std::string& parent, const std::string& name) {
+                    const std::string path = parent + DIR_SEP + name;
+                    if (FileUtil::IsDirectory(path)) {
+                        if (depth > 0) {
+                            list(path, depth - 1);
+                        }
+                    } else if (const auto it = names.find(path.substr(games_path.size() + 1));
+                               it != names.end()) {
+                        games.push_back(it->second);
+                    }
+                    return true;
+                });
+        };
+        list(games_path, recursion);
+        return games;
+    };
+
+    // However the threads opening them are scheduled, games are reported in that order
+    const std::vector<std::string> games = Scan(scanner, games_path, 0);
+    REQUIRE(games.size() == 18);
+    REQUIRE(games == host_order(0));
+
+    const std::vector<std::string> recursive_games = Scan(scanner, games_path, 1);
+    REQUIRE(recursive_games.size() == 19);
+    REQUIRE(recursive_games == host_order(1));
+}
+
+TEST_CASE("GameScanner - unchanged files are not opened again", "[core][loader]") {
+    const Tests::TempDirectory dir("game_scanner_test");
+    WriteFile(dir / "games/a.3dsx", Make3DSX(true));
+    WriteFile(dir / "games/b.3dsx", Make3DSX(false));
+    WriteFile(dir / "games/broken.3ds", {1, 2, 3});
+    const std::string index_path = dir.Path("game_list.bin");
+
+    std::vector<std::string> games;
+    {
+        GameScanner scanner(2, index_path);
+        games = Scan(scanner, dir.Path("games"), 0);
+        REQUIRE(scanner.GetStats().files == 3);
+        REQUIRE(scanner.GetStats().opened == 3);
+    }
+    REQUIRE(fs::exists(index_path));
+
+    {
+        GameScanner scanner(2, index_path);
+        REQUIRE(Scan(scanner, dir.Path("games"), 0) == games);
+        REQUIRE(scanner.GetStats().files == 3);
+        REQUIRE(scanner.GetStats().opened == 0);
+    }
+
+    // b gains an icon.
+    WriteFile(dir / "games/b.3dsx", Make3DSX(true));
+    GameScanner scanner(2, index_path);
+    const auto updated_games = Scan(scanner, dir.Path("games"), 0);
+    REQUIRE(scanner.GetStats().opened == 1);
+    REQUIRE(std::count(updated_games.begin(), updated_games.end(), "b.3dsx with icon") == 1);
+}
+
+TEST_CASE("GameScanner - benchmark", "[.][benchmark][core][loader]") {
+    const char* game_dir = std::getenv("CITRA_GAME_DIR");
+    if (!game_dir) {
+        WARN("Set CITRA_GAME_DIR to a directory of games to run this benchmark");
+        return;
+    }
+    const Tests::TempDirectory dir("game_scanner_test");
+    const std::string index_path = dir.Path("game_list.bin");
+
+    const auto scan = [&](std::size_t num_threads) {
+        GameScanner scanner(num_threads, index_path);
+        std::size_t num_games = 0;
+        scanner.Scan(game_dir, 256, [&](GameInfo&&) { num_games++; });
+        return num_games;
+    };
+
+    // Without an index, as the game list used to scan; every scan writes one.
+    const std::size_t num_threads = Common::ThreadPool::DefaultThreadCount(8);
+    BENCHMARK("No index, serial") {
+        fs::remove(index_path);
+        return scan(0);
+    };
+    BENCHMARK("No index, thread pool") {
+        fs::remove(index_path);
+        return scan(num_threads);
+    };
+    BENCHMARK("Index, thread pool") {
+        return scan(num_threads);
+    };
+}
+
+} // namespace Loader
@@ -0,0 +1,90 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <fmt/format.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "common/file_util.h"
+
+namespace Tests {
+
+/**
+ * A directory in the system's temporary directory that exists for as long as the object, and is
+ * removed along with everything in it afterwards. The name is suffixed with the process ID and a
+ * random number, so that test processes running at the same time never share a directory.
+ */
+class TempDirectory {
+public:
+    explicit TempDirectory(std::string_view name) {
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = getpid();
+#endif
+        std::random_device random;
+        do {
+            root = std::filesystem::temp_directory_path() /
+                   fmt::format("citra_{}_{}_{:08x}", name, pid, random());
+        } while (!std::filesystem::create_directories(root));
+    }
+
+    ~TempDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(root, error);
+    }
+
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    const std::filesystem::path& Root() const {
+        return root;
+    }
+
+    /// Returns the path of `relative` within the directory.
+    std::filesystem::path operator/(const std::filesystem::path& relative) const {
+        return root / relative;
+    }
+
+    /// Returns the path of `relative` within the directory as a string.
+    std::string Path(const std::filesystem::path& relative) const {
+        return (root / relative).string();
+    }
+
+    /// Returns the path of the directory `relative` within the directory, ending in a separator.
+    std::string DirectoryPath(const std::filesystem::path& relative) const {
+        return (root / relative).string() + '/';
+    }
+
+private:
+    std::filesystem::path root;
+};
+
+/// A TempDirectory that the user cache directory is moved to, in its "cache" subdirectory.
+class TempCacheDirectory : public TempDirectory {
+public:
+    explicit TempCacheDirectory(std::string_view name)
+        : TempDirectory(name), old_cache_dir(FileUtil::GetUserPath(FileUtil::UserPath::CacheDir)) {
+        FileUtil::UpdateUserPath(FileUtil::UserPath::CacheDir, Path("cache"));
+    }
+
+    ~TempCacheDirectory() {
+        // User paths are stored with a trailing separator, but set without one
+        FileUtil::UpdateUserPath(FileUtil::UserPath::CacheDir,
+                                 old_cache_dir.substr(0, old_cache_dir.size() - 1));
+    }
+
+private:
+    std::string old_cache_dir;
+};
+
+} // namespace Tests
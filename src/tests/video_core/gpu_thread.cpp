@@ -0,0 +1,299 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "core/hw/display_transfer.h"
+#include "core/hw/memory_fill.h"
+#include "core/memory.h"
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/gpu_thread.h"
+#include "video_core/pica_state.h"
+#include "video_core/pica_types.h"
+#include "video_core/shader/shader.h"
+#include "video_core/swrasterizer/clipper.h"
+#include "video_core/swrasterizer/rasterizer.h"
+#include "video_core/video_core.h"
+
+namespace VideoCore {
+
+namespace {
+
+void Spin(std::chrono::microseconds duration) {
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+using Pica::float24;
+using SwRasterizerTests::RawFloat24;
+using Triangles = std::vector<Pica::Shader::OutputVertex>;
+
+// The top screen, which the 3DS draws rotated
+constexpr u32 fb_width = 240;
+constexpr u32 fb_height = 400;
+constexpr PAddr color_address = Memory::VRAM_PADDR;
+constexpr PAddr depth_address = Memory::VRAM_PADDR + 0x100000;
+
+/**
+ * The work of drawing a frame on the software path: clearing the framebuffer with memory fills,
+ * drawing the triangles of a few command lists and copying the result to a linear buffer with a
+ * display transfer.
+ */
+class FrameWork {
+public:
+    FrameWork() : output(fb_width * fb_height * 3) {
+        VideoCore::g_memory = &memory;
+
+        auto& regs = Pica::g_state.regs;
+        std::memset(&regs, 0, sizeof(regs));
+        regs.rasterizer.viewport_size_x.Assign(RawFloat24(fb_width / 2.0f));
+        regs.rasterizer.viewport_size_y.Assign(RawFloat24(fb_height / 2.0f));
+        // Clip space depth goes from 0 to -w
+        regs.rasterizer.viewport_depth_range.Assign(RawFloat24(-1.0f));
+        regs.lighting.disable.Assign(1);
+
+        // Depth tested and alpha blended
+        auto& output_merger = regs.framebuffer.output_merger;
+        using BlendFactor = Pica::FramebufferRegs::BlendFactor;
+        output_merger.alphablend_enable.Assign(1);
+        output_merger.alpha_blending.factor_source_rgb.Assign(BlendFactor::SourceAlpha);
+        output_merger.alpha_blending.factor_dest_rgb.Assign(BlendFactor::OneMinusSourceAlpha);
+        output_merger.alpha_blending.factor_source_a.Assign(BlendFactor::One);
+        output_merger.alpha_blending.factor_dest_a.Assign(BlendFactor::Zero);
+        output_merger.depth_test_enable.Assign(1);
+        output_merger.depth_test_func.Assign(Pica::FramebufferRegs::CompareFunc::LessThan);
+        output_merger.red_enable.Assign(1);
+        output_merger.green_enable.Assign(1);
+        output_merger.blue_enable.Assign(1);
+        output_merger.alpha_enable.Assign(1);
+        output_merger.depth_write_enable.Assign(1);
+
+        auto& framebuffer = regs.framebuffer.framebuffer;
+        framebuffer.allow_color_write.Assign(0xF);
+        framebuffer.allow_depth_stencil_write.Assign(0x3);
+        framebuffer.color_format.Assign(Pica::FramebufferRegs::ColorFormat::RGBA8);
+        framebuffer.depth_format.Assign(Pica::FramebufferRegs::DepthFormat::D24S8);
+        framebuffer.color_buffer_address.Assign(color_address / 8);
+        framebuffer.depth_buffer_address.Assign(depth_address / 8);
+        framebuffer.width.Assign(fb_width);
+        framebuffer.height.Assign(fb_height - 1);
+        // The registers were set without going through the command processor
+        Pica::Rasterizer::g_rasterizer_state.Invalidate();
+
+        color_clear = MakeFill(color_address, 0xFF202020);
+        depth_clear = MakeFill(depth_address, 0x00FFFFFF);
+
+        transfer.input_format.Assign(GPU::Regs::PixelFormat::RGBA8);
+        transfer.output_format.Assign(GPU::Regs::PixelFormat::RGB8);
+        transfer.input_width.Assign(fb_width);
+        transfer.input_height.Assign(fb_height);
+        transfer.output_width.Assign(fb_width);
+        transfer.output_height.Assign(fb_height);
+    }
+
+    ~FrameWork() {
+        VideoCore::g_memory = nullptr;
+    }
+
+    void Clear() {
+        GPU::PerformMemoryFill(color_clear, memory.GetPhysicalPointer(color_address));
+        GPU::PerformMemoryFill(depth_clear, memory.GetPhysicalPointer(depth_address));
+    }
+
+    void Draw(const Triangles& vertices) {
+        for (std::size_t i = 0; i + 2 < vertices.size(); i += 3) {
+            Pica::Clipper::ProcessTriangle(vertices[i], vertices[i + 1], vertices[i + 2]);
+        }
+    }
+
+    void Present() {
+        GPU::PerformDisplayTransfer(transfer, memory.GetPhysicalPointer(color_address),
+                                    output.data());
+    }
+
+private:
+    static GPU::Regs::MemoryFillConfig MakeFill(PAddr address, u32 value) {
+        GPU::Regs::MemoryFillConfig config{};
+        // Addresses are given in units of 8 bytes
+        config.address_start = address / 8;
+        config.address_end = (address + fb_width * fb_height * 4) / 8;
+        config.value_32bit = value;
+        config.fill_32bit.Assign(1);
+        return config;
+    }
+
+    Memory::MemorySystem memory;
+    GPU::Regs::MemoryFillConfig color_clear;
+    GPU::Regs::MemoryFillConfig depth_clear;
+    GPU::Regs::DisplayTransferConfig transfer{};
+    std::vector<u8> output;
+};
+
+/**
+ * Builds the triangles of a command list on the CPU: a grid of translucent quads at different
+ * depths, turned a little further every frame. Each list covers about a quarter of the screen,
+ * and the lists of a frame overlap each other.
+ */
+Triangles BuildTriangles(int frame, int list) {
+    constexpr int grid = 8;
+    const float angle = frame * 0.02f + list * 0.5f;
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+
+    Triangles vertices;
+    vertices.reserve(grid * grid * 6);
+    const auto add_vertex = [&](float x, float y, float z, float shade) {
+        Pica::Shader::OutputVertex vertex{};
+        vertex.pos = Common::MakeVec(float24::FromFloat32(x * c - y * s),
+                                     float24::FromFloat32(x * s + y * c), float24::FromFloat32(-z),
+                                     float24::FromFloat32(1.0f));
+        vertex.color =
+            Common::MakeVec(float24::FromFloat32(shade), float24::FromFloat32(1.0f - shade),
+                            float24::FromFloat32(0.5f), float24::FromFloat32(0.6f));
+        vertices.push_back(vertex);
+    };
+    for (int y = 0; y < grid; y++) {
+        for (int x = 0; x < grid; x++) {
+            const float x0 = x * 2.0f / grid - 1.0f;
+            const float y0 = y * 2.0f / grid - 1.0f;
+            const float x1 = x0 + 1.0f / grid;
+            const float y1 = y0 + 1.0f / grid;
+            const float z = ((x * 7 + y * 13 + list * 5) % 16) / 16.0f;
+            const float shade = static_cast<float>(x + y) / (2 * grid);
+            add_vertex(x0, y0, z, shade);
+            add_vertex(x1, y0, z, shade);
+            add_vertex(x1, y1, z, shade);
+            add_vertex(x0, y0, z, shade);
+            add_vertex(x1, y1, z, shade);
+            add_vertex(x0, y1, z, shade);
+        }
+    }
+    return vertices;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("GPUThread - work runs in order on the GPU thread", "[video_core]") {
+    constexpr u64 num_work = 20;
+    GPUThread gpu_thread(4);
+    REQUIRE(!gpu_thread.IsGPUThread());
+
+    // Recorded on the GPU thread and checked here, as Catch can only check on the test thread
+    std::vector<u64> order;
+    std::vector<u64> fences;
+    std::vector<bool> on_gpu_thread;
+    for (u64 i = 1; i <= num_work; i++) {
+        const u64 fence = gpu_thread.Submit([&, i] {
+            on_gpu_thread.push_back(gpu_thread.IsGPUThread());
+            fences.push_back(gpu_thread.GetCurrentFence());
+            // Waiting on the GPU thread itself must not deadlock
+            gpu_thread.WaitForIdle();
+            order.push_back(i);
+        });
+        REQUIRE(fence == i);
+    }
+    gpu_thread.WaitFor(num_work);
+    REQUIRE(gpu_thread.GetLastFence() == num_work);
+    REQUIRE(order.size() == num_work);
+    for (u64 i = 0; i < order.size(); i++) {
+        REQUIRE(order[i] == i + 1);
+        REQUIRE(fences[i] == i + 1);
+        REQUIRE(on_gpu_thread[i]);
+    }
+
+    // Fences that were never handed out do not block
+    gpu_thread.WaitFor(1000);
+}
+
+TEST_CASE("GPUThread - fences carry on from a restored fence", "[video_core]") {
+    GPUThread gpu_thread(4);
+    gpu_thread.Submit([] {});
+    gpu_thread.ContinueFrom(500);
+    REQUIRE(gpu_thread.GetLastFence() == 500);
+
+    std::atomic<u64> current_fence{0};
+    const u64 fence =
+        gpu_thread.Submit([&] { current_fence = gpu_thread.GetCurrentFence(); });
+    REQUIRE(fence == 501);
+    gpu_thread.WaitFor(fence);
+    REQUIRE(current_fence == 501);
+}
+
+TEST_CASE("GPUThread - submitting blocks once the queue is full", "[video_core]") {
+    constexpr std::size_t queue_depth = 3;
+    GPUThread gpu_thread(queue_depth);
+
+    std::atomic<u64> completed{0};
+    for (u64 i = 0; i < 50; i++) {
+        const u64 fence = gpu_thread.Submit([&] {
+            Spin(std::chrono::microseconds(100));
+            completed++;
+        });
+        REQUIRE(fence - completed <= queue_depth);
+    }
+    gpu_thread.WaitForIdle();
+    REQUIRE(completed == 50);
+}
+
+TEST_CASE("GPUThread - pending work completes on destruction", "[video_core]") {
+    std::atomic<int> completed{0};
+    {
+        GPUThread gpu_thread(8);
+        for (int i = 0; i < 8; i++) {
+            gpu_thread.Submit([&] {
+                Spin(std::chrono::microseconds(100));
+                completed++;
+            });
+        }
+    }
+    REQUIRE(completed == 8);
+}
+
+TEST_CASE("GPUThread - benchmark", "[.][benchmark][video_core]") {
+    // Frames of four command lists, synchronised at vblank. Between lists, the CPU builds the
+    // triangles of the next one and runs the game, which the spin stands in for.
+    constexpr int num_frames = 4;
+    constexpr int num_lists = 4;
+    constexpr auto cpu_time = std::chrono::microseconds(2500);
+    FrameWork frame_work;
+    GPUThread gpu_thread(8);
+
+    const auto run_frames = [&](GPUThread* thread) {
+        const auto run = [thread](auto work) {
+            if (thread) {
+                thread->Submit(std::move(work));
+            } else {
+                work();
+            }
+        };
+        for (int frame = 0; frame < num_frames; frame++) {
+            run([&frame_work] { frame_work.Clear(); });
+            for (int list = 0; list < num_lists; list++) {
+                Spin(cpu_time);
+                run([&frame_work, triangles = BuildTriangles(frame, list)] {
+                    frame_work.Draw(triangles);
+                });
+            }
+            run([&frame_work] { frame_work.Present(); });
+            if (thread) {
+                thread->WaitForIdle();
+            }
+        }
+    };
+
+    BENCHMARK("Synchronous") {
+        run_frames(nullptr);
+    };
+    BENCHMARK("GPU thread") {
+        run_frames(&gpu_thread);
+    };
+}
+
+} // namespace VideoCore
@@ -0,0 +1,373 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include <boost/container/static_vector.hpp>
+#include <catch2/catch.hpp>
+#include "common/logging/log.h"
+#include "common/vector_math.h"
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/pica_state.h"
+#include "video_core/pica_types.h"
+#include "video_core/shader/shader.h"
+#include "video_core/swrasterizer/clipper.h"
+#include "video_core/swrasterizer/rasterizer.h"
+
+namespace Pica::Clipper {
+
+namespace {
+
+using Rasterizer::Vertex;
+using SwRasterizerTests::RawFloat24;
+
+// The clipper as it clipped and set up each triangle separately.
+struct ClippingEdge {
+public:
+    ClippingEdge(Common::Vec4<float24> coeffs,
+                 Common::Vec4<float24> bias = Common::Vec4<float24>(float24::FromFloat32(0),
+                                                                    float24::FromFloat32(0),
+                                                                    float24::FromFloat32(0),
+                                                                    float24::FromFloat32(0)))
+        : coeffs(coeffs), bias(bias) {}
+
+    bool IsInside(const Vertex& vertex) const {
+        return Common::Dot(vertex.pos + bias, coeffs) >= float24::FromFloat32(0);
+    }
+
+    bool IsOutSide(const Vertex& vertex) const {
+        return !IsInside(vertex);
+    }
+
+    Vertex GetIntersection(const Vertex& v0, const Vertex& v1) const {
+        float24 dp = Common::Dot(v0.pos + bias, coeffs);
+        float24 dp_prev = Common::Dot(v1.pos + bias, coeffs);
+        float24 factor = dp_prev / (dp_prev - dp);
+
+        return Vertex::Lerp(factor, v0, v1);
+    }
+
+private:
+    float24 pos;
+    Common::Vec4<float24> coeffs;
+    Common::Vec4<float24> bias;
+};
+
+void InitScreenCoordinates(Vertex& vtx) {
+    struct {
+        float24 halfsize_x;
+        float24 offset_x;
+        float24 halfsize_y;
+        float24 offset_y;
+        float24 zscale;
+        float24 offset_z;
+    } viewport;
+
+    const auto& regs = g_state.regs;
+    viewport.halfsize_x = float24::FromRaw(regs.rasterizer.viewport_size_x);
+    viewport.halfsize_y = float24::FromRaw(regs.rasterizer.viewport_size_y);
+    viewport.offset_x = float24::FromFloat32(static_cast<float>(regs.rasterizer.viewport_corner.x));
+    viewport.offset_y = float24::FromFloat32(static_cast<float>(regs.rasterizer.viewport_corner.y));
+
+    float24 inv_w = float24::FromFloat32(1.f) / vtx.pos.w;
+    vtx.pos.w = inv_w;
+    vtx.quat *= inv_w;
+    vtx.color *= inv_w;
+    vtx.tc0 *= inv_w;
+    vtx.tc1 *= inv_w;
+    vtx.tc0_w *= inv_w;
+    vtx.view *= inv_w;
+    vtx.tc2 *= inv_w;
+
+    vtx.screenpos[0] =
+        (vtx.pos.x * inv_w + float24::FromFloat32(1.0)) * viewport.halfsize_x + viewport.offset_x;
+    vtx.screenpos[1] =
+        (vtx.pos.y * inv_w + float24::FromFloat32(1.0)) * viewport.halfsize_y + viewport.offset_y;
+    vtx.screenpos[2] = vtx.pos.z * inv_w;
+}
+
+void ReferenceProcessTriangle(const OutputVertex& v0, const OutputVertex& v1,
+                              const OutputVertex& v2, const TriangleHandler& triangle_handler) {
+    using boost::container::static_vector;
+
+    // Clipping a planar n-gon against a plane will remove at least 1 vertex and introduces 2 at
+    // the new edge (or less in degenerate cases). As such, we can say that each clipping plane
+    // introduces at most 1 new vertex to the polygon. Since we start with a triangle and have a
+    // fixed 6 clipping planes, the maximum number of vertices of the clipped polygon is 3 + 6 = 9.
+    static const std::size_t MAX_VERTICES = 9;
+    static_vector<Vertex, MAX_VERTICES> buffer_a = {v0, v1, v2};
+    static_vector<Vertex, MAX_VERTICES> buffer_b;
+
+    auto FlipQuaternionIfOpposite = [](auto& a, const auto& b) {
+        if (Common::Dot(a, b) < float24::Zero())
+            a = a * float24::FromFloat32(-1.0f);
+    };
+
+    // Flip the quaternions if they are opposite to prevent interpolating them over the wrong
+    // direction.
+    FlipQuaternionIfOpposite(buffer_a[1].quat, buffer_a[0].quat);
+    FlipQuaternionIfOpposite(buffer_a[2].quat, buffer_a[0].quat);
+
+    auto* output_list = &buffer_a;
+    auto* input_list = &buffer_b;
+
+    // NOTE: We clip against a w=epsilon plane to guarantee that the output has a positive w value.
+    // TODO: Not sure if this is a valid approach. Also should probably instead use the smallest
+    //       epsilon possible within float24 accuracy.
+    static const float24 EPSILON = float24::FromFloat32(0.00001f);
+    static const float24 f0 = float24::FromFloat32(0.0);
+    static const float24 f1 = float24::FromFloat32(1.0);
+    static const std::array<ClippingEdge, 7> clipping_edges = {{
+        {Common::MakeVec(-f1, f0, f0, f1)}, // x = +w
+        {Common::MakeVec(f1, f0, f0, f1)},  // x = -w
+        {Common::MakeVec(f0, -f1, f0, f1)}, // y = +w
+        {Common::MakeVec(f0, f1, f0, f1)},  // y = -w
+        {Common::MakeVec(f0, f0, -f1, f0)}, // z =  0
+        {Common::MakeVec(f0, f0, f1, f1)},  // z = -w
+        {Common::MakeVec(f0, f0, f0, f1),
+         Common::Vec4<float24>(f0, f0, f0, EPSILON)}, // w = EPSILON
+    }};
+
+    // Simple implementation of the Sutherland-Hodgman clipping algorithm.
+    // TODO: Make this less inefficient (currently lots of useless buffering overhead happens here)
+    auto Clip = [&](const ClippingEdge& edge) {
+        std::swap(input_list, output_list);
+        output_list->clear();
+
+        const Vertex* reference_vertex = &input_list->back();
+
+        for (const auto& vertex : *input_list) {
+            // NOTE: This algorithm changes vertex order in some cases!
+            if (edge.IsInside(vertex)) {
+                if (edge.IsOutSide(*reference_vertex)) {
+                    output_list->push_back(edge.GetIntersection(vertex, *reference_vertex));
+                }
+
+                output_list->push_back(vertex);
+            } else if (edge.IsInside(*reference_vertex)) {
+                output_list->push_back(edge.GetIntersection(vertex, *reference_vertex));
+            }
+            reference_vertex = &vertex;
+        }
+    };
+
+    for (auto edge : clipping_edges) {
+        Clip(edge);
+
+        // Need to have at least a full triangle to continue...
+        if (output_list->size() < 3)
+            return;
+    }
+
+    if (g_state.regs.rasterizer.clip_enable) {
+        ClippingEdge custom_edge{g_state.regs.rasterizer.GetClipCoef()};
+        Clip(custom_edge);
+
+        if (output_list->size() < 3)
+            return;
+    }
+
+    InitScreenCoordinates((*output_list)[0]);
+    InitScreenCoordinates((*output_list)[1]);
+
+    for (std::size_t i = 0; i < output_list->size() - 2; i++) {
+        Vertex& vtx0 = (*output_list)[0];
+        Vertex& vtx1 = (*output_list)[i + 1];
+        Vertex& vtx2 = (*output_list)[i + 2];
+
+        InitScreenCoordinates(vtx2);
+
+        LOG_TRACE(
+            Render_Software,
+            "Triangle {}/{} at position ({:.3}, {:.3}, {:.3}, {:.3f}), "
+            "({:.3}, {:.3}, {:.3}, {:.3}), ({:.3}, {:.3}, {:.3}, {:.3}) and "
+            "screen position ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2})",
+            i + 1, output_list->size() - 2, vtx0.pos.x.ToFloat32(), vtx0.pos.y.ToFloat32(),
+            vtx0.pos.z.ToFloat32(), vtx0.pos.w.ToFloat32(), vtx1.pos.x.ToFloat32(),
+            vtx1.pos.y.ToFloat32(), vtx1.pos.z.ToFloat32(), vtx1.pos.w.ToFloat32(),
+            vtx2.pos.x.ToFloat32(), vtx2.pos.y.ToFloat32(), vtx2.pos.z.ToFloat32(),
+            vtx2.pos.w.ToFloat32(), vtx0.screenpos.x.ToFloat32(), vtx0.screenpos.y.ToFloat32(),
+            vtx0.screenpos.z.ToFloat32(), vtx1.screenpos.x.ToFloat32(),
+            vtx1.screenpos.y.ToFloat32(), vtx1.screenpos.z.ToFloat32(),
+            vtx2.screenpos.x.ToFloat32(), vtx2.screenpos.y.ToFloat32(),
+            vtx2.screenpos.z.ToFloat32());
+
+        triangle_handler(vtx0, vtx1, vtx2);
+    }
+}
+
+using Triangle = std::array<Vertex, 3>;
+
+/// Collects the triangles a clipper outputs.
+class TriangleList {
+public:
+    TriangleHandler Handler() {
+        return [this](const Vertex& v0, const Vertex& v1, const Vertex& v2) {
+            triangles.push_back({{v0, v1, v2}});
+        };
+    }
+
+    std::vector<Triangle> triangles;
+};
+
+/// The bits of the attributes of a vertex, which the clippers must agree on exactly.
+std::vector<u32> AttributeBits(const Vertex& vertex) {
+    std::vector<u32> bits;
+    const auto append = [&bits](float24 value) {
+        u32 raw;
+        const float f = value.ToFloat32();
+        std::memcpy(&raw, &f, sizeof(raw));
+        bits.push_back(raw);
+    };
+    for (std::size_t i = 0; i < 4; ++i) {
+        append(vertex.pos[i]);
+        append(vertex.quat[i]);
+        append(vertex.color[i]);
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+        append(vertex.tc0[i]);
+        append(vertex.tc1[i]);
+        append(vertex.tc2[i]);
+    }
+    append(vertex.tc0_w);
+    for (std::size_t i = 0; i < 3; ++i) {
+        append(vertex.view[i]);
+        append(vertex.screenpos[i]);
+    }
+    return bits;
+}
+
+float24 RandomFloat24(std::mt19937& rng, float min, float max) {
+    return float24::FromFloat32(std::uniform_real_distribution<float>(min, max)(rng));
+}
+
+/**
+ * A vertex around the view volume, occasionally with an infinite or NaN coordinate.
+ * @param visible Whether the vertex is in the view volume instead
+ */
+OutputVertex RandomVertex(std::mt19937& rng, bool visible = false) {
+    OutputVertex vertex{};
+    const float24 w = visible ? RandomFloat24(rng, 0.5f, 4.0f) : RandomFloat24(rng, -0.5f, 4.0f);
+    const float range = visible ? 0.9f : 1.3f;
+    vertex.pos = Common::MakeVec(w * RandomFloat24(rng, -range, range),
+                                 w * RandomFloat24(rng, -range, range),
+                                 -w * RandomFloat24(rng, visible ? 0.05f : -0.2f,
+                                                  visible ? 0.95f : 1.2f),
+                                 w);
+    if (!visible && std::uniform_int_distribution<int>(0, 99)(rng) == 0) {
+        constexpr std::array special = {std::numeric_limits<float>::infinity(),
+                                        -std::numeric_limits<float>::infinity(),
+                                        std::numeric_limits<float>::quiet_NaN(), 0.0f};
+        vertex.pos[std::uniform_int_distribution<int>(0, 3)(rng)] =
+            float24::FromFloat32(special[std::uniform_int_distribution<int>(0, 3)(rng)]);
+    }
+    for (std::size_t i = 0; i < 4; ++i) {
+        vertex.quat[i] = RandomFloat24(rng, -1.0f, 1.0f);
+        vertex.color[i] = RandomFloat24(rng, 0.0f, 1.0f);
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+        vertex.tc0[i] = RandomFloat24(rng, -2.0f, 2.0f);
+        vertex.tc1[i] = RandomFloat24(rng, -2.0f, 2.0f);
+        vertex.tc2[i] = RandomFloat24(rng, -2.0f, 2.0f);
+    }
+    vertex.tc0_w = RandomFloat24(rng, -2.0f, 2.0f);
+    for (std::size_t i = 0; i < 3; ++i) {
+        vertex.view[i] = RandomFloat24(rng, -10.0f, 10.0f);
+    }
+    return vertex;
+}
+
+void SetViewport(RasterizerRegs& regs) {
+    regs.viewport_size_x.Assign(RawFloat24(200.0f));
+    regs.viewport_size_y.Assign(RawFloat24(120.0f));
+    regs.viewport_corner.x.Assign(0);
+    regs.viewport_corner.y.Assign(0);
+}
+
+} // Anonymous namespace
+
+TEST_CASE("Clipper - triangles match clipping each triangle separately",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xC11B);
+    auto& regs = g_state.regs.rasterizer;
+    SetViewport(regs);
+
+    for (const bool clip_enable : {false, true}) {
+        regs.clip_enable.Assign(clip_enable);
+        for (int i = 0; i < 20000; ++i) {
+            if (clip_enable) {
+                for (auto& coef : regs.clip_coef) {
+                    coef.Assign(RawFloat24(RandomFloat24(rng, -1.0f, 1.0f).ToFloat32()));
+                }
+            }
+            // Half of the triangles are visible, the others mostly cross the view volume
+            const bool visible = i % 2 == 0;
+            const OutputVertex v0 = RandomVertex(rng, visible);
+            const OutputVertex v1 = RandomVertex(rng, visible);
+            const OutputVertex v2 = RandomVertex(rng, visible);
+
+            TriangleList output;
+            TriangleList reference;
+            ProcessTriangle(v0, v1, v2, output.Handler());
+            ReferenceProcessTriangle(v0, v1, v2, reference.Handler());
+
+            REQUIRE(output.triangles.size() == reference.triangles.size());
+            for (std::size_t t = 0; t < output.triangles.size(); ++t) {
+                for (std::size_t v = 0; v < 3; ++v) {
+                    REQUIRE(AttributeBits(output.triangles[t][v]) ==
+                            AttributeBits(reference.triangles[t][v]));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Clipper - benchmark", "[.][benchmark]") {
+    constexpr int num_triangles = 1 << 16;
+    std::mt19937 rng(0xBE7C);
+    auto& regs = g_state.regs.rasterizer;
+    SetViewport(regs);
+    regs.clip_enable.Assign(0);
+
+    // Mostly visible triangles, as in a scene that was culled before it was drawn, with one in
+    // sixteen around the view volume
+    std::vector<OutputVertex> vertices;
+    for (int i = 0; i < num_triangles; ++i) {
+        const bool visible = i % 16 != 0;
+        for (int v = 0; v < 3; ++v) {
+            vertices.push_back(RandomVertex(rng, visible));
+        }
+    }
+
+    std::size_t count = 0;
+    const TriangleHandler count_triangle = [&count](const Vertex&, const Vertex&, const Vertex&) {
+        ++count;
+    };
+    const auto process_all = [&](const auto& process_triangle) {
+        count = 0;
+        for (std::size_t i = 0; i < vertices.size(); i += 3) {
+            process_triangle(vertices[i], vertices[i + 1], vertices[i + 2], count_triangle);
+        }
+        return count;
+    };
+    const auto classified = [](const OutputVertex& v0, const OutputVertex& v1,
+                               const OutputVertex& v2, const TriangleHandler& handler) {
+        ProcessTriangle(v0, v1, v2, handler);
+    };
+    REQUIRE(process_all(ReferenceProcessTriangle) == process_all(classified));
+
+    BENCHMARK("65536 triangles, per triangle clipping") {
+        return process_all(ReferenceProcessTriangle);
+    };
+    BENCHMARK("65536 triangles, classified") {
+        return process_all(classified);
+    };
+}
+
+} // namespace Pica::Clipper
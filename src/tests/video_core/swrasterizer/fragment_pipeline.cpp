@@ -0,0 +1,446 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/regs.h"
+#include "video_core/swrasterizer/fragment_pipeline.h"
+#include "video_core/swrasterizer/framebuffer.h"
+#include "video_core/swrasterizer/texturing.h"
+
+namespace Pica::Rasterizer {
+
+namespace {
+
+using namespace SwRasterizerTests;
+
+using TevStageConfig = TexturingRegs::TevStageConfig;
+using Source = TevStageConfig::Source;
+
+TevInputs RandomInputs(std::mt19937& rng) {
+    return {RandomColor(rng),
+            RandomColor(rng),
+            RandomColor(rng),
+            {RandomColor(rng), RandomColor(rng), RandomColor(rng), RandomColor(rng)}};
+}
+
+/// Configures the texture combiners with random stages, some of which pass their input through.
+void RandomizeTevStages(std::mt19937& rng, Regs& regs) {
+    constexpr std::array sources = {
+        Source::PrimaryColor, Source::PrimaryFragmentColor, Source::SecondaryFragmentColor,
+        Source::Texture0,     Source::Texture1,             Source::Texture2,
+        Source::Texture3,     Source::PreviousBuffer,       Source::Constant,
+        Source::Previous,
+    };
+    constexpr std::array<u32, 10> color_modifiers = {0, 1, 2, 3, 4, 5, 8, 9, 12, 13};
+    // The dot products only exist for colors
+    constexpr std::array<u32, 8> alpha_ops = {0, 1, 2, 3, 4, 5, 8, 9};
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFFFF);
+
+    auto& texturing = regs.texturing;
+    for (TevStageConfig* stage : {&texturing.tev_stage0, &texturing.tev_stage1,
+                                  &texturing.tev_stage2, &texturing.tev_stage3,
+                                  &texturing.tev_stage4, &texturing.tev_stage5}) {
+        stage->color_source1.Assign(Pick(rng, sources));
+        stage->color_source2.Assign(Pick(rng, sources));
+        stage->color_source3.Assign(Pick(rng, sources));
+        stage->alpha_source1.Assign(Pick(rng, sources));
+        stage->alpha_source2.Assign(Pick(rng, sources));
+        stage->alpha_source3.Assign(Pick(rng, sources));
+        stage->color_modifier1.Assign(
+            static_cast<TevStageConfig::ColorModifier>(Pick(rng, color_modifiers)));
+        stage->color_modifier2.Assign(
+            static_cast<TevStageConfig::ColorModifier>(Pick(rng, color_modifiers)));
+        stage->color_modifier3.Assign(
+            static_cast<TevStageConfig::ColorModifier>(Pick(rng, color_modifiers)));
+        stage->alpha_modifier1.Assign(static_cast<TevStageConfig::AlphaModifier>(dist(rng) % 8));
+        stage->alpha_modifier2.Assign(static_cast<TevStageConfig::AlphaModifier>(dist(rng) % 8));
+        stage->alpha_modifier3.Assign(static_cast<TevStageConfig::AlphaModifier>(dist(rng) % 8));
+        stage->color_op.Assign(static_cast<TevStageConfig::Operation>(dist(rng) % 10));
+        stage->alpha_op.Assign(static_cast<TevStageConfig::Operation>(Pick(rng, alpha_ops)));
+        stage->const_color = dist(rng);
+        stage->scales_raw = dist(rng) & 0x30003;
+
+        if (dist(rng) % 3 == 0) {
+            stage->sources_raw = 0;
+            stage->color_source1.Assign(Source::Previous);
+            stage->alpha_source1.Assign(Source::Previous);
+            stage->modifiers_raw = 0;
+            stage->ops_raw = 0;
+            stage->scales_raw = 0;
+        }
+    }
+    texturing.tev_combiner_buffer_input.update_mask_rgb.Assign(dist(rng) & 0xF);
+    texturing.tev_combiner_buffer_input.update_mask_a.Assign(dist(rng) & 0xF);
+    texturing.tev_combiner_buffer_color.raw = dist(rng);
+}
+
+/// The texture combiners as evaluated before pipelines were built, reading the registers.
+Common::Vec4<u8> ReferenceCombineTextures(const Regs& regs, const TevInputs& inputs) {
+    const auto tev_stages = regs.texturing.GetTevStages();
+    Common::Vec4<u8> combiner_output = {0, 0, 0, 0};
+    Common::Vec4<u8> combiner_buffer = {0, 0, 0, 0};
+    Common::Vec4<u8> next_combiner_buffer =
+        Common::MakeVec(regs.texturing.tev_combiner_buffer_color.r.Value(),
+                        regs.texturing.tev_combiner_buffer_color.g.Value(),
+                        regs.texturing.tev_combiner_buffer_color.b.Value(),
+                        regs.texturing.tev_combiner_buffer_color.a.Value())
+            .Cast<u8>();
+
+    for (unsigned tev_stage_index = 0; tev_stage_index < tev_stages.size(); ++tev_stage_index) {
+        const auto& tev_stage = tev_stages[tev_stage_index];
+
+        auto GetSource = [&](Source source) -> Common::Vec4<u8> {
+            switch (source) {
+            case Source::PrimaryColor:
+                return inputs.primary_color;
+            case Source::PrimaryFragmentColor:
+                return inputs.primary_fragment_color;
+            case Source::SecondaryFragmentColor:
+                return inputs.secondary_fragment_color;
+            case Source::Texture0:
+            case Source::Texture1:
+            case Source::Texture2:
+            case Source::Texture3:
+                return inputs.texture_color[static_cast<u32>(source) -
+                                            static_cast<u32>(Source::Texture0)];
+            case Source::PreviousBuffer:
+                return combiner_buffer;
+            case Source::Constant:
+                return Common::MakeVec(tev_stage.const_r.Value(), tev_stage.const_g.Value(),
+                                       tev_stage.const_b.Value(), tev_stage.const_a.Value())
+                    .Cast<u8>();
+            case Source::Previous:
+                return combiner_output;
+            default:
+                return {0, 0, 0, 0};
+            }
+        };
+
+        Common::Vec3<u8> color_result[3] = {
+            GetColorModifier(tev_stage.color_modifier1, GetSource(tev_stage.color_source1)),
+            GetColorModifier(tev_stage.color_modifier2, GetSource(tev_stage.color_source2)),
+            GetColorModifier(tev_stage.color_modifier3, GetSource(tev_stage.color_source3)),
+        };
+        auto color_output = ColorCombine(tev_stage.color_op, color_result);
+
+        u8 alpha_output;
+        if (tev_stage.color_op == TevStageConfig::Operation::Dot3_RGBA) {
+            alpha_output = color_output.x;
+        } else {
+            std::array<u8, 3> alpha_result = {{
+                GetAlphaModifier(tev_stage.alpha_modifier1,
+                                       GetSource(tev_stage.alpha_source1)),
+                GetAlphaModifier(tev_stage.alpha_modifier2,
+                                       GetSource(tev_stage.alpha_source2)),
+                GetAlphaModifier(tev_stage.alpha_modifier3,
+                                       GetSource(tev_stage.alpha_source3)),
+            }};
+            alpha_output = AlphaCombine(tev_stage.alpha_op, alpha_result);
+        }
+
+        combiner_output[0] = std::min(255u, color_output.r() * tev_stage.GetColorMultiplier());
+        combiner_output[1] = std::min(255u, color_output.g() * tev_stage.GetColorMultiplier());
+        combiner_output[2] = std::min(255u, color_output.b() * tev_stage.GetColorMultiplier());
+        combiner_output[3] = std::min(255u, alpha_output * tev_stage.GetAlphaMultiplier());
+
+        combiner_buffer = next_combiner_buffer;
+
+        if (regs.texturing.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferColor(
+                tev_stage_index)) {
+            next_combiner_buffer.r() = combiner_output.r();
+            next_combiner_buffer.g() = combiner_output.g();
+            next_combiner_buffer.b() = combiner_output.b();
+        }
+
+        if (regs.texturing.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferAlpha(
+                tev_stage_index)) {
+            next_combiner_buffer.a() = combiner_output.a();
+        }
+    }
+
+    return combiner_output;
+}
+
+/// Blending as evaluated before pipelines were built, reading the registers.
+Common::Vec4<u8> ReferenceBlend(const Regs& regs, const Common::Vec4<u8>& source,
+                                const Common::Vec4<u8>& dest) {
+    using BlendFactor = FramebufferRegs::BlendFactor;
+    const auto& output_merger = regs.framebuffer.output_merger;
+    Common::Vec4<u8> blend_output;
+
+    if (output_merger.alphablend_enable) {
+        const auto params = output_merger.alpha_blending;
+        const Common::Vec4<u8> blend_const =
+            Common::MakeVec(output_merger.blend_const.r.Value(),
+                            output_merger.blend_const.g.Value(),
+                            output_merger.blend_const.b.Value(),
+                            output_merger.blend_const.a.Value())
+                .Cast<u8>();
+
+        auto LookupFactor = [&](unsigned channel, BlendFactor factor) -> u8 {
+            switch (factor) {
+            case BlendFactor::Zero:
+                return 0;
+            case BlendFactor::One:
+                return 255;
+            case BlendFactor::SourceColor:
+                return source[channel];
+            case BlendFactor::OneMinusSourceColor:
+                return 255 - source[channel];
+            case BlendFactor::DestColor:
+                return dest[channel];
+            case BlendFactor::OneMinusDestColor:
+                return 255 - dest[channel];
+            case BlendFactor::SourceAlpha:
+                return source.a();
+            case BlendFactor::OneMinusSourceAlpha:
+                return 255 - source.a();
+            case BlendFactor::DestAlpha:
+                return dest.a();
+            case BlendFactor::OneMinusDestAlpha:
+                return 255 - dest.a();
+            case BlendFactor::ConstantColor:
+                return blend_const[channel];
+            case BlendFactor::OneMinusConstantColor:
+                return 255 - blend_const[channel];
+            case BlendFactor::ConstantAlpha:
+                return blend_const.a();
+            case BlendFactor::OneMinusConstantAlpha:
+                return 255 - blend_const.a();
+            case BlendFactor::SourceAlphaSaturate:
+                if (channel == 3)
+                    return 255;
+                return std::min(source.a(), static_cast<u8>(255 - dest.a()));
+            }
+            return source[channel];
+        };
+
+        auto srcfactor = Common::MakeVec(LookupFactor(0, params.factor_source_rgb),
+                                         LookupFactor(1, params.factor_source_rgb),
+                                         LookupFactor(2, params.factor_source_rgb),
+                                         LookupFactor(3, params.factor_source_a));
+        auto dstfactor = Common::MakeVec(LookupFactor(0, params.factor_dest_rgb),
+                                         LookupFactor(1, params.factor_dest_rgb),
+                                         LookupFactor(2, params.factor_dest_rgb),
+                                         LookupFactor(3, params.factor_dest_a));
+
+        blend_output =
+            EvaluateBlendEquation(source, srcfactor, dest, dstfactor, params.blend_equation_rgb);
+        blend_output.a() =
+            EvaluateBlendEquation(source, srcfactor, dest, dstfactor, params.blend_equation_a)
+                .a();
+    } else {
+        blend_output = Common::MakeVec(LogicOp(source.r(), dest.r(), output_merger.logic_op),
+                                       LogicOp(source.g(), dest.g(), output_merger.logic_op),
+                                       LogicOp(source.b(), dest.b(), output_merger.logic_op),
+                                       LogicOp(source.a(), dest.a(), output_merger.logic_op));
+    }
+
+    return {
+        output_merger.red_enable ? blend_output.r() : dest.r(),
+        output_merger.green_enable ? blend_output.g() : dest.g(),
+        output_merger.blue_enable ? blend_output.b() : dest.b(),
+        output_merger.alpha_enable ? blend_output.a() : dest.a(),
+    };
+}
+
+bool ReferenceCompare(FramebufferRegs::CompareFunc func, u32 lhs, u32 rhs) {
+    using CompareFunc = FramebufferRegs::CompareFunc;
+    switch (func) {
+    case CompareFunc::Never:
+        return false;
+    case CompareFunc::Always:
+        return true;
+    case CompareFunc::Equal:
+        return lhs == rhs;
+    case CompareFunc::NotEqual:
+        return lhs != rhs;
+    case CompareFunc::LessThan:
+        return lhs < rhs;
+    case CompareFunc::LessThanOrEqual:
+        return lhs <= rhs;
+    case CompareFunc::GreaterThan:
+        return lhs > rhs;
+    case CompareFunc::GreaterThanOrEqual:
+        return lhs >= rhs;
+    }
+    return false;
+}
+
+} // Anonymous namespace
+
+TEST_CASE("FragmentPipeline - texture combiners match the register configuration",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0x7E5);
+    Regs regs{};
+
+    for (int config = 0; config < 500; ++config) {
+        RandomizeTevStages(rng, regs);
+        const FragmentPipeline pipeline(regs);
+
+        for (int fragment = 0; fragment < 20; ++fragment) {
+            const TevInputs inputs = RandomInputs(rng);
+            REQUIRE(AsArray(pipeline.CombineTextures(inputs)) ==
+                    AsArray(ReferenceCombineTextures(regs, inputs)));
+        }
+    }
+}
+
+TEST_CASE("FragmentPipeline - blending matches the register configuration",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xB1E);
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFFFF);
+    Regs regs{};
+    auto& output_merger = regs.framebuffer.output_merger;
+
+    for (int config = 0; config < 500; ++config) {
+        output_merger.alphablend_enable.Assign(dist(rng) & 1);
+        output_merger.alpha_blending.blend_equation_rgb.Assign(
+            static_cast<FramebufferRegs::BlendEquation>(dist(rng) % 5));
+        output_merger.alpha_blending.blend_equation_a.Assign(
+            static_cast<FramebufferRegs::BlendEquation>(dist(rng) % 5));
+        output_merger.alpha_blending.factor_source_rgb.Assign(
+            static_cast<FramebufferRegs::BlendFactor>(dist(rng) % 15));
+        output_merger.alpha_blending.factor_dest_rgb.Assign(
+            static_cast<FramebufferRegs::BlendFactor>(dist(rng) % 15));
+        output_merger.alpha_blending.factor_source_a.Assign(
+            static_cast<FramebufferRegs::BlendFactor>(dist(rng) % 15));
+        output_merger.alpha_blending.factor_dest_a.Assign(
+            static_cast<FramebufferRegs::BlendFactor>(dist(rng) % 15));
+        output_merger.logic_op.Assign(static_cast<FramebufferRegs::LogicOp>(dist(rng) % 16));
+        output_merger.blend_const.raw = dist(rng);
+        output_merger.red_enable.Assign(dist(rng) & 1);
+        output_merger.green_enable.Assign(dist(rng) & 1);
+        output_merger.blue_enable.Assign(dist(rng) & 1);
+        output_merger.alpha_enable.Assign(dist(rng) & 1);
+        const FragmentPipeline pipeline(regs);
+
+        for (int fragment = 0; fragment < 20; ++fragment) {
+            const auto source = RandomColor(rng);
+            const auto dest = RandomColor(rng);
+            REQUIRE(AsArray(pipeline.Blend(source, dest)) ==
+                    AsArray(ReferenceBlend(regs, source, dest)));
+        }
+    }
+}
+
+TEST_CASE("FragmentPipeline - tests compare like the register configuration",
+          "[video_core][swrasterizer]") {
+    Regs regs{};
+    auto& output_merger = regs.framebuffer.output_merger;
+    output_merger.alpha_test.enable.Assign(1);
+    output_merger.alpha_test.ref.Assign(0x80);
+    output_merger.stencil_test.reference_value.Assign(0x35);
+    output_merger.stencil_test.input_mask.Assign(0x0F);
+
+    for (u32 func = 0; func < 8; ++func) {
+        const auto compare_func = static_cast<FramebufferRegs::CompareFunc>(func);
+        output_merger.alpha_test.func.Assign(compare_func);
+        output_merger.stencil_test.func.Assign(compare_func);
+        output_merger.depth_test_func.Assign(compare_func);
+        const FragmentPipeline pipeline(regs);
+
+        for (u32 value : {0x00u, 0x05u, 0x7Fu, 0x80u, 0x81u, 0xF5u, 0xFFu}) {
+            REQUIRE(pipeline.AlphaTest(static_cast<u8>(value)) ==
+                    ReferenceCompare(compare_func, value, 0x80));
+            REQUIRE(pipeline.StencilTest(static_cast<u8>(value)) ==
+                    ReferenceCompare(compare_func, 0x05, value & 0x0F));
+            REQUIRE(pipeline.DepthTest(value << 16, 0x800000) ==
+                    ReferenceCompare(compare_func, value << 16, 0x800000));
+        }
+    }
+
+    output_merger.alpha_test.enable.Assign(0);
+    output_merger.alpha_test.func.Assign(FramebufferRegs::CompareFunc::Never);
+    REQUIRE(FragmentPipeline(regs).AlphaTest(0));
+}
+
+TEST_CASE("FragmentPipelineCache - pipelines follow the registers", "[video_core][swrasterizer]") {
+    FragmentPipelineCache cache(4);
+    Regs regs{};
+    regs.texturing.tev_stage0.const_color = 0x11223344;
+
+    const FragmentPipeline* pipeline = &cache.Get(regs);
+    REQUIRE(&cache.Get(regs) == pipeline);
+    REQUIRE(pipeline->GetKey() == FragmentPipeline::MakeKey(regs));
+
+    // Registers the pipeline doesn't depend on leave it alone
+    regs.rasterizer.viewport_size_x.Assign(240);
+    REQUIRE(&cache.Get(regs) == pipeline);
+
+    regs.texturing.tev_stage0.const_color = 0x55667788;
+    REQUIRE(cache.Get(regs).GetKey() == FragmentPipeline::MakeKey(regs));
+
+    regs.framebuffer.output_merger.depth_test_enable.Assign(1);
+    REQUIRE(cache.Get(regs).depth_test_enable);
+    regs.framebuffer.output_merger.depth_test_enable.Assign(0);
+    REQUIRE_FALSE(cache.Get(regs).depth_test_enable);
+}
+
+TEST_CASE("FragmentPipeline - depends on the registers of its key", "[video_core][swrasterizer]") {
+    const Regs regs{};
+    const FragmentPipeline::Key key = FragmentPipeline::MakeKey(regs);
+    for (u32 id = 0; id < Regs::NUM_REGS; ++id) {
+        Regs changed = regs;
+        changed.reg_array[id] = 0xFFFFFFFF;
+        INFO("Register " << id);
+        REQUIRE((FragmentPipeline::MakeKey(changed) != key) ==
+                FragmentPipeline::DependsOnRegister(id));
+    }
+}
+
+TEST_CASE("FragmentPipeline - benchmark", "[.][benchmark]") {
+    constexpr int num_fragments = 1 << 20;
+    std::mt19937 rng(0xBE7C);
+    std::vector<TevInputs> inputs(1024);
+    std::generate(inputs.begin(), inputs.end(), [&rng] { return RandomInputs(rng); });
+
+    for (int config = 0; config < 4; ++config) {
+        Regs regs{};
+        RandomizeTevStages(rng, regs);
+        regs.framebuffer.output_merger.alphablend_enable.Assign(1);
+        regs.framebuffer.output_merger.alpha_blending.factor_source_rgb.Assign(
+            FramebufferRegs::BlendFactor::SourceAlpha);
+        regs.framebuffer.output_merger.alpha_blending.factor_dest_rgb.Assign(
+            FramebufferRegs::BlendFactor::OneMinusSourceAlpha);
+        regs.framebuffer.output_merger.red_enable.Assign(1);
+        regs.framebuffer.output_merger.green_enable.Assign(1);
+        regs.framebuffer.output_merger.blue_enable.Assign(1);
+        regs.framebuffer.output_merger.alpha_enable.Assign(1);
+        const FragmentPipeline pipeline(regs);
+
+        const auto shade_all = [&inputs](const auto& shade) {
+            u32 checksum = 0;
+            Common::Vec4<u8> dest = {0, 0, 0, 0};
+            for (int i = 0; i < num_fragments; ++i) {
+                dest = shade(inputs[i % inputs.size()], dest);
+                checksum += dest.r() + dest.a();
+            }
+            return checksum;
+        };
+        const auto reference = [&regs](const TevInputs& fragment, const Common::Vec4<u8>& dest) {
+            return ReferenceBlend(regs, ReferenceCombineTextures(regs, fragment), dest);
+        };
+        const auto optimized = [&pipeline](const TevInputs& fragment,
+                                           const Common::Vec4<u8>& dest) {
+            return pipeline.Blend(pipeline.CombineTextures(fragment), dest);
+        };
+        REQUIRE(shade_all(reference) == shade_all(optimized));
+
+        BENCHMARK("Configuration " + std::to_string(config) + ", registers") {
+            return shade_all(reference);
+        };
+        BENCHMARK("Configuration " + std::to_string(config) + ", pipeline") {
+            return shade_all(optimized);
+        };
+    }
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,277 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <catch2/catch.hpp>
+#include "common/color.h"
+#include "core/memory.h"
+#include "video_core/pica_state.h"
+#include "video_core/regs_framebuffer.h"
+#include "video_core/swrasterizer/framebuffer.h"
+#include "video_core/utils.h"
+#include "video_core/video_core.h"
+
+namespace Pica::Rasterizer {
+
+namespace {
+
+using ColorFormat = FramebufferRegs::ColorFormat;
+using DepthFormat = FramebufferRegs::DepthFormat;
+
+constexpr u32 width = 64;
+constexpr u32 height = 48;
+constexpr PAddr color_address = Memory::VRAM_PADDR;
+constexpr PAddr depth_address = Memory::VRAM_PADDR + 0x100000;
+
+/// Points the software rasterizer at a framebuffer in VRAM for the duration of a test.
+class FramebufferEnvironment {
+public:
+    FramebufferEnvironment() {
+        VideoCore::g_memory = &memory;
+    }
+
+    ~FramebufferEnvironment() {
+        VideoCore::g_memory = nullptr;
+    }
+
+    FramebufferRegs MakeRegs(ColorFormat color_format, DepthFormat depth_format,
+                             u32 fb_width = width, u32 fb_height = height) const {
+        FramebufferRegs regs{};
+        regs.framebuffer.color_format.Assign(color_format);
+        regs.framebuffer.depth_format.Assign(depth_format);
+        regs.framebuffer.color_buffer_address.Assign(color_address / 8);
+        regs.framebuffer.depth_buffer_address.Assign(depth_address / 8);
+        regs.framebuffer.width.Assign(fb_width);
+        regs.framebuffer.height.Assign(fb_height - 1);
+        return regs;
+    }
+
+    u8* GetPointer(PAddr address) {
+        return memory.GetPhysicalPointer(address);
+    }
+
+private:
+    Memory::MemorySystem memory;
+};
+
+/// Offset of a pixel in a framebuffer, computed the way the per-pixel accessors used to.
+u32 ReferenceOffset(int x, int y, u32 bytes_per_pixel) {
+    y = height - 1 - y;
+    const u32 coarse_y = y & ~7;
+    return VideoCore::GetMortonOffset(x, y, bytes_per_pixel) + coarse_y * width * bytes_per_pixel;
+}
+
+void ReferenceEncode(ColorFormat format, const Common::Vec4<u8>& color, u8* bytes) {
+    switch (format) {
+    case ColorFormat::RGBA8:
+        Color::EncodeRGBA8(color, bytes);
+        break;
+    case ColorFormat::RGB8:
+        Color::EncodeRGB8(color, bytes);
+        break;
+    case ColorFormat::RGB5A1:
+        Color::EncodeRGB5A1(color, bytes);
+        break;
+    case ColorFormat::RGB565:
+        Color::EncodeRGB565(color, bytes);
+        break;
+    case ColorFormat::RGBA4:
+        Color::EncodeRGBA4(color, bytes);
+        break;
+    }
+}
+
+Common::Vec4<u8> ReferenceDecode(ColorFormat format, const u8* bytes) {
+    switch (format) {
+    case ColorFormat::RGBA8:
+        return Color::DecodeRGBA8(bytes);
+    case ColorFormat::RGB8:
+        return Color::DecodeRGB8(bytes);
+    case ColorFormat::RGB5A1:
+        return Color::DecodeRGB5A1(bytes);
+    case ColorFormat::RGB565:
+        return Color::DecodeRGB565(bytes);
+    case ColorFormat::RGBA4:
+        return Color::DecodeRGBA4(bytes);
+    }
+    return {0, 0, 0, 0};
+}
+
+u32 ReferenceDecodeDepth(DepthFormat format, const u8* bytes) {
+    switch (format) {
+    case DepthFormat::D16:
+        return Color::DecodeD16(bytes);
+    case DepthFormat::D24:
+        return Color::DecodeD24(bytes);
+    case DepthFormat::D24S8:
+        return Color::DecodeD24S8(bytes).x;
+    }
+    return 0;
+}
+
+void ReferenceEncodeDepth(DepthFormat format, u32 value, u8* bytes) {
+    switch (format) {
+    case DepthFormat::D16:
+        Color::EncodeD16(value, bytes);
+        break;
+    case DepthFormat::D24:
+        Color::EncodeD24(value, bytes);
+        break;
+    case DepthFormat::D24S8:
+        Color::EncodeD24X8(value, bytes);
+        break;
+    }
+}
+
+/// Looks a pixel up from the registers the way the per-pixel accessors used to.
+u8* ReferencePixel(PAddr address, int x, int y, u32 bytes_per_pixel) {
+    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
+    y = framebuffer.height - y;
+
+    const u32 coarse_y = y & ~7;
+    return VideoCore::g_memory->GetPhysicalPointer(address) +
+           VideoCore::GetMortonOffset(x, y, bytes_per_pixel) +
+           coarse_y * framebuffer.width * bytes_per_pixel;
+}
+
+Common::Vec4<u8> PixelColor(int x, int y) {
+    return Common::MakeVec(x * 4, y * 5, x ^ y, 255 - x - y).Cast<u8>();
+}
+
+Common::Vec4<u8> Average(const Common::Vec4<u8>& a, const Common::Vec4<u8>& b) {
+    return ((a.Cast<int>() + b.Cast<int>()) / 2).Cast<u8>();
+}
+
+} // Anonymous namespace
+
+TEST_CASE("FramebufferAccessor - color pixels are laid out in Morton order",
+          "[video_core][swrasterizer]") {
+    FramebufferEnvironment env;
+    const u8* buffer = env.GetPointer(color_address);
+
+    for (const auto format : {ColorFormat::RGBA8, ColorFormat::RGB8, ColorFormat::RGB5A1,
+                              ColorFormat::RGB565, ColorFormat::RGBA4}) {
+        const FramebufferAccessor framebuffer(env.MakeRegs(format, DepthFormat::D24S8), true, true);
+        const u32 bytes_per_pixel = FramebufferRegs::BytesPerColorPixel(format);
+
+        for (int y = 0; y < static_cast<int>(height); ++y) {
+            const auto row = framebuffer.GetRow(y);
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                framebuffer.DrawPixel(row, x, PixelColor(x, y));
+            }
+        }
+
+        for (int y = 0; y < static_cast<int>(height); ++y) {
+            const auto row = framebuffer.GetRow(y);
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                u8 expected[4];
+                ReferenceEncode(format, PixelColor(x, y), expected);
+                const u8* pixel = buffer + ReferenceOffset(x, y, bytes_per_pixel);
+                REQUIRE(std::memcmp(pixel, expected, bytes_per_pixel) == 0);
+
+                const auto color = framebuffer.GetPixel(row, x);
+                const auto reference = ReferenceDecode(format, pixel);
+                REQUIRE(color.r() == reference.r());
+                REQUIRE(color.g() == reference.g());
+                REQUIRE(color.b() == reference.b());
+                REQUIRE(color.a() == reference.a());
+            }
+        }
+    }
+}
+
+TEST_CASE("FramebufferAccessor - depth and stencil are laid out in Morton order",
+          "[video_core][swrasterizer]") {
+    FramebufferEnvironment env;
+    const u8* buffer = env.GetPointer(depth_address);
+
+    for (const auto format : {DepthFormat::D16, DepthFormat::D24, DepthFormat::D24S8}) {
+        const FramebufferAccessor framebuffer(env.MakeRegs(ColorFormat::RGBA8, format), true,
+                                              true);
+        const u32 bytes_per_pixel = FramebufferRegs::BytesPerDepthPixel(format);
+        const u32 depth_mask = (1u << FramebufferRegs::DepthBitsPerPixel(format)) - 1;
+        const auto depth_at = [depth_mask](int x, int y) {
+            return static_cast<u32>(x * 0x10203 + y * 0x30201) & depth_mask;
+        };
+
+        for (int y = 0; y < static_cast<int>(height); ++y) {
+            const auto row = framebuffer.GetRow(y);
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                framebuffer.SetDepth(row, x, depth_at(x, y));
+                framebuffer.SetStencil(row, x, static_cast<u8>(x + y));
+            }
+        }
+
+        for (int y = 0; y < static_cast<int>(height); ++y) {
+            const auto row = framebuffer.GetRow(y);
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                const u8* pixel = buffer + ReferenceOffset(x, y, bytes_per_pixel);
+                REQUIRE(framebuffer.GetDepth(row, x) == depth_at(x, y));
+                switch (format) {
+                case DepthFormat::D16:
+                    REQUIRE(Color::DecodeD16(pixel) == depth_at(x, y));
+                    break;
+                case DepthFormat::D24:
+                    REQUIRE(Color::DecodeD24(pixel) == depth_at(x, y));
+                    break;
+                case DepthFormat::D24S8:
+                    REQUIRE(Color::DecodeD24S8(pixel).x == depth_at(x, y));
+                    REQUIRE(Color::DecodeD24S8(pixel).y == static_cast<u8>(x + y));
+                    REQUIRE(framebuffer.GetStencil(row, x) == static_cast<u8>(x + y));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("FramebufferAccessor - benchmark", "[.][benchmark]") {
+    constexpr u32 bench_width = 400;
+    constexpr u32 bench_height = 240;
+    FramebufferEnvironment env;
+    const FramebufferRegs regs =
+        env.MakeRegs(ColorFormat::RGBA8, DepthFormat::D24S8, bench_width, bench_height);
+
+    // The rasterizer used to look the buffers up in the registers for every access
+    g_state.regs.framebuffer = regs;
+    const auto reference_pixel = [](int x, int y) {
+        const auto& fb = g_state.regs.framebuffer.framebuffer;
+        u8* depth = ReferencePixel(fb.GetDepthBufferPhysicalAddress(), x, y,
+                                   FramebufferRegs::BytesPerDepthPixel(fb.depth_format));
+        const u32 z = static_cast<u32>(x + y);
+        if (z < ReferenceDecodeDepth(fb.depth_format, depth)) {
+            return;
+        }
+        ReferenceEncodeDepth(fb.depth_format, z, depth);
+        u8* color = ReferencePixel(fb.GetColorBufferPhysicalAddress(), x, y,
+                                   FramebufferRegs::BytesPerColorPixel(fb.color_format));
+        ReferenceEncode(fb.color_format,
+                        Average(ReferenceDecode(fb.color_format, color), PixelColor(x, y)), color);
+    };
+
+    BENCHMARK("400x240 pixels, per access lookups") {
+        for (int y = 0; y < static_cast<int>(bench_height); ++y) {
+            for (int x = 0; x < static_cast<int>(bench_width); ++x) {
+                reference_pixel(x, y);
+            }
+        }
+    };
+    BENCHMARK("400x240 pixels, accessor") {
+        const FramebufferAccessor framebuffer(regs, true, true);
+        for (int y = 0; y < static_cast<int>(bench_height); ++y) {
+            const auto row = framebuffer.GetRow(y);
+            for (int x = 0; x < static_cast<int>(bench_width); ++x) {
+                const u32 z = static_cast<u32>(x + y);
+                if (z < framebuffer.GetDepth(row, x)) {
+                    continue;
+                }
+                framebuffer.SetDepth(row, x, z);
+                const auto dest = framebuffer.GetPixel(row, x);
+                framebuffer.DrawPixel(row, x, Average(dest, PixelColor(x, y)));
+            }
+        }
+    };
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,150 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/pica_state.h"
+#include "video_core/regs.h"
+#include "video_core/regs_lighting.h"
+#include "video_core/swrasterizer/lighting.h"
+
+namespace Pica {
+
+namespace {
+
+using namespace SwRasterizerTests;
+
+using LightingConfig = LightingRegs::LightingConfig;
+using LightingLutInput = LightingRegs::LightingLutInput;
+
+} // Anonymous namespace
+
+TEST_CASE("FragmentLighting - colors match the register configuration",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0x1164);
+    const auto lighting_state = RandomLightingLuts(rng);
+
+    for (int config = 0; config < 400; ++config) {
+        const LightingRegs regs = RandomLightingRegs(rng);
+        const FragmentLighting lighting(regs);
+        for (int i = 0; i < 50; ++i) {
+            const LightingFragment fragment = RandomLightingFragment(rng);
+            const auto [primary, secondary] = lighting.ComputeFragmentsColors(
+                *lighting_state, fragment.normquat, fragment.view, fragment.texture_color);
+            const auto [reference_primary, reference_secondary] =
+                ComputeFragmentsColors(regs, *lighting_state, fragment.normquat, fragment.view,
+                                         fragment.texture_color);
+            REQUIRE(AsArray(primary) == AsArray(reference_primary));
+            REQUIRE(AsArray(secondary) == AsArray(reference_secondary));
+        }
+    }
+}
+
+TEST_CASE("FragmentLighting - float LUTs follow the raw entries", "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xF107);
+    const auto lighting_state = RandomLightingLuts(rng);
+    auto copy = std::make_unique<State::Lighting>();
+    copy->luts = lighting_state->luts;
+    copy->UpdateFloatLuts();
+
+    for (std::size_t lut = 0; lut < copy->luts.size(); ++lut) {
+        for (std::size_t index = 0; index < copy->luts[lut].size(); ++index) {
+            const auto& entry = copy->luts[lut][index];
+            REQUIRE(copy->float_luts[lut][index].value == entry.ToFloat());
+            REQUIRE(copy->float_luts[lut][index].difference == entry.DiffToFloat());
+        }
+    }
+}
+
+TEST_CASE("FragmentLightingCache - lighting follows the registers", "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xCAC4);
+    const auto lighting_state = RandomLightingLuts(rng);
+    FragmentLightingCache cache;
+
+    for (int config = 0; config < 20; ++config) {
+        const LightingRegs regs = RandomLightingRegs(rng);
+        const LightingFragment fragment = RandomLightingFragment(rng);
+        const auto [primary, secondary] = cache.Get(regs).ComputeFragmentsColors(
+            *lighting_state, fragment.normquat, fragment.view, fragment.texture_color);
+        const auto [reference_primary, reference_secondary] = ComputeFragmentsColors(
+            regs, *lighting_state, fragment.normquat, fragment.view, fragment.texture_color);
+        REQUIRE(AsArray(primary) == AsArray(reference_primary));
+        REQUIRE(AsArray(secondary) == AsArray(reference_secondary));
+        REQUIRE(&cache.Get(regs) == &cache.Get(regs));
+    }
+}
+
+TEST_CASE("FragmentLighting - depends on the lighting registers but the LUT uploads",
+          "[video_core][swrasterizer]") {
+    REQUIRE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.light[0])));
+    REQUIRE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.config0)));
+    REQUIRE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.lut_scale)));
+    REQUIRE_FALSE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.lut_config)));
+    REQUIRE_FALSE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.lut_data[0])));
+    REQUIRE_FALSE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting.lut_data[7])));
+    REQUIRE_FALSE(FragmentLighting::DependsOnRegister(PICA_REG_INDEX(lighting) - 1));
+    REQUIRE_FALSE(FragmentLighting::DependsOnRegister(
+        PICA_REG_INDEX(lighting) + sizeof(LightingRegs) / sizeof(u32)));
+}
+
+TEST_CASE("FragmentLighting - benchmark", "[.][benchmark]") {
+    constexpr int num_fragments = 1 << 16;
+    std::mt19937 rng(0xBE7C);
+    const auto lighting_state = RandomLightingLuts(rng);
+
+    // Two point lights with distance attenuation, a specular distribution and a reflection LUT
+    LightingRegs regs = RandomLightingRegs(rng);
+    regs.max_light_index.Assign(1);
+    regs.light_enable.slot_0.Assign(0);
+    regs.light_enable.slot_1.Assign(1);
+    regs.config0.config.Assign(LightingConfig::Config0);
+    regs.config0.enable_shadow.Assign(0);
+    regs.config0.bump_mode.Assign(LightingRegs::LightingBumpMode::None);
+    regs.config1.raw = 0;
+    regs.config1.disable_shadow.Assign(0xFF);
+    regs.config1.disable_spot_atten.Assign(0xFF);
+    regs.config1.disable_lut_d1.Assign(1);
+    regs.config1.disable_lut_fr.Assign(1);
+    regs.lut_input.d0.Assign(LightingLutInput::NH);
+    regs.lut_input.rr.Assign(LightingLutInput::NV);
+    for (auto& light : regs.light) {
+        light.config.directional.Assign(0);
+    }
+
+    std::vector<LightingFragment> fragments(num_fragments);
+    std::generate(fragments.begin(), fragments.end(),
+                  [&rng] { return RandomLightingFragment(rng); });
+
+    const auto light_all = [&fragments](const auto& compute) {
+        u32 checksum = 0;
+        for (const LightingFragment& fragment : fragments) {
+            const auto [primary, secondary] = compute(fragment);
+            checksum += primary.r() + secondary.g();
+        }
+        return checksum;
+    };
+    const auto reference = [&](const LightingFragment& fragment) {
+        return ComputeFragmentsColors(regs, *lighting_state, fragment.normquat, fragment.view,
+                                        fragment.texture_color);
+    };
+    FragmentLightingCache cache;
+    const auto resolved = [&](const LightingFragment& fragment) {
+        return cache.Get(regs).ComputeFragmentsColors(*lighting_state, fragment.normquat,
+                                                      fragment.view, fragment.texture_color);
+    };
+    REQUIRE(light_all(reference) == light_all(resolved));
+
+    BENCHMARK("65536 fragments, per fragment registers") {
+        return light_all(reference);
+    };
+    BENCHMARK("65536 fragments, resolved") {
+        return light_all(resolved);
+    };
+}
+
+} // namespace Pica
@@ -0,0 +1,148 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <catch2/catch.hpp>
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/pica_state.h"
+#include "video_core/regs.h"
+#include "video_core/regs_texturing.h"
+#include "video_core/swrasterizer/proctex.h"
+
+namespace Pica::Rasterizer {
+
+namespace {
+
+using namespace SwRasterizerTests;
+
+using ProcTexClamp = TexturingRegs::ProcTexClamp;
+using ProcTexShift = TexturingRegs::ProcTexShift;
+using ProcTexCombiner = TexturingRegs::ProcTexCombiner;
+using ProcTexFilter = TexturingRegs::ProcTexFilter;
+
+} // Anonymous namespace
+
+TEST_CASE("ProcTexSampler - colors match the register configuration",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0x960C);
+    const auto state = RandomProcTexLuts(rng);
+    std::uniform_real_distribution<float> coordinate(-3.0f, 3.0f);
+
+    for (int config = 0; config < 1000; ++config) {
+        const TexturingRegs regs = RandomProcTexRegs(rng);
+        const ProcTexSampler sampler(regs);
+        for (int i = 0; i < 100; ++i) {
+            const float u = coordinate(rng);
+            const float v = coordinate(rng);
+            REQUIRE(AsArray(sampler.Sample(u, v, *state)) ==
+                    AsArray(ProcTex(u, v, regs, *state)));
+        }
+    }
+}
+
+TEST_CASE("ProcTexSampler - float LUTs follow the raw entries", "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xF107);
+    const auto state = RandomProcTexLuts(rng);
+    auto copy = std::make_unique<State::ProcTex>();
+    copy->noise_table = state->noise_table;
+    copy->color_map_table = state->color_map_table;
+    copy->alpha_map_table = state->alpha_map_table;
+    copy->color_table = state->color_table;
+    copy->color_diff_table = state->color_diff_table;
+    copy->UpdateFloatLuts();
+
+    for (std::size_t i = 0; i < copy->noise_table.size(); ++i) {
+        REQUIRE(copy->float_noise_table[i].value == state->noise_table[i].ToFloat());
+        REQUIRE(copy->float_noise_table[i].difference == state->noise_table[i].DiffToFloat());
+        REQUIRE(copy->float_color_map_table[i].value == state->color_map_table[i].ToFloat());
+        REQUIRE(copy->float_alpha_map_table[i].difference ==
+                state->alpha_map_table[i].DiffToFloat());
+    }
+    for (std::size_t i = 0; i < copy->color_table.size(); ++i) {
+        const auto color = state->color_table[i].ToVector().Cast<float>();
+        const auto diff = state->color_diff_table[i].ToVector().Cast<float>();
+        for (std::size_t channel = 0; channel < 4; ++channel) {
+            REQUIRE(copy->float_color_table[i][channel] == color[channel]);
+            REQUIRE(copy->float_color_diff_table[i][channel] == diff[channel]);
+        }
+    }
+}
+
+TEST_CASE("ProcTexSamplerCache - samplers follow the registers", "[video_core][swrasterizer]") {
+    std::mt19937 rng(0xCAC4);
+    const auto state = RandomProcTexLuts(rng);
+    ProcTexSamplerCache cache;
+
+    for (int config = 0; config < 20; ++config) {
+        const TexturingRegs regs = RandomProcTexRegs(rng);
+        REQUIRE(cache.Get(regs).GetKey() == ProcTexSampler::MakeKey(regs));
+        REQUIRE(AsArray(cache.Get(regs).Sample(0.3f, 1.7f, *state)) ==
+                AsArray(ProcTex(0.3f, 1.7f, regs, *state)));
+        REQUIRE(&cache.Get(regs) == &cache.Get(regs));
+    }
+}
+
+TEST_CASE("ProcTexSampler - depends on the registers of its key", "[video_core][swrasterizer]") {
+    const Regs regs{};
+    const ProcTexSampler::Key key = ProcTexSampler::MakeKey(regs.texturing);
+    for (u32 id = 0; id < Regs::NUM_REGS; ++id) {
+        Regs changed = regs;
+        changed.reg_array[id] = 0xFFFFFFFF;
+        INFO("Register " << id);
+        REQUIRE((ProcTexSampler::MakeKey(changed.texturing) != key) ==
+                ProcTexSampler::DependsOnRegister(id));
+    }
+}
+
+TEST_CASE("ProcTexSampler - benchmark", "[.][benchmark]") {
+    constexpr int size = 256;
+    std::mt19937 rng(0xBE7C);
+    const auto state = RandomProcTexLuts(rng);
+
+    // A radial gradient, as used for glows and shadows, with and without noise
+    TexturingRegs regs = RandomProcTexRegs(rng);
+    regs.proctex.u_clamp.Assign(ProcTexClamp::MirroredRepeat);
+    regs.proctex.v_clamp.Assign(ProcTexClamp::MirroredRepeat);
+    regs.proctex.color_combiner.Assign(ProcTexCombiner::SqrtAdd2);
+    regs.proctex.alpha_combiner.Assign(ProcTexCombiner::Add);
+    regs.proctex.separate_alpha.Assign(1);
+    regs.proctex.u_shift.Assign(ProcTexShift::None);
+    regs.proctex.v_shift.Assign(ProcTexShift::None);
+    regs.proctex_lut.filter.Assign(ProcTexFilter::Linear);
+
+    const auto sample_all = [&state](const auto& sample) {
+        u32 checksum = 0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const auto color = sample(x / 128.0f - 1.0f, y / 128.0f - 1.0f, *state);
+                checksum += color.r() + color.a();
+            }
+        }
+        return checksum;
+    };
+    const auto reference = [&regs](float u, float v, const State::ProcTex& state) {
+        return ProcTex(u, v, regs, state);
+    };
+    ProcTexSamplerCache cache;
+    const auto resolved = [&regs, &cache](float u, float v, const State::ProcTex& state) {
+        return cache.Get(regs).Sample(u, v, state);
+    };
+
+    for (const bool noise : {false, true}) {
+        regs.proctex.noise_enable.Assign(noise);
+        REQUIRE(sample_all(reference) == sample_all(resolved));
+
+        const std::string name = noise ? "256x256 texels with noise" : "256x256 texels";
+        BENCHMARK(name + ", per fragment registers") {
+            return sample_all(reference);
+        };
+        BENCHMARK(name + ", resolved") {
+            return sample_all(resolved);
+        };
+    }
+}
+
+} // namespace Pica::Rasterizer
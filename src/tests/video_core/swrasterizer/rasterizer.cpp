@@ -0,0 +1,111 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <random>
+#include <utility>
+#include <catch2/catch.hpp>
+#include "tests/video_core/swrasterizer/swrasterizer_test_common.h"
+#include "video_core/regs.h"
+#include "video_core/swrasterizer/fragment_pipeline.h"
+#include "video_core/swrasterizer/lighting.h"
+#include "video_core/swrasterizer/proctex.h"
+#include "video_core/swrasterizer/rasterizer.h"
+
+namespace Pica::Rasterizer {
+
+namespace {
+
+using namespace SwRasterizerTests;
+
+} // Anonymous namespace
+
+TEST_CASE("RasterizerState - the pipeline is resolved again when its registers are written",
+          "[video_core][swrasterizer]") {
+    RasterizerState state;
+    Regs regs{};
+    regs.texturing.tev_stage0.const_color = 0x11223344;
+    const FragmentPipeline::Key key = FragmentPipeline::MakeKey(regs);
+    REQUIRE(state.GetFragmentPipeline(regs).GetKey() == key);
+
+    // Writes to registers the pipeline doesn't depend on keep it
+    regs.texturing.tev_stage0.const_color = 0x55667788;
+    state.NotifyRegisterChanged(PICA_REG_INDEX(rasterizer.viewport_size_x));
+    REQUIRE(state.GetFragmentPipeline(regs).GetKey() == key);
+
+    state.NotifyRegisterChanged(PICA_REG_INDEX(texturing.tev_stage0.const_color));
+    REQUIRE(state.GetFragmentPipeline(regs).GetKey() == FragmentPipeline::MakeKey(regs));
+
+    regs.framebuffer.output_merger.depth_test_enable.Assign(1);
+    state.Invalidate();
+    REQUIRE(state.GetFragmentPipeline(regs).depth_test_enable);
+}
+
+TEST_CASE("RasterizerState - the lighting is resolved again when its registers are written",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0x5747);
+    const auto lighting_state = RandomLightingLuts(rng);
+    const LightingFragment fragment = RandomLightingFragment(rng);
+    const auto colors = [&](const FragmentLighting& lighting) {
+        const auto [primary, secondary] = lighting.ComputeFragmentsColors(
+            *lighting_state, fragment.normquat, fragment.view, fragment.texture_color);
+        return std::make_pair(AsArray(primary), AsArray(secondary));
+    };
+    const auto reference = [&](const LightingRegs& regs) {
+        const auto [primary, secondary] = ComputeFragmentsColors(
+            regs, *lighting_state, fragment.normquat, fragment.view, fragment.texture_color);
+        return std::make_pair(AsArray(primary), AsArray(secondary));
+    };
+
+    RasterizerState state;
+    const LightingRegs first = RandomLightingRegs(rng);
+    REQUIRE(colors(state.GetFragmentLighting(first)) == reference(first));
+
+    // Uploading LUT entries leaves the registers the lighting is built from alone
+    const LightingRegs second = RandomLightingRegs(rng);
+    REQUIRE(reference(second) != reference(first));
+    state.NotifyRegisterChanged(PICA_REG_INDEX(lighting.lut_config));
+    state.NotifyRegisterChanged(PICA_REG_INDEX(lighting.lut_data[5]));
+    REQUIRE(colors(state.GetFragmentLighting(second)) == reference(first));
+
+    state.NotifyRegisterChanged(PICA_REG_INDEX(lighting.config0));
+    REQUIRE(colors(state.GetFragmentLighting(second)) == reference(second));
+
+    state.Invalidate();
+    REQUIRE(colors(state.GetFragmentLighting(first)) == reference(first));
+}
+
+TEST_CASE("RasterizerState - the proctex sampler is resolved again when its registers are written",
+          "[video_core][swrasterizer]") {
+    std::mt19937 rng(0x960C);
+    const auto proctex_state = RandomProcTexLuts(rng);
+    const auto color = [&](const ProcTexSampler& sampler) {
+        return AsArray(sampler.Sample(0.3f, 1.7f, *proctex_state));
+    };
+    const auto reference = [&](const TexturingRegs& regs) {
+        return AsArray(ProcTex(0.3f, 1.7f, regs, *proctex_state));
+    };
+
+    RasterizerState state;
+    const TexturingRegs first = RandomProcTexRegs(rng);
+    REQUIRE(color(state.GetProcTexSampler(first)) == reference(first));
+
+    // Uploading LUT entries leaves the registers the sampler is built from alone
+    TexturingRegs second = first;
+    second.proctex.color_combiner.Assign(TexturingRegs::ProcTexCombiner::U);
+    second.proctex.separate_alpha.Assign(0);
+    second.proctex_lut_offset.level0.Assign(0);
+    second.proctex_lut.width.Assign(128);
+    REQUIRE(reference(second) != reference(first));
+    state.NotifyRegisterChanged(PICA_REG_INDEX(texturing.proctex_lut_config));
+    state.NotifyRegisterChanged(PICA_REG_INDEX(texturing.proctex_lut_data[2]));
+    REQUIRE(color(state.GetProcTexSampler(second)) == reference(first));
+
+    state.NotifyRegisterChanged(PICA_REG_INDEX(texturing.proctex));
+    REQUIRE(color(state.GetProcTexSampler(second)) == reference(second));
+
+    state.Invalidate();
+    REQUIRE(color(state.GetProcTexSampler(first)) == reference(first));
+}
+
+} // namespace Pica::Rasterizer
@@ -0,0 +1,258 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <random>
+#include "common/common_types.h"
+#include "common/quaternion.h"
+#include "common/vector_math.h"
+#include "video_core/pica_state.h"
+#include "video_core/regs_lighting.h"
+#include "video_core/regs_texturing.h"
+
+namespace SwRasterizerTests {
+
+/// Picks one of the values at random.
+template <typename T, std::size_t N>
+T Pick(std::mt19937& rng, const std::array<T, N>& values) {
+    return values[std::uniform_int_distribution<std::size_t>(0, N - 1)(rng)];
+}
+
+inline Common::Vec4<u8> RandomColor(std::mt19937& rng) {
+    std::uniform_int_distribution<u32> dist(0, 255);
+    return Common::MakeVec(dist(rng), dist(rng), dist(rng), dist(rng)).Cast<u8>();
+}
+
+/// Vec4 has no comparison operators, so colors are compared as arrays.
+inline std::array<u8, 4> AsArray(const Common::Vec4<u8>& color) {
+    return {color.r(), color.g(), color.b(), color.a()};
+}
+
+/**
+ * Generates the raw bits of a Pica float (float16, float20, ...) with a finite exponent close to
+ * the bias.
+ * @param positive Whether to always leave the sign bit clear
+ */
+inline u32 RandomFloat(std::mt19937& rng, unsigned mantissa_bits, unsigned exponent_bits,
+                       bool positive = false) {
+    const u32 bias = (1u << (exponent_bits - 1)) - 1;
+    const u32 sign = positive ? 0 : std::uniform_int_distribution<u32>(0, 1)(rng);
+    const u32 exponent = std::uniform_int_distribution<u32>(bias - 6, bias + 2)(rng);
+    const u32 mantissa = std::uniform_int_distribution<u32>(0, (1u << mantissa_bits) - 1)(rng);
+    return (sign << (exponent_bits + mantissa_bits)) | (exponent << mantissa_bits) | mantissa;
+}
+
+/// Encodes a float, truncating its mantissa, as the raw float24 that decodes to it.
+inline u32 RawFloat24(float value) {
+    // The registers hold float24 values in their raw form
+    u32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const u32 sign = bits >> 31;
+    const u32 exponent = (bits >> 23) & 0xFF;
+    const u32 mantissa = (bits >> 7) & 0xFFFF;
+    return value == 0.0f ? 0 : (sign << 23) | ((exponent - 64) << 16) | mantissa;
+}
+
+inline void RandomizeLightColor(std::mt19937& rng, Pica::LightingRegs::LightColor& color) {
+    std::uniform_int_distribution<u32> dist(0, 255);
+    color.r.Assign(dist(rng));
+    color.g.Assign(dist(rng));
+    color.b.Assign(dist(rng));
+}
+
+/// Lighting LUTs with random entries.
+inline std::unique_ptr<Pica::State::Lighting> RandomLightingLuts(std::mt19937& rng) {
+    auto lighting = std::make_unique<Pica::State::Lighting>();
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFF);
+    for (std::size_t lut = 0; lut < lighting->luts.size(); ++lut) {
+        for (std::size_t index = 0; index < lighting->luts[lut].size(); ++index) {
+            lighting->SetLutEntry(lut, index, dist(rng));
+        }
+    }
+    return lighting;
+}
+
+/// A random lighting configuration, leaving out the LUT inputs and bump modes that don't exist.
+inline Pica::LightingRegs RandomLightingRegs(std::mt19937& rng) {
+    using Pica::LightingRegs;
+    using LightingConfig = LightingRegs::LightingConfig;
+    using LightingLutInput = LightingRegs::LightingLutInput;
+    using LightingScale = LightingRegs::LightingScale;
+
+    constexpr std::array configs = {
+        LightingConfig::Config0, LightingConfig::Config1, LightingConfig::Config2,
+        LightingConfig::Config3, LightingConfig::Config4, LightingConfig::Config5,
+        LightingConfig::Config6, LightingConfig::Config7,
+    };
+    constexpr std::array scales = {
+        LightingScale::Scale1, LightingScale::Scale2,   LightingScale::Scale4,
+        LightingScale::Scale8, LightingScale::Scale1_4, LightingScale::Scale1_2,
+    };
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFFFF);
+    const auto input = [&] { return static_cast<LightingLutInput>(dist(rng) % 6); };
+
+    LightingRegs regs{};
+    for (auto& light : regs.light) {
+        for (auto* color : {&light.specular_0, &light.specular_1, &light.diffuse, &light.ambient}) {
+            RandomizeLightColor(rng, *color);
+        }
+        light.x.Assign(RandomFloat(rng, 10, 5));
+        light.y.Assign(RandomFloat(rng, 10, 5));
+        light.z.Assign(RandomFloat(rng, 10, 5));
+        light.spot_x.Assign(static_cast<s32>(dist(rng) % 4095) - 2047);
+        light.spot_y.Assign(static_cast<s32>(dist(rng) % 4095) - 2047);
+        light.spot_z.Assign(static_cast<s32>(dist(rng) % 4095) - 2047);
+        light.config.directional.Assign(dist(rng) & 1);
+        light.config.two_sided_diffuse.Assign(dist(rng) & 1);
+        light.config.geometric_factor_0.Assign(dist(rng) & 1);
+        light.config.geometric_factor_1.Assign(dist(rng) & 1);
+        light.dist_atten_bias.Assign(RandomFloat(rng, 12, 7));
+        light.dist_atten_scale.Assign(RandomFloat(rng, 12, 7));
+    }
+    RandomizeLightColor(rng, regs.global_ambient);
+    regs.max_light_index.Assign(dist(rng) % 8);
+
+    regs.config0.enable_shadow.Assign(dist(rng) & 1);
+    regs.config0.enable_primary_alpha.Assign(dist(rng) & 1);
+    regs.config0.enable_secondary_alpha.Assign(dist(rng) & 1);
+    regs.config0.config.Assign(Pick(rng, configs));
+    regs.config0.shadow_primary.Assign(dist(rng) & 1);
+    regs.config0.shadow_secondary.Assign(dist(rng) & 1);
+    regs.config0.shadow_invert.Assign(dist(rng) & 1);
+    regs.config0.shadow_alpha.Assign(dist(rng) & 1);
+    regs.config0.bump_selector.Assign(dist(rng) % 4);
+    regs.config0.shadow_selector.Assign(dist(rng) % 4);
+    regs.config0.clamp_highlights.Assign(dist(rng) & 1);
+    regs.config0.bump_mode.Assign(static_cast<LightingRegs::LightingBumpMode>(dist(rng) % 3));
+    regs.config0.disable_bump_renorm.Assign(dist(rng) & 1);
+    regs.config1.raw = dist(rng);
+
+    regs.abs_lut_input.disable_d0.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_d1.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_sp.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_fr.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_rb.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_rg.Assign(dist(rng) & 1);
+    regs.abs_lut_input.disable_rr.Assign(dist(rng) & 1);
+    regs.lut_input.d0.Assign(input());
+    regs.lut_input.d1.Assign(input());
+    regs.lut_input.sp.Assign(input());
+    regs.lut_input.fr.Assign(input());
+    regs.lut_input.rb.Assign(input());
+    regs.lut_input.rg.Assign(input());
+    regs.lut_input.rr.Assign(input());
+    regs.lut_scale.d0.Assign(Pick(rng, scales));
+    regs.lut_scale.d1.Assign(Pick(rng, scales));
+    regs.lut_scale.sp.Assign(Pick(rng, scales));
+    regs.lut_scale.fr.Assign(Pick(rng, scales));
+    regs.lut_scale.rb.Assign(Pick(rng, scales));
+    regs.lut_scale.rg.Assign(Pick(rng, scales));
+    regs.lut_scale.rr.Assign(Pick(rng, scales));
+    regs.light_enable.slot_0.Assign(dist(rng) % 8);
+    regs.light_enable.slot_1.Assign(dist(rng) % 8);
+    regs.light_enable.slot_2.Assign(dist(rng) % 8);
+    regs.light_enable.slot_3.Assign(dist(rng) % 8);
+    regs.light_enable.slot_4.Assign(dist(rng) % 8);
+    regs.light_enable.slot_5.Assign(dist(rng) % 8);
+    regs.light_enable.slot_6.Assign(dist(rng) % 8);
+    regs.light_enable.slot_7.Assign(dist(rng) % 8);
+    return regs;
+}
+
+/// The inputs of the lighting of a fragment.
+struct LightingFragment {
+    Common::Quaternion<float> normquat;
+    Common::Vec3<float> view;
+    Common::Vec4<u8> texture_color[4];
+};
+
+inline LightingFragment RandomLightingFragment(std::mt19937& rng) {
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::uniform_int_distribution<u32> color(0, 255);
+    LightingFragment fragment;
+    fragment.normquat =
+        Common::Quaternion<float>{{coordinate(rng), coordinate(rng), coordinate(rng)},
+                                  coordinate(rng)}
+            .Normalized();
+    fragment.view = Common::MakeVec(coordinate(rng), coordinate(rng), coordinate(rng) - 2.0f);
+    for (auto& texture_color : fragment.texture_color) {
+        texture_color =
+            Common::MakeVec(color(rng), color(rng), color(rng), color(rng)).Cast<u8>();
+    }
+    return fragment;
+}
+
+/// Procedural texture LUTs with random entries.
+inline std::unique_ptr<Pica::State::ProcTex> RandomProcTexLuts(std::mt19937& rng) {
+    using ProcTexLutTable = Pica::TexturingRegs::ProcTexLutTable;
+
+    auto proctex = std::make_unique<Pica::State::ProcTex>();
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFFFF);
+    for (const auto table : {ProcTexLutTable::Noise, ProcTexLutTable::ColorMap,
+                             ProcTexLutTable::AlphaMap, ProcTexLutTable::Color,
+                             ProcTexLutTable::ColorDiff}) {
+        for (std::size_t index = 0; index < 256; ++index) {
+            // Keeps the interpolated values in range, as the LUTs written by games do
+            u32 value;
+            if (table == ProcTexLutTable::Noise) {
+                value = dist(rng);
+            } else if (table == ProcTexLutTable::ColorMap || table == ProcTexLutTable::AlphaMap) {
+                const s32 map_value = dist(rng) % 4096;
+                const s32 difference = std::clamp(static_cast<s32>(dist(rng) % 4096) - 2048,
+                                                  -map_value, 4095 - map_value);
+                value = static_cast<u32>(map_value) | ((difference & 0xFFF) << 12);
+            } else {
+                value = 0;
+                for (int channel = 0; channel < 4; ++channel) {
+                    const u32 byte = table == ProcTexLutTable::Color ? 16 + dist(rng) % 224
+                                                                     : (dist(rng) % 16 - 8) & 0xFF;
+                    value |= byte << (channel * 8);
+                }
+            }
+            proctex->SetLutEntry(table, index, value);
+        }
+    }
+    return proctex;
+}
+
+/// A random procedural texture configuration, leaving out the modes that don't exist.
+inline Pica::TexturingRegs RandomProcTexRegs(std::mt19937& rng) {
+    using Pica::TexturingRegs;
+    using ProcTexClamp = TexturingRegs::ProcTexClamp;
+    using ProcTexShift = TexturingRegs::ProcTexShift;
+    using ProcTexCombiner = TexturingRegs::ProcTexCombiner;
+    using ProcTexFilter = TexturingRegs::ProcTexFilter;
+
+    std::uniform_int_distribution<u32> dist(0, 0xFFFFFFFF);
+    TexturingRegs regs{};
+    regs.proctex.u_clamp.Assign(static_cast<ProcTexClamp>(dist(rng) % 5));
+    regs.proctex.v_clamp.Assign(static_cast<ProcTexClamp>(dist(rng) % 5));
+    regs.proctex.color_combiner.Assign(static_cast<ProcTexCombiner>(dist(rng) % 10));
+    regs.proctex.alpha_combiner.Assign(static_cast<ProcTexCombiner>(dist(rng) % 10));
+    regs.proctex.separate_alpha.Assign(dist(rng) & 1);
+    regs.proctex.noise_enable.Assign(dist(rng) & 1);
+    regs.proctex.u_shift.Assign(static_cast<ProcTexShift>(dist(rng) % 3));
+    regs.proctex.v_shift.Assign(static_cast<ProcTexShift>(dist(rng) % 3));
+    regs.proctex_noise_u.amplitude.Assign(static_cast<s32>(dist(rng) % 0x10000) - 0x8000);
+    regs.proctex_noise_u.phase.Assign(RandomFloat(rng, 10, 5));
+    regs.proctex_noise_v.amplitude.Assign(static_cast<s32>(dist(rng) % 0x10000) - 0x8000);
+    regs.proctex_noise_v.phase.Assign(RandomFloat(rng, 10, 5));
+    // Negative frequencies would sample the noise LUT out of its range
+    regs.proctex_noise_frequency.u.Assign(RandomFloat(rng, 10, 5, true));
+    regs.proctex_noise_frequency.v.Assign(RandomFloat(rng, 10, 5, true));
+    regs.proctex_lut.filter.Assign(static_cast<ProcTexFilter>(dist(rng) % 6));
+    // The color LUT range stays within the 256 entries
+    const u32 width = 1 + dist(rng) % 255;
+    regs.proctex_lut.width.Assign(width);
+    regs.proctex_lut_offset.level0.Assign(dist(rng) % (257 - width));
+    return regs;
+}
+
+} // namespace SwRasterizerTests
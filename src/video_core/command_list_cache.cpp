@@ -0,0 +1,161 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <bitset>
+#include "common/hash.h"
+#include "video_core/command_list_cache.h"
+#include "video_core/command_processor.h"
+#include "video_core/regs.h"
+
+namespace Pica::CommandProcessor {
+
+namespace {
+
+/// Registers handled specially by WritePicaReg, which can't be collapsed.
+const std::bitset<Regs::NUM_REGS> side_effect_regs = [] {
+    std::bitset<Regs::NUM_REGS> regs;
+    const auto mark = [&regs](std::size_t first, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            regs.set(first + i);
+        }
+    };
+
+    mark(PICA_REG_INDEX(trigger_irq), 1);
+    mark(PICA_REG_INDEX(pipeline.triangle_topology), 1);
+    mark(PICA_REG_INDEX(pipeline.restart_primitive), 1);
+    mark(PICA_REG_INDEX(pipeline.vs_default_attributes_setup.index), 1);
+    mark(PICA_REG_INDEX(pipeline.vs_default_attributes_setup.set_value[0]), 3);
+    mark(PICA_REG_INDEX(pipeline.command_buffer.trigger[0]), 2);
+    mark(PICA_REG_INDEX(pipeline.trigger_draw), 1);
+    mark(PICA_REG_INDEX(pipeline.trigger_draw_indexed), 1);
+
+    mark(PICA_REG_INDEX(gs.bool_uniforms), 1);
+    mark(PICA_REG_INDEX(gs.int_uniforms[0]), 4);
+    mark(PICA_REG_INDEX(gs.uniform_setup.set_value[0]), 8);
+    mark(PICA_REG_INDEX(gs.program.set_word[0]), 8);
+    mark(PICA_REG_INDEX(gs.swizzle_patterns.set_word[0]), 8);
+
+    mark(PICA_REG_INDEX(vs.bool_uniforms), 1);
+    mark(PICA_REG_INDEX(vs.int_uniforms[0]), 4);
+    mark(PICA_REG_INDEX(vs.uniform_setup.set_value[0]), 8);
+    mark(PICA_REG_INDEX(vs.program.set_word[0]), 8);
+    mark(PICA_REG_INDEX(vs.swizzle_patterns.set_word[0]), 8);
+
+    mark(PICA_REG_INDEX(lighting.lut_data[0]), 8);
+    mark(PICA_REG_INDEX(texturing.fog_lut_data[0]), 8);
+    mark(PICA_REG_INDEX(texturing.proctex_lut_data[0]), 8);
+    return regs;
+}();
+
+} // Anonymous namespace
+
+bool HasWriteSideEffects(u32 id) {
+    return id >= Regs::NUM_REGS || side_effect_regs.test(id);
+}
+
+bool IsCommandBufferJump(u32 id) {
+    return id == PICA_REG_INDEX(pipeline.command_buffer.trigger[0]) ||
+           id == PICA_REG_INDEX(pipeline.command_buffer.trigger[1]);
+}
+
+bool DecodeCommandList(const u32* list, u32 length, std::vector<DecodedCommand>& commands) {
+    commands.clear();
+
+    const auto add_command = [&commands](u32 id, u32 value, u32 mask) {
+        if (id >= Regs::NUM_REGS) {
+            // Left to WritePicaReg to report
+            return false;
+        }
+
+        if (!commands.empty() && commands.back().id == id && !HasWriteSideEffects(id)) {
+            // Only the bytes the later write leaves alone keep the earlier value
+            DecodedCommand& previous = commands.back();
+            const u32 write_mask = expand_bits_to_bytes[mask];
+            previous.value = (previous.value & ~write_mask) | (value & write_mask);
+            previous.mask |= static_cast<u16>(mask);
+            return true;
+        }
+
+        commands.push_back({static_cast<u16>(id), static_cast<u16>(mask), value});
+        return true;
+    };
+
+    std::size_t offset = 0;
+    while (offset < length) {
+        // Commands are aligned to 8 bytes
+        offset += offset % 2;
+        if (offset + 2 > length) {
+            return false;
+        }
+
+        const u32 value = list[offset];
+        const CommandHeader header = {list[offset + 1]};
+        offset += 2;
+        if (offset + header.extra_data_length > length) {
+            return false;
+        }
+
+        for (u32 i = 0; i <= header.extra_data_length; ++i) {
+            const u32 id = header.cmd_id + (header.group_commands ? i : 0);
+            if (!add_command(id, i == 0 ? value : list[offset++], header.parameter_mask)) {
+                return false;
+            }
+
+            if (IsCommandBufferJump(id)) {
+                // The parameters after a jump are read from the new command buffer
+                return i == header.extra_data_length;
+            }
+        }
+    }
+    return true;
+}
+
+CommandListCache::CommandListCache(std::size_t max_lists) : max_lists(max_lists) {}
+
+const std::vector<DecodedCommand>* CommandListCache::Get(PAddr address, const u32* list,
+                                                         u32 length) {
+    const u64 key = (static_cast<u64>(address) << 32) | length;
+
+    auto it = lists.find(key);
+    if (it == lists.end()) {
+        if (lists.size() >= max_lists) {
+            lists.clear();
+        }
+        // New lists are only remembered, as most lists are rewritten before they are run again
+        CachedList& cached = lists[key];
+        cached.hash = Common::ComputeHash64(list, length * sizeof(u32));
+        return nullptr;
+    }
+
+    CachedList& cached = it->second;
+    if (cached.changes >= max_changes) {
+        // Hashing a list that is rewritten every time it is run only adds to parsing it
+        if (++cached.skipped < recheck_interval) {
+            return nullptr;
+        }
+        cached.skipped = 0;
+    }
+
+    const u64 hash = Common::ComputeHash64(list, length * sizeof(u32));
+    if (hash != cached.hash) {
+        cached.hash = hash;
+        cached.changes = std::min(cached.changes + 1, max_changes);
+        cached.decoded = false;
+        return nullptr;
+    }
+
+    cached.changes = 0;
+    if (!cached.decoded) {
+        cached.decodable = DecodeCommandList(list, length, cached.commands);
+        cached.decoded = true;
+    }
+    return cached.decodable ? &cached.commands : nullptr;
+}
+
+void CommandListCache::Clear() {
+    lists.clear();
+}
+
+} // namespace Pica::CommandProcessor
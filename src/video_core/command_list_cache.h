@@ -0,0 +1,91 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "common/common_types.h"
+
+namespace Pica::CommandProcessor {
+
+/// A register write made by a command list.
+struct DecodedCommand {
+    u16 id;
+    /// Bytes of the register written, a bit per byte like CommandHeader::parameter_mask
+    u16 mask;
+    u32 value;
+};
+
+/// Whether writing the register does more than store its value, like drawing or uploading data.
+bool HasWriteSideEffects(u32 id);
+
+/// Whether writing the register makes the command processor jump to another command buffer.
+bool IsCommandBufferJump(u32 id);
+
+/**
+ * Decodes a command list into the register writes it makes, in order. Consecutive writes to a
+ * register without side effects are collapsed into one. Decoding stops after a jump to another
+ * command buffer, as the rest of the list is never read.
+ * @param list Pointer to the command list
+ * @param length Length of the command list, in words
+ * @param commands Receives the decoded register writes
+ * @returns false if the list can't be decoded ahead of time, because it reads past its end,
+ *          writes invalid registers or jumps in the middle of a command
+ */
+bool DecodeCommandList(const u32* list, u32 length, std::vector<DecodedCommand>& commands);
+
+/**
+ * Keeps decoded command lists, so that lists submitted again unchanged are not parsed again.
+ * Lists are keyed by their address and size, and checked against a hash of their contents.
+ * Hashing a list costs a few percent of decoding it, so this is cheaper than tracking the CPU's
+ * writes to the pages of every list.
+ *
+ * Games rewrite many of their lists every frame, and hashing, decoding and replaying such a list
+ * costs more than parsing it. A list is therefore only decoded once it has been seen twice with
+ * the same contents, and a list that keeps changing is no longer hashed, apart from an occasional
+ * check of whether it has settled.
+ */
+class CommandListCache {
+public:
+    /// Number of times in a row a list may change before it is no longer hashed
+    static constexpr u32 max_changes = 3;
+
+    /// Number of runs of a list that keeps changing between checks of whether it has settled
+    static constexpr u32 recheck_interval = 64;
+
+    /// @param max_lists Number of lists kept before the cache is emptied
+    explicit CommandListCache(std::size_t max_lists);
+
+    /**
+     * Returns the register writes made by the command list, or nullptr if the list is to be
+     * parsed as it is read instead, because it is new, has changed since it was last seen, keeps
+     * changing or can't be decoded ahead of time.
+     * The result is valid until the next call.
+     */
+    const std::vector<DecodedCommand>* Get(PAddr address, const u32* list, u32 length);
+
+    /// Drops all the cached lists.
+    void Clear();
+
+private:
+    struct CachedList {
+        u64 hash = 0;
+        /// Number of times in a row the list was seen with different contents
+        u32 changes = 0;
+        /// Number of runs since the list was last hashed, once it keeps changing
+        u32 skipped = 0;
+        /// Whether the list has been decoded since its contents last changed
+        bool decoded = false;
+        /// Whether the list could be decoded ahead of time
+        bool decodable = false;
+        std::vector<DecodedCommand> commands;
+    };
+
+    const std::size_t max_lists;
+    std::unordered_map<u64, CachedList> lists;
+};
+
+} // namespace Pica::CommandProcessor
@@ -15,6 +15,7 @@
 #include "core/hw/gpu.h"
 #include "core/memory.h"
 #include "core/tracer/recorder.h"
+#include "video_core/command_list_cache.h"
 #include "video_core/command_processor.h"
 #include "video_core/debug_utils/debug_utils.h"
 #include "video_core/pica_state.h"
@@ -31,14 +32,11 @@
 
 namespace Pica::CommandProcessor {
 
-// Expand a 4-bit mask to 4-byte mask, e.g. 0b0101 -> 0x00FF00FF
-constexpr std::array<u32, 16> expand_bits_to_bytes{
-    0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff, 0x00ff0000, 0x00ff00ff, 0x00ffff00, 0x00ffffff,
-    0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff, 0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff,
-};
-
 MICROPROFILE_DEFINE(GPU_Drawing, "GPU", "Drawing", MP_RGB(50, 50, 240));
 
+// Command lists run again unchanged are decoded once and replayed while they stay the same
+static CommandListCache command_list_cache(256);
+
 static const char* GetShaderSetupTypeName(Shader::ShaderSetup& setup) {
     if (&setup == &g_state.vs) {
         return "vertex shader";
@@ -143,7 +141,7 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
     switch (id) {
     // Trigger IRQ
     case PICA_REG_INDEX(trigger_irq):
-        Service::GSP::SignalInterrupt(Service::GSP::InterruptId::P3D);
+        GPU::SignalInterrupt(Service::GSP::InterruptId::P3D);
         break;
 
     case PICA_REG_INDEX(pipeline.triangle_topology):
@@ -585,7 +583,7 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
 
         ASSERT_MSG(lut_config.index < 256, "lut_config.index exceeded maximum value of 255!");
 
-        g_state.lighting.luts[lut_config.type][lut_config.index].raw = value;
+        g_state.lighting.SetLutEntry(lut_config.type, lut_config.index, value);
         lut_config.index.Assign(lut_config.index + 1);
         break;
     }
@@ -612,25 +610,7 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
     case PICA_REG_INDEX(texturing.proctex_lut_data[6]):
     case PICA_REG_INDEX(texturing.proctex_lut_data[7]): {
         auto& index = regs.texturing.proctex_lut_config.index;
-        auto& pt = g_state.proctex;
-
-        switch (regs.texturing.proctex_lut_config.ref_table.Value()) {
-        case TexturingRegs::ProcTexLutTable::Noise:
-            pt.noise_table[index % pt.noise_table.size()].raw = value;
-            break;
-        case TexturingRegs::ProcTexLutTable::ColorMap:
-            pt.color_map_table[index % pt.color_map_table.size()].raw = value;
-            break;
-        case TexturingRegs::ProcTexLutTable::AlphaMap:
-            pt.alpha_map_table[index % pt.alpha_map_table.size()].raw = value;
-            break;
-        case TexturingRegs::ProcTexLutTable::Color:
-            pt.color_table[index % pt.color_table.size()].raw = value;
-            break;
-        case TexturingRegs::ProcTexLutTable::ColorDiff:
-            pt.color_diff_table[index % pt.color_diff_table.size()].raw = value;
-            break;
-        }
+        g_state.proctex.SetLutEntry(regs.texturing.proctex_lut_config.ref_table, index, value);
         index.Assign(index + 1);
         break;
     }
@@ -645,18 +625,8 @@ static void WritePicaReg(u32 id, u32 value, u32 mask) {
                                  reinterpret_cast<void*>(&id));
 }
 
-void ProcessCommandList(PAddr list, u32 size) {
-
-    u32* buffer = (u32*)VideoCore::g_memory->GetPhysicalPointer(list);
-
-    if (Pica::g_debug_context && Pica::g_debug_context->recorder) {
-        Pica::g_debug_context->recorder->MemoryAccessed((u8*)buffer, size, list);
-    }
-
-    g_state.cmd_list.addr = list;
-    g_state.cmd_list.head_ptr = g_state.cmd_list.current_ptr = buffer;
-    g_state.cmd_list.length = size / sizeof(u32);
-
+/// Parses and runs the commands of the current command list, as they are read.
+static void ParseCommandList() {
     while (g_state.cmd_list.current_ptr < g_state.cmd_list.head_ptr + g_state.cmd_list.length) {
 
         // Align read pointer to 8 bytes
@@ -675,4 +645,55 @@ void ProcessCommandList(PAddr list, u32 size) {
     }
 }
 
+/// Whether the debugger or the tracer follows the commands as they are read from the list.
+static bool IsCommandListObserved() {
+    if (DebugUtils::IsPicaTracing()) {
+        return true;
+    }
+    if (!g_debug_context) {
+        return false;
+    }
+    const auto& breakpoints = g_debug_context->breakpoints;
+    return breakpoints[static_cast<int>(DebugContext::Event::PicaCommandLoaded)].enabled ||
+           breakpoints[static_cast<int>(DebugContext::Event::PicaCommandProcessed)].enabled;
+}
+
+void ProcessCommandList(PAddr list, u32 size, bool use_cache) {
+
+    u32* buffer = (u32*)VideoCore::g_memory->GetPhysicalPointer(list);
+
+    if (Pica::g_debug_context && Pica::g_debug_context->recorder) {
+        Pica::g_debug_context->recorder->MemoryAccessed((u8*)buffer, size, list);
+    }
+
+    g_state.cmd_list.addr = list;
+    g_state.cmd_list.head_ptr = g_state.cmd_list.current_ptr = buffer;
+    g_state.cmd_list.length = size / sizeof(u32);
+
+    if (!use_cache || IsCommandListObserved()) {
+        ParseCommandList();
+        return;
+    }
+
+    while (const auto* commands = command_list_cache.Get(list, g_state.cmd_list.head_ptr,
+                                                         g_state.cmd_list.length)) {
+        for (const DecodedCommand& command : *commands) {
+            WritePicaReg(command.id, command.value, command.mask);
+        }
+
+        if (commands->empty() || !IsCommandBufferJump(commands->back().id)) {
+            g_state.cmd_list.current_ptr = g_state.cmd_list.head_ptr + g_state.cmd_list.length;
+            return;
+        }
+
+        // The jump has pointed the current command list to the new command buffer
+        const unsigned index = static_cast<unsigned>(
+            commands->back().id - PICA_REG_INDEX(pipeline.command_buffer.trigger[0]));
+        list = g_state.regs.pipeline.command_buffer.GetPhysicalAddress(index);
+    }
+
+    // Lists that are new, keep changing or can't be decoded ahead of time are run as they are
+    ParseCommandList();
+}
+
 } // namespace Pica::CommandProcessor
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include <type_traits>
 #include "common/bit_field.h"
 #include "common/common_types.h"
@@ -32,6 +33,17 @@ static_assert(std::is_standard_layout<CommandHeader>::value == true,
               "CommandHeader does not use standard layout");
 static_assert(sizeof(CommandHeader) == sizeof(u32), "CommandHeader has incorrect size!");
 
-void ProcessCommandList(PAddr list, u32 size);
+// Expand a 4-bit mask to 4-byte mask, e.g. 0b0101 -> 0x00FF00FF
+constexpr std::array<u32, 16> expand_bits_to_bytes{
+    0x00000000, 0x000000ff, 0x0000ff00, 0x0000ffff, 0x00ff0000, 0x00ff00ff, 0x00ffff00, 0x00ffffff,
+    0xff000000, 0xff0000ff, 0xff00ff00, 0xff00ffff, 0xffff0000, 0xffff00ff, 0xffffff00, 0xffffffff,
+};
+
+/**
+ * Runs the command list at the given physical address.
+ * @param use_cache Whether lists seen before with the same contents may be replayed from the
+ *                  command list cache, instead of being parsed as they are read
+ */
+void ProcessCommandList(PAddr list, u32 size, bool use_cache = true);
 
 } // namespace Pica::CommandProcessor
@@ -0,0 +1,90 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <limits>
+#include "common/microprofile.h"
+#include "common/thread.h"
+#include "video_core/gpu_thread.h"
+
+namespace VideoCore {
+
+MICROPROFILE_DEFINE(GPU_ThreadWait, "GPU", "Wait for GPU thread", MP_RGB(255, 100, 100));
+
+GPUThread::GPUThread(std::size_t queue_depth)
+    : queue_depth(std::max<std::size_t>(queue_depth, 1)), thread(&GPUThread::ThreadLoop, this) {}
+
+GPUThread::~GPUThread() {
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    work_available.notify_one();
+    thread.join();
+}
+
+u64 GPUThread::Submit(std::function<void()> work) {
+    std::unique_lock lock{mutex};
+    if (last_submitted - last_completed >= queue_depth) {
+        MICROPROFILE_SCOPE(GPU_ThreadWait);
+        work_completed.wait(lock, [this] { return last_submitted - last_completed < queue_depth; });
+    }
+    const u64 fence = ++last_submitted;
+    queue.emplace_back(fence, std::move(work));
+    lock.unlock();
+    work_available.notify_one();
+    return fence;
+}
+
+void GPUThread::WaitFor(u64 fence) {
+    // Work running on the GPU thread cannot wait for itself.
+    if (IsGPUThread()) {
+        return;
+    }
+    std::unique_lock lock{mutex};
+    // Fences that were never handed out, e.g. ones restored from a save state, are not waited on.
+    fence = std::min(fence, last_submitted);
+    if (last_completed < fence) {
+        MICROPROFILE_SCOPE(GPU_ThreadWait);
+        work_completed.wait(lock, [this, fence] { return last_completed >= fence; });
+    }
+}
+
+void GPUThread::WaitForIdle() {
+    WaitFor(std::numeric_limits<u64>::max());
+}
+
+u64 GPUThread::GetLastFence() {
+    std::lock_guard lock{mutex};
+    return last_submitted;
+}
+
+void GPUThread::ContinueFrom(u64 fence) {
+    WaitForIdle();
+    std::lock_guard lock{mutex};
+    last_submitted = last_completed = fence;
+}
+
+void GPUThread::ThreadLoop() {
+    Common::SetCurrentThreadName("GPU");
+    std::unique_lock lock{mutex};
+    while (true) {
+        work_available.wait(lock, [this] { return stop || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        auto [fence, work] = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+
+        current_fence = fence;
+        work();
+
+        lock.lock();
+        last_completed = fence;
+        work_completed.notify_all();
+    }
+}
+
+} // namespace VideoCore
@@ -0,0 +1,82 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "common/common_types.h"
+
+namespace VideoCore {
+
+/**
+ * Runs GPU work (command lists, display transfers, memory fills) on a dedicated thread, in the
+ * order it was submitted, so that it overlaps with CPU emulation. Each piece of work is given a
+ * fence, increasing by one with every submission, that can be waited on.
+ */
+class GPUThread {
+public:
+    /**
+     * @param queue_depth Number of pieces of work that may be queued or running at once. Submit
+     *                    blocks once that many are in flight.
+     */
+    explicit GPUThread(std::size_t queue_depth);
+
+    /// Finishes the work that was already submitted and stops the thread.
+    ~GPUThread();
+
+    GPUThread(const GPUThread&) = delete;
+    GPUThread& operator=(const GPUThread&) = delete;
+
+    /// Queues work for the GPU thread and returns its fence.
+    u64 Submit(std::function<void()> work);
+
+    /// Waits until the work with the given fence, and all work before it, has completed.
+    void WaitFor(u64 fence);
+
+    /// Waits until all work submitted so far has completed.
+    void WaitForIdle();
+
+    /// Returns the fence of the work submitted last.
+    u64 GetLastFence();
+
+    /**
+     * Hands out fences following the given one from now on, e.g. to carry on from a save state.
+     * Waits for the work that was already submitted to complete first.
+     */
+    void ContinueFrom(u64 fence);
+
+    /// Whether the calling thread is the GPU thread.
+    bool IsGPUThread() const {
+        return std::this_thread::get_id() == thread.get_id();
+    }
+
+    /// Returns the fence of the work that is running. GPU thread only.
+    u64 GetCurrentFence() const {
+        return current_fence;
+    }
+
+private:
+    void ThreadLoop();
+
+    const std::size_t queue_depth;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_completed;
+    std::deque<std::pair<u64, std::function<void()>>> queue;
+    u64 last_submitted = 0;
+    u64 last_completed = 0;
+    bool stop = false;
+
+    u64 current_fence = 0;
+    std::thread thread;
+};
+
+} // namespace VideoCore
@@ -97,6 +97,64 @@ struct State {
         UnionArray<ColorEntry, 256> color_table;
         UnionArray<ColorDifferenceEntry, 256> color_diff_table;
 
+        /// A value entry converted to float, as the software renderer samples it.
+        struct FloatValueEntry {
+            float value;
+            float difference;
+        };
+
+        // The LUTs converted to float. Not serialized, as they are rebuilt from the raw LUTs.
+        std::array<FloatValueEntry, 128> float_noise_table{};
+        std::array<FloatValueEntry, 128> float_color_map_table{};
+        std::array<FloatValueEntry, 128> float_alpha_map_table{};
+        std::array<Common::Vec4<float>, 256> float_color_table{};
+        std::array<Common::Vec4<float>, 256> float_color_diff_table{};
+
+        /// Sets an entry of one of the LUTs, along with its float conversion.
+        void SetLutEntry(TexturingRegs::ProcTexLutTable table, std::size_t index, u32 raw) {
+            const auto set_value = [raw](auto& lut, auto& float_lut, std::size_t i) {
+                lut[i].raw = raw;
+                float_lut[i] = {lut[i].ToFloat(), lut[i].DiffToFloat()};
+            };
+            switch (table) {
+            case TexturingRegs::ProcTexLutTable::Noise:
+                set_value(noise_table, float_noise_table, index % noise_table.size());
+                break;
+            case TexturingRegs::ProcTexLutTable::ColorMap:
+                set_value(color_map_table, float_color_map_table, index % color_map_table.size());
+                break;
+            case TexturingRegs::ProcTexLutTable::AlphaMap:
+                set_value(alpha_map_table, float_alpha_map_table, index % alpha_map_table.size());
+                break;
+            case TexturingRegs::ProcTexLutTable::Color: {
+                const std::size_t i = index % color_table.size();
+                color_table[i].raw = raw;
+                float_color_table[i] = color_table[i].ToVector().Cast<float>();
+                break;
+            }
+            case TexturingRegs::ProcTexLutTable::ColorDiff: {
+                const std::size_t i = index % color_diff_table.size();
+                color_diff_table[i].raw = raw;
+                float_color_diff_table[i] = color_diff_table[i].ToVector().Cast<float>();
+                break;
+            }
+            }
+        }
+
+        /// Converts all the LUTs to float again, after they were replaced.
+        void UpdateFloatLuts() {
+            using Table = TexturingRegs::ProcTexLutTable;
+            for (std::size_t i = 0; i < noise_table.size(); ++i) {
+                SetLutEntry(Table::Noise, i, noise_table[i].raw);
+                SetLutEntry(Table::ColorMap, i, color_map_table[i].raw);
+                SetLutEntry(Table::AlphaMap, i, alpha_map_table[i].raw);
+            }
+            for (std::size_t i = 0; i < color_table.size(); ++i) {
+                SetLutEntry(Table::Color, i, color_table[i].raw);
+                SetLutEntry(Table::ColorDiff, i, color_diff_table[i].raw);
+            }
+        }
+
     private:
         friend class boost::serialization::access;
         template <class Archive>
@@ -137,6 +195,30 @@ struct State {
         };
 
         std::array<UnionArray<LutEntry, 256>, 24> luts;
+
+        /// A LUT entry converted to float, as the software renderer samples it.
+        struct FloatLutEntry {
+            float value;
+            float difference;
+        };
+
+        /// The LUTs converted to float. Not serialized, as it is rebuilt from luts.
+        std::array<std::array<FloatLutEntry, 256>, 24> float_luts{};
+
+        /// Sets an entry of the LUTs, along with its float conversion.
+        void SetLutEntry(std::size_t lut, std::size_t index, u32 raw) {
+            luts[lut][index].raw = raw;
+            float_luts[lut][index] = {luts[lut][index].ToFloat(), luts[lut][index].DiffToFloat()};
+        }
+
+        /// Converts all the LUTs to float again, after they were replaced.
+        void UpdateFloatLuts() {
+            for (std::size_t lut = 0; lut < luts.size(); ++lut) {
+                for (std::size_t index = 0; index < luts[lut].size(); ++index) {
+                    SetLutEntry(lut, index, luts[lut][index].raw);
+                }
+            }
+        }
     } lighting;
 
     struct {
@@ -247,6 +329,8 @@ private:
         cmd_list.head_ptr =
             reinterpret_cast<u32*>(VideoCore::g_memory->GetPhysicalPointer(cmd_list.addr));
         cmd_list.current_ptr = cmd_list.head_ptr + offset;
+        proctex.UpdateFloatLuts();
+        lighting.UpdateFloatLuts();
     }
 };
 
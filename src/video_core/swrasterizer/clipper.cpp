@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <iterator>
+#include <optional>
 #include <boost/container/static_vector.hpp>
 #include "common/bit_field.h"
 #include "common/common_types.h"
@@ -16,6 +18,10 @@
 #include "video_core/swrasterizer/clipper.h"
 #include "video_core/swrasterizer/rasterizer.h"
 
+#ifdef ARCHITECTURE_x86_64
+#include <emmintrin.h>
+#endif
+
 using Pica::Rasterizer::Vertex;
 
 namespace Pica::Clipper {
@@ -51,55 +57,252 @@ private:
     Common::Vec4<float24> bias;
 };
 
-static void InitScreenCoordinates(Vertex& vtx) {
-    struct {
-        float24 halfsize_x;
-        float24 offset_x;
-        float24 halfsize_y;
-        float24 offset_y;
-        float24 zscale;
-        float24 offset_z;
-    } viewport;
-
-    const auto& regs = g_state.regs;
-    viewport.halfsize_x = float24::FromRaw(regs.rasterizer.viewport_size_x);
-    viewport.halfsize_y = float24::FromRaw(regs.rasterizer.viewport_size_y);
-    viewport.offset_x = float24::FromFloat32(static_cast<float>(regs.rasterizer.viewport_corner.x));
-    viewport.offset_y = float24::FromFloat32(static_cast<float>(regs.rasterizer.viewport_corner.y));
-
-    float24 inv_w = float24::FromFloat32(1.f) / vtx.pos.w;
+// NOTE: We clip against a w=epsilon plane to guarantee that the output has a positive w value.
+// TODO: Not sure if this is a valid approach. Also should probably instead use the smallest
+//       epsilon possible within float24 accuracy.
+static const float24 EPSILON = float24::FromFloat32(0.00001f);
+static const float24 f0 = float24::FromFloat32(0.0);
+static const float24 f1 = float24::FromFloat32(1.0);
+static const std::array<ClippingEdge, 7> clipping_edges = {{
+    {Common::MakeVec(-f1, f0, f0, f1)}, // x = +w
+    {Common::MakeVec(f1, f0, f0, f1)},  // x = -w
+    {Common::MakeVec(f0, -f1, f0, f1)}, // y = +w
+    {Common::MakeVec(f0, f1, f0, f1)},  // y = -w
+    {Common::MakeVec(f0, f0, -f1, f0)}, // z =  0
+    {Common::MakeVec(f0, f0, f1, f1)},  // z = -w
+    {Common::MakeVec(f0, f0, f0, f1), Common::Vec4<float24>(f0, f0, f0, EPSILON)}, // w = EPSILON
+}};
+
+struct Viewport {
+    float24 halfsize_x;
+    float24 offset_x;
+    float24 halfsize_y;
+    float24 offset_y;
+};
+
+static Viewport GetViewport(const RasterizerRegs& regs) {
+    Viewport viewport;
+    viewport.halfsize_x = float24::FromRaw(regs.viewport_size_x);
+    viewport.halfsize_y = float24::FromRaw(regs.viewport_size_y);
+    viewport.offset_x = float24::FromFloat32(static_cast<float>(regs.viewport_corner.x));
+    viewport.offset_y = float24::FromFloat32(static_cast<float>(regs.viewport_corner.y));
+    return viewport;
+}
+
+/// Sets the screen position of a vertex, once its attributes are divided by w.
+static void InitScreenCoordinates(const Viewport& viewport, Vertex& vtx, float24 inv_w) {
     vtx.pos.w = inv_w;
-    vtx.quat *= inv_w;
-    vtx.color *= inv_w;
-    vtx.tc0 *= inv_w;
-    vtx.tc1 *= inv_w;
-    vtx.tc0_w *= inv_w;
-    vtx.view *= inv_w;
-    vtx.tc2 *= inv_w;
-
-    vtx.screenpos[0] =
-        (vtx.pos.x * inv_w + float24::FromFloat32(1.0)) * viewport.halfsize_x + viewport.offset_x;
-    vtx.screenpos[1] =
-        (vtx.pos.y * inv_w + float24::FromFloat32(1.0)) * viewport.halfsize_y + viewport.offset_y;
+    vtx.screenpos[0] = (vtx.pos.x * inv_w + f1) * viewport.halfsize_x + viewport.offset_x;
+    vtx.screenpos[1] = (vtx.pos.y * inv_w + f1) * viewport.halfsize_y + viewport.offset_y;
     vtx.screenpos[2] = vtx.pos.z * inv_w;
 }
 
+#ifdef ARCHITECTURE_x86_64
+
+/// Multiplies like float24 does, which gives 0 instead of NaN when multiplying infinity by 0.
+static __m128 MultiplyFloat24(__m128 a, __m128 b) {
+    const __m128 result = _mm_mul_ps(a, b);
+    const __m128 zero_mask = _mm_and_ps(_mm_cmpunord_ps(result, result), _mm_cmpord_ps(a, b));
+    return _mm_andnot_ps(zero_mask, result);
+}
+
+#endif // ARCHITECTURE_x86_64
+
+/// Does the perspective divide and the viewport transform of the vertices.
+static void InitScreenCoordinates(const Viewport& viewport, Vertex* vertices, std::size_t count) {
+#ifdef ARCHITECTURE_x86_64
+    // The attributes divided by w, from quat to tc2. The padding between them is divided as well.
+    constexpr std::size_t first_attribute = offsetof(OutputVertex, quat) / sizeof(float24);
+    constexpr std::size_t last_attribute = offsetof(OutputVertex, tc2) / sizeof(float24) + 2;
+    static_assert(sizeof(float24) == sizeof(float) && (last_attribute - first_attribute) % 4 == 0,
+                  "The attributes must be made of whole vectors of floats");
+
+    // The vertices are divided four at a time
+    for (std::size_t first = 0; first < count; first += 4) {
+        const std::size_t batch_size = std::min<std::size_t>(count - first, 4);
+        alignas(16) std::array<float, 4> inv_w{1.0f, 1.0f, 1.0f, 1.0f};
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            inv_w[i] = vertices[first + i].pos.w.ToFloat32();
+        }
+        _mm_store_ps(inv_w.data(), _mm_div_ps(_mm_set1_ps(1.0f), _mm_load_ps(inv_w.data())));
+
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            Vertex& vtx = vertices[first + i];
+            float* attributes = reinterpret_cast<float*>(&vtx.pos);
+            const __m128 factor = _mm_set1_ps(inv_w[i]);
+            for (std::size_t j = first_attribute; j < last_attribute; j += 4) {
+                _mm_storeu_ps(attributes + j,
+                              MultiplyFloat24(_mm_loadu_ps(attributes + j), factor));
+            }
+            InitScreenCoordinates(viewport, vtx, float24::FromFloat32(inv_w[i]));
+        }
+    }
+#else
+    for (std::size_t i = 0; i < count; ++i) {
+        Vertex& vtx = vertices[i];
+        const float24 inv_w = f1 / vtx.pos.w;
+        vtx.quat *= inv_w;
+        vtx.color *= inv_w;
+        vtx.tc0 *= inv_w;
+        vtx.tc1 *= inv_w;
+        vtx.tc0_w *= inv_w;
+        vtx.view *= inv_w;
+        vtx.tc2 *= inv_w;
+        InitScreenCoordinates(viewport, vtx, inv_w);
+    }
+#endif
+}
+
+/// Where a triangle lies relative to the clipping edges.
+enum class TriangleClass {
+    /// Inside all of the edges, clipping leaves it as is
+    Inside,
+    /// Outside of the first edge it isn't inside of, clipping removes it
+    Outside,
+    /// Crosses an edge, it has to be clipped
+    Straddling,
+};
+
+/// Classifies a triangle from the masks of its vertices inside each edge, in clipping order.
+template <typename InsideMaskFunc>
+static TriangleClass ClassifyTriangle(std::size_t num_edges, InsideMaskFunc&& inside_mask) {
+    for (std::size_t edge = 0; edge < num_edges; ++edge) {
+        const unsigned mask = inside_mask(edge);
+        if (mask == 0) {
+            return TriangleClass::Outside;
+        }
+        if (mask != 0b111) {
+            return TriangleClass::Straddling;
+        }
+    }
+    return TriangleClass::Inside;
+}
+
+static TriangleClass ClassifyTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2,
+                                      const ClippingEdge* custom_edge) {
+    const auto edge_mask = [&v0, &v1, &v2](const ClippingEdge& edge) {
+        return static_cast<unsigned>(edge.IsInside(v0)) |
+               static_cast<unsigned>(edge.IsInside(v1)) << 1 |
+               static_cast<unsigned>(edge.IsInside(v2)) << 2;
+    };
+
+#ifdef ARCHITECTURE_x86_64
+    // The fixed edges are tested for the three vertices at once, one in each lane and the first
+    // one again in the last lane. Their dot products reduce to a sum of two coordinates, as the
+    // products with 0 are 0 in float24 unless the coordinate is NaN.
+    const __m128 x = _mm_setr_ps(v0.pos.x.ToFloat32(), v1.pos.x.ToFloat32(),
+                                 v2.pos.x.ToFloat32(), v0.pos.x.ToFloat32());
+    const __m128 y = _mm_setr_ps(v0.pos.y.ToFloat32(), v1.pos.y.ToFloat32(),
+                                 v2.pos.y.ToFloat32(), v0.pos.y.ToFloat32());
+    const __m128 z = _mm_setr_ps(v0.pos.z.ToFloat32(), v1.pos.z.ToFloat32(),
+                                 v2.pos.z.ToFloat32(), v0.pos.z.ToFloat32());
+    const __m128 w = _mm_setr_ps(v0.pos.w.ToFloat32(), v1.pos.w.ToFloat32(),
+                                 v2.pos.w.ToFloat32(), v0.pos.w.ToFloat32());
+    const __m128 nan = _mm_or_ps(_mm_cmpunord_ps(x, y), _mm_cmpunord_ps(z, w));
+    if (_mm_movemask_ps(nan) != 0) {
+        // NaN makes every dot product NaN, leave it to clipping
+        return TriangleClass::Straddling;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 epsilon = _mm_set1_ps(EPSILON.ToFloat32());
+    const __m128 inside[] = {
+        _mm_cmpge_ps(_mm_sub_ps(w, x), zero),       // x = +w
+        _mm_cmpge_ps(_mm_add_ps(x, w), zero),       // x = -w
+        _mm_cmpge_ps(_mm_sub_ps(w, y), zero),       // y = +w
+        _mm_cmpge_ps(_mm_add_ps(y, w), zero),       // y = -w
+        _mm_cmple_ps(z, zero),                      // z =  0
+        _mm_cmpge_ps(_mm_add_ps(z, w), zero),       // z = -w
+        _mm_cmpge_ps(_mm_add_ps(w, epsilon), zero), // w = EPSILON
+    };
+    static_assert(std::size(inside) == std::tuple_size_v<decltype(clipping_edges)>);
+    const TriangleClass result = ClassifyTriangle(clipping_edges.size(), [&inside](std::size_t i) {
+        return static_cast<unsigned>(_mm_movemask_ps(inside[i])) & 0b111;
+    });
+#else
+    const TriangleClass result = ClassifyTriangle(
+        clipping_edges.size(), [&](std::size_t i) { return edge_mask(clipping_edges[i]); });
+#endif
+
+    if (result != TriangleClass::Inside || !custom_edge) {
+        return result;
+    }
+    return ClassifyTriangle(1, [&](std::size_t) { return edge_mask(*custom_edge); });
+}
+
+/// Passes the triangles of a convex polygon, as a fan around its first vertex, to the handler.
+static void DrawPolygon(const Vertex* vertices, std::size_t count,
+                        const TriangleHandler& triangle_handler) {
+    for (std::size_t i = 0; i < count - 2; i++) {
+        const Vertex& vtx0 = vertices[0];
+        const Vertex& vtx1 = vertices[i + 1];
+        const Vertex& vtx2 = vertices[i + 2];
+
+        LOG_TRACE(
+            Render_Software,
+            "Triangle {}/{} at position ({:.3}, {:.3}, {:.3}, {:.3f}), "
+            "({:.3}, {:.3}, {:.3}, {:.3}), ({:.3}, {:.3}, {:.3}, {:.3}) and "
+            "screen position ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2})",
+            i + 1, count - 2, vtx0.pos.x.ToFloat32(), vtx0.pos.y.ToFloat32(),
+            vtx0.pos.z.ToFloat32(), vtx0.pos.w.ToFloat32(), vtx1.pos.x.ToFloat32(),
+            vtx1.pos.y.ToFloat32(), vtx1.pos.z.ToFloat32(), vtx1.pos.w.ToFloat32(),
+            vtx2.pos.x.ToFloat32(), vtx2.pos.y.ToFloat32(), vtx2.pos.z.ToFloat32(),
+            vtx2.pos.w.ToFloat32(), vtx0.screenpos.x.ToFloat32(), vtx0.screenpos.y.ToFloat32(),
+            vtx0.screenpos.z.ToFloat32(), vtx1.screenpos.x.ToFloat32(),
+            vtx1.screenpos.y.ToFloat32(), vtx1.screenpos.z.ToFloat32(),
+            vtx2.screenpos.x.ToFloat32(), vtx2.screenpos.y.ToFloat32(),
+            vtx2.screenpos.z.ToFloat32());
+
+        triangle_handler(vtx0, vtx1, vtx2);
+    }
+}
+
 void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2) {
+    static const TriangleHandler rasterize_triangle = Rasterizer::ProcessTriangle;
+    ProcessTriangle(v0, v1, v2, rasterize_triangle);
+}
+
+void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2,
+                     const TriangleHandler& triangle_handler) {
     using boost::container::static_vector;
 
+    const auto& regs = g_state.regs.rasterizer;
+    const Viewport viewport = GetViewport(regs);
+    std::optional<ClippingEdge> custom_edge;
+    if (regs.clip_enable) {
+        custom_edge.emplace(regs.GetClipCoef());
+    }
+
+    auto FlipQuaternionIfOpposite = [](auto& a, const auto& b) {
+        if (Common::Dot(a, b) < float24::Zero())
+            a = a * float24::FromFloat32(-1.0f);
+    };
+
+    // Most triangles are entirely inside the view volume, or outside of it. Those are found
+    // without going through the clipping buffers.
+    std::array<Vertex, 3> triangle{{v0, v1, v2}};
+    switch (ClassifyTriangle(triangle[0], triangle[1], triangle[2],
+                             custom_edge ? &*custom_edge : nullptr)) {
+    case TriangleClass::Outside:
+        return;
+    case TriangleClass::Inside:
+        FlipQuaternionIfOpposite(triangle[1].quat, triangle[0].quat);
+        FlipQuaternionIfOpposite(triangle[2].quat, triangle[0].quat);
+        InitScreenCoordinates(viewport, triangle.data(), triangle.size());
+        DrawPolygon(triangle.data(), triangle.size(), triangle_handler);
+        return;
+    case TriangleClass::Straddling:
+        break;
+    }
+
     // Clipping a planar n-gon against a plane will remove at least 1 vertex and introduces 2 at
     // the new edge (or less in degenerate cases). As such, we can say that each clipping plane
     // introduces at most 1 new vertex to the polygon. Since we start with a triangle and have a
     // fixed 6 clipping planes, the maximum number of vertices of the clipped polygon is 3 + 6 = 9.
     static const std::size_t MAX_VERTICES = 9;
-    static_vector<Vertex, MAX_VERTICES> buffer_a = {v0, v1, v2};
+    static_vector<Vertex, MAX_VERTICES> buffer_a(triangle.begin(), triangle.end());
     static_vector<Vertex, MAX_VERTICES> buffer_b;
 
-    auto FlipQuaternionIfOpposite = [](auto& a, const auto& b) {
-        if (Common::Dot(a, b) < float24::Zero())
-            a = a * float24::FromFloat32(-1.0f);
-    };
-
     // Flip the quaternions if they are opposite to prevent interpolating them over the wrong
     // direction.
     FlipQuaternionIfOpposite(buffer_a[1].quat, buffer_a[0].quat);
@@ -108,23 +311,6 @@ void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const Outpu
     auto* output_list = &buffer_a;
     auto* input_list = &buffer_b;
 
-    // NOTE: We clip against a w=epsilon plane to guarantee that the output has a positive w value.
-    // TODO: Not sure if this is a valid approach. Also should probably instead use the smallest
-    //       epsilon possible within float24 accuracy.
-    static const float24 EPSILON = float24::FromFloat32(0.00001f);
-    static const float24 f0 = float24::FromFloat32(0.0);
-    static const float24 f1 = float24::FromFloat32(1.0);
-    static const std::array<ClippingEdge, 7> clipping_edges = {{
-        {Common::MakeVec(-f1, f0, f0, f1)}, // x = +w
-        {Common::MakeVec(f1, f0, f0, f1)},  // x = -w
-        {Common::MakeVec(f0, -f1, f0, f1)}, // y = +w
-        {Common::MakeVec(f0, f1, f0, f1)},  // y = -w
-        {Common::MakeVec(f0, f0, -f1, f0)}, // z =  0
-        {Common::MakeVec(f0, f0, f1, f1)},  // z = -w
-        {Common::MakeVec(f0, f0, f0, f1),
-         Common::Vec4<float24>(f0, f0, f0, EPSILON)}, // w = EPSILON
-    }};
-
     // Simple implementation of the Sutherland-Hodgman clipping algorithm.
     // TODO: Make this less inefficient (currently lots of useless buffering overhead happens here)
     auto Clip = [&](const ClippingEdge& edge) {
@@ -156,41 +342,15 @@ void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const Outpu
             return;
     }
 
-    if (g_state.regs.rasterizer.clip_enable) {
-        ClippingEdge custom_edge{g_state.regs.rasterizer.GetClipCoef()};
-        Clip(custom_edge);
+    if (custom_edge) {
+        Clip(*custom_edge);
 
         if (output_list->size() < 3)
             return;
     }
 
-    InitScreenCoordinates((*output_list)[0]);
-    InitScreenCoordinates((*output_list)[1]);
-
-    for (std::size_t i = 0; i < output_list->size() - 2; i++) {
-        Vertex& vtx0 = (*output_list)[0];
-        Vertex& vtx1 = (*output_list)[i + 1];
-        Vertex& vtx2 = (*output_list)[i + 2];
-
-        InitScreenCoordinates(vtx2);
-
-        LOG_TRACE(
-            Render_Software,
-            "Triangle {}/{} at position ({:.3}, {:.3}, {:.3}, {:.3f}), "
-            "({:.3}, {:.3}, {:.3}, {:.3}), ({:.3}, {:.3}, {:.3}, {:.3}) and "
-            "screen position ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2}), ({:.2}, {:.2}, {:.2})",
-            i + 1, output_list->size() - 2, vtx0.pos.x.ToFloat32(), vtx0.pos.y.ToFloat32(),
-            vtx0.pos.z.ToFloat32(), vtx0.pos.w.ToFloat32(), vtx1.pos.x.ToFloat32(),
-            vtx1.pos.y.ToFloat32(), vtx1.pos.z.ToFloat32(), vtx1.pos.w.ToFloat32(),
-            vtx2.pos.x.ToFloat32(), vtx2.pos.y.ToFloat32(), vtx2.pos.z.ToFloat32(),
-            vtx2.pos.w.ToFloat32(), vtx0.screenpos.x.ToFloat32(), vtx0.screenpos.y.ToFloat32(),
-            vtx0.screenpos.z.ToFloat32(), vtx1.screenpos.x.ToFloat32(),
-            vtx1.screenpos.y.ToFloat32(), vtx1.screenpos.z.ToFloat32(),
-            vtx2.screenpos.x.ToFloat32(), vtx2.screenpos.y.ToFloat32(),
-            vtx2.screenpos.z.ToFloat32());
-
-        Rasterizer::ProcessTriangle(vtx0, vtx1, vtx2);
-    }
+    InitScreenCoordinates(viewport, output_list->data(), output_list->size());
+    DrawPolygon(output_list->data(), output_list->size(), triangle_handler);
 }
 
 } // namespace Pica::Clipper
@@ -4,16 +4,31 @@
 
 #pragma once
 
+#include <functional>
+
 namespace Pica {
 namespace Shader {
 struct OutputVertex;
 }
 
+namespace Rasterizer {
+struct Vertex;
+}
+
 namespace Clipper {
 
 using Shader::OutputVertex;
 
+/// Receives the triangles of a clipped primitive, with their screen coordinates initialized.
+using TriangleHandler = std::function<void(const Rasterizer::Vertex& v0,
+                                           const Rasterizer::Vertex& v1,
+                                           const Rasterizer::Vertex& v2)>;
+
 void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2);
 
+/// Clips the triangle and passes the resulting triangles to the handler instead of rasterizing.
+void ProcessTriangle(const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2,
+                     const TriangleHandler& triangle_handler);
+
 } // namespace Clipper
 } // namespace Pica
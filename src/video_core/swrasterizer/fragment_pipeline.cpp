@@ -0,0 +1,429 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <utility>
+#include "common/assert.h"
+#include "common/hash.h"
+#include "common/logging/log.h"
+#include "video_core/swrasterizer/fragment_pipeline.h"
+#include "video_core/swrasterizer/framebuffer.h"
+
+namespace Pica::Rasterizer {
+
+using TevStageConfig = TexturingRegs::TevStageConfig;
+
+namespace {
+
+template <FramebufferRegs::CompareFunc func>
+bool Compare(u32 lhs, u32 rhs) {
+    using CompareFunc = FramebufferRegs::CompareFunc;
+
+    switch (func) {
+    case CompareFunc::Never:
+        return false;
+    case CompareFunc::Always:
+        return true;
+    case CompareFunc::Equal:
+        return lhs == rhs;
+    case CompareFunc::NotEqual:
+        return lhs != rhs;
+    case CompareFunc::LessThan:
+        return lhs < rhs;
+    case CompareFunc::LessThanOrEqual:
+        return lhs <= rhs;
+    case CompareFunc::GreaterThan:
+        return lhs > rhs;
+    case CompareFunc::GreaterThanOrEqual:
+        return lhs >= rhs;
+    }
+    return false;
+}
+
+template <FramebufferRegs::BlendFactor factor>
+u8 LookupBlendFactor(const Common::Vec4<u8>& source, const Common::Vec4<u8>& dest,
+                     const Common::Vec4<u8>& constant, unsigned channel) {
+    using BlendFactor = FramebufferRegs::BlendFactor;
+
+    switch (factor) {
+    case BlendFactor::Zero:
+        return 0;
+
+    case BlendFactor::One:
+        return 255;
+
+    case BlendFactor::SourceColor:
+        return source[channel];
+
+    case BlendFactor::OneMinusSourceColor:
+        return 255 - source[channel];
+
+    case BlendFactor::DestColor:
+        return dest[channel];
+
+    case BlendFactor::OneMinusDestColor:
+        return 255 - dest[channel];
+
+    case BlendFactor::SourceAlpha:
+        return source.a();
+
+    case BlendFactor::OneMinusSourceAlpha:
+        return 255 - source.a();
+
+    case BlendFactor::DestAlpha:
+        return dest.a();
+
+    case BlendFactor::OneMinusDestAlpha:
+        return 255 - dest.a();
+
+    case BlendFactor::ConstantColor:
+        return constant[channel];
+
+    case BlendFactor::OneMinusConstantColor:
+        return 255 - constant[channel];
+
+    case BlendFactor::ConstantAlpha:
+        return constant.a();
+
+    case BlendFactor::OneMinusConstantAlpha:
+        return 255 - constant.a();
+
+    case BlendFactor::SourceAlphaSaturate:
+        // Returns 1.0 for the alpha channel
+        if (channel == 3)
+            return 255;
+        return std::min(source.a(), static_cast<u8>(255 - dest.a()));
+    }
+
+    // Unknown factors are reported when the pipeline is built
+    return source[channel];
+}
+
+template <std::size_t... funcs>
+constexpr auto MakeCompareFuncs(std::index_sequence<funcs...>) {
+    return std::array{&Compare<static_cast<FramebufferRegs::CompareFunc>(funcs)>...};
+}
+
+template <std::size_t... factors>
+constexpr auto MakeBlendFactorFuncs(std::index_sequence<factors...>) {
+    return std::array{&LookupBlendFactor<static_cast<FramebufferRegs::BlendFactor>(factors)>...};
+}
+
+constexpr auto compare_funcs = MakeCompareFuncs(std::make_index_sequence<8>{});
+constexpr auto blend_factor_funcs = MakeBlendFactorFuncs(std::make_index_sequence<16>{});
+
+/// Detects if a TEV stage is configured to output the previous stage's output unchanged.
+bool IsPassThroughTevStage(const TevStageConfig& stage) {
+    return (stage.color_op == TevStageConfig::Operation::Replace &&
+            stage.alpha_op == TevStageConfig::Operation::Replace &&
+            stage.color_source1 == TevStageConfig::Source::Previous &&
+            stage.alpha_source1 == TevStageConfig::Source::Previous &&
+            stage.color_modifier1 == TevStageConfig::ColorModifier::SourceColor &&
+            stage.alpha_modifier1 == TevStageConfig::AlphaModifier::SourceAlpha &&
+            stage.GetColorMultiplier() == 1 && stage.GetAlphaMultiplier() == 1);
+}
+
+/// Returns the index of a combiner source, reporting the sources that aren't known.
+u8 GetSourceIndex(TevStageConfig::Source source) {
+    using Source = TevStageConfig::Source;
+
+    switch (source) {
+    case Source::PrimaryColor:
+    case Source::PrimaryFragmentColor:
+    case Source::SecondaryFragmentColor:
+    case Source::Texture0:
+    case Source::Texture1:
+    case Source::Texture2:
+    case Source::Texture3:
+    case Source::PreviousBuffer:
+    case Source::Constant:
+    case Source::Previous:
+        break;
+    default:
+        // These read as zero
+        LOG_ERROR(HW_GPU, "Unknown color combiner source {}", static_cast<u32>(source));
+        UNIMPLEMENTED();
+        break;
+    }
+    return static_cast<u8>(source);
+}
+
+constexpr std::size_t stage_size = sizeof(TevStageConfig) / sizeof(u32);
+
+/// The registers the pipeline key is made of, as the index of the first register and the count
+constexpr std::array<std::pair<std::size_t, std::size_t>, 13> key_registers = {{
+    {PICA_REG_INDEX(texturing.tev_stage0), stage_size},
+    {PICA_REG_INDEX(texturing.tev_stage1), stage_size},
+    {PICA_REG_INDEX(texturing.tev_stage2), stage_size},
+    {PICA_REG_INDEX(texturing.tev_stage3), stage_size},
+    {PICA_REG_INDEX(texturing.tev_stage4), stage_size},
+    {PICA_REG_INDEX(texturing.tev_stage5), stage_size},
+    // Also holds the fog mode and flip
+    {PICA_REG_INDEX(texturing.tev_combiner_buffer_input), 1},
+    {PICA_REG_INDEX(texturing.tev_combiner_buffer_color), 1},
+    {PICA_REG_INDEX(texturing.fog_color), 1},
+    // The output merger registers before its padding
+    {PICA_REG_INDEX(framebuffer.output_merger), 8},
+    {PICA_REG_INDEX(framebuffer.framebuffer.allow_color_write), 1},
+    {PICA_REG_INDEX(framebuffer.framebuffer.allow_depth_stencil_write), 1},
+    {PICA_REG_INDEX(framebuffer.framebuffer.depth_format), 1},
+}};
+
+} // Anonymous namespace
+
+FragmentPipeline::Key FragmentPipeline::MakeKey(const Regs& regs) {
+    Key key;
+    auto out = key.begin();
+    for (const auto& [index, count] : key_registers) {
+        out = std::copy_n(regs.reg_array.begin() + index, count, out);
+    }
+    ASSERT(out == key.end());
+    return key;
+}
+
+bool FragmentPipeline::DependsOnRegister(u32 id) {
+    return std::any_of(key_registers.begin(), key_registers.end(), [id](const auto& range) {
+        return id >= range.first && id < range.first + range.second;
+    });
+}
+
+FragmentPipeline::FragmentPipeline(const Regs& regs) : key(MakeKey(regs)) {
+    const auto& texturing = regs.texturing;
+    const auto& output_merger = regs.framebuffer.output_merger;
+    const auto& framebuffer = regs.framebuffer.framebuffer;
+
+    const auto stages = texturing.GetTevStages();
+    num_tev_stages = 0;
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+        const auto& config = stages[i];
+        TevStage& stage = tev_stages[i];
+
+        stage.color_sources = {GetSourceIndex(config.color_source1),
+                               GetSourceIndex(config.color_source2),
+                               GetSourceIndex(config.color_source3)};
+        stage.alpha_sources = {GetSourceIndex(config.alpha_source1),
+                               GetSourceIndex(config.alpha_source2),
+                               GetSourceIndex(config.alpha_source3)};
+        stage.color_modifiers = {GetColorModifierFunc(config.color_modifier1),
+                                 GetColorModifierFunc(config.color_modifier2),
+                                 GetColorModifierFunc(config.color_modifier3)};
+        stage.alpha_modifiers = {GetAlphaModifierFunc(config.alpha_modifier1),
+                                 GetAlphaModifierFunc(config.alpha_modifier2),
+                                 GetAlphaModifierFunc(config.alpha_modifier3)};
+        stage.color_combine = GetColorCombineFunc(config.color_op);
+        // The result of the Dot3_RGBA operation is also placed in the alpha component
+        stage.alpha_combine = config.color_op == TevStageConfig::Operation::Dot3_RGBA
+                                  ? nullptr
+                                  : GetAlphaCombineFunc(config.alpha_op);
+        stage.constant = Common::MakeVec(config.const_r.Value(), config.const_g.Value(),
+                                         config.const_b.Value(), config.const_a.Value())
+                             .Cast<u8>();
+        stage.color_multiplier = config.GetColorMultiplier();
+        stage.alpha_multiplier = config.GetAlphaMultiplier();
+        stage.pass_through = IsPassThroughTevStage(config);
+        stage.updates_buffer_color =
+            texturing.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferColor(
+                static_cast<unsigned>(i));
+        stage.updates_buffer_alpha =
+            texturing.tev_combiner_buffer_input.TevStageUpdatesCombinerBufferAlpha(
+                static_cast<unsigned>(i));
+
+        // Nothing reads the combiner buffer after the last stage that doesn't pass through
+        if (!stage.pass_through) {
+            num_tev_stages = i + 1;
+        }
+    }
+    combiner_buffer_color = Common::MakeVec(texturing.tev_combiner_buffer_color.r.Value(),
+                                            texturing.tev_combiner_buffer_color.g.Value(),
+                                            texturing.tev_combiner_buffer_color.b.Value(),
+                                            texturing.tev_combiner_buffer_color.a.Value())
+                                .Cast<u8>();
+
+    shadow_mode =
+        output_merger.fragment_operation_mode == FramebufferRegs::FragmentOperationMode::Shadow;
+
+    alpha_test_enable = output_merger.alpha_test.enable != 0;
+    alpha_test_func =
+        compare_funcs[static_cast<std::size_t>(output_merger.alpha_test.func.Value())];
+    alpha_test_ref = static_cast<u8>(output_merger.alpha_test.ref);
+
+    fog_enable = texturing.fog_mode == TexturingRegs::FogMode::Fog;
+    fog_flip = texturing.fog_flip != 0;
+    fog_color = Common::MakeVec(texturing.fog_color.r.Value(), texturing.fog_color.g.Value(),
+                                texturing.fog_color.b.Value())
+                    .Cast<u8>();
+
+    const auto& stencil_test = output_merger.stencil_test;
+    stencil_action_enable = stencil_test.enable &&
+                            framebuffer.depth_format == FramebufferRegs::DepthFormat::D24S8;
+    stencil_func = compare_funcs[static_cast<std::size_t>(stencil_test.func.Value())];
+    stencil_reference_value = static_cast<u8>(stencil_test.reference_value);
+    stencil_input_mask = static_cast<u8>(stencil_test.input_mask);
+    stencil_write_mask = static_cast<u8>(stencil_test.write_mask);
+    stencil_fail_action = stencil_test.action_stencil_fail;
+    depth_fail_action = stencil_test.action_depth_fail;
+    depth_pass_action = stencil_test.action_depth_pass;
+
+    depth_test_enable = output_merger.depth_test_enable != 0;
+    depth_test_func =
+        compare_funcs[static_cast<std::size_t>(output_merger.depth_test_func.Value())];
+    depth_write_enable = output_merger.depth_write_enable != 0;
+    depth_stencil_write_enable = framebuffer.allow_depth_stencil_write != 0;
+    depth_bits = FramebufferRegs::DepthBitsPerPixel(framebuffer.depth_format);
+
+    color_write_enable = framebuffer.allow_color_write != 0;
+
+    alphablend_enable = output_merger.alphablend_enable != 0;
+    const auto get_blend_factor = [](FramebufferRegs::BlendFactor factor) {
+        const auto index = static_cast<std::size_t>(factor);
+        if (index > static_cast<std::size_t>(FramebufferRegs::BlendFactor::SourceAlphaSaturate)) {
+            LOG_CRITICAL(HW_GPU, "Unknown blend factor {:x}", index);
+            UNIMPLEMENTED();
+        }
+        return blend_factor_funcs[index];
+    };
+    const auto& params = output_merger.alpha_blending;
+    const auto source_rgb = get_blend_factor(params.factor_source_rgb);
+    const auto dest_rgb = get_blend_factor(params.factor_dest_rgb);
+    source_factors = {source_rgb, source_rgb, source_rgb,
+                      get_blend_factor(params.factor_source_a)};
+    dest_factors = {dest_rgb, dest_rgb, dest_rgb, get_blend_factor(params.factor_dest_a)};
+    blend_equation_rgb = params.blend_equation_rgb;
+    blend_equation_a = params.blend_equation_a;
+    blend_const = Common::MakeVec(output_merger.blend_const.r.Value(),
+                                  output_merger.blend_const.g.Value(),
+                                  output_merger.blend_const.b.Value(),
+                                  output_merger.blend_const.a.Value())
+                      .Cast<u8>();
+    logic_op = output_merger.logic_op;
+    write_mask = {output_merger.red_enable != 0, output_merger.green_enable != 0,
+                  output_merger.blue_enable != 0, output_merger.alpha_enable != 0};
+}
+
+Common::Vec4<u8> FragmentPipeline::CombineTextures(const TevInputs& inputs) const {
+    using Source = TevStageConfig::Source;
+
+    // Indexed by source, so that stages read them without going through their configuration
+    std::array<Common::Vec4<u8>, 16> sources{};
+    sources[static_cast<std::size_t>(Source::PrimaryColor)] = inputs.primary_color;
+    sources[static_cast<std::size_t>(Source::PrimaryFragmentColor)] =
+        inputs.primary_fragment_color;
+    sources[static_cast<std::size_t>(Source::SecondaryFragmentColor)] =
+        inputs.secondary_fragment_color;
+    std::copy(inputs.texture_color.begin(), inputs.texture_color.end(),
+              sources.begin() + static_cast<std::size_t>(Source::Texture0));
+
+    Common::Vec4<u8>& combiner_output = sources[static_cast<std::size_t>(Source::Previous)];
+    Common::Vec4<u8>& combiner_buffer = sources[static_cast<std::size_t>(Source::PreviousBuffer)];
+    Common::Vec4<u8>& constant = sources[static_cast<std::size_t>(Source::Constant)];
+    Common::Vec4<u8> next_combiner_buffer = combiner_buffer_color;
+
+    for (std::size_t i = 0; i < num_tev_stages; ++i) {
+        const TevStage& stage = tev_stages[i];
+
+        if (!stage.pass_through) {
+            constant = stage.constant;
+
+            // The alpha combiner may read the previous output, so the color result is only
+            // written once both have run
+            const Common::Vec3<u8> color_result[3] = {
+                stage.color_modifiers[0](sources[stage.color_sources[0]]),
+                stage.color_modifiers[1](sources[stage.color_sources[1]]),
+                stage.color_modifiers[2](sources[stage.color_sources[2]]),
+            };
+            const Common::Vec3<u8> color_output = stage.color_combine(color_result);
+
+            u8 alpha_output;
+            if (stage.alpha_combine) {
+                const std::array<u8, 3> alpha_result = {{
+                    stage.alpha_modifiers[0](sources[stage.alpha_sources[0]]),
+                    stage.alpha_modifiers[1](sources[stage.alpha_sources[1]]),
+                    stage.alpha_modifiers[2](sources[stage.alpha_sources[2]]),
+                }};
+                alpha_output = stage.alpha_combine(alpha_result);
+            } else {
+                alpha_output = color_output.x;
+            }
+
+            combiner_output[0] = std::min(255u, color_output.r() * stage.color_multiplier);
+            combiner_output[1] = std::min(255u, color_output.g() * stage.color_multiplier);
+            combiner_output[2] = std::min(255u, color_output.b() * stage.color_multiplier);
+            combiner_output[3] = std::min(255u, alpha_output * stage.alpha_multiplier);
+        }
+
+        combiner_buffer = next_combiner_buffer;
+
+        if (stage.updates_buffer_color) {
+            next_combiner_buffer.r() = combiner_output.r();
+            next_combiner_buffer.g() = combiner_output.g();
+            next_combiner_buffer.b() = combiner_output.b();
+        }
+
+        if (stage.updates_buffer_alpha) {
+            next_combiner_buffer.a() = combiner_output.a();
+        }
+    }
+
+    return combiner_output;
+}
+
+Common::Vec4<u8> FragmentPipeline::Blend(const Common::Vec4<u8>& source,
+                                         const Common::Vec4<u8>& dest) const {
+    Common::Vec4<u8> blend_output;
+
+    if (alphablend_enable) {
+        const auto srcfactor = Common::MakeVec(source_factors[0](source, dest, blend_const, 0),
+                                               source_factors[1](source, dest, blend_const, 1),
+                                               source_factors[2](source, dest, blend_const, 2),
+                                               source_factors[3](source, dest, blend_const, 3));
+        const auto dstfactor = Common::MakeVec(dest_factors[0](source, dest, blend_const, 0),
+                                               dest_factors[1](source, dest, blend_const, 1),
+                                               dest_factors[2](source, dest, blend_const, 2),
+                                               dest_factors[3](source, dest, blend_const, 3));
+
+        blend_output = EvaluateBlendEquation(source, srcfactor, dest, dstfactor,
+                                             blend_equation_rgb);
+        blend_output.a() =
+            EvaluateBlendEquation(source, srcfactor, dest, dstfactor, blend_equation_a).a();
+    } else {
+        blend_output = Common::MakeVec(LogicOp(source.r(), dest.r(), logic_op),
+                                       LogicOp(source.g(), dest.g(), logic_op),
+                                       LogicOp(source.b(), dest.b(), logic_op),
+                                       LogicOp(source.a(), dest.a(), logic_op));
+    }
+
+    return {
+        write_mask[0] ? blend_output.r() : dest.r(),
+        write_mask[1] ? blend_output.g() : dest.g(),
+        write_mask[2] ? blend_output.b() : dest.b(),
+        write_mask[3] ? blend_output.a() : dest.a(),
+    };
+}
+
+FragmentPipelineCache::FragmentPipelineCache(std::size_t max_pipelines)
+    : max_pipelines(max_pipelines) {}
+
+const FragmentPipeline& FragmentPipelineCache::Get(const Regs& regs) {
+    const FragmentPipeline::Key key = FragmentPipeline::MakeKey(regs);
+    if (last_pipeline && last_pipeline->GetKey() == key) {
+        return *last_pipeline;
+    }
+
+    const u64 hash = Common::ComputeHash64(key.data(), sizeof(key));
+    auto it = pipelines.find(hash);
+    if (it == pipelines.end() || it->second.GetKey() != key) {
+        if (it != pipelines.end()) {
+            pipelines.erase(it);
+        } else if (pipelines.size() >= max_pipelines) {
+            pipelines.clear();
+        }
+        it = pipelines.emplace(hash, FragmentPipeline(regs)).first;
+    }
+
+    last_pipeline = &it->second;
+    return *last_pipeline;
+}
+
+} // namespace Pica::Rasterizer
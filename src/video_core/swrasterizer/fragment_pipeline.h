@@ -0,0 +1,160 @@
+// Copyright 2020 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include "common/common_types.h"
+#include "common/vector_math.h"
+#include "video_core/regs.h"
+#include "video_core/swrasterizer/texturing.h"
+
+namespace Pica::Rasterizer {
+
+/// Colors of a fragment that the texture combiners can take as sources.
+struct TevInputs {
+    Common::Vec4<u8> primary_color;
+    Common::Vec4<u8> primary_fragment_color;
+    Common::Vec4<u8> secondary_fragment_color;
+    std::array<Common::Vec4<u8>, 4> texture_color;
+};
+
+/**
+ * The per-fragment operations of a register configuration: the texture combiners and the output
+ * merger. Each combiner, test and blend factor is resolved once to a function specialized for its
+ * mode, so that fragments don't go through the registers and their switches.
+ */
+class FragmentPipeline {
+public:
+    /// The registers the pipeline is built from.
+    using Key = std::array<u32, 6 * 5 + 3 + 8 + 3>;
+
+    static Key MakeKey(const Regs& regs);
+
+    /// Whether the register is one the pipeline is built from, so writing it changes the key.
+    static bool DependsOnRegister(u32 id);
+
+    explicit FragmentPipeline(const Regs& regs);
+
+    const Key& GetKey() const {
+        return key;
+    }
+
+    /// Runs the texture combiners on the fragment colors and returns the combined color.
+    Common::Vec4<u8> CombineTextures(const TevInputs& inputs) const;
+
+    /// Whether the fragment alpha passes the alpha test, if enabled.
+    bool AlphaTest(u8 alpha) const {
+        return !alpha_test_enable || alpha_test_func(alpha, alpha_test_ref);
+    }
+
+    /// Whether the stencil value in the framebuffer passes the stencil test.
+    bool StencilTest(u8 old_stencil) const {
+        return stencil_func(stencil_reference_value & stencil_input_mask,
+                            old_stencil & stencil_input_mask);
+    }
+
+    /// Whether the fragment depth passes the depth test against the depth in the framebuffer.
+    bool DepthTest(u32 z, u32 ref_z) const {
+        return depth_test_func(z, ref_z);
+    }
+
+    /**
+     * Blends the fragment color with the framebuffer color, or combines them with the logic
+     * operation, and keeps the framebuffer channels that aren't written.
+     */
+    Common::Vec4<u8> Blend(const Common::Vec4<u8>& source, const Common::Vec4<u8>& dest) const;
+
+    // Output merger state read for each fragment
+
+    bool shadow_mode;
+
+    bool fog_enable;
+    bool fog_flip;
+    Common::Vec3<u8> fog_color;
+
+    bool stencil_action_enable;
+    u8 stencil_reference_value;
+    u8 stencil_write_mask;
+    FramebufferRegs::StencilAction stencil_fail_action;
+    FramebufferRegs::StencilAction depth_fail_action;
+    FramebufferRegs::StencilAction depth_pass_action;
+
+    bool depth_test_enable;
+    bool depth_write_enable;
+    bool depth_stencil_write_enable;
+    unsigned depth_bits;
+
+    bool color_write_enable;
+
+private:
+    using CompareFunc = bool (*)(u32 lhs, u32 rhs);
+    using BlendFactorFunc = u8 (*)(const Common::Vec4<u8>& source, const Common::Vec4<u8>& dest,
+                                   const Common::Vec4<u8>& constant, unsigned channel);
+
+    struct TevStage {
+        // Indices into the sources of CombineTextures, which are TevStageConfig::Source values
+        std::array<u8, 3> color_sources;
+        std::array<u8, 3> alpha_sources;
+        std::array<ColorModifierFunc, 3> color_modifiers;
+        std::array<AlphaModifierFunc, 3> alpha_modifiers;
+        ColorCombineFunc color_combine;
+        /// nullptr when the alpha is the color result, as with Dot3_RGBA
+        AlphaCombineFunc alpha_combine;
+        Common::Vec4<u8> constant;
+        unsigned color_multiplier;
+        unsigned alpha_multiplier;
+        /// Whether the stage outputs the previous stage's output unchanged
+        bool pass_through;
+        bool updates_buffer_color;
+        bool updates_buffer_alpha;
+    };
+
+    Key key;
+
+    std::array<TevStage, 6> tev_stages;
+    /// Number of stages run, leaving out the trailing stages that pass their input through
+    std::size_t num_tev_stages;
+    Common::Vec4<u8> combiner_buffer_color;
+
+    bool alpha_test_enable;
+    CompareFunc alpha_test_func;
+    u8 alpha_test_ref;
+
+    CompareFunc stencil_func;
+    u8 stencil_input_mask;
+
+    CompareFunc depth_test_func;
+
+    bool alphablend_enable;
+    std::array<BlendFactorFunc, 4> source_factors;
+    std::array<BlendFactorFunc, 4> dest_factors;
+    FramebufferRegs::BlendEquation blend_equation_rgb;
+    FramebufferRegs::BlendEquation blend_equation_a;
+    Common::Vec4<u8> blend_const;
+    FramebufferRegs::LogicOp logic_op;
+    std::array<bool, 4> write_mask;
+};
+
+/// Keeps the fragment pipelines of the register configurations drawn with recently.
+class FragmentPipelineCache {
+public:
+    /// @param max_pipelines Number of pipelines kept before the cache is emptied
+    explicit FragmentPipelineCache(std::size_t max_pipelines);
+
+    /**
+     * Returns the fragment pipeline of the current register configuration, building it if it
+     * isn't cached. The result is valid until the next call.
+     */
+    const FragmentPipeline& Get(const Regs& regs);
+
+private:
+    const std::size_t max_pipelines;
+    std::unordered_map<u64, FragmentPipeline> pipelines;
+    const FragmentPipeline* last_pipeline = nullptr;
+};
+
+} // namespace Pica::Rasterizer
@@ -3,12 +3,15 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <utility>
 #include "common/assert.h"
 #include "common/color.h"
 #include "common/common_types.h"
 #include "common/logging/log.h"
 #include "common/vector_math.h"
-#include "core/hw/gpu.h"
 #include "core/memory.h"
 #include "video_core/pica_state.h"
 #include "video_core/regs_framebuffer.h"
@@ -18,210 +21,222 @@
 
 namespace Pica::Rasterizer {
 
-void DrawPixel(int x, int y, const Common::Vec4<u8>& color) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetColorBufferPhysicalAddress();
+namespace {
 
-    // Similarly to textures, the render framebuffer is laid out from bottom to top, too.
-    // NOTE: The framebuffer height register contains the actual FB height minus one.
-    y = framebuffer.height - y;
-
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel =
-        GPU::Regs::BytesPerPixel(GPU::Regs::PixelFormat(framebuffer.color_format.Value()));
-    u32 dst_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) +
-                     coarse_y * framebuffer.width * bytes_per_pixel;
-    u8* dst_pixel = VideoCore::g_memory->GetPhysicalPointer(addr) + dst_offset;
+using ColorFormat = FramebufferRegs::ColorFormat;
+using DepthFormat = FramebufferRegs::DepthFormat;
 
-    switch (framebuffer.color_format) {
-    case FramebufferRegs::ColorFormat::RGBA8:
-        Color::EncodeRGBA8(color, dst_pixel);
-        break;
+template <ColorFormat format>
+Common::Vec4<u8> DecodeColor(const u8* bytes) {
+    switch (format) {
+    case ColorFormat::RGBA8:
+        return Color::DecodeRGBA8(bytes);
 
-    case FramebufferRegs::ColorFormat::RGB8:
-        Color::EncodeRGB8(color, dst_pixel);
-        break;
+    case ColorFormat::RGB8:
+        return Color::DecodeRGB8(bytes);
 
-    case FramebufferRegs::ColorFormat::RGB5A1:
-        Color::EncodeRGB5A1(color, dst_pixel);
-        break;
+    case ColorFormat::RGB5A1:
+        return Color::DecodeRGB5A1(bytes);
 
-    case FramebufferRegs::ColorFormat::RGB565:
-        Color::EncodeRGB565(color, dst_pixel);
-        break;
+    case ColorFormat::RGB565:
+        return Color::DecodeRGB565(bytes);
 
-    case FramebufferRegs::ColorFormat::RGBA4:
-        Color::EncodeRGBA4(color, dst_pixel);
-        break;
+    case ColorFormat::RGBA4:
+        return Color::DecodeRGBA4(bytes);
 
     default:
         LOG_CRITICAL(Render_Software, "Unknown framebuffer color format {:x}",
-                     static_cast<u32>(framebuffer.color_format.Value()));
+                     static_cast<u32>(format));
         UNIMPLEMENTED();
     }
-}
-
-const Common::Vec4<u8> GetPixel(int x, int y) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetColorBufferPhysicalAddress();
 
-    y = framebuffer.height - y;
-
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel =
-        GPU::Regs::BytesPerPixel(GPU::Regs::PixelFormat(framebuffer.color_format.Value()));
-    u32 src_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) +
-                     coarse_y * framebuffer.width * bytes_per_pixel;
-    u8* src_pixel = VideoCore::g_memory->GetPhysicalPointer(addr) + src_offset;
+    return {0, 0, 0, 0};
+}
 
-    switch (framebuffer.color_format) {
-    case FramebufferRegs::ColorFormat::RGBA8:
-        return Color::DecodeRGBA8(src_pixel);
+template <ColorFormat format>
+void EncodeColor(const Common::Vec4<u8>& color, u8* bytes) {
+    switch (format) {
+    case ColorFormat::RGBA8:
+        Color::EncodeRGBA8(color, bytes);
+        break;
 
-    case FramebufferRegs::ColorFormat::RGB8:
-        return Color::DecodeRGB8(src_pixel);
+    case ColorFormat::RGB8:
+        Color::EncodeRGB8(color, bytes);
+        break;
 
-    case FramebufferRegs::ColorFormat::RGB5A1:
-        return Color::DecodeRGB5A1(src_pixel);
+    case ColorFormat::RGB5A1:
+        Color::EncodeRGB5A1(color, bytes);
+        break;
 
-    case FramebufferRegs::ColorFormat::RGB565:
-        return Color::DecodeRGB565(src_pixel);
+    case ColorFormat::RGB565:
+        Color::EncodeRGB565(color, bytes);
+        break;
 
-    case FramebufferRegs::ColorFormat::RGBA4:
-        return Color::DecodeRGBA4(src_pixel);
+    case ColorFormat::RGBA4:
+        Color::EncodeRGBA4(color, bytes);
+        break;
 
     default:
         LOG_CRITICAL(Render_Software, "Unknown framebuffer color format {:x}",
-                     static_cast<u32>(framebuffer.color_format.Value()));
+                     static_cast<u32>(format));
         UNIMPLEMENTED();
     }
-
-    return {0, 0, 0, 0};
 }
 
-u32 GetDepth(int x, int y) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetDepthBufferPhysicalAddress();
-    u8* depth_buffer = VideoCore::g_memory->GetPhysicalPointer(addr);
-
-    y = framebuffer.height - y;
-
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel = FramebufferRegs::BytesPerDepthPixel(framebuffer.depth_format);
-    u32 stride = framebuffer.width * bytes_per_pixel;
-
-    u32 src_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) + coarse_y * stride;
-    u8* src_pixel = depth_buffer + src_offset;
-
-    switch (framebuffer.depth_format) {
-    case FramebufferRegs::DepthFormat::D16:
-        return Color::DecodeD16(src_pixel);
-    case FramebufferRegs::DepthFormat::D24:
-        return Color::DecodeD24(src_pixel);
-    case FramebufferRegs::DepthFormat::D24S8:
-        return Color::DecodeD24S8(src_pixel).x;
+template <DepthFormat format>
+u32 DecodeDepth(const u8* bytes) {
+    switch (format) {
+    case DepthFormat::D16:
+        return Color::DecodeD16(bytes);
+    case DepthFormat::D24:
+        return Color::DecodeD24(bytes);
+    case DepthFormat::D24S8:
+        return Color::DecodeD24S8(bytes).x;
     default:
-        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}",
-                     static_cast<u32>(framebuffer.depth_format.Value()));
+        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}", static_cast<u32>(format));
         UNIMPLEMENTED();
         return 0;
     }
 }
 
-u8 GetStencil(int x, int y) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetDepthBufferPhysicalAddress();
-    u8* depth_buffer = VideoCore::g_memory->GetPhysicalPointer(addr);
+template <DepthFormat format>
+void EncodeDepth(u32 value, u8* bytes) {
+    switch (format) {
+    case DepthFormat::D16:
+        Color::EncodeD16(value, bytes);
+        break;
 
-    y = framebuffer.height - y;
+    case DepthFormat::D24:
+        Color::EncodeD24(value, bytes);
+        break;
 
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel = Pica::FramebufferRegs::BytesPerDepthPixel(framebuffer.depth_format);
-    u32 stride = framebuffer.width * bytes_per_pixel;
+    case DepthFormat::D24S8:
+        Color::EncodeD24X8(value, bytes);
+        break;
 
-    u32 src_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) + coarse_y * stride;
-    u8* src_pixel = depth_buffer + src_offset;
+    default:
+        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}", static_cast<u32>(format));
+        UNIMPLEMENTED();
+        break;
+    }
+}
 
-    switch (framebuffer.depth_format) {
-    case FramebufferRegs::DepthFormat::D24S8:
-        return Color::DecodeD24S8(src_pixel).y;
+template <DepthFormat format>
+u8 DecodeStencil(const u8* bytes) {
+    switch (format) {
+    case DepthFormat::D24S8:
+        return Color::DecodeD24S8(bytes).y;
 
     default:
         LOG_WARNING(
             HW_GPU,
             "GetStencil called for function which doesn't have a stencil component (format {})",
-            static_cast<u32>(framebuffer.depth_format.Value()));
+            static_cast<u32>(format));
         return 0;
     }
 }
 
-void SetDepth(int x, int y, u32 value) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetDepthBufferPhysicalAddress();
-    u8* depth_buffer = VideoCore::g_memory->GetPhysicalPointer(addr);
-
-    y = framebuffer.height - y;
-
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel = FramebufferRegs::BytesPerDepthPixel(framebuffer.depth_format);
-    u32 stride = framebuffer.width * bytes_per_pixel;
-
-    u32 dst_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) + coarse_y * stride;
-    u8* dst_pixel = depth_buffer + dst_offset;
-
-    switch (framebuffer.depth_format) {
-    case FramebufferRegs::DepthFormat::D16:
-        Color::EncodeD16(value, dst_pixel);
-        break;
-
-    case FramebufferRegs::DepthFormat::D24:
-        Color::EncodeD24(value, dst_pixel);
+template <DepthFormat format>
+void EncodeStencil(u8 value, u8* bytes) {
+    switch (format) {
+    case DepthFormat::D16:
+    case DepthFormat::D24:
+        // Nothing to do
         break;
 
-    case FramebufferRegs::DepthFormat::D24S8:
-        Color::EncodeD24X8(value, dst_pixel);
+    case DepthFormat::D24S8:
+        Color::EncodeX24S8(value, bytes);
         break;
 
     default:
-        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}",
-                     static_cast<u32>(framebuffer.depth_format.Value()));
+        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}", static_cast<u32>(format));
         UNIMPLEMENTED();
         break;
     }
 }
 
-void SetStencil(int x, int y, u8 value) {
-    const auto& framebuffer = g_state.regs.framebuffer.framebuffer;
-    const PAddr addr = framebuffer.GetDepthBufferPhysicalAddress();
-    u8* depth_buffer = VideoCore::g_memory->GetPhysicalPointer(addr);
-
-    y = framebuffer.height - y;
-
-    const u32 coarse_y = y & ~7;
-    u32 bytes_per_pixel = Pica::FramebufferRegs::BytesPerDepthPixel(framebuffer.depth_format);
-    u32 stride = framebuffer.width * bytes_per_pixel;
-
-    u32 dst_offset = VideoCore::GetMortonOffset(x, y, bytes_per_pixel) + coarse_y * stride;
-    u8* dst_pixel = depth_buffer + dst_offset;
+template <std::size_t... formats>
+constexpr auto MakeColorAccessors(std::index_sequence<formats...>) {
+    return std::array{std::make_pair(&DecodeColor<static_cast<ColorFormat>(formats)>,
+                                     &EncodeColor<static_cast<ColorFormat>(formats)>)...};
+}
 
-    switch (framebuffer.depth_format) {
-    case Pica::FramebufferRegs::DepthFormat::D16:
-    case Pica::FramebufferRegs::DepthFormat::D24:
-        // Nothing to do
-        break;
+template <std::size_t... formats>
+constexpr auto MakeDepthAccessors(std::index_sequence<formats...>) {
+    return std::array{std::make_tuple(&DecodeDepth<static_cast<DepthFormat>(formats)>,
+                                      &EncodeDepth<static_cast<DepthFormat>(formats)>,
+                                      &DecodeStencil<static_cast<DepthFormat>(formats)>,
+                                      &EncodeStencil<static_cast<DepthFormat>(formats)>)...};
+}
 
-    case Pica::FramebufferRegs::DepthFormat::D24S8:
-        Color::EncodeX24S8(value, dst_pixel);
-        break;
+// Indexed by format, including the values of the register fields that aren't valid formats
+constexpr auto color_accessors = MakeColorAccessors(std::make_index_sequence<8>{});
+constexpr auto depth_accessors = MakeDepthAccessors(std::make_index_sequence<4>{});
+
+/// Bytes per pixel of the valid formats, or 0 for the others, whose accessors only report them.
+u32 BytesPerPixel(ColorFormat format) {
+    switch (format) {
+    case ColorFormat::RGBA8:
+    case ColorFormat::RGB8:
+    case ColorFormat::RGB5A1:
+    case ColorFormat::RGB565:
+    case ColorFormat::RGBA4:
+        return FramebufferRegs::BytesPerColorPixel(format);
+    default:
+        return 0;
+    }
+}
 
+u32 BytesPerPixel(DepthFormat format) {
+    switch (format) {
+    case DepthFormat::D16:
+    case DepthFormat::D24:
+    case DepthFormat::D24S8:
+        return FramebufferRegs::BytesPerDepthPixel(format);
     default:
-        LOG_CRITICAL(HW_GPU, "Unimplemented depth format {}",
-                     static_cast<u32>(framebuffer.depth_format.Value()));
-        UNIMPLEMENTED();
-        break;
+        return 0;
     }
 }
 
+/// Returns the offsets of the columns and rows of a tile in Morton order, in bytes.
+std::pair<std::array<u32, 8>, std::array<u32, 8>> MakeTileOffsets(u32 bytes_per_pixel) {
+    std::array<u32, 8> x_offsets;
+    std::array<u32, 8> y_offsets;
+    for (u32 i = 0; i < 8; ++i) {
+        x_offsets[i] = VideoCore::MortonInterleave(i, 0) * bytes_per_pixel;
+        y_offsets[i] = VideoCore::MortonInterleave(0, i) * bytes_per_pixel;
+    }
+    return {x_offsets, y_offsets};
+}
+
+} // Anonymous namespace
+
+FramebufferAccessor::FramebufferAccessor(const FramebufferRegs& regs, bool use_color_buffer,
+                                         bool use_depth_buffer) {
+    const auto& framebuffer = regs.framebuffer;
+    color_buffer = use_color_buffer ? VideoCore::g_memory->GetPhysicalPointer(
+                                          framebuffer.GetColorBufferPhysicalAddress())
+                                    : nullptr;
+    depth_buffer = use_depth_buffer ? VideoCore::g_memory->GetPhysicalPointer(
+                                          framebuffer.GetDepthBufferPhysicalAddress())
+                                    : nullptr;
+    height = framebuffer.height;
+
+    const u32 color_bytes_per_pixel = BytesPerPixel(framebuffer.color_format);
+    color_row_stride = framebuffer.width * color_bytes_per_pixel;
+    color_tile_size = 8 * 8 * color_bytes_per_pixel;
+    std::tie(color_x_offsets, color_y_offsets) = MakeTileOffsets(color_bytes_per_pixel);
+    std::tie(decode_color, encode_color) =
+        color_accessors[static_cast<std::size_t>(framebuffer.color_format.Value())];
+
+    const u32 depth_bytes_per_pixel = BytesPerPixel(framebuffer.depth_format);
+    depth_row_stride = framebuffer.width * depth_bytes_per_pixel;
+    depth_tile_size = 8 * 8 * depth_bytes_per_pixel;
+    std::tie(depth_x_offsets, depth_y_offsets) = MakeTileOffsets(depth_bytes_per_pixel);
+    std::tie(decode_depth, encode_depth, decode_stencil, encode_stencil) =
+        depth_accessors[static_cast<std::size_t>(framebuffer.depth_format.Value())];
+}
+
 u8 PerformStencilAction(FramebufferRegs::StencilAction action, u8 old_stencil, u8 ref) {
     switch (action) {
     case FramebufferRegs::StencilAction::Keep:
@@ -4,18 +4,102 @@
 
 #pragma once
 
+#include <array>
 #include "common/common_types.h"
 #include "common/vector_math.h"
 #include "video_core/regs_framebuffer.h"
 
 namespace Pica::Rasterizer {
 
-void DrawPixel(int x, int y, const Common::Vec4<u8>& color);
-const Common::Vec4<u8> GetPixel(int x, int y);
-u32 GetDepth(int x, int y);
-u8 GetStencil(int x, int y);
-void SetDepth(int x, int y, u32 value);
-void SetStencil(int x, int y, u8 value);
+/**
+ * Reads and writes the pixels of the color and depth buffers configured in the registers. The
+ * buffer pointers, tile layout and formats are resolved when it is constructed, so that it can be
+ * set up once per triangle rather than for each pixel.
+ */
+class FramebufferAccessor {
+public:
+    /// Position of a framebuffer row in both buffers, shared by all the pixels of the row.
+    struct Row {
+        u32 color_offset;
+        u32 depth_offset;
+    };
+
+    /**
+     * Buffers that aren't accessed aren't looked up, as they may be left at unmapped addresses.
+     * @param use_color_buffer Whether the color buffer is accessed
+     * @param use_depth_buffer Whether the depth and stencil buffer is accessed
+     */
+    FramebufferAccessor(const FramebufferRegs& regs, bool use_color_buffer, bool use_depth_buffer);
+
+    /// Returns the position of the row at y, in the bottom to top coordinates of the rasterizer.
+    Row GetRow(int y) const {
+        // Similarly to textures, the render framebuffer is laid out from bottom to top, too.
+        // NOTE: The framebuffer height register contains the actual FB height minus one.
+        y = height - y;
+
+        const u32 coarse_y = y & ~7;
+        return {coarse_y * color_row_stride + color_y_offsets[y & 7],
+                coarse_y * depth_row_stride + depth_y_offsets[y & 7]};
+    }
+
+    void DrawPixel(const Row& row, int x, const Common::Vec4<u8>& color) const {
+        encode_color(color, color_buffer + ColorOffset(row, x));
+    }
+
+    Common::Vec4<u8> GetPixel(const Row& row, int x) const {
+        return decode_color(color_buffer + ColorOffset(row, x));
+    }
+
+    u32 GetDepth(const Row& row, int x) const {
+        return decode_depth(depth_buffer + DepthOffset(row, x));
+    }
+
+    u8 GetStencil(const Row& row, int x) const {
+        return decode_stencil(depth_buffer + DepthOffset(row, x));
+    }
+
+    void SetDepth(const Row& row, int x, u32 value) const {
+        encode_depth(value, depth_buffer + DepthOffset(row, x));
+    }
+
+    void SetStencil(const Row& row, int x, u8 value) const {
+        encode_stencil(value, depth_buffer + DepthOffset(row, x));
+    }
+
+private:
+    // Pixels are stored in 8x8 tiles in Morton order, see VideoCore::GetMortonOffset
+    u32 ColorOffset(const Row& row, int x) const {
+        return row.color_offset + (x >> 3) * color_tile_size + color_x_offsets[x & 7];
+    }
+
+    u32 DepthOffset(const Row& row, int x) const {
+        return row.depth_offset + (x >> 3) * depth_tile_size + depth_x_offsets[x & 7];
+    }
+
+    u8* color_buffer;
+    u8* depth_buffer;
+    u32 height;
+
+    /// Size of a row of tiles, in bytes
+    u32 color_row_stride;
+    u32 depth_row_stride;
+    /// Size of a tile, in bytes
+    u32 color_tile_size;
+    u32 depth_tile_size;
+    /// Offsets of the columns and rows of a tile, in bytes
+    std::array<u32, 8> color_x_offsets;
+    std::array<u32, 8> color_y_offsets;
+    std::array<u32, 8> depth_x_offsets;
+    std::array<u32, 8> depth_y_offsets;
+
+    Common::Vec4<u8> (*decode_color)(const u8* bytes);
+    void (*encode_color)(const Common::Vec4<u8>& color, u8* bytes);
+    u32 (*decode_depth)(const u8* bytes);
+    void (*encode_depth)(u32 value, u8* bytes);
+    u8 (*decode_stencil)(const u8* bytes);
+    void (*encode_stencil)(u8 value, u8* bytes);
+};
+
 u8 PerformStencilAction(FramebufferRegs::StencilAction action, u8 old_stencil, u8 ref);
 
 Common::Vec4<u8> EvaluateBlendEquation(const Common::Vec4<u8>& src,
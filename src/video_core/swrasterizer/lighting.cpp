@@ -3,21 +3,22 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "common/assert.h"
+#include "common/logging/log.h"
+#include "video_core/regs.h"
 #include "video_core/swrasterizer/lighting.h"
 
 namespace Pica {
 
 static float LookupLightingLut(const Pica::State::Lighting& lighting, std::size_t lut_index,
                                u8 index, float delta) {
-    ASSERT_MSG(lut_index < lighting.luts.size(), "Out of range lut");
-    ASSERT_MSG(index < lighting.luts[lut_index].size(), "Out of range index");
+    ASSERT_MSG(lut_index < lighting.float_luts.size(), "Out of range lut");
+    ASSERT_MSG(index < lighting.float_luts[lut_index].size(), "Out of range index");
 
-    const auto& lut = lighting.luts[lut_index][index];
-
-    float lut_value = lut.ToFloat();
-    float lut_diff = lut.DiffToFloat();
-
-    return lut_value + lut_diff * delta;
+    const auto& lut = lighting.float_luts[lut_index][index];
+    return lut.value + lut.difference * delta;
 }
 
 std::tuple<Common::Vec4<u8>, Common::Vec4<u8>> ComputeFragmentsColors(
@@ -329,4 +330,351 @@ std::tuple<Common::Vec4<u8>, Common::Vec4<u8>> ComputeFragmentsColors(
     return std::make_tuple(diffuse, specular);
 }
 
+bool FragmentLighting::DependsOnRegister(u32 id) {
+    constexpr u32 first = PICA_REG_INDEX(lighting);
+    constexpr u32 count = sizeof(LightingRegs) / sizeof(u32);
+    // The LUTs are read from the lighting state for each fragment
+    const bool lut_register = id == PICA_REG_INDEX(lighting.lut_config) ||
+                              (id >= PICA_REG_INDEX(lighting.lut_data[0]) &&
+                               id <= PICA_REG_INDEX(lighting.lut_data[7]));
+    return id >= first && id < first + count && !lut_register;
+}
+
+FragmentLighting::FragmentLighting(const LightingRegs& lighting) {
+    const auto config = lighting.config0.config.Value();
+
+    used_inputs = 0;
+    const auto make_sampler = [&](bool enable, LightingRegs::LightingLutInput input, bool abs,
+                                  LightingRegs::LightingScale scale,
+                                  LightingRegs::LightingSampler sampler) {
+        LutSampler result{};
+        result.enable = enable;
+        result.input = static_cast<std::size_t>(input);
+        result.abs = abs;
+        result.scale = lighting.lut_scale.GetScale(scale);
+        result.lut = static_cast<std::size_t>(sampler);
+        if (!enable) {
+            return result;
+        }
+        if (result.input > static_cast<std::size_t>(LightingRegs::LightingLutInput::CP)) {
+            // Read as 0
+            LOG_CRITICAL(HW_GPU, "Unknown lighting LUT input {}", result.input);
+            UNIMPLEMENTED();
+        }
+        used_inputs |= 1u << result.input;
+        return result;
+    };
+    const auto supported = [config](LightingRegs::LightingSampler sampler) {
+        return LightingRegs::IsLightingSamplerSupported(config, sampler);
+    };
+    using Sampler = LightingRegs::LightingSampler;
+
+    d0 = make_sampler(lighting.config1.disable_lut_d0 == 0 && supported(Sampler::Distribution0),
+                      lighting.lut_input.d0, lighting.abs_lut_input.disable_d0 == 0,
+                      lighting.lut_scale.d0, Sampler::Distribution0);
+    d1 = make_sampler(lighting.config1.disable_lut_d1 == 0 && supported(Sampler::Distribution1),
+                      lighting.lut_input.d1, lighting.abs_lut_input.disable_d1 == 0,
+                      lighting.lut_scale.d1, Sampler::Distribution1);
+    rr = make_sampler(lighting.config1.disable_lut_rr == 0 && supported(Sampler::ReflectRed),
+                      lighting.lut_input.rr, lighting.abs_lut_input.disable_rr == 0,
+                      lighting.lut_scale.rr, Sampler::ReflectRed);
+    rg = make_sampler(lighting.config1.disable_lut_rg == 0 && supported(Sampler::ReflectGreen),
+                      lighting.lut_input.rg, lighting.abs_lut_input.disable_rg == 0,
+                      lighting.lut_scale.rg, Sampler::ReflectGreen);
+    rb = make_sampler(lighting.config1.disable_lut_rb == 0 && supported(Sampler::ReflectBlue),
+                      lighting.lut_input.rb, lighting.abs_lut_input.disable_rb == 0,
+                      lighting.lut_scale.rb, Sampler::ReflectBlue);
+    fr = make_sampler(lighting.config1.disable_lut_fr == 0 && supported(Sampler::Fresnel),
+                      lighting.lut_input.fr, lighting.abs_lut_input.disable_fr == 0,
+                      lighting.lut_scale.fr, Sampler::Fresnel);
+
+    num_lights = lighting.max_light_index + 1;
+    for (unsigned light_index = 0; light_index < num_lights; ++light_index) {
+        const unsigned num = lighting.light_enable.GetNum(light_index);
+        const auto& light_config = lighting.light[num];
+        Light& light = lights[light_index];
+
+        light.position = {float16::FromRaw(light_config.x).ToFloat32(),
+                          float16::FromRaw(light_config.y).ToFloat32(),
+                          float16::FromRaw(light_config.z).ToFloat32()};
+        light.directional = light_config.config.directional != 0;
+        light.two_sided_diffuse = light_config.config.two_sided_diffuse != 0;
+        const Common::Vec3<s32> spot_dir{light_config.spot_x.Value(),
+                                         light_config.spot_y.Value(),
+                                         light_config.spot_z.Value()};
+        light.spot_direction = spot_dir.Cast<float>() / 2047.0f;
+
+        light.dist_atten_enable = !lighting.IsDistAttenDisabled(num);
+        light.dist_atten_scale = float20::FromRaw(light_config.dist_atten_scale).ToFloat32();
+        light.dist_atten_bias = float20::FromRaw(light_config.dist_atten_bias).ToFloat32();
+        light.dist_atten_lut =
+            static_cast<std::size_t>(LightingRegs::DistanceAttenuationSampler(num));
+        light.spot_atten = make_sampler(
+            !lighting.IsSpotAttenDisabled(num) && supported(Sampler::SpotlightAttenuation),
+            lighting.lut_input.sp, lighting.abs_lut_input.disable_sp == 0, lighting.lut_scale.sp,
+            LightingRegs::SpotlightAttenuationSampler(num));
+
+        light.specular_0 = light_config.specular_0.ToVec3f();
+        light.specular_1 = light_config.specular_1.ToVec3f();
+        light.diffuse = light_config.diffuse.ToVec3f();
+        light.ambient = light_config.ambient.ToVec3f();
+        light.geometric_factor_0 = light_config.config.geometric_factor_0 != 0;
+        light.geometric_factor_1 = light_config.config.geometric_factor_1 != 0;
+        light.shadow_enable = !lighting.IsShadowDisabled(num);
+        // Note: only the last entry in the light slots applies the Fresnel factor
+        light.fresnel = light_index == lighting.max_light_index && fr.enable;
+    }
+
+    // The projection onto the tangent is only computed with Config7, it reads 0 otherwise
+    use_cp_input = config == LightingRegs::LightingConfig::Config7;
+
+    shadow_enable = lighting.config0.enable_shadow != 0;
+    shadow_selector = lighting.config0.shadow_selector;
+    shadow_invert = lighting.config0.shadow_invert != 0;
+    shadow_primary = lighting.config0.shadow_primary != 0;
+    shadow_secondary = lighting.config0.shadow_secondary != 0;
+    shadow_alpha = lighting.config0.shadow_alpha != 0;
+
+    bump_mode = lighting.config0.bump_mode;
+    bump_selector = lighting.config0.bump_selector;
+    bump_renorm = lighting.config0.disable_bump_renorm == 0;
+    if (bump_mode != LightingRegs::LightingBumpMode::None &&
+        bump_mode != LightingRegs::LightingBumpMode::NormalMap &&
+        bump_mode != LightingRegs::LightingBumpMode::TangentMap) {
+        LOG_ERROR(HW_GPU, "Unknown bump mode {}", static_cast<u32>(bump_mode));
+    }
+
+    clamp_highlights = lighting.config0.clamp_highlights != 0;
+    enable_primary_alpha = lighting.config0.enable_primary_alpha != 0;
+    enable_secondary_alpha = lighting.config0.enable_secondary_alpha != 0;
+    global_ambient = lighting.global_ambient.ToVec3f();
+}
+
+std::tuple<Common::Vec4<u8>, Common::Vec4<u8>> FragmentLighting::ComputeFragmentsColors(
+    const Pica::State::Lighting& lighting_state, const Common::Quaternion<float>& normquat,
+    const Common::Vec3<float>& view, const Common::Vec4<u8> (&texture_color)[4]) const {
+
+    Common::Vec4<float> shadow;
+    if (shadow_enable) {
+        shadow = texture_color[shadow_selector].Cast<float>() / 255.0f;
+        if (shadow_invert) {
+            shadow = Common::MakeVec(1.0f, 1.0f, 1.0f, 1.0f) - shadow;
+        }
+    } else {
+        shadow = Common::MakeVec(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    Common::Vec3<float> surface_normal;
+    Common::Vec3<float> surface_tangent;
+
+    if (bump_mode == LightingRegs::LightingBumpMode::NormalMap ||
+        bump_mode == LightingRegs::LightingBumpMode::TangentMap) {
+        Common::Vec3<float> perturbation =
+            texture_color[bump_selector].xyz().Cast<float>() / 127.5f -
+            Common::MakeVec(1.0f, 1.0f, 1.0f);
+        if (bump_mode == LightingRegs::LightingBumpMode::NormalMap) {
+            if (bump_renorm) {
+                const float z_square = 1 - perturbation.xy().Length2();
+                perturbation.z = std::sqrt(std::max(z_square, 0.0f));
+            }
+            surface_normal = perturbation;
+            surface_tangent = Common::MakeVec(1.0f, 0.0f, 0.0f);
+        } else {
+            surface_normal = Common::MakeVec(0.0f, 0.0f, 1.0f);
+            surface_tangent = perturbation;
+        }
+    } else {
+        surface_normal = Common::MakeVec(0.0f, 0.0f, 1.0f);
+        surface_tangent = Common::MakeVec(1.0f, 0.0f, 0.0f);
+    }
+
+    // Use the normalized the quaternion when performing the rotation
+    const auto normal = Common::QuaternionRotate(normquat, surface_normal);
+    const auto tangent = Common::QuaternionRotate(normquat, surface_tangent);
+    const Common::Vec3<float> norm_view = view.Normalized();
+
+    Common::Vec4<float> diffuse_sum = {0.0f, 0.0f, 0.0f, 1.0f};
+    Common::Vec4<float> specular_sum = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    const auto uses = [this](LightingRegs::LightingLutInput input) {
+        return (used_inputs & (1u << static_cast<u32>(input))) != 0;
+    };
+    const bool uses_half_vector = uses(LightingRegs::LightingLutInput::NH) ||
+                                  uses(LightingRegs::LightingLutInput::VH) ||
+                                  (use_cp_input && uses(LightingRegs::LightingLutInput::CP));
+    const float nv = uses(LightingRegs::LightingLutInput::NV) ? Common::Dot(normal, norm_view)
+                                                              : 0.0f;
+
+    for (unsigned light_index = 0; light_index < num_lights; ++light_index) {
+        const Light& light = lights[light_index];
+
+        Common::Vec3<float> light_vector =
+            light.directional ? light.position : light.position + view;
+        light_vector.Normalize();
+        const Common::Vec3<float> half_vector = norm_view + light_vector;
+
+        float dist_atten = 1.0f;
+        if (light.dist_atten_enable) {
+            const auto distance = (-view - light.position).Length();
+            const float sample_loc =
+                std::clamp(light.dist_atten_scale * distance + light.dist_atten_bias, 0.0f, 1.0f);
+
+            const u8 lutindex =
+                static_cast<u8>(std::clamp(std::floor(sample_loc * 256.0f), 0.0f, 255.0f));
+            const float delta = sample_loc * 256 - lutindex;
+            dist_atten = LookupLightingLut(lighting_state, light.dist_atten_lut, lutindex, delta);
+        }
+
+        // The values of the LUT inputs, indexed by LightingLutInput. Only the inputs read by the
+        // enabled samplers are computed.
+        std::array<float, 8> inputs{};
+        if (uses_half_vector) {
+            const Common::Vec3<float> norm_half_vector = half_vector.Normalized();
+            inputs[0] = Common::Dot(normal, norm_half_vector);
+            inputs[1] = Common::Dot(norm_view, norm_half_vector);
+            if (use_cp_input) {
+                const Common::Vec3<float> half_vector_proj =
+                    norm_half_vector - normal * Common::Dot(normal, norm_half_vector);
+                inputs[5] = Common::Dot(half_vector_proj, tangent);
+            }
+        }
+        inputs[2] = nv;
+        if (uses(LightingRegs::LightingLutInput::LN)) {
+            inputs[3] = Common::Dot(light_vector, normal);
+        }
+        if (uses(LightingRegs::LightingLutInput::SP)) {
+            inputs[4] = Common::Dot(light_vector, light.spot_direction);
+        }
+
+        const auto sample = [&](const LutSampler& sampler) {
+            float result = inputs[sampler.input];
+
+            u8 index;
+            float delta;
+
+            if (sampler.abs) {
+                if (light.two_sided_diffuse)
+                    result = std::abs(result);
+                else
+                    result = std::max(result, 0.0f);
+
+                float flr = std::floor(result * 256.0f);
+                index = static_cast<u8>(std::clamp(flr, 0.0f, 255.0f));
+                delta = result * 256 - index;
+            } else {
+                float flr = std::floor(result * 128.0f);
+                s8 signed_index = static_cast<s8>(std::clamp(flr, -128.0f, 127.0f));
+                delta = result * 128.0f - signed_index;
+                index = static_cast<u8>(signed_index);
+            }
+
+            return sampler.scale * LookupLightingLut(lighting_state, sampler.lut, index, delta);
+        };
+
+        const float spot_atten = light.spot_atten.enable ? sample(light.spot_atten) : 1.0f;
+
+        // Specular 0 component
+        const float d0_lut_value = d0.enable ? sample(d0) : 1.0f;
+        Common::Vec3<float> specular_0 = d0_lut_value * light.specular_0;
+
+        // ReflectGreen and ReflectBlue default to the ReflectRed value, which defaults to 1.0
+        Common::Vec3<float> refl_value;
+        refl_value.x = rr.enable ? sample(rr) : 1.0f;
+        refl_value.y = rg.enable ? sample(rg) : refl_value.x;
+        refl_value.z = rb.enable ? sample(rb) : refl_value.x;
+
+        // Specular 1 component
+        const float d1_lut_value = d1.enable ? sample(d1) : 1.0f;
+        Common::Vec3<float> specular_1 = d1_lut_value * refl_value * light.specular_1;
+
+        // Fresnel
+        if (light.fresnel) {
+            const float lut_value = sample(fr);
+
+            // Enabled for diffuse lighting alpha component
+            if (enable_primary_alpha) {
+                diffuse_sum.a() = lut_value;
+            }
+
+            // Enabled for the specular lighting alpha component
+            if (enable_secondary_alpha) {
+                specular_sum.a() = lut_value;
+            }
+        }
+
+        auto dot_product = Common::Dot(light_vector, normal);
+        if (light.two_sided_diffuse)
+            dot_product = std::abs(dot_product);
+        else
+            dot_product = std::max(dot_product, 0.0f);
+
+        float clamp_highlights_factor = 1.0f;
+        if (clamp_highlights) {
+            clamp_highlights_factor = dot_product == 0.0f ? 0.0f : 1.0f;
+        }
+
+        if (light.geometric_factor_0 || light.geometric_factor_1) {
+            float geo_factor = half_vector.Length2();
+            geo_factor = geo_factor == 0.0f ? 0.0f : std::min(dot_product / geo_factor, 1.0f);
+            if (light.geometric_factor_0) {
+                specular_0 *= geo_factor;
+            }
+            if (light.geometric_factor_1) {
+                specular_1 *= geo_factor;
+            }
+        }
+
+        auto diffuse = (light.diffuse * dot_product + light.ambient) * dist_atten * spot_atten;
+        auto specular =
+            (specular_0 + specular_1) * clamp_highlights_factor * dist_atten * spot_atten;
+
+        if (light.shadow_enable) {
+            if (shadow_primary) {
+                diffuse = diffuse * shadow.xyz();
+            }
+            if (shadow_secondary) {
+                specular = specular * shadow.xyz();
+            }
+        }
+
+        diffuse_sum += Common::MakeVec(diffuse, 0.0f);
+        specular_sum += Common::MakeVec(specular, 0.0f);
+    }
+
+    if (shadow_alpha) {
+        // Alpha shadow also uses the Fresnel selecotr to determine which alpha to apply
+        // Enabled for diffuse lighting alpha component
+        if (enable_primary_alpha) {
+            diffuse_sum.a() *= shadow.w;
+        }
+
+        // Enabled for the specular lighting alpha component
+        if (enable_secondary_alpha) {
+            specular_sum.a() *= shadow.w;
+        }
+    }
+
+    diffuse_sum += Common::MakeVec(global_ambient, 0.0f);
+
+    auto diffuse = Common::MakeVec<float>(std::clamp(diffuse_sum.x, 0.0f, 1.0f) * 255,
+                                          std::clamp(diffuse_sum.y, 0.0f, 1.0f) * 255,
+                                          std::clamp(diffuse_sum.z, 0.0f, 1.0f) * 255,
+                                          std::clamp(diffuse_sum.w, 0.0f, 1.0f) * 255)
+                       .Cast<u8>();
+    auto specular = Common::MakeVec<float>(std::clamp(specular_sum.x, 0.0f, 1.0f) * 255,
+                                           std::clamp(specular_sum.y, 0.0f, 1.0f) * 255,
+                                           std::clamp(specular_sum.z, 0.0f, 1.0f) * 255,
+                                           std::clamp(specular_sum.w, 0.0f, 1.0f) * 255)
+                        .Cast<u8>();
+    return std::make_tuple(diffuse, specular);
+}
+
+const FragmentLighting& FragmentLightingCache::Get(const LightingRegs& lighting) {
+    if (!fragment_lighting || std::memcmp(&lighting_regs, &lighting, sizeof(lighting)) != 0) {
+        std::memcpy(&lighting_regs, &lighting, sizeof(lighting));
+        fragment_lighting.emplace(lighting);
+    }
+    return *fragment_lighting;
+}
+
 } // namespace Pica
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <optional>
 #include <tuple>
 #include "common/quaternion.h"
 #include "common/vector_math.h"
@@ -11,9 +14,103 @@
 
 namespace Pica {
 
+/**
+ * Computes the primary and secondary fragment colors, reading the lighting registers for the
+ * fragment. FragmentLighting computes the same colors with the registers resolved beforehand.
+ */
 std::tuple<Common::Vec4<u8>, Common::Vec4<u8>> ComputeFragmentsColors(
     const Pica::LightingRegs& lighting, const Pica::State::Lighting& lighting_state,
     const Common::Quaternion<float>& normquat, const Common::Vec3<float>& view,
     const Common::Vec4<u8> (&texture_color)[4]);
 
+/**
+ * The fragment lighting of a lighting register configuration. The lights, LUT samplers and
+ * switches are resolved when it is built, so that fragments only go through the arithmetic.
+ */
+class FragmentLighting {
+public:
+    explicit FragmentLighting(const LightingRegs& lighting);
+
+    /// Whether the register is one the lighting is built from.
+    static bool DependsOnRegister(u32 id);
+
+    std::tuple<Common::Vec4<u8>, Common::Vec4<u8>> ComputeFragmentsColors(
+        const Pica::State::Lighting& lighting_state, const Common::Quaternion<float>& normquat,
+        const Common::Vec3<float>& view, const Common::Vec4<u8> (&texture_color)[4]) const;
+
+private:
+    /// A LUT sampled with one of the lighting inputs.
+    struct LutSampler {
+        bool enable;
+        /// Index of the input, a LightingLutInput value
+        std::size_t input;
+        bool abs;
+        float scale;
+        std::size_t lut;
+    };
+
+    struct Light {
+        Common::Vec3<float> position;
+        bool directional;
+        bool two_sided_diffuse;
+        Common::Vec3<float> spot_direction;
+
+        bool dist_atten_enable;
+        float dist_atten_scale;
+        float dist_atten_bias;
+        std::size_t dist_atten_lut;
+        LutSampler spot_atten;
+
+        Common::Vec3<float> specular_0;
+        Common::Vec3<float> specular_1;
+        Common::Vec3<float> diffuse;
+        Common::Vec3<float> ambient;
+        bool geometric_factor_0;
+        bool geometric_factor_1;
+        bool shadow_enable;
+        /// Whether the light applies the Fresnel factor, which only the last light does
+        bool fresnel;
+    };
+
+    std::array<Light, 8> lights;
+    unsigned num_lights;
+
+    LutSampler d0;
+    LutSampler d1;
+    LutSampler rr;
+    LutSampler rg;
+    LutSampler rb;
+    LutSampler fr;
+    /// Bit mask of the LightingLutInput values read by the enabled samplers
+    unsigned used_inputs;
+    bool use_cp_input;
+
+    bool shadow_enable;
+    std::size_t shadow_selector;
+    bool shadow_invert;
+    bool shadow_primary;
+    bool shadow_secondary;
+    bool shadow_alpha;
+
+    LightingRegs::LightingBumpMode bump_mode;
+    std::size_t bump_selector;
+    bool bump_renorm;
+
+    bool clamp_highlights;
+    bool enable_primary_alpha;
+    bool enable_secondary_alpha;
+    Common::Vec3<float> global_ambient;
+};
+
+/// Keeps the fragment lighting of the last lighting register configuration drawn with.
+class FragmentLightingCache {
+public:
+    /// Returns the fragment lighting of the registers, building it again if they have changed.
+    const FragmentLighting& Get(const LightingRegs& lighting);
+
+private:
+    LightingRegs lighting_regs;
+    std::optional<FragmentLighting> fragment_lighting;
+};
+
 } // namespace Pica
@@ -4,7 +4,12 @@
 
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include "common/logging/log.h"
 #include "common/math_util.h"
+#include "video_core/regs.h"
 #include "video_core/swrasterizer/proctex.h"
 
 namespace Pica::Rasterizer {
@@ -14,14 +19,14 @@ using ProcTexShift = TexturingRegs::ProcTexShift;
 using ProcTexCombiner = TexturingRegs::ProcTexCombiner;
 using ProcTexFilter = TexturingRegs::ProcTexFilter;
 
-static float LookupLUT(const std::array<State::ProcTex::ValueEntry, 128>& lut, float coord) {
+static float LookupLUT(const std::array<State::ProcTex::FloatValueEntry, 128>& lut, float coord) {
     // For NoiseLUT/ColorMap/AlphaMap, coord=0.0 is lut[0], coord=127.0/128.0 is lut[127] and
     // coord=1.0 is lut[127]+lut_diff[127]. For other indices, the result is interpolated using
     // value entries and difference entries.
     coord *= 128;
     const int index_int = std::min(static_cast<int>(coord), 127);
     const float frac = coord - index_int;
-    return lut[index_int].ToFloat() + frac * lut[index_int].DiffToFloat();
+    return lut[index_int].value + frac * lut[index_int].difference;
 }
 
 // These function are used to generate random noise for procedural texture. Their results are
@@ -45,13 +50,7 @@ static float NoiseRand2D(unsigned int x, unsigned int y) {
     return -1.0f + v2 * 2.0f / 15.0f;
 }
 
-static float NoiseCoef(float u, float v, const TexturingRegs& regs, const State::ProcTex& state) {
-    const float freq_u = float16::FromRaw(regs.proctex_noise_frequency.u).ToFloat32();
-    const float freq_v = float16::FromRaw(regs.proctex_noise_frequency.v).ToFloat32();
-    const float phase_u = float16::FromRaw(regs.proctex_noise_u.phase).ToFloat32();
-    const float phase_v = float16::FromRaw(regs.proctex_noise_v.phase).ToFloat32();
-    const float x = 9 * freq_u * std::abs(u + phase_u);
-    const float y = 9 * freq_v * std::abs(v + phase_v);
+static float NoiseCoef(float x, float y, const State::ProcTex& state) {
     const int x_int = static_cast<int>(x);
     const int y_int = static_cast<int>(y);
     const float x_frac = x - x_int;
@@ -61,27 +60,26 @@ static float NoiseCoef(float u, float v, const TexturingRegs& regs, const State:
     const float g1 = NoiseRand2D(x_int + 1, y_int) * (x_frac + y_frac - 1);
     const float g2 = NoiseRand2D(x_int, y_int + 1) * (x_frac + y_frac - 1);
     const float g3 = NoiseRand2D(x_int + 1, y_int + 1) * (x_frac + y_frac - 2);
-    const float x_noise = LookupLUT(state.noise_table, x_frac);
-    const float y_noise = LookupLUT(state.noise_table, y_frac);
+    const float x_noise = LookupLUT(state.float_noise_table, x_frac);
+    const float y_noise = LookupLUT(state.float_noise_table, y_frac);
     return Common::BilinearInterp(g0, g1, g2, g3, x_noise, y_noise);
 }
 
-static float GetShiftOffset(float v, ProcTexShift mode, ProcTexClamp clamp_mode) {
-    const float offset = (clamp_mode == ProcTexClamp::MirroredRepeat) ? 1 : 0.5f;
+// The coordinate modes and combiners. The values that don't exist are reported when a sampler is
+// built with them.
+
+static float GetShiftOffset(float v, ProcTexShift mode, float offset) {
     switch (mode) {
-    case ProcTexShift::None:
-        return 0;
     case ProcTexShift::Odd:
         return offset * (((int)v / 2) % 2);
     case ProcTexShift::Even:
         return offset * ((((int)v + 1) / 2) % 2);
     default:
-        LOG_CRITICAL(HW_GPU, "Unknown shift mode {}", mode);
         return 0;
     }
-};
+}
 
-static void ClampCoord(float& coord, ProcTexClamp mode) {
+static float ClampCoord(float coord, ProcTexClamp mode) {
     switch (mode) {
     case ProcTexClamp::ToZero:
         if (coord > 1.0f)
@@ -106,52 +104,195 @@ static void ClampCoord(float& coord, ProcTexClamp mode) {
             coord = 1.0f;
         break;
     default:
-        LOG_CRITICAL(HW_GPU, "Unknown clamp mode {}", mode);
         coord = std::min(coord, 1.0f);
         break;
     }
+    return coord;
 }
 
-static float CombineAndMap(float u, float v, ProcTexCombiner combiner,
-                           const std::array<State::ProcTex::ValueEntry, 128>& map_table) {
-    float f;
+static float Combine(float u, float v, ProcTexCombiner combiner) {
     switch (combiner) {
     case ProcTexCombiner::U:
-        f = u;
-        break;
+        return u;
     case ProcTexCombiner::U2:
-        f = u * u;
-        break;
+        return u * u;
     case TexturingRegs::ProcTexCombiner::V:
-        f = v;
-        break;
+        return v;
     case TexturingRegs::ProcTexCombiner::V2:
-        f = v * v;
-        break;
+        return v * v;
     case TexturingRegs::ProcTexCombiner::Add:
-        f = (u + v) * 0.5f;
-        break;
+        return (u + v) * 0.5f;
     case TexturingRegs::ProcTexCombiner::Add2:
-        f = (u * u + v * v) * 0.5f;
-        break;
+        return (u * u + v * v) * 0.5f;
     case TexturingRegs::ProcTexCombiner::SqrtAdd2:
-        f = std::min(std::sqrt(u * u + v * v), 1.0f);
-        break;
+        return std::min(std::sqrt(u * u + v * v), 1.0f);
     case TexturingRegs::ProcTexCombiner::Min:
-        f = std::min(u, v);
-        break;
+        return std::min(u, v);
     case TexturingRegs::ProcTexCombiner::Max:
-        f = std::max(u, v);
-        break;
+        return std::max(u, v);
     case TexturingRegs::ProcTexCombiner::RMax:
-        f = std::min(((u + v) * 0.5f + std::sqrt(u * u + v * v)) * 0.5f, 1.0f);
+        return std::min(((u + v) * 0.5f + std::sqrt(u * u + v * v)) * 0.5f, 1.0f);
+    default:
+        return 0.0f;
+    }
+}
+
+// The functions above specialized for each value of their register field, and tables of the
+// specializations. The field is a constant in each of them, so their switches fold away.
+
+template <ProcTexShift mode>
+static float Shift(float v, float offset) {
+    return GetShiftOffset(v, mode, offset);
+}
+
+template <ProcTexClamp mode>
+static float Clamp(float coord) {
+    return ClampCoord(coord, mode);
+}
+
+template <ProcTexCombiner combiner>
+static float CombineCoords(float u, float v) {
+    return Combine(u, v, combiner);
+}
+
+template <std::size_t... modes>
+static constexpr auto MakeShiftFuncs(std::index_sequence<modes...>) {
+    return std::array{&Shift<static_cast<ProcTexShift>(modes)>...};
+}
+
+template <std::size_t... modes>
+static constexpr auto MakeClampFuncs(std::index_sequence<modes...>) {
+    return std::array{&Clamp<static_cast<ProcTexClamp>(modes)>...};
+}
+
+template <std::size_t... combiners>
+static constexpr auto MakeCombineFuncs(std::index_sequence<combiners...>) {
+    return std::array{&CombineCoords<static_cast<ProcTexCombiner>(combiners)>...};
+}
+
+static constexpr auto shift_funcs = MakeShiftFuncs(std::make_index_sequence<4>{});
+static constexpr auto clamp_funcs = MakeClampFuncs(std::make_index_sequence<8>{});
+static constexpr auto combine_funcs = MakeCombineFuncs(std::make_index_sequence<16>{});
+
+ProcTexSampler::Key ProcTexSampler::MakeKey(const TexturingRegs& regs) {
+    static_assert(offsetof(TexturingRegs, proctex_lut_offset) -
+                          offsetof(TexturingRegs, proctex) ==
+                      (std::tuple_size_v<Key> - 1) * sizeof(u32),
+                  "The procedural texture registers must be contiguous");
+    Key key;
+    std::memcpy(key.data(), &regs.proctex, sizeof(key));
+    return key;
+}
+
+bool ProcTexSampler::DependsOnRegister(u32 id) {
+    constexpr u32 first = PICA_REG_INDEX(texturing.proctex);
+    return id >= first && id < first + std::tuple_size_v<Key>;
+}
+
+ProcTexSampler::ProcTexSampler(const TexturingRegs& regs) : key(MakeKey(regs)) {
+    const auto& proctex = regs.proctex;
+
+    if (static_cast<u32>(proctex.u_shift.Value()) > 2 ||
+        static_cast<u32>(proctex.v_shift.Value()) > 2) {
+        LOG_CRITICAL(HW_GPU, "Unknown shift mode {} {}", proctex.u_shift.Value(),
+                     proctex.v_shift.Value());
+    }
+    if (static_cast<u32>(proctex.u_clamp.Value()) > 4 ||
+        static_cast<u32>(proctex.v_clamp.Value()) > 4) {
+        LOG_CRITICAL(HW_GPU, "Unknown clamp mode {} {}", proctex.u_clamp.Value(),
+                     proctex.v_clamp.Value());
+    }
+    if (static_cast<u32>(proctex.color_combiner.Value()) > 9 ||
+        (proctex.separate_alpha && static_cast<u32>(proctex.alpha_combiner.Value()) > 9)) {
+        LOG_CRITICAL(HW_GPU, "Unknown combiner {} {}", proctex.color_combiner.Value(),
+                     proctex.alpha_combiner.Value());
+    }
+
+    u_shift = shift_funcs[static_cast<std::size_t>(proctex.u_shift.Value())];
+    v_shift = shift_funcs[static_cast<std::size_t>(proctex.v_shift.Value())];
+    u_shift_offset = (proctex.u_clamp == ProcTexClamp::MirroredRepeat) ? 1 : 0.5f;
+    v_shift_offset = (proctex.v_clamp == ProcTexClamp::MirroredRepeat) ? 1 : 0.5f;
+    u_clamp = clamp_funcs[static_cast<std::size_t>(proctex.u_clamp.Value())];
+    v_clamp = clamp_funcs[static_cast<std::size_t>(proctex.v_clamp.Value())];
+
+    noise_enable = proctex.noise_enable != 0;
+    noise_scale_u = 9 * float16::FromRaw(regs.proctex_noise_frequency.u).ToFloat32();
+    noise_scale_v = 9 * float16::FromRaw(regs.proctex_noise_frequency.v).ToFloat32();
+    noise_phase_u = float16::FromRaw(regs.proctex_noise_u.phase).ToFloat32();
+    noise_phase_v = float16::FromRaw(regs.proctex_noise_v.phase).ToFloat32();
+    noise_amplitude_u = static_cast<float>(regs.proctex_noise_u.amplitude);
+    noise_amplitude_v = static_cast<float>(regs.proctex_noise_v.amplitude);
+
+    color_combiner = combine_funcs[static_cast<std::size_t>(proctex.color_combiner.Value())];
+    separate_alpha = proctex.separate_alpha != 0;
+    alpha_combiner = combine_funcs[static_cast<std::size_t>(proctex.alpha_combiner.Value())];
+
+    // TODO(wwylele): implement mipmap
+    switch (regs.proctex_lut.filter) {
+    case ProcTexFilter::Linear:
+    case ProcTexFilter::LinearMipmapLinear:
+    case ProcTexFilter::LinearMipmapNearest:
+        linear_filter = true;
         break;
     default:
-        LOG_CRITICAL(HW_GPU, "Unknown combiner {}", combiner);
-        f = 0.0f;
+        linear_filter = false;
         break;
     }
-    return LookupLUT(map_table, f);
+    // For the color lut, coord=0.0 is lut[offset] and coord=1.0 is lut[offset+width-1]
+    lut_offset = static_cast<float>(regs.proctex_lut_offset.level0.Value());
+    lut_scale = static_cast<float>(regs.proctex_lut.width - 1);
+}
+
+Common::Vec4<u8> ProcTexSampler::Sample(float u, float v, const State::ProcTex& state) const {
+    u = std::abs(u);
+    v = std::abs(v);
+
+    // Get shift offset before noise generation
+    const float u_shift_value = u_shift(v, u_shift_offset);
+    const float v_shift_value = v_shift(u, v_shift_offset);
+
+    // Generate noise
+    if (noise_enable) {
+        const float noise = NoiseCoef(noise_scale_u * std::abs(u + noise_phase_u),
+                                      noise_scale_v * std::abs(v + noise_phase_v), state);
+        u += noise * noise_amplitude_u / 4095.0f;
+        v += noise * noise_amplitude_v / 4095.0f;
+        u = std::abs(u);
+        v = std::abs(v);
+    }
+
+    // Shift
+    u += u_shift_value;
+    v += v_shift_value;
+
+    // Clamp
+    u = u_clamp(u);
+    v = v_clamp(v);
+
+    // Combine and map
+    const float lut_coord = LookupLUT(state.float_color_map_table, color_combiner(u, v));
+
+    // Look up the color
+    const float index = lut_offset + lut_coord * lut_scale;
+    Common::Vec4<u8> final_color;
+    if (linear_filter) {
+        const int index_int = static_cast<int>(index);
+        const float frac = index - index_int;
+        final_color = (state.float_color_table[index_int] +
+                       frac * state.float_color_diff_table[index_int])
+                          .Cast<u8>();
+    } else {
+        final_color = state.color_table[static_cast<int>(std::round(index))].ToVector();
+    }
+
+    if (separate_alpha) {
+        // Note: in separate alpha mode, the alpha channel skips the color LUT look up stage. It
+        // uses the output of the alpha map directly instead.
+        const float final_alpha = LookupLUT(state.float_alpha_map_table, alpha_combiner(u, v));
+        return Common::MakeVec<u8>(final_color.rgb(), static_cast<u8>(final_alpha * 255));
+    } else {
+        return final_color;
+    }
 }
 
 Common::Vec4<u8> ProcTex(float u, float v, const TexturingRegs& regs, const State::ProcTex& state) {
@@ -159,12 +300,19 @@ Common::Vec4<u8> ProcTex(float u, float v, const TexturingRegs& regs, const Stat
     v = std::abs(v);
 
     // Get shift offset before noise generation
-    const float u_shift = GetShiftOffset(v, regs.proctex.u_shift, regs.proctex.u_clamp);
-    const float v_shift = GetShiftOffset(u, regs.proctex.v_shift, regs.proctex.v_clamp);
+    const float u_offset = (regs.proctex.u_clamp == ProcTexClamp::MirroredRepeat) ? 1 : 0.5f;
+    const float v_offset = (regs.proctex.v_clamp == ProcTexClamp::MirroredRepeat) ? 1 : 0.5f;
+    const float u_shift = GetShiftOffset(v, regs.proctex.u_shift, u_offset);
+    const float v_shift = GetShiftOffset(u, regs.proctex.v_shift, v_offset);
 
     // Generate noise
     if (regs.proctex.noise_enable) {
-        float noise = NoiseCoef(u, v, regs, state);
+        const float freq_u = float16::FromRaw(regs.proctex_noise_frequency.u).ToFloat32();
+        const float freq_v = float16::FromRaw(regs.proctex_noise_frequency.v).ToFloat32();
+        const float phase_u = float16::FromRaw(regs.proctex_noise_u.phase).ToFloat32();
+        const float phase_v = float16::FromRaw(regs.proctex_noise_v.phase).ToFloat32();
+        float noise = NoiseCoef(9 * freq_u * std::abs(u + phase_u),
+                                9 * freq_v * std::abs(v + phase_v), state);
         u += noise * regs.proctex_noise_u.amplitude / 4095.0f;
         v += noise * regs.proctex_noise_v.amplitude / 4095.0f;
         u = std::abs(u);
@@ -176,11 +324,12 @@ Common::Vec4<u8> ProcTex(float u, float v, const TexturingRegs& regs, const Stat
     v += v_shift;
 
     // Clamp
-    ClampCoord(u, regs.proctex.u_clamp);
-    ClampCoord(v, regs.proctex.v_clamp);
+    u = ClampCoord(u, regs.proctex.u_clamp);
+    v = ClampCoord(v, regs.proctex.v_clamp);
 
     // Combine and map
-    const float lut_coord = CombineAndMap(u, v, regs.proctex.color_combiner, state.color_map_table);
+    const float lut_coord =
+        LookupLUT(state.float_color_map_table, Combine(u, v, regs.proctex.color_combiner));
 
     // Look up the color
     // For the color lut, coord=0.0 is lut[offset] and coord=1.0 is lut[offset+width-1]
@@ -195,27 +344,35 @@ Common::Vec4<u8> ProcTex(float u, float v, const TexturingRegs& regs, const Stat
     case ProcTexFilter::LinearMipmapNearest: {
         const int index_int = static_cast<int>(index);
         const float frac = index - index_int;
-        const auto color_value = state.color_table[index_int].ToVector().Cast<float>();
-        const auto color_diff = state.color_diff_table[index_int].ToVector().Cast<float>();
-        final_color = (color_value + frac * color_diff).Cast<u8>();
+        final_color = (state.float_color_table[index_int] +
+                       frac * state.float_color_diff_table[index_int])
+                          .Cast<u8>();
         break;
     }
     case ProcTexFilter::Nearest:
     case ProcTexFilter::NearestMipmapLinear:
     case ProcTexFilter::NearestMipmapNearest:
+    default:
         final_color = state.color_table[static_cast<int>(std::round(index))].ToVector();
         break;
     }
 
     if (regs.proctex.separate_alpha) {
         // Note: in separate alpha mode, the alpha channel skips the color LUT look up stage. It
-        // uses the output of CombineAndMap directly instead.
+        // uses the output of the alpha map directly instead.
         const float final_alpha =
-            CombineAndMap(u, v, regs.proctex.alpha_combiner, state.alpha_map_table);
+            LookupLUT(state.float_alpha_map_table, Combine(u, v, regs.proctex.alpha_combiner));
         return Common::MakeVec<u8>(final_color.rgb(), static_cast<u8>(final_alpha * 255));
     } else {
         return final_color;
     }
 }
 
+const ProcTexSampler& ProcTexSamplerCache::Get(const TexturingRegs& regs) {
+    if (!sampler || sampler->GetKey() != ProcTexSampler::MakeKey(regs)) {
+        sampler.emplace(regs);
+    }
+    return *sampler;
+}
+
 } // namespace Pica::Rasterizer
@@ -4,13 +4,83 @@
 
 #pragma once
 
+#include <array>
+#include <optional>
 #include "common/common_types.h"
 #include "common/vector_math.h"
 #include "video_core/pica_state.h"
 
 namespace Pica::Rasterizer {
 
-/// Generates procedural texture color for the given coordinates
+/**
+ * Generates procedural texture color for the given coordinates, reading the registers for the
+ * fragment. ProcTexSampler generates the same colors with the registers resolved beforehand.
+ */
 Common::Vec4<u8> ProcTex(float u, float v, const TexturingRegs& regs, const State::ProcTex& state);
 
+/**
+ * The procedural texture of a register configuration. The noise parameters, coordinate modes and
+ * combiners are resolved when it is built, and the LUTs are read in their float form, so that
+ * fragments only go through the arithmetic.
+ */
+class ProcTexSampler {
+public:
+    /// The registers the sampler is built from, from proctex to proctex_lut_offset.
+    using Key = std::array<u32, 6>;
+
+    static Key MakeKey(const TexturingRegs& regs);
+
+    /// Whether the register is one the sampler is built from.
+    static bool DependsOnRegister(u32 id);
+
+    explicit ProcTexSampler(const TexturingRegs& regs);
+
+    const Key& GetKey() const {
+        return key;
+    }
+
+    /// Generates procedural texture color for the given coordinates
+    Common::Vec4<u8> Sample(float u, float v, const State::ProcTex& state) const;
+
+private:
+    using ShiftFunc = float (*)(float coord, float offset);
+    using ClampFunc = float (*)(float coord);
+    using CombineFunc = float (*)(float u, float v);
+
+    Key key;
+
+    ShiftFunc u_shift;
+    ShiftFunc v_shift;
+    float u_shift_offset;
+    float v_shift_offset;
+    ClampFunc u_clamp;
+    ClampFunc v_clamp;
+
+    bool noise_enable;
+    float noise_scale_u;
+    float noise_scale_v;
+    float noise_phase_u;
+    float noise_phase_v;
+    float noise_amplitude_u;
+    float noise_amplitude_v;
+
+    CombineFunc color_combiner;
+    bool separate_alpha;
+    CombineFunc alpha_combiner;
+
+    bool linear_filter;
+    float lut_offset;
+    float lut_scale;
+};
+
+/// Keeps the procedural texture sampler of the last register configuration drawn with.
+class ProcTexSamplerCache {
+public:
+    /// Returns the sampler of the registers, building it again if they have changed.
+    const ProcTexSampler& Get(const TexturingRegs& regs);
+
+private:
+    std::optional<ProcTexSampler> sampler;
+};
+
 } // namespace Pica::Rasterizer
@@ -4,7 +4,12 @@
 
 #pragma once
 
+#include "common/common_types.h"
+#include "video_core/regs.h"
 #include "video_core/shader/shader.h"
+#include "video_core/swrasterizer/fragment_pipeline.h"
+#include "video_core/swrasterizer/lighting.h"
+#include "video_core/swrasterizer/proctex.h"
 
 namespace Pica::Rasterizer {
 
@@ -39,6 +44,51 @@ struct Vertex : Shader::OutputVertex {
     }
 };
 
+/**
+ * The fragment state the rasterizer resolves from the registers, kept across triangles until one
+ * of the registers it is resolved from is written.
+ */
+class RasterizerState {
+public:
+    /// Marks the state resolved from the register as out of date.
+    void NotifyRegisterChanged(u32 id);
+
+    /// Marks all of the state as out of date, as when the registers are all replaced.
+    void Invalidate();
+
+    /// Returns the fragment pipeline of the registers. The result is valid until the next call.
+    const FragmentPipeline& GetFragmentPipeline(const Regs& regs);
+
+    /// Returns the fragment lighting of the registers.
+    const FragmentLighting& GetFragmentLighting(const LightingRegs& lighting);
+
+    /// Returns the procedural texture sampler of the registers.
+    const ProcTexSampler& GetProcTexSampler(const TexturingRegs& texturing);
+
+private:
+    enum : u8 {
+        FragmentPipelineOutOfDate = 1 << 0,
+        FragmentLightingOutOfDate = 1 << 1,
+        ProcTexSamplerOutOfDate = 1 << 2,
+        AllOutOfDate =
+            FragmentPipelineOutOfDate | FragmentLightingOutOfDate | ProcTexSamplerOutOfDate,
+    };
+
+    u8 out_of_date = AllOutOfDate;
+
+    FragmentPipelineCache fragment_pipeline_cache{64};
+    const FragmentPipeline* fragment_pipeline = nullptr;
+
+    FragmentLightingCache fragment_lighting_cache;
+    const FragmentLighting* fragment_lighting = nullptr;
+
+    ProcTexSamplerCache proctex_sampler_cache;
+    const ProcTexSampler* proctex_sampler = nullptr;
+};
+
+/// The state of the software rasterizer, which the register writes are forwarded to.
+extern RasterizerState g_rasterizer_state;
+
 void ProcessTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2);
 
 } // namespace Pica::Rasterizer
@@ -3,14 +3,28 @@
 // Refer to the license.txt file included.
 
 #include "video_core/swrasterizer/clipper.h"
+#include "video_core/swrasterizer/rasterizer.h"
 #include "video_core/swrasterizer/swrasterizer.h"
 
 namespace VideoCore {
 
+SWRasterizer::SWRasterizer() {
+    // The registers may have been written while another rasterizer was in use
+    Pica::Rasterizer::g_rasterizer_state.Invalidate();
+}
+
 void SWRasterizer::AddTriangle(const Pica::Shader::OutputVertex& v0,
                                const Pica::Shader::OutputVertex& v1,
                                const Pica::Shader::OutputVertex& v2) {
     Pica::Clipper::ProcessTriangle(v0, v1, v2);
 }
 
+void SWRasterizer::NotifyPicaRegisterChanged(u32 id) {
+    Pica::Rasterizer::g_rasterizer_state.NotifyRegisterChanged(id);
+}
+
+void SWRasterizer::SyncEntireState() {
+    Pica::Rasterizer::g_rasterizer_state.Invalidate();
+}
+
 } // namespace VideoCore
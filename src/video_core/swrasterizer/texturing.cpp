@@ -3,6 +3,9 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
 #include "common/assert.h"
 #include "common/common_types.h"
 #include "common/vector_math.h"
@@ -237,4 +240,72 @@ u8 AlphaCombine(TevStageConfig::Operation op, const std::array<u8, 3>& input) {
     }
 };
 
+// The functions above specialized for each value of their register field, and tables of the
+// specializations. The field is a constant in each of them, so their switches fold away.
+
+template <TevStageConfig::ColorModifier factor>
+static Common::Vec3<u8> ModifyColor(const Common::Vec4<u8>& values) {
+    return GetColorModifier(factor, values);
+}
+
+template <TevStageConfig::AlphaModifier factor>
+static u8 ModifyAlpha(const Common::Vec4<u8>& values) {
+    return GetAlphaModifier(factor, values);
+}
+
+template <TevStageConfig::Operation op>
+static Common::Vec3<u8> CombineColor(const Common::Vec3<u8> input[3]) {
+    return ColorCombine(op, input);
+}
+
+template <TevStageConfig::Operation op>
+static u8 CombineAlpha(const std::array<u8, 3>& input) {
+    return AlphaCombine(op, input);
+}
+
+template <std::size_t... factors>
+static constexpr std::array<ColorModifierFunc, sizeof...(factors)> MakeColorModifierFuncs(
+    std::index_sequence<factors...>) {
+    return {{&ModifyColor<static_cast<TevStageConfig::ColorModifier>(factors)>...}};
+}
+
+template <std::size_t... factors>
+static constexpr std::array<AlphaModifierFunc, sizeof...(factors)> MakeAlphaModifierFuncs(
+    std::index_sequence<factors...>) {
+    return {{&ModifyAlpha<static_cast<TevStageConfig::AlphaModifier>(factors)>...}};
+}
+
+template <std::size_t... ops>
+static constexpr std::array<ColorCombineFunc, sizeof...(ops)> MakeColorCombineFuncs(
+    std::index_sequence<ops...>) {
+    return {{&CombineColor<static_cast<TevStageConfig::Operation>(ops)>...}};
+}
+
+template <std::size_t... ops>
+static constexpr std::array<AlphaCombineFunc, sizeof...(ops)> MakeAlphaCombineFuncs(
+    std::index_sequence<ops...>) {
+    return {{&CombineAlpha<static_cast<TevStageConfig::Operation>(ops)>...}};
+}
+
+static constexpr auto color_modifier_funcs = MakeColorModifierFuncs(std::make_index_sequence<16>{});
+static constexpr auto alpha_modifier_funcs = MakeAlphaModifierFuncs(std::make_index_sequence<8>{});
+static constexpr auto color_combine_funcs = MakeColorCombineFuncs(std::make_index_sequence<16>{});
+static constexpr auto alpha_combine_funcs = MakeAlphaCombineFuncs(std::make_index_sequence<16>{});
+
+ColorModifierFunc GetColorModifierFunc(TevStageConfig::ColorModifier factor) {
+    return color_modifier_funcs[static_cast<std::size_t>(factor) % color_modifier_funcs.size()];
+}
+
+AlphaModifierFunc GetAlphaModifierFunc(TevStageConfig::AlphaModifier factor) {
+    return alpha_modifier_funcs[static_cast<std::size_t>(factor) % alpha_modifier_funcs.size()];
+}
+
+ColorCombineFunc GetColorCombineFunc(TevStageConfig::Operation op) {
+    return color_combine_funcs[static_cast<std::size_t>(op) % color_combine_funcs.size()];
+}
+
+AlphaCombineFunc GetAlphaCombineFunc(TevStageConfig::Operation op) {
+    return alpha_combine_funcs[static_cast<std::size_t>(op) % alpha_combine_funcs.size()];
+}
+
 } // namespace Pica::Rasterizer
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include "common/common_types.h"
 #include "common/vector_math.h"
 #include "video_core/regs_texturing.h"
@@ -12,6 +13,23 @@ namespace Pica::Rasterizer {
 
 int GetWrappedTexCoord(TexturingRegs::TextureConfig::WrapMode mode, int val, unsigned size);
 
+using ColorModifierFunc = Common::Vec3<u8> (*)(const Common::Vec4<u8>& values);
+using AlphaModifierFunc = u8 (*)(const Common::Vec4<u8>& values);
+using ColorCombineFunc = Common::Vec3<u8> (*)(const Common::Vec3<u8> input[3]);
+using AlphaCombineFunc = u8 (*)(const std::array<u8, 3>& input);
+
+/// Returns GetColorModifier specialized for the factor.
+ColorModifierFunc GetColorModifierFunc(TexturingRegs::TevStageConfig::ColorModifier factor);
+
+/// Returns GetAlphaModifier specialized for the factor.
+AlphaModifierFunc GetAlphaModifierFunc(TexturingRegs::TevStageConfig::AlphaModifier factor);
+
+/// Returns ColorCombine specialized for the operation.
+ColorCombineFunc GetColorCombineFunc(TexturingRegs::TevStageConfig::Operation op);
+
+/// Returns AlphaCombine specialized for the operation.
+AlphaCombineFunc GetAlphaCombineFunc(TexturingRegs::TevStageConfig::Operation op);
+
 Common::Vec3<u8> GetColorModifier(TexturingRegs::TevStageConfig::ColorModifier factor,
                                   const Common::Vec4<u8>& values);
 
@@ -6,6 +6,7 @@
 #include "common/archives.h"
 #include "common/logging/log.h"
 #include "core/settings.h"
+#include "video_core/gpu_thread.h"
 #include "video_core/pica.h"
 #include "video_core/pica_state.h"
 #include "video_core/renderer_base.h"
@@ -19,6 +20,7 @@
 namespace VideoCore {
 
 std::unique_ptr<RendererBase> g_renderer; ///< Renderer plugin
+std::unique_ptr<GPUThread> g_gpu_thread;
 
 std::atomic<bool> g_hw_renderer_enabled;
 std::atomic<bool> g_shader_jit_enabled;
@@ -45,6 +47,10 @@ ResultStatus Init(Frontend::EmuWindow& emu_window, Memory::MemorySystem& memory)
 
     OpenGL::GLES = Settings::values.use_gles;
 
+    if (Settings::values.use_async_gpu) {
+        g_gpu_thread = std::make_unique<GPUThread>(Settings::values.async_gpu_queue_depth);
+    }
+
     if (!emu_window.ShouldDeferRendererInit()) {
         g_renderer = std::make_unique<OpenGL::RendererOpenGL>(emu_window);
         ResultStatus result = g_renderer->Init();
@@ -64,6 +70,8 @@ ResultStatus Init(Frontend::EmuWindow& emu_window, Memory::MemorySystem& memory)
 
 /// Shutdown the video core
 void Shutdown() {
+    // Finish the queued work while the renderer it draws with still exists
+    g_gpu_thread.reset();
     Pica::Shutdown();
 
     g_renderer->ShutDown();
@@ -24,7 +24,11 @@ class MemorySystem;
 
 namespace VideoCore {
 
+class GPUThread;
+
 extern std::unique_ptr<RendererBase> g_renderer; ///< Renderer plugin
+/// Thread running GPU work asynchronously, or null if it runs on the emulation thread
+extern std::unique_ptr<GPUThread> g_gpu_thread;
 
 // TODO: Wrap these in a user settings struct along with any other graphics settings (often set from
 // qt ui)